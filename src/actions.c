@@ -4,6 +4,7 @@
 #include "layout.h"
 #include "tags.h"
 #include "parse.h" /* for showchain */
+#include "keytab.h" /* for findkey */
 #include "actions.h" /* verification */
 
 Bool
@@ -359,8 +360,6 @@ k_chain(XEvent *e, Key *key)
 		mod = CLEANMASK(ev.xkey.state);
 
 		switch (ev.type) {
-			Key *kp;
-
 		case KeyRelease:
 			XPRINTF("KeyRelease: 0x%02lx %s\n", mod, XKeysymToString(keysym));
 			/* a key release other than the active key is a release of a
@@ -383,13 +382,8 @@ k_chain(XEvent *e, Key *key)
 					k->stop(&ev, k);
 				return;
 			}
-			for (kp = key->chain; !k && kp; kp = kp->cnext) {
-				XPRINTF("KeyPress: checking 0x%02lx %s against 0x%02lx %s\n",
-						mod, XKeysymToString(keysym),
-						kp->mod, XKeysymToString(kp->keysym));
-				if (kp->keysym == keysym && kp->mod == mod)
-					k = kp;
-			}
+			if (!k)
+				k = findkey(key, keysym, mod);
 			if (k) {
 				XPRINTF("KeyPress: activating action for chain: %s\n", showchain(k));
 				if (k->func)
@@ -5,15 +5,21 @@
 #include "ewmh.h"
 #include "layout.h"
 #include "parse.h"
+#include "keytab.h"
 #include "buttons.h"
 #include "tags.h"
 #include "actions.h"
 #include "config.h"
 #include "image.h"
 #include "icons.h"
+#include "decode.h"
+#include "phase.h"
+#include "watch.h"
+#include "prof.h"
+#include "trace.h"
+#include "evstat.h"
 #include "save.h"
-
-#define EXTRANGE    16		/* all X11 extension event must fit in this range */
+#include "record.h"
 
 /* function declarations */
 void compileregs(void);
@@ -27,6 +33,7 @@ void freemonitors(void);
 void updatemonitors(XEvent *e, unsigned n, Bool size, Bool full);
 void manage(Window w, XWindowAttributes *wa);
 void restack_belowif(Client *c, Client *sibling);
+void replay(void);
 void run(void);
 void scan(void);
 void tag(Client *c, int index);
@@ -86,6 +93,16 @@ Bool lockfocus = False;
 unsigned long focus_request = 0;
 Appl *appls = NULL;
 Class *classes = NULL;
+
+/* Class and Appl records are also chained into hash tables that are doubled
+ * whenever they hold more records than buckets, so that looking them up when
+ * a window is managed takes constant time however many there are. */
+static Class **classtab = NULL;
+static unsigned classbkts = 0, nclasses = 0;
+#ifdef STARTUP_NOTIFICATION
+static Appl **appltab = NULL;
+static unsigned applbkts = 0, nappls = 0;
+#endif
 Client *focuslock = NULL;
 Client *sel;
 Client *gave;				/* gave focus last */
@@ -96,6 +113,7 @@ XContext context[PartLast];
 Cursor cursor[CursorLast];
 Rule **rules;
 int nrules;
+unsigned rulegen = 1;			/* bumped when rules are reloaded */
 unsigned int modkey;
 unsigned int numlockmask;
 unsigned int scrlockmask;
@@ -106,6 +124,16 @@ Group systray = { NULL, 0, 0 };
 
 char *clientId = NULL;
 
+#ifdef XSHM
+static Status
+xshmqueryversion(Display *dsply, int *major, int *minor)
+{
+	Bool pixmaps;
+
+	return XShmQueryVersion(dsply, major, minor, &pixmaps);
+}
+#endif
+
 ExtensionInfo einfo[BaseLast] = {
 	/* *INDENT-OFF* */
 #if 1
@@ -134,6 +162,9 @@ ExtensionInfo einfo[BaseLast] = {
 #endif
 #ifdef SHAPE
 	[XshapeBase]	 = { .name = "SHAPE",	  .version = &XShapeQueryVersion,	},
+#endif
+#ifdef XSHM
+	[XshmBase]	 = { .name = "MIT-SHM",	  .version = &xshmqueryversion,	},
 #endif
 	/* *INDENT-ON* */
 };
@@ -320,25 +351,107 @@ applyatoms(Client *c)
 
 static Monitor *nearmonitor(void);
 
+/* tags matched by the tag regex of rule i on the current screen: computed
+ * for all rules whenever the rule set or the tag names change */
+static unsigned long long
+ruletags(int i)
+{
+	regmatch_t tmp;
+	int k;
+	unsigned j;
+
+	if (!scr->ruletags) {
+		scr->ruletags = ecalloc(64, sizeof(*scr->ruletags));
+		for (k = 0; k < nrules; k++) {
+			if (!rules[k]->tagregex)
+				continue;
+			for (j = 0; j < MAXTAGS; j++)
+				if (!regexec(rules[k]->tagregex, scr->tags[j].name, 1, &tmp, 0))
+					scr->ruletags[k] |= (1ULL << j);
+		}
+	}
+	return (scr->ruletags[i] & ((1ULL << scr->ntags) - 1));
+}
+
+void
+invalidateruletags(AScreen *ds)
+{
+	free(ds->ruletags);
+	ds->ruletags = NULL;
+}
+
+void
+invalidaterules(void)
+{
+	AScreen *s;
+
+	rulegen++;
+	for (s = screens; s && s < screens + nscr; s++)
+		invalidateruletags(s);
+}
+
+/* bit mask of the rules whose prop regex matches the client: results are
+ * cached against the Class of the client keyed by its interned role and name,
+ * of which the cache holds a reference so that they cannot be freed and their
+ * addresses reused for other strings while the Class outlives its clients */
+static unsigned long long
+matchrules(Client *c)
+{
+	static char buf[512];
+	unsigned long long matches = 0;
+	regmatch_t tmp;
+	Class *k;
+	int i;
+	Rule *r;
+
+	/* one bit per rule: initrules() reads at most 64 rules */
+	assert(nrules <= 64);
+	if ((k = getclass(c)) && k->rules.gen == rulegen &&
+	    k->rules.wm_role == c->wm_role && k->rules.wm_name == c->wm_name)
+		return (k->rules.matches);
+	snprintf(buf, sizeof(buf), "%s:%s:%s:%s",
+			c->ch.res_class ? : "", c->ch.res_name ? : "",
+			c->wm_role ? : "", c->wm_name ? : "");
+	buf[LENGTH(buf) - 1] = 0;
+	for (i = 0; i < nrules; i++) {
+		r = rules[i];
+		if (!r->propregex)
+			continue;
+		/* anchored rules cannot match without their literal prefix */
+		if (r->prefix && strncmp(buf, r->prefix, r->prefixlen))
+			continue;
+		if (!regexec(r->propregex, buf, 1, &tmp, 0))
+			matches |= (1ULL << i);
+	}
+	if (k) {
+		k->rules.gen = rulegen;
+		if (k->rules.wm_role != c->wm_role) {
+			unintern(k->rules.wm_role);
+			k->rules.wm_role = intern(c->wm_role);
+		}
+		if (k->rules.wm_name != c->wm_name) {
+			unintern(k->rules.wm_name);
+			k->rules.wm_name = intern(c->wm_name);
+		}
+		k->rules.matches = matches;
+	}
+	return (matches);
+}
+
 static void
 applyrules(Client *c)
 {
-	static char buf[512];
 	int i;
-	unsigned j;
-	regmatch_t tmp;
+	unsigned long long matches, tags;
 	Bool matched = False;
 	View *cv = c->cview ? : selview();
 	Monitor *cm = (cv && cv->curmon) ? cv->curmon : nearmonitor(); /* XXX: necessary? */
 	Rule *r;
 
 	/* rule matching */
-	snprintf(buf, sizeof(buf), "%s:%s:%s:%s",
-			c->ch.res_class ? : "", c->ch.res_name ? : "",
-			c->wm_role ? : "", c->wm_name ? : "");
-	buf[LENGTH(buf) - 1] = 0;
+	matches = matchrules(c);
 	for (i = 0, r = rules[0]; i < nrules; i++, r = rules[i])
-		if (r->propregex && !regexec(r->propregex, buf, 1, &tmp, 0)) {
+		if (matches & (1ULL << i)) {
 #if 1
 			if (r->is.set.is) {
 				c->is.is |= (r->is.set.is & r->is.is.is);
@@ -362,13 +475,9 @@ applyrules(Client *c)
 			if (!(c->has.title = r->hastitle))
 				c->has.grips = False;
 #endif
-			if (r->tagregex) {
-				for (j = 0; j < scr->ntags; j++) {
-					if (!regexec(r->tagregex, scr->tags[j].name, 1, &tmp, 0)) {
-						matched = True;
-						c->tags |= (1ULL << j);
-					}
-				}
+			if (r->tagregex && (tags = ruletags(i))) {
+				matched = True;
+				c->tags |= tags;
 			}
 		}
 	if (!matched && cm)
@@ -1002,6 +1111,12 @@ cleanup(WithdrawCause cause)
 		freestyle();
 		XUngrabKey(dpy, AnyKey, AnyModifier, scr->root);
 	}
+	freewatch();
+	freedecode();
+	freeimage();
+	freephases();
+	internstats();
+	iconstats();
 
 	XFreeCursor(dpy, cursor[CursorTopLeft]);
 	XFreeCursor(dpy, cursor[CursorTop]);
@@ -1067,7 +1182,7 @@ destroynotify(XEvent *e)
 	XDestroyWindowEvent *ev = &e->xdestroywindow;
 
 	if ((c = getmanaged(ev->window, ClientWindow))) {
-		XPRINTF(c, "unmanage destroyed window\n");
+		XCPRINTF(c, "unmanage destroyed window\n");
 		unmanage(c, CauseDestroyed);
 		return True;
 	}
@@ -1086,6 +1201,8 @@ ecalloc(size_t nmemb, size_t size)
 {
 	void *res = calloc(nmemb, size);
 
+	/* also called from the icon decoding threads */
+	__atomic_fetch_add(&profallocs, 1, __ATOMIC_RELAXED);
 	if (!res)
 		eprint("fatal: could not calloc() %z x %z bytes\n", nmemb, size);
 	return res;
@@ -1102,11 +1219,120 @@ erealloc(void *ptr, size_t size)
 {
 	void *res;
 
+	__atomic_fetch_add(&profallocs, 1, __ATOMIC_RELAXED);
 	if (!(res = realloc(ptr, size)))
 		eprint("fatal: could not realloc() %z bytes\n", size);
 	return res;
 }
 
+unsigned
+strhash(unsigned hash, const char *str)
+{
+	if (str)
+		while (*str)
+			hash = (hash ^ (unsigned char) *str++) * 16777619U;	/* FNV-1a */
+	return (hash);
+}
+
+/*
+ * Client identity strings (WM_CLASS, WM_WINDOW_ROLE, session names and dock
+ * application commands) are interned: equal strings share a single reference
+ * counted copy, so that they can be compared by pointer.
+ */
+
+typedef struct Interned Interned;
+
+struct Interned {
+	Interned *next;			/* next in hash bucket */
+	unsigned hash;			/* hash of string */
+	unsigned refs;			/* references to string */
+	size_t len;			/* length of string */
+	char str[];			/* the string itself */
+};
+
+static Interned **interntab = NULL;
+static unsigned internbkts = 0, ninterned = 0;
+static size_t internbytes = 0, rawbytes = 0;
+
+#define INTERNED(str) ((Interned *) ((str) - offsetof(Interned, str)))
+
+const char *
+intern(const char *str)
+{
+	Interned *s, **tab;
+	unsigned hash, i;
+	size_t len;
+
+	if (!str)
+		return (NULL);
+	hash = strhash(HASHINIT, str);
+	len = strlen(str);
+	if (interntab)
+		for (s = interntab[hash & (internbkts - 1)]; s; s = s->next)
+			if (s->hash == hash && s->len == len && !memcmp(s->str, str, len)) {
+				s->refs++;
+				rawbytes += len + 1;
+				return (s->str);
+			}
+	if (ninterned >= internbkts) {
+		unsigned bkts = internbkts ? internbkts << 1 : 256;
+
+		tab = ecalloc(bkts, sizeof(*tab));
+		for (i = 0; i < internbkts; i++)
+			while ((s = interntab[i])) {
+				interntab[i] = s->next;
+				s->next = tab[s->hash & (bkts - 1)];
+				tab[s->hash & (bkts - 1)] = s;
+			}
+		free(interntab);
+		interntab = tab;
+		internbkts = bkts;
+	}
+	s = emallocz(sizeof(*s) + len + 1);
+	s->hash = hash;
+	s->refs = 1;
+	s->len = len;
+	memcpy(s->str, str, len + 1);
+	s->next = interntab[hash & (internbkts - 1)];
+	interntab[hash & (internbkts - 1)] = s;
+	ninterned++;
+	internbytes += len + 1;
+	rawbytes += len + 1;
+	return (s->str);
+}
+
+void
+unintern(const char *str)
+{
+	Interned *s, **sp;
+
+	if (!str)
+		return;
+	s = INTERNED(str);
+	rawbytes -= s->len + 1;
+	if (--s->refs)
+		return;
+	for (sp = &interntab[s->hash & (internbkts - 1)]; *sp && *sp != s; sp = &(*sp)->next) ;
+	assert(*sp == s);
+	*sp = s->next;
+	ninterned--;
+	internbytes -= s->len + 1;
+	free(s);
+}
+
+unsigned
+internhash(const char *str)
+{
+	return (str ? INTERNED(str)->hash : 0);
+}
+
+void
+internstats(void)
+{
+	OPRINTF("interned strings: %u strings, %zu bytes for %zu bytes referenced\n",
+		ninterned, internbytes, rawbytes);
+}
+
 static Bool
 motionnotify(XEvent *e)
 {
@@ -1233,7 +1459,7 @@ enternotify(XEvent *e)
 	if ((c = findmanaged(ev->window))) {
 		if (ev->detail == NotifyInferior)
 			return False;
-		XPRINTF(c, "EnterNotify received\n");
+		XCPRINTF(c, "EnterNotify received\n");
 		enterclient(e, c);
 		if (c != sel)
 			installcolormaps(event_scr, c, c->cmapwins);
@@ -1347,7 +1573,7 @@ damagenotify(XEvent *e)
 	Client *c;
 
 	if ((c = getmanaged(ev->drawable, ClientWindow))) {
-		XPRINTF(c, "Got damage notify, redrawing damage \n");
+		XCPRINTF(c, "Got damage notify, redrawing damage \n");
 		return drawdamage(c, ev);
 	}
 	return False;
@@ -1362,7 +1588,7 @@ shapenotify(XEvent *e)
 	Client *c;
 
 	if ((c = getmanaged(ev->window, ClientWindow))) {
-		XPRINTF(c, "Got shape notify, redrawing shapes \n");
+		XCPRINTF(c, "Got shape notify, redrawing shapes \n");
 		if (!c->is.dockapp)
 			return configureshapes(c);
 	}
@@ -1442,7 +1668,7 @@ static void
 setfocus(Client *c)
 {
 	if (focusok(c)) {
-		XPRINTF(c, "setting focus\n");
+		XCPRINTF(c, "setting focus\n");
 		if (c->can.focus & GIVE_FOCUS)
 			XSetInputFocus(dpy, c->icon ? : c->win, RevertToPointerRoot, user_time);
 		if (c->can.focus & TAKE_FOCUS) {
@@ -1470,7 +1696,7 @@ setfocus(Client *c)
 			XSetInputFocus(dpy, PointerRoot, revert, user_time);
 	} else {
 		/* this happens often now */
-		XPRINTF(c, "cannot set focus\n");
+		XCPRINTF(c, "cannot set focus\n");
 	}
 }
 
@@ -1592,7 +1818,7 @@ focus(Client *c)
 		return;
 	ewmh_update_net_active_window();
 	if (c && c != o) {
-		XPRINTF(c, "selecting\n");
+		XCPRINTF(c, "selecting\n");
 		setselected(c);
 		/* clear urgent */
 		if (c->is.attn) {
@@ -1612,7 +1838,7 @@ focus(Client *c)
 			arrange(c->cview);
 	}
 	if (o && o != c) {
-		XPRINTF(o, "deselecting\n");
+		XCPRINTF(o, "deselecting\n");
 		drawclient(o); /* just for focus change */
 		lowertiled(o); /* does nothing at the moment */
 		XSetWindowBorder(dpy, o->frame, scr->style.color.norm[ColBorder].pixel);
@@ -2112,9 +2338,10 @@ getresource(const char *resource, const char *defval)
 
 	snprintf(name, sizeof(name), "%s.%s", RESNAME, resource);
 	snprintf(clas, sizeof(clas), "%s.%s", RESCLASS, resource);
-	if (XrmGetResource(xrdb, name, clas, &type, &value) && value.addr)
-		return value.addr;
-	return defval;
+	if (!XrmGetResource(xrdb, name, clas, &type, &value))
+		value.addr = NULL;
+	phaseres(name, clas, value.addr);
+	return (value.addr ? : defval);
 }
 
 const char *
@@ -2125,9 +2352,10 @@ getscreenres(const char *resource, const char *defval)
 
 	snprintf(name, sizeof(name), "%s.screen%d.%s", RESNAME, scr->screen, resource);
 	snprintf(clas, sizeof(clas), "%s.Screen%d.%s", RESCLASS, scr->screen, resource);
-	if (XrmGetResource(xrdb, name, clas, &type, &value) && value.addr)
-		return value.addr;
-	return defval;
+	if (!XrmGetResource(xrdb, name, clas, &type, &value))
+		value.addr = NULL;
+	phaseres(name, clas, value.addr);
+	return (value.addr ? : defval);
 }
 
 const char *
@@ -2138,9 +2366,10 @@ getsessionres(const char *resource, const char *defval)
 
 	snprintf(name, sizeof(name), "%s.session.%s", RESNAME, resource);
 	snprintf(clas, sizeof(clas), "%s.Session.%s", RESCLASS, resource);
-	if (XrmGetResource(xrdb, name, clas, &type, &value) && value.addr)
-		return value.addr;
-	return defval;
+	if (!XrmGetResource(xrdb, name, clas, &type, &value))
+		value.addr = NULL;
+	phaseres(name, clas, value.addr);
+	return (value.addr ? : defval);
 }
 
 const char *
@@ -2322,6 +2551,7 @@ grabkeys(void)
 	Key *k;
 
 	XUngrabKey(dpy, AnyKey, AnyModifier, scr->root);
+	hashkeys();
 	for (k = scr->keylist; k; k = k->cnext) {
 		if ((code = XKeysymToKeycode(dpy, k->keysym))) {
 			for (j = 0; j < LENGTH(modifiers); j++)
@@ -2379,11 +2609,8 @@ keypress(XEvent *e)
 					k->stop(&ev, k);
 				k = NULL;
 			}
-			if (!k) {
-				for (k = scr->keylist; k; k = k->cnext)
-					if (k->keysym == keysym && k->mod == mod)
-						break;
-			}
+			if (!k)
+				k = findkey(NULL, keysym, mod);
 			if (k) {
 				XPRINTF("KeyPress: activating action for chain: %s\n", showchain(k));
 				handled = True;
@@ -2518,12 +2745,12 @@ void
 show_client_state(Client *c)
 {
 	(void) c;
-	XPRINTF(c, "%-20s: 0x%08x\n", "wintype", c->wintype);
-	XPRINTF(c, "%-20s: 0x%08x\n", "skip.skip", c->skip.skip);
-	XPRINTF(c, "%-20s: 0x%08x\n", "is.is", c->is.is);
-	XPRINTF(c, "%-20s: 0x%08x\n", "has.has", c->has.has);
-	XPRINTF(c, "%-20s: 0x%08x\n", "needs.has", c->needs.has);
-	XPRINTF(c, "%-20s: 0x%08x\n", "can.can", c->can.can);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "wintype", c->wintype);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "skip.skip", c->skip.skip);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "is.is", c->is.is);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "has.has", c->has.has);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "needs.has", c->needs.has);
+	XCPRINTF(c, "%-20s: 0x%08x\n", "can.can", c->can.can);
 }
 
 static void
@@ -2951,7 +3178,7 @@ manage(Window w, XWindowAttributes *wa)
 	ewmh_process_net_startup_id(c);
 	ewmh_update_net_window_desktop(c);
 	ewmh_update_net_window_extents(c);
-	XPRINTF(c, "updating icon due initial manage\n");
+	XCPRINTF(c, "updating icon due initial manage\n");
 	ewmh_process_net_window_icon(c);
 	ewmh_update_ob_app_props(c);
 
@@ -3233,7 +3460,7 @@ sync_request(Client *c, Time time)
 	if (overflow)
 		XSyncMinValue(&c->sync.val);
 
-	XPRINTF(c, "Arming alarm 0x%08lx\n", c->sync.alarm);
+	XCPRINTF(c, "Arming alarm 0x%08lx\n", c->sync.alarm);
 	aa.trigger.counter = c->sync.counter;
 	aa.trigger.wait_value = c->sync.val;
 	aa.trigger.value_type = XSyncAbsolute;
@@ -3244,7 +3471,7 @@ sync_request(Client *c, Time time)
 			 XSyncCACounter | XSyncCAValueType | XSyncCAValue |
 			 XSyncCATestType | XSyncCAEvents, &aa);
 
-	XPRINTF(c, "%s", "Sending client meessage\n");
+	XCPRINTF(c, "%s", "Sending client meessage\n");
 	ce.xclient.type = ClientMessage;
 	ce.xclient.message_type = _XA_WM_PROTOCOLS;
 	ce.xclient.display = dpy;
@@ -3290,7 +3517,7 @@ alarmnotify(XEvent *e)
 		XPRINTF("Recevied alarm notify for unknown alarm 0x%08lx\n", ae->alarm);
 		return False;
 	}
-	XPRINTF(c, "alarm notify on 0x%08lx\n", ae->alarm);
+	XCPRINTF(c, "alarm notify on 0x%08lx\n", ae->alarm);
 	if (!c->sync.waiting) {
 		XPRINTF("%s", "Alarm was cancelled!\n");
 		return True;
@@ -3333,7 +3560,7 @@ reparentnotify(XEvent *e)
 
 	if ((c = getmanaged(ev->window, ClientWindow))) {
 		if (ev->parent != c->frame) {
-			XPRINTF(c, "unmanage reparented window\n");
+			XCPRINTF(c, "unmanage reparented window\n");
 			unmanage(c, CauseReparented);
 		}
 		return True;
@@ -3562,7 +3789,7 @@ updatesessionprop(Client *c, Atom prop, int state)
 	}
 	return True;
       bad:
-	XPRINTF(c, "bad attempt to change client leader %s\n", (name = XGetAtomName(dpy, prop)));
+	XCPRINTF(c, "bad attempt to change client leader %s\n", (name = XGetAtomName(dpy, prop)));
 	if (name)
 		XFree(name);
 	return False;
@@ -3737,10 +3964,10 @@ updateleaderprop(Client *c, Atom prop, int state)
 			/* Set of icons to display.  We don't do this so we can ignore
 			   it.  At some point we might display iconified windows in a
 			   windowmaker-style clip. */
-			XPRINTF(c, "updating icon due to _NET_WM_ICON update\n");
+			XCPRINTF(c, "updating icon due to _NET_WM_ICON update\n");
 			ewmh_process_net_window_icon(c);
 		} else if (prop == _XA_KWM_WIN_ICON) {
-			XPRINTF(c, "updating icon due to KWM_WIN_ICON update\n");
+			XCPRINTF(c, "updating icon due to KWM_WIN_ICON update\n");
 			ewmh_process_net_window_icon(c);
 		} else if (prop == _XA_NET_WM_PID) {
 			/* Normally set on individual (managed) windows.  This property
@@ -3794,7 +4021,7 @@ updateleaderprop(Client *c, Atom prop, int state)
 	}
 	return True;
       bad:
-	XPRINTF(c, "bad attempt to change group leader %s\n", (name = XGetAtomName(dpy, prop)));
+	XCPRINTF(c, "bad attempt to change group leader %s\n", (name = XGetAtomName(dpy, prop)));
 	if (name)
 		XFree(name);
 	return False;
@@ -3966,10 +4193,10 @@ updateclientprop(Client *c, Atom prop, int state)
 			/* Set of icons to display.  We don't do this so we can ignore
 			   it.  At some point we might display iconified windows in a
 			   windowmaker-style clip. */
-			XPRINTF(c, "updating icon due to _NET_WM_ICON update\n");
+			XCPRINTF(c, "updating icon due to _NET_WM_ICON update\n");
 			ewmh_process_net_window_icon(c);
 		} else if (prop == _XA_KWM_WIN_ICON) {
-			XPRINTF(c, "updating icon due to KWM_WIN_ICON update\n");
+			XCPRINTF(c, "updating icon due to KWM_WIN_ICON update\n");
 			ewmh_process_net_window_icon(c);
 		} else if (prop == _XA_NET_WM_PID) {
 			/* This property should not change after the window is managed,
@@ -4020,7 +4247,7 @@ updateclientprop(Client *c, Atom prop, int state)
 	}
 	return True;
       bad:
-	XPRINTF(c, "bad attempt to change client %s\n", (name = XGetAtomName(dpy, prop)));
+	XCPRINTF(c, "bad attempt to change client %s\n", (name = XGetAtomName(dpy, prop)));
 	if (name)
 		XFree(name);
 	return False;
@@ -4177,7 +4404,7 @@ void
 quit(const char *arg)
 {
 	running = False;
-	if (arg) {
+	if (arg && !replaying) {
 		XPRINTF("cleanup switching\n");
 		cleanup(CauseSwitching);
 		XCloseDisplay(dpy);
@@ -4190,6 +4417,8 @@ void
 restart(const char *arg)
 {
 	running = False;
+	if (replaying)
+		return;		/* ends the replay */
 	if (arg) {
 		XPRINTF("cleanup switching\n");
 		cleanup(CauseSwitching);
@@ -4197,17 +4426,13 @@ restart(const char *arg)
 		execlp("sh", "sh", "-c", arg, NULL);
 		eprint("Can't exec sh -c \"%s\": %s\n", arg, strerror(errno));
 	} else {
-		char **argv;
-		int i;
-
 		/* argv must be NULL terminated and writable */
-		argv = calloc(cargc + 1, sizeof(*argv));
-		for (i = 0; i < cargc; i++)
-			argv[i] = strdup(cargv[i]);
+		char **argv = recordargv(cargc, cargv);
 
 		XPRINTF("cleanup restarting\n");
 		cleanup(CauseRestarting);
 		XCloseDisplay(dpy);
+		recordclose();
 		execvp(argv[0], argv);
 		eprint("Can't restart: %s\n", strerror(errno));
 	}
@@ -4218,9 +4443,13 @@ handle_event(XEvent *ev)
 {
 	int i;
 
-	if (ev->type <= LASTEvent) {
+	if (recording)
+		recordhandle(ev);
+	else if (replaying)
+		replayhandle(ev);
+	if (ev->type < LASTEvent) {
 		if (handler[ev->type])
-			return (handler[ev->type]) (ev);
+			return evstathandle(ev->type, handler[ev->type], ev);
 	} else
 		for (i = BaseLast - 1; i >= 0; i--) {
 			if (!einfo[i].have)
@@ -4229,7 +4458,7 @@ handle_event(XEvent *ev)
 				int slot = ev->type - einfo[i].event + LASTEvent + EXTRANGE * i;
 
 				if (handler[slot])
-					return (handler[slot]) (ev);
+					return evstathandle(slot, handler[slot], ev);
 			}
 		}
 	XPRINTF("WARNING: No handler for event type %d\n", ev->type);
@@ -4281,6 +4510,21 @@ geteventscr(XEvent *ev)
 	return (event_scr);
 }
 
+/* handle recorded events instead of those from the server */
+void
+replay(void)
+{
+	XEvent ev;
+
+	XSync(dpy, False);
+	while (running && replaynext(&ev)) {
+		scr = geteventscr(&ev);
+		if (!handle_event(&ev))
+			DPRINTF("WARNING: Event %d not handled\n", ev.type);
+	}
+	replaydone();
+}
+
 void
 run(void)
 {
@@ -4291,7 +4535,11 @@ run(void)
 	XSync(dpy, False);
 	xfd = ConnectionNumber(dpy);
 	while (running) {
-		struct pollfd pfd = { xfd, POLLIN | POLLERR | POLLHUP, 0 };
+		struct pollfd pfd[3] = {
+			{ xfd, POLLIN | POLLERR | POLLHUP, 0 },
+			{ decodefd(), POLLIN, 0 },	/* ignored when -1 */
+			{ watchfd(), POLLIN, 0 }	/* ignored when -1 */
+		};
 		int sig;
 
 		if ((sig = signum)) {
@@ -4311,35 +4559,45 @@ run(void)
 			case SIGCHLD:
 				while (waitpid(-1, &sig, WNOHANG) > 0) ;
 				break;
+			case SIGUSR1:
+				evstatdump();
+				break;
 			default:
 				break;
 			}
 		}
 
-		if (poll(&pfd, 1, -1) == -1) {
+		/* events already read into the queue (by the round trips of a
+		   reload, say) are not seen by poll(): do not block on them */
+		if (poll(pfd, 3, QLength(dpy) ? 0 : watchtimeout()) == -1) {
 			if (errno == EAGAIN || errno == EINTR || errno == ERESTART) {
 				errno = 0;
 				continue;
 			}
 			eprint("%s", "poll failed: %s\n", strerror(errno));
 		} else {
-			if (pfd.revents & (POLLNVAL | POLLHUP | POLLERR)) {
-				if (pfd.revents & POLLNVAL)
+			if (pfd[0].revents & (POLLNVAL | POLLHUP | POLLERR)) {
+				if (pfd[0].revents & POLLNVAL)
 					EPRINTF("POLLNVAL bit set!\n");
-				if (pfd.revents & POLLHUP)
+				if (pfd[0].revents & POLLHUP)
 					EPRINTF("POLLHUP bit set!\n");
-				if (pfd.revents & POLLERR)
+				if (pfd[0].revents & POLLERR)
 					EPRINTF("POLLERR bit set!\n");
 				eprint("%s", "poll error\n");
 			}
-			if (pfd.revents & POLLIN) {
-				while (running && XPending(dpy)) {
-					XNextEvent(dpy, &ev);
-					scr = geteventscr(&ev);
-					DPRINTF("Got an event!\n");
-					if (!handle_event(&ev))
-						DPRINTF("WARNING: Event %d not handled\n", ev.type);
-				}
+			if (pfd[1].revents & POLLIN)
+				decodedone();
+			if (pfd[2].revents & POLLIN)
+				watchevents();
+			watchexpire();
+			/* whichever descriptor fired: decodedone() and reloads from
+			   watchexpire() make round trips that queue events */
+			while (running && XPending(dpy)) {
+				XNextEvent(dpy, &ev);
+				scr = geteventscr(&ev);
+				DPRINTF("Got an event!\n");
+				if (!handle_event(&ev))
+					DPRINTF("WARNING: Event %d not handled\n", ev.type);
 			}
 		}
 	}
@@ -5228,6 +5486,10 @@ initmonitors(XEvent *e)
 void
 sighandler(int sig)
 {
+	if (sig == SIGUSR2) {
+		tracedump();	/* now, even when the event loop is stuck */
+		return;
+	}
 	signum = sig;
 }
 
@@ -5428,10 +5690,37 @@ initdirs(Bool reload __attribute__((unused)))
 	}
 }
 
+/*
+ * Runs one initialization phase, recording its inputs.  On reload the phase
+ * is skipped when none of the resources or files that it read the last time
+ * have changed, unless full is set because something it builds on changed.
+ * Returns whether it ran.
+ */
+static Bool
+initphase(InitPhase phase, void (*init) (Bool), Bool reload, Bool full, const char *what)
+{
+	InitPhase prev;
+
+	if (reload && !full && !phasechanged(phase)) {
+		OPRINTF("%s unchanged\n", what);
+		return False;
+	}
+	OPRINTF("initializing %s\n", what);
+	/* phases from PhaseScreen on are run for each screen */
+	profbegin(what, phase >= PhaseScreen ? scr->screen : -1);
+	prev = beginphase(phase);
+	init(reload);
+	endphase(prev);
+	profend();
+	return True;
+}
+
 void
 initialize(const char *conf, AdwmOperations * ops, Bool reload __attribute__((unused)))
 {
 	char *owd;
+	Bool full, scrfull, keys;
+	InitPhase prev;
 
 	/* save original working directory to restore after processing rc files */
 	owd = ecalloc(PATH_MAX, sizeof(*owd));
@@ -5439,65 +5728,112 @@ initialize(const char *conf, AdwmOperations * ops, Bool reload __attribute__((un
 		strcpy(owd, "/");
 
 	OPRINTF("initializing cursors\n");
+	profbegin("cursors", -1);
 	initcursors(reload);	/* init cursors */
+	profend();
 	OPRINTF("initializing modifier map\n");
+	profbegin("modifier map", -1);
 	initmodmap(reload);	/* init modifier map */
+	profend();
 	OPRINTF("initializing event selection\n");
+	profbegin("event selection", -1);
 	initselect(reload);	/* select for events */
+	profend();
 	OPRINTF("initializing startup notification\n");
+	profbegin("startup notification", -1);
 	initstartup(reload);	/* init startup notification */
+	profend();
 
 	OPRINTF("initializing home and XDG directories\n");
+	profbegin("directories", -1);
 	initdirs(reload);	/* init HOME and XDG directories */
+	profend();
 	OPRINTF("initializing location of config file\n");
+	profbegin("configuration files", -1);
 	initrcfile(conf, reload);	/* find the configuration file */
-	OPRINTF("initializing client rules\n");
-	initrules(reload);	/* initialize window class.name rules */
+	profend();
+
+	/* The configuration is always redone: options point into the database.
+	   When it changed, everything else is redone too. */
+	full = !reload || phasechanged(PhaseConfig);
+	/* initialize window class.name rules */
+	initphase(PhaseRules, initrules, reload, full, "client rules");
 	OPRINTF("initializing configuration\n");
+	profbegin("configuration", -1);
+	prev = beginphase(PhaseConfig);
 	initconfig(reload);	/* initialize configuration */
-	OPRINTF("initializing icon theme\n");
-	initicons(reload);	/* initialize icon theme */
+	endphase(prev);
+	profend();
+	/* initialize icon theme */
+	initphase(PhaseIcons, initicons, reload, full, "icon theme");
 
 	for (scr = screens; scr < screens + nscr; scr++) {
 		if (!scr->managed)
 			continue;
 
+		scrfull = full || phasechanged(PhaseScreen);
+		profbegin("screen", scr->screen);
+		prev = beginphase(PhaseScreen);
 		OPRINTF("initializing screen\n");
 		initscreen(reload);	/* init per-screen configuration */
 		OPRINTF("initializing EWMH atoms and root properties\n");
 		initewmh(ops->name);	/* init EWMH atoms */
 		OPRINTF("initializing tags (desktops)\n");
 		inittags(reload);	/* init tags */
+		endphase(prev);
+		profend();
 
 		if (!reload) {
 			OPRINTF("initializing monitor geometry\n");
+			profbegin("monitors", scr->screen);
 			initmonitors(NULL);	/* init geometry */
+			profend();
 			/* Cannot do this on reload: it resets current views. */
 		}
 
-		OPRINTF("initializing key bindings\n");
-		initkeys(reload);	/* init key bindings */
-		OPRINTF("initializing button bindings\n");
-		initbuttons(reload);	/* init button bindings */
-		OPRINTF("showing button bindings\n");
-		showbuttons();
+		/* init key bindings */
+		keys = initphase(PhaseKeys, initkeys, reload, scrfull, "key bindings");
+		/* init button bindings */
+		if (initphase(PhaseButtons, initbuttons, reload, scrfull, "button bindings")) {
+			OPRINTF("showing button bindings\n");
+			showbuttons();
+		}
 		OPRINTF("initializing dock\n");
+		profbegin("dock", scr->screen);
 		initdock(reload);	/* initialize dock */
+		profend();
 		OPRINTF("initializing layouts and views\n");
+		profbegin("views", scr->screen);
 		initviews(reload);	/* initialize layouts */
+		profend();
 
-		OPRINTF("initializing key grabs\n");
-		grabkeys();
+		if (keys) {
+			OPRINTF("initializing key grabs\n");
+			profbegin("key grabs", scr->screen);
+			grabkeys();
+			profend();
+		}
 
-		OPRINTF("initializing style\n");
-		initstyle(reload);	/* init appearance */
-		OPRINTF("initializing struts and workareas\n");
-		initstruts(reload);	/* initialize struts and workareas */
-		OPRINTF("initializing icon sizes\n");
-		initsizes(reload);	/* init icon sizes */
+		/* init appearance */
+		if (initphase(PhaseStyle, initstyle, reload, scrfull, "style")) {
+			OPRINTF("initializing struts and workareas\n");
+			profbegin("struts", scr->screen);
+			initstruts(reload);	/* initialize struts and workareas */
+			profend();
+			OPRINTF("initializing icon sizes\n");
+			profbegin("icon sizes", scr->screen);
+			initsizes(reload);	/* init icon sizes */
+			profend();
+		} else if (phasechanged(PhaseColors)) {
+			OPRINTF("initializing style colors\n");
+			profbegin("colors", scr->screen);
+			initcolors();	/* only the colors changed */
+			profend();
+		}
 	}
 
 	findscreen(reload);	/* find current screen (with pointer) */
+	watchconfig();		/* watch the files just read */
 
 	if (owd) {
 		if (chdir(owd))
@@ -5510,7 +5846,11 @@ initialize(const char *conf, AdwmOperations * ops, Bool reload __attribute__((un
 void
 reload(void)
 {
-	return initialize(NULL, baseops, True);
+	profreset();
+	profbegin("reload", -1);
+	initialize(NULL, baseops, True);
+	profend();
+	profwrite();
 }
 
 void
@@ -5866,18 +6206,14 @@ unmanage(Client *c, WithdrawCause cause)
 	c->name = NULL;
 	free(c->icon_name);
 	c->icon_name = NULL;
-	free(c->wm_name);
+	unintern(c->wm_name);
 	c->wm_name = NULL;
-	free(c->wm_role);
+	unintern(c->wm_role);
 	c->wm_role = NULL;
-	if (c->ch.res_name) {
-		XFree(c->ch.res_name);
-		c->ch.res_name = NULL;
-	}
-	if (c->ch.res_class) {
-		XFree(c->ch.res_class);
-		c->ch.res_class = NULL;
-	}
+	unintern(c->ch.res_name);
+	c->ch.res_name = NULL;
+	unintern(c->ch.res_class);
+	c->ch.res_class = NULL;
 	removebutton(&c->button);
 	free(c);
 	XSync(dpy, False);
@@ -5998,18 +6334,18 @@ unmapnotify(XEvent *e)
 	XUnmapEvent *ev = &e->xunmap;
 
 	if ((c = getmanaged(ev->window, ClientWindow))) {
-		XPRINTF(c, "self-unmapped window\n");
+		XCPRINTF(c, "self-unmapped window\n");
 		if (ev->send_event) {
 			/* synthetic */
 			if (ev->event == event_scr->root) {
-				XPRINTF(c, "unmanage self-unmapped window (synthetic)\n");
+				XCPRINTF(c, "unmanage self-unmapped window (synthetic)\n");
 				unmanage(c, CauseUnmapped);
 				return True;
 			}
 		} else {
 			/* real event */
 			if (ev->event == c->frame && c->is.managed) {
-				XPRINTF(c, "unmanage self-unmapped window (real event)\n");
+				XCPRINTF(c, "unmanage self-unmapped window (real event)\n");
 				unmanage(c, CauseUnmapped);
 				return True;
 			}
@@ -6021,15 +6357,17 @@ unmapnotify(XEvent *e)
 void
 updateclasshint(Client *c)
 {
-	if (c->ch.res_class) {
-		XFree(c->ch.res_class);
-		c->ch.res_class = NULL;
-	}
-	if (c->ch.res_name) {
-		XFree(c->ch.res_name);
-		c->ch.res_name = NULL;
-	}
-	getclasshint(c, &c->ch);
+	XClassHint ch = { NULL, NULL }, old = c->ch;
+
+	getclasshint(c, &ch);
+	c->ch.res_class = (char *) intern(ch.res_class);
+	c->ch.res_name = (char *) intern(ch.res_name);
+	unintern(old.res_class);
+	unintern(old.res_name);
+	if (ch.res_class)
+		XFree(ch.res_class);
+	if (ch.res_name)
+		XFree(ch.res_name);
 	updateclass(c);
 }
 
@@ -6048,8 +6386,15 @@ remove_spaces(char *str)
 void
 updatesmrole(Client *c)
 {
-	gettextprop(c->win, _XA_WM_WINDOW_ROLE, &c->wm_role);
-	remove_spaces(c->wm_role);
+	const char *old = c->wm_role;
+	char *wm_role = NULL;
+
+	if (gettextprop(c->win, _XA_WM_WINDOW_ROLE, &wm_role)) {
+		remove_spaces(wm_role);
+		c->wm_role = intern(wm_role);
+		unintern(old);
+		free(wm_role);
+	}
 }
 
 void
@@ -6078,7 +6423,7 @@ updatehints(Client *c)
 				    || wmh->icon_window != c->wmh.icon_window
 				    || wmh->icon_mask != c->wmh.icon_mask) {
 					applywmhints(c, wmh);
-					XPRINTF(c, "updating icon due to WM_HINTS update\n");
+					XCPRINTF(c, "updating icon due to WM_HINTS update\n");
 					ewmh_process_net_window_icon(c);
 				} else
 					applywmhints(c, wmh);
@@ -6245,11 +6590,13 @@ void
 updatesmname(Client *c)
 {
 	/* Just use the initial name for rules, session management and dock apps. */
-	const char *wm_name = c->name ? : "Untitled";
+	const char *old = c->wm_name;
+	char *wm_name = strdup(c->name ? : "Untitled");
 
-	free(c->wm_name); /* safety */
-	c->wm_name = strdup(wm_name);
-	remove_spaces(c->wm_name);
+	remove_spaces(wm_name);
+	c->wm_name = intern(wm_name);
+	unintern(old); /* safety */
+	free(wm_name);
 }
 
 void
@@ -6367,20 +6714,38 @@ getappl(Client *c)
 Appl *
 findappl(SnStartupSequence *seq)
 {
-	Appl *a;
+	Appl *a = NULL;
 	const char *appid, *str;
+	unsigned hash;
 
 	if (!seq)
 		return NULL;
 	if (!(appid = sn_startup_sequence_get_application_id(seq)))
 		return NULL;
-	for (a = appls; a; a = a->next)
-		if (!strcmp(a->appid, appid))
-			break;
+	hash = strhash(HASHINIT, appid);
+	if (appltab)
+		for (a = appltab[hash & (applbkts - 1)]; a; a = a->hnext)
+			if (a->hash == hash && !strcmp(a->appid, appid))
+				break;
 	if (!a) {
+		if (nappls >= applbkts) {
+			Appl *p;
+
+			applbkts = applbkts ? applbkts << 1 : 64;
+			free(appltab);
+			appltab = ecalloc(applbkts, sizeof(*appltab));
+			for (p = appls; p; p = p->next) {
+				p->hnext = appltab[p->hash & (applbkts - 1)];
+				appltab[p->hash & (applbkts - 1)] = p;
+			}
+		}
 		a = ecalloc(1, sizeof(*a));
 		a->next = appls;
 		appls = a;
+		a->hash = hash;
+		a->hnext = appltab[hash & (applbkts - 1)];
+		appltab[hash & (applbkts - 1)] = a;
+		nappls++;
 		a->appid = strdup(appid);
 		if ((str = sn_startup_sequence_get_name(seq)))
 			a->name = strdup(str);
@@ -6466,20 +6831,37 @@ getclass(Client *c)
 Class *
 findclass(const XClassHint *ch)
 {
-	Class *r;
+	Class *r = NULL;
+	unsigned hash;
 
 	if (!ch->res_class || !ch->res_name)
 		return NULL;
-	for (r = classes; r; r = r->next)
-		if (!strcmp(r->ch.res_class, ch->res_class) &&
-		    !strcmp(r->ch.res_name, ch->res_name))
-			break;
+	hash = internhash(ch->res_class) * 31 + internhash(ch->res_name);
+	if (classtab)
+		for (r = classtab[hash & (classbkts - 1)]; r; r = r->hnext)
+			if (r->ch.res_class == ch->res_class && r->ch.res_name == ch->res_name)
+				break;
 	if (!r) {
+		if (nclasses >= classbkts) {
+			Class *p;
+
+			classbkts = classbkts ? classbkts << 1 : 64;
+			free(classtab);
+			classtab = ecalloc(classbkts, sizeof(*classtab));
+			for (p = classes; p; p = p->next) {
+				p->hnext = classtab[p->hash & (classbkts - 1)];
+				classtab[p->hash & (classbkts - 1)] = p;
+			}
+		}
 		r = ecalloc(1, sizeof(*r));
 		r->next = classes;
 		classes = r;
-		r->ch.res_class = strdup(ch->res_class);
-		r->ch.res_name = strdup(ch->res_name);
+		r->hash = hash;
+		r->hnext = classtab[hash & (classbkts - 1)];
+		classtab[hash & (classbkts - 1)] = r;
+		nclasses++;
+		r->ch.res_class = (char *) intern(ch->res_class);
+		r->ch.res_name = (char *) intern(ch->res_name);
 		r->members = NULL;
 		r->count = 0;
 	}
@@ -6496,8 +6878,7 @@ updateclass(Client *c)
 		return;
 	}
 	if ((r = getclass(c))) {
-		if (!strcmp(r->ch.res_class, c->ch.res_class) &&
-				!strcmp(r->ch.res_name, c->ch.res_name))
+		if (r->ch.res_class == c->ch.res_class && r->ch.res_name == c->ch.res_name)
 			return;
 		removeclass(c);
 		r = NULL;
@@ -6826,6 +7207,7 @@ xioerror(Display *dsply)
 {
 	EPRINTF("error is %s\n", strerror(errno));
 	dumpstack(__FILE__, __LINE__, __func__);
+	tracedump();
 	return xioerrorxlib(dsply);
 }
 
@@ -6922,7 +7304,8 @@ usage(int argc __attribute__((unused)), char *argv[])
 		return;
 	(void) fprintf(stderr, "\
 Usage:\n\
-    %1$s [{-f|--file} {PATH/}RCFILE]\n\
+    %1$s [{-f|--file} {PATH/}RCFILE] [{-p|--profile} PROFILE]\n\
+    %1$s [{-f|--file} {PATH/}RCFILE] {{-R|--record}|{-P|--replay}} FILE\n\
     %1$s {-h|--help}\n\
     %1$s {-V|--version}\n\
     %1$s {-C|--copying}\n\
@@ -6936,7 +7319,8 @@ help(int argc __attribute__((unused)), char *argv[])
 		return;
 	(void) fprintf(stdout, "\
 Usage:\n\
-    %1$s [{-f|--file} {PATH/}RCFILE]\n\
+    %1$s [{-f|--file} {PATH/}RCFILE] [{-p|--profile} PROFILE]\n\
+    %1$s [{-f|--file} {PATH/}RCFILE] {{-R|--record}|{-P|--replay}} FILE\n\
     %1$s {-c|--clientId} ID {-r|--restore} SAVEFILE\n\
     %1$s {-h|--help}\n\
     %1$s {-v|--version}\n\
@@ -6948,6 +7332,13 @@ Options:\n\
         specifies the session ID used in previous session\n\
     -r, --restore SAVEFILE\n\
         specifies the file used to save state from previous session\n\
+    -p, --profile PROFILE\n\
+        write a trace of startup and reloads to the file PROFILE\n\
+    -R, --record FILE\n\
+        record the events handled, and the windows they refer to, to FILE\n\
+    -P, --replay FILE\n\
+        handle the events recorded in FILE instead of those from the\n\
+        server, then print the time taken and exit\n\
     -h, --help, -?, --?\n\
         print this usage information and exit\n\
     -v, --version\n\
@@ -6959,6 +7350,10 @@ Options:\n\
     -V, --verbose [LEVEL]\n\
         increment or set output verbosity LEVEL [default: '%3$d']\n\
         this option may be repeated.\n\
+    -T, --trace [RECORDS]\n\
+        trace to a ring of RECORDS records instead of printing debug\n\
+        output [default: '65536']; SIGUSR2 dumps the ring to a file\n\
+        (only when configured with --enable-trace)\n\
 ", argv[0], options.debug, options.output);
 }
 
@@ -6968,6 +7363,8 @@ main(int argc, char *argv[])
 	char conf[PATH_MAX + 1] = { 0, }, *p, *clientid = NULL, *savefile = NULL;
 	int i;
 
+	initprof();
+
 	/* don't care about job control */
 	signal(SIGTTIN, SIG_IGN);
 	signal(SIGTTOU, SIG_IGN);
@@ -6978,11 +7375,8 @@ main(int argc, char *argv[])
 	signal(SIGTERM, sighandler);
 	signal(SIGQUIT, sighandler);
 	signal(SIGCHLD, sighandler);
-#if 0
-	/* consider adding more signal handlers */
 	signal(SIGUSR1, sighandler);
 	signal(SIGUSR2, sighandler);
-#endif
 
 	setlocale(LC_CTYPE, "");
 
@@ -6999,9 +7393,13 @@ main(int argc, char *argv[])
 			{"file",	required_argument,	NULL, 'f'},
 			{"clientId",	required_argument,	NULL, 'c'},
 			{"restore",	required_argument,	NULL, 'r'},
+			{"profile",	required_argument,	NULL, 'p'},
+			{"record",	required_argument,	NULL, 'R'},
+			{"replay",	required_argument,	NULL, 'P'},
 
 			{"debug",	optional_argument,	NULL, 'D'},
 			{"verbose",	optional_argument,	NULL, 'V'},
+			{"trace",	optional_argument,	NULL, 'T'},
 			{"help",	no_argument,		NULL, 'h'},
 			{"version",	no_argument,		NULL, 'v'},
 			{"copying",	no_argument,		NULL, 'C'},
@@ -7009,9 +7407,9 @@ main(int argc, char *argv[])
 		};
 		/* *INDENT-ON* */
 
-		c = getopt_long_only(argc, argv, "f:c:r:D::V::hvC", long_options, &option_index);
+		c = getopt_long_only(argc, argv, "f:c:r:p:R:P:D::V::T::hvC", long_options, &option_index);
 #else				/* defined _GNU_SOURCE */
-		c = getopt(argc, argv, "f:c:r:DVhvC");
+		c = getopt(argc, argv, "f:c:r:p:R:P:DVThvC");
 #endif				/* defined _GNU_SOURCE */
 		if (c == -1) {
 			if (options.debug)
@@ -7032,6 +7430,15 @@ main(int argc, char *argv[])
 			free(savefile);
 			savefile = strdup(optarg);
 			break;
+		case 'p':	/* -p, --profile PROFILE */
+			profoutput(optarg);
+			break;
+		case 'R':	/* -R, --record FILE */
+			recordoutput(optarg);
+			break;
+		case 'P':	/* -P, --replay FILE */
+			replayinput(optarg);
+			break;
 		case 'D':	/* -D, --debug [level] */
 			if (options.debug)
 				fprintf(stderr, "%s: increasing debug verbosity\n", argv[0]);
@@ -7056,6 +7463,12 @@ main(int argc, char *argv[])
 				goto bad_option;
 			options.output = val;
 			break;
+		case 'T':	/* -T, --trace [records] */
+			val = 0;
+			if (optarg && ((val = strtoul(optarg, &endptr, 0)) <= 0 || *endptr))
+				goto bad_option;
+			inittrace(val);
+			break;
 		case 'h':	/* -h, --help */
 			help(argc, argv);
 			exit(EXIT_SUCCESS);
@@ -7141,6 +7554,8 @@ main(int argc, char *argv[])
 		OPRINTF("screen %d has root 0x%lx\n", scr->screen, scr->root);
 		initimage();
 	}
+	initdecode();
+	initwatch();
 	if ((p = getenv("DISPLAY")) && (p = strrchr(p, '.')) && strlen(p + 1)
 	    && strspn(p + 1, "0123456789") == strlen(p + 1) && (i = atoi(p + 1)) < nscr) {
 		OPRINTF("managing one screen: %d\n", i);
@@ -7156,16 +7571,27 @@ main(int argc, char *argv[])
 	for (scr = screens; scr < screens + nscr && !scr->managed; scr++) ;
 	if (scr == screens + nscr)
 		eprint("%s", "adwm: another window manager is already running on each screen\n");
+	initrecord();
+	profbegin("startup", -1);
 	setup(conf, baseops);
 	for (scr = screens; scr < screens + nscr; scr++)
 		if (scr->managed) {
 			OPRINTF("scanning screen %d\n", scr->screen);
+			profbegin("scan", scr->screen);
 			scan();
+			profend();
 		}
+	XSync(dpy, False);	/* include the requests still queued */
+	profend();
+	profwrite();
 	OPRINTF("%s", "showing scanned configuration\n");
 	save(stderr, True);
 	OPRINTF("%s", "entering main event loop\n");
-	run();
+	if (replaying)
+		replay();
+	else
+		run();
+	recordclose();
 	OPRINTF("%s", "showing quitting configuration\n");
 	save(stderr, True);
 	OPRINTF("cleanup quitting\n");
@@ -7,10 +7,12 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/poll.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <dirent.h>
 #include <fcntl.h>
 #ifdef _GNU_SOURCE
@@ -68,6 +70,11 @@
 #ifdef SHAPE
 #include <X11/extensions/shape.h>
 #endif
+#ifdef XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
 #ifdef SMLIB
 #include <X11/ICE/ICEutil.h>
 #include <X11/SM/SMlib.h>
@@ -450,10 +457,15 @@ enum {
 #endif
 #ifdef SHAPE
 	XshapeBase,
+#endif
+#ifdef XSHM
+	XshmBase,
 #endif
 	BaseLast
 };					/* X11 extensions */
 
+#define EXTRANGE    16		/* all X11 extension event must fit in this range */
+
 enum {
 	LeftStrut,
 	RightStrut,
@@ -1056,6 +1068,8 @@ extern WithUnion with_mask;
 
 struct Appl {
 	Appl *next;			/* next in list */
+	Appl *hnext;			/* next in hash bucket */
+	unsigned hash;			/* hash of appid */
 	char *appid;			/* application id (unique) */
 	char *name;			/* application name (or NULL) */
 	char *description;		/* description (or NULL) */
@@ -1069,20 +1083,28 @@ struct Appl {
 
 struct Class {
 	Class *next;			/* next in list */
-	XClassHint ch;			/* res_class and res_name */
+	Class *hnext;			/* next in hash bucket */
+	unsigned hash;			/* hash of res_class and res_name */
+	XClassHint ch;			/* res_class and res_name (interned) */
 	Window *members;		/* windows with this res_class and name */
 	ButtonImage button;		/* titlebar icon for this class */
 	unsigned count;			/* count of windows */
+	struct {
+		unsigned gen;		/* rule set generation */
+		const char *wm_role;	/* role matched (interned, referenced) */
+		const char *wm_name;	/* name matched (interned, referenced) */
+		unsigned long long matches;	/* rules that matched */
+	} rules;			/* cached rule matches */
 };
 
 struct Client {
 	XWMHints wmh;			/* initial state */
-	XClassHint ch;
+	XClassHint ch;			/* res_class and res_name (interned) */
 	XSizeHints sh;
 	char *name;
 	char *icon_name;
-	char *wm_name;			/* name for session management */
-	char *wm_role;			/* role for session management */
+	const char *wm_name;		/* name for session management (interned) */
+	const char *wm_role;		/* role for session management (interned) */
 	int monitor;			/* initial monitor */
 	Extents e;			/* copy of _NET_FRAME_EXTENTS */
 	Geometry s, u;			/* static and initial */
@@ -1167,7 +1189,10 @@ struct Client {
 #ifdef STARTUP_NOTIFICATION
 	SnStartupSequence *seq;
 #endif
-	unsigned int opacity;
+	unsigned int opacity;		/* requested by client or OPAQUE */
+	unsigned int frameopacity;	/* last written to frame */
+	Bool wantsopacity;		/* client set _NET_WM_WINDOW_OPACITY */
+	Bool hasframeopacity;		/* frameopacity is set on frame */
 };
 
 struct CycleList {
@@ -1288,11 +1313,11 @@ struct Leaf {
 		Leaf *next;			/* next leaf for same client */
 		Client *client;
 		char *clientid;
-		char *res_name;
-		char *res_class;
-		char *wm_name;
-		char *wm_role;
-		char *wm_command;
+		const char *res_name;		/* interned */
+		const char *res_class;		/* interned */
+		const char *wm_name;		/* interned */
+		const char *wm_role;		/* interned */
+		const char *wm_command;		/* interned */
 	} client;
 };
 
@@ -1373,6 +1398,8 @@ struct Key {
 	void (*stop) (XEvent *, Key *);
 	Key *chain;
 	Key *cnext;
+	Key *parent;			/* key this one continues in a chain */
+	Key *hnext;			/* next in key hash bucket */
 	char *arg;
 	RelativeDirection dir;
 	Bool wrap;
@@ -1453,7 +1480,10 @@ struct AScreen {
 	} dock;
 	View views[MAXTAGS];
 	Tag tags[MAXTAGS];
+	unsigned long long *ruletags;	/* tags matched by each rule (or NULL) */
 	Key *keylist;
+	Key **keytab;			/* keys hashed by parent, keysym and mod */
+	unsigned keybkts;		/* buckets in keytab */
 	struct {
 		int orient;		/* orientation */
 		unsigned rows, cols;		/* rows and cols (one can be zero) */
@@ -1489,6 +1519,7 @@ struct AScreen {
 	XColor *colors;			/* colormap */
 	int ncolors;			/* number of colors in colormap */
 	int cpc;
+	void (*convert) (const AScreen *, const ARGB *, unsigned char *, unsigned);	/* row converter */
 #ifdef STARTUP_NOTIFICATION
 	SnMonitorContext *ctx;
 #endif
@@ -1520,11 +1551,15 @@ typedef struct {
 #endif
 	regex_t *propregex;
 	regex_t *tagregex;
+	char *prefix;			/* literal prefix of anchored prop (or NULL) */
+	size_t prefixlen;		/* length of prefix */
 } Rule;					/* window matching rules */
 
 #ifdef STARTUP_NOTIFICATION
 struct Notify {
 	Notify *next;
+	Notify *hnext;			/* next in hash bucket */
+	unsigned hash;			/* hash of id */
 	SnStartupSequence *seq;
 	char *id;
 	char *launcher;
@@ -1533,11 +1568,25 @@ struct Notify {
 	pid_t pid;
 	long sequence;
 	Time timestamp;
+	Window win;			/* client window when assigned */
 	Bool complete;
 	Bool assigned;
 };
 #endif
 
+typedef enum {
+	PhaseNone,
+	PhaseConfig,			/* global configuration */
+	PhaseRules,			/* window rules */
+	PhaseIcons,			/* icon theme */
+	PhaseScreen,			/* per-screen configuration and tags */
+	PhaseKeys,			/* per-screen key bindings */
+	PhaseButtons,			/* button bindings */
+	PhaseStyle,			/* per-screen style, but for colors */
+	PhaseColors,			/* per-screen style colors */
+	PhaseLast
+} InitPhase;
+
 typedef struct {
 	void *handle;
 	char *name;
@@ -1563,6 +1612,14 @@ View *nearview();
 void *ecalloc(size_t nmemb, size_t size);
 void *emallocz(size_t size);
 void *erealloc(void *ptr, size_t size);
+void invalidaterules(void);
+void invalidateruletags(AScreen *ds);
+unsigned strhash(unsigned hash, const char *str);
+#define HASHINIT 2166136261U
+const char *intern(const char *str);
+void unintern(const char *str);
+unsigned internhash(const char *str);
+void internstats(void);
 void eprint(const char *errstr, ...);
 Client *findclient(Window w);
 Client *findmanaged(Window w);
@@ -1681,23 +1738,127 @@ void show_client_state(Client *c);
 #define __CFMTS(_c)	"{%-8s,%-8s} [0x%08lx 0x%08lx 0x%08lx %-20s] "
 #define __CARGS(_c)	(_c)->ch.res_class, (_c)->ch.res_name, (_c)->frame,(_c)->win,(_c)->icon,(_c)->name
 
-#define __PTRACE(_num)		  do { if (options.debug >= _num) { \
+/*
+ * Binary tracing (-T): instead of formatting, the debug macros below write a
+ * fixed-size record of their call site, the time and their first few
+ * arguments to a ring (see trace.c).  Each call site has a static TraceSite
+ * in the adwm_trace section, so the sites can be written out with the ring
+ * and adwmtrace can format the records offline.  Strings are recorded as
+ * their first 8 characters.  Tracing is only compiled in with TRACE
+ * (--enable-trace): all of the debug macros are then traced, including those
+ * that are otherwise compiled out without DEBUG.  Without TRACE the macros are
+ * what they would be without tracing.
+ */
+typedef enum {
+	TraceCall,			/* DPRINT */
+	TraceDebug,			/* DPRINTF, XPRINTF */
+	TraceClient,			/* CPRINTF: window first */
+	TraceGeometry,			/* GPRINTF: x,y then w,h first */
+	TraceError,			/* EPRINTF */
+} TraceKind;
+
+typedef struct {
+	const char *file;
+	const char *func;
+	const char *fmt;
+	int line;
+	int kind;
+} __attribute__((aligned(32))) TraceSite;
+
+#define TRACEARGS	5
+
+typedef struct {
+	uint64_t seq;			/* record number + 1, 0 while written */
+	uint64_t time;			/* CLOCK_MONOTONIC, ns */
+	const TraceSite *site;
+	uint64_t args[TRACEARGS];
+} TraceRecord;
+
+extern int tracing;
+void traceput(const TraceSite *site, uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3,
+	      uint64_t a4);
+
+static inline uint64_t
+__traceint(unsigned long long v)
+{
+	return (v);
+}
+
+static inline uint64_t
+__traceptr(const volatile void *p)
+{
+	return ((uintptr_t) p);
+}
+
+static inline uint64_t
+__tracedbl(double d)
+{
+	union { double d; uint64_t u; } x = { d };
+
+	return (x.u);
+}
+
+static inline uint64_t
+__tracestr(const char *s)
+{
+	union { char c[8]; uint64_t u; } x = { .u = 0 };
+	unsigned i;
+
+	if (!s)
+		s = "(null)";
+	for (i = 0; i < sizeof(x.c) && s[i]; i++)
+		x.c[i] = s[i];
+	return (x.u);
+}
+
+/* the conditional promotes bit-fields and decays arrays */
+#define __TARG(_x) _Generic(0 ? 0 : (_x), \
+		_Bool: __traceint, char: __traceint, signed char: __traceint, \
+		unsigned char: __traceint, short: __traceint, unsigned short: __traceint, \
+		int: __traceint, unsigned: __traceint, long: __traceint, \
+		unsigned long: __traceint, long long: __traceint, \
+		unsigned long long: __traceint, float: __tracedbl, double: __tracedbl, \
+		char *: __tracestr, const char *: __tracestr, \
+		default: __traceptr)(0 ? 0 : (_x))
+#define __TARGS(_z,_a,_b,_c,_d,_e,_rest...) __TARG(_a), __TARG(_b), __TARG(_c), __TARG(_d), __TARG(_e)
+
+#ifdef TRACE
+#define __TRACING	__builtin_expect(tracing, 0)
+#define __TRACE(_kind,_fmt,_args...) do { \
+		static const TraceSite __tracesite __attribute__((section("adwm_trace"), used)) = \
+			{ __FILE__, __func__, _fmt, __LINE__, _kind }; \
+		traceput(&__tracesite, __TARGS(0, ##_args, 0, 0, 0, 0, 0)); } while (0)
+#else
+#define __TRACING	0
+#define __TRACE(_kind,_fmt,_args...) do { } while (0)
+#endif
+
+#define __TGXY(_g)	((uint64_t) (uint32_t) (_g)->x << 32 | (uint32_t) (_g)->y)
+#define __TGWH(_g)	((uint64_t) (uint32_t) (_g)->w << 32 | (uint32_t) (_g)->h)
+
+#define __PTRACE(_num)		  do { if (__TRACING) __TRACE(TraceCall, NULL); \
+		else if (options.debug >= _num) { \
 		fprintf(stderr, NAME ": T: [%s] %12s: +%4d : %s()\n", _timestamp(), __FILE__, __LINE__, __func__); \
 		fflush(stderr); } } while (0)
 
-#define __DPRINTF(_num, _args...)  do { if (options.debug >= _num) { \
+#define __DPRINTF(_num, _args...)  do { if (__TRACING) __TRACE(TraceDebug, _args); \
+		else if (options.debug >= _num) { \
 		fprintf(stderr, NAME ": D: [%s] %12s: +%4d : %s() : ", _timestamp(), __FILE__, __LINE__, __func__); \
 		fprintf(stderr, _args); fflush(stderr); } } while (0)
 
-#define __CPRINTF(_num,_c,_args...) do { if (options.debug >= _num) { \
+#define __CTRACE(_c,_fmt,_args...) __TRACE(TraceClient, _fmt, (_c)->win, ##_args)
+#define __CPRINTF(_num,_c,_args...) do { if (__TRACING) __CTRACE(_c, _args); \
+		else if (options.debug >= _num) { \
 		fprintf(stderr, NAME ": D: [%s] %12s: +%4d : %s() : " __CFMTS(_c), _timestamp(), __FILE__, __LINE__, __func__,__CARGS(_c)); \
 		fprintf(stderr, _args); fflush(stderr); } } while (0)
 
-#define __GPRINTF(_num,_g,_args...) do { if (options.debug >= _num) { \
+#define __GTRACE(_g,_fmt,_args...) __TRACE(TraceGeometry, _fmt, __TGXY(_g), __TGWH(_g), ##_args)
+#define __GPRINTF(_num,_g,_args...) do { if (__TRACING) __GTRACE(_g, _args); \
+		else if (options.debug >= _num) { \
 		fprintf(stderr, NAME ": D: [%s] %12s: +%4d : %s() : " __GFMTS(_g), _timestamp(), __FILE__, __LINE__, __func__,__GARGS(_g)); \
 		fprintf(stderr, _args); fflush(stderr); } } while (0)
 
-#define __EPRINTF(_args...)	  do { \
+#define __EPRINTF(_args...)	  do { if (__TRACING) __TRACE(TraceError, _args); \
 		fprintf(stderr, NAME ": E: [%s] %12s: +%4d : %s() : ", _timestamp(), __FILE__, __LINE__, __func__); \
 		fprintf(stderr, _args); fflush(stderr); } while (0)
 
@@ -1709,7 +1870,10 @@ void show_client_state(Client *c);
 		fprintf(stderr, NAME ": I: "); \
 		fprintf(stderr, _args); fflush(stderr); } } while (0)
 
-#define __XPRINTF(_num, _args...)  do { } while(0)
+#define __XPRINT		  do { if (__TRACING) __TRACE(TraceCall, NULL); } while(0)
+#define __XPRINTF(_num, _args...)  do { if (__TRACING) __TRACE(TraceDebug, _args); } while(0)
+#define __XCPRINTF(_num,_c,_args...) do { if (__TRACING) __CTRACE(_c, _args); } while(0)
+#define __XGPRINTF(_num,_g,_args...) do { if (__TRACING) __GTRACE(_g, _args); } while(0)
 
 #define _DPRINT			__PTRACE(0)
 #define _DPRINTF(args...)	__DPRINTF(0,args)
@@ -1719,6 +1883,8 @@ void show_client_state(Client *c);
 #define _BKTRACE(args...)	__BKTRACE(args)
 #define _OPRINTF(args...)	__OPRINTF(0,args)
 #define _XPRINTF(args...)	__XPRINTF(0,args)
+#define _XCPRINTF(c,args...)	__XCPRINTF(0,c,args)
+#define _XGPRINTF(g,args...)	__XGPRINTF(0,g,args)
 
 #ifdef DEBUG
 #define DPRINT			_DPRINT
@@ -1726,16 +1892,19 @@ void show_client_state(Client *c);
 #define CPRINTF(c,args...)	_CPRINTF(c,args)
 #define GPRINTF(g,args...)	_GPRINTF(g,args)
 #else
-#define DPRINT			do { } while(0)
-#define DPRINTF(args...)	do { } while(0)
-#define CPRINTF(c,args...)	do { } while(0)
-#define GPRINTF(g,args...)	do { } while(0)
+/* only traced (and nothing at all without TRACE) */
+#define DPRINT			__XPRINT
+#define DPRINTF(args...)	_XPRINTF(args)
+#define CPRINTF(c,args...)	_XCPRINTF(c,args)
+#define GPRINTF(g,args...)	_XGPRINTF(g,args)
 #endif
 
 #define EPRINTF(args...)	_EPRINTF(args)
 #define BKTRACE(args...)	_BKTRACE(args)
 #define OPRINTF(args...)	_OPRINTF(args)
 #define XPRINTF(args...)	_XPRINTF(args)
+#define XCPRINTF(c,args...)	_XCPRINTF(c,args)
+#define XGPRINTF(g,args...)	_XGPRINTF(g,args)
 
 #define NONREENTRANT_ENTER \
 static int _was_here = 0; \
@@ -1791,6 +1960,7 @@ extern Client *took;			/* took focus last */
 extern int nscr;
 extern int nrules;
 extern Rule **rules;
+extern unsigned rulegen;
 extern unsigned modkey;
 extern unsigned numlockmask;
 extern unsigned scrlockmask;
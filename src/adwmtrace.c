@@ -0,0 +1,232 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "trace.h"
+
+/*
+ * Format a trace dump written by adwm -T (see trace.c) the way that the
+ * debug macros would have printed it.  Arguments past those recorded print
+ * as '?' and strings print as their first 8 characters.
+ */
+
+typedef struct {
+	unsigned line, kind;
+	char *file, *func, *fmt;
+} Site;
+
+static const char *program = "adwmtrace";
+
+static void
+fatal(const char *msg, const char *arg)
+{
+	fprintf(stderr, "%s: %s%s%s\n", program, msg, arg ? ": " : "", arg ? : "");
+	exit(EXIT_FAILURE);
+}
+
+static void
+readall(FILE *f, void *buf, size_t len)
+{
+	if (len && fread(buf, len, 1, f) != 1)
+		fatal("truncated dump", NULL);
+}
+
+static char *
+readstr(FILE *f, uint32_t len)
+{
+	char *s;
+
+	if (!(s = calloc(len + 1, 1)))
+		fatal("out of memory", NULL);
+	readall(f, s, len);
+	return (s);
+}
+
+static void
+printstr(const char *spec, uint64_t v)
+{
+	union { char c[8]; uint64_t u; } x = { .u = v };
+	char buf[16];
+
+	memcpy(buf, x.c, sizeof(x.c));
+	buf[8] = '\0';
+	if (strlen(buf) == 8)
+		strcat(buf, "...");
+	printf(spec, buf);
+}
+
+static void
+printint(const char *spec, char conv, const char *len, uint64_t v)
+{
+	Bool sign = (conv == 'd' || conv == 'i');
+
+	if (!strcmp(len, "ll") || !strcmp(len, "q"))
+		sign ? printf(spec, (long long) v) : printf(spec, (unsigned long long) v);
+	else if (*len == 'l' || *len == 'z' || *len == 'j' || *len == 't')
+		sign ? printf(spec, (long) v) : printf(spec, (unsigned long) v);
+	else if (!strcmp(len, "hh"))
+		sign ? printf(spec, (int) (signed char) v) : printf(spec, (unsigned) (unsigned char) v);
+	else if (*len == 'h')
+		sign ? printf(spec, (int) (short) v) : printf(spec, (unsigned) (unsigned short) v);
+	else
+		sign ? printf(spec, (int) v) : printf(spec, (unsigned) v);
+}
+
+/* print fmt with the recorded arguments, one conversion at a time */
+static void
+printfmt(const char *fmt, const uint64_t *args, unsigned nargs)
+{
+	char spec[64], len[3];
+	const char *p, *q, *r;
+	unsigned a = 0, n;
+	union { double d; uint64_t u; } x;
+
+	for (p = fmt; *p; p++) {
+		if (*p != '%') {
+			putchar(*p);
+			continue;
+		}
+		if (p[1] == '%') {
+			putchar(*++p);
+			continue;
+		}
+		/* flags, width and precision: '*' takes an argument */
+		for (q = p + 1; *q && strchr("-+ #0'", *q); q++) ;
+		for (; *q && (isdigit((unsigned char) *q) || *q == '.' || *q == '*'); q++)
+			if (*q == '*')
+				a++;
+		for (n = 0; *q && strchr("hlLqjzt", *q) && n < 2; q++)
+			len[n++] = *q;
+		len[n] = '\0';
+		if (!*q)
+			break;
+		/* the spec without the length and any '*' */
+		n = 0;
+		for (r = p; r < q - strlen(len) && n < sizeof(spec) - 3; r++)
+			if (*r != '*')
+				spec[n++] = *r;
+		spec[n] = '\0';
+		p = q;
+		if (*p == 'n')
+			continue;
+		if (a >= nargs) {
+			putchar('?');
+			continue;
+		}
+		switch (*p) {
+		case 's':
+			strcat(spec, "s");
+			printstr(spec, args[a++]);
+			break;
+		case 'p':
+			strcat(spec, "p");
+			printf(spec, (void *) (uintptr_t) args[a++]);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			spec[n] = *p;
+			spec[n + 1] = '\0';
+			x.u = args[a++];
+			printf(spec, x.d);
+			break;
+		case 'c':
+			strcat(spec, "c");
+			printf(spec, (int) args[a++]);
+			break;
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+			/* put the length back in */
+			snprintf(spec + n, sizeof(spec) - n, "%s%c", *len == 'L' ? "ll" : len, *p);
+			printint(spec, *p, *len == 'L' ? "ll" : len, args[a++]);
+			break;
+		default:
+			printf("%%%c", *p);
+			break;
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	TraceHeader h;
+	TraceRecord *ring, *r;
+	Site *sites, *s;
+	uint64_t n, k, first, skipped = 0;
+	uint32_t w[5];
+	unsigned i, nargs;
+	const uint64_t *args;
+	FILE *f;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s DUMPFILE\n", argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if (!(f = fopen(argv[1], "r")))
+		fatal(strerror(errno), argv[1]);
+	readall(f, &h, sizeof(h));
+	if (memcmp(h.magic, TRACEMAGIC, sizeof(h.magic)))
+		fatal("not a trace dump", argv[1]);
+	if (!h.nrecords || (h.nrecords & (h.nrecords - 1)))
+		fatal("bad ring size", argv[1]);
+	if (!(sites = calloc(h.nsites + 1, sizeof(*sites))) ||
+	    !(ring = calloc(h.nrecords, sizeof(*ring))))
+		fatal("out of memory", NULL);
+	for (i = 0; i < h.nsites; i++) {
+		readall(f, w, sizeof(w));
+		sites[i].line = w[0];
+		sites[i].kind = w[1];
+		sites[i].file = readstr(f, w[2]);
+		sites[i].func = readstr(f, w[3]);
+		sites[i].fmt = w[4] ? readstr(f, w[4]) : NULL;
+	}
+	readall(f, ring, h.nrecords * sizeof(*ring));
+	fclose(f);
+
+	first = h.head > h.nrecords ? h.head - h.nrecords : 0;
+	for (n = first; n < h.head; n++) {
+		r = ring + (n & (h.nrecords - 1));
+		if (r->seq != n + 1) {
+			skipped++;	/* being written when dumped */
+			continue;
+		}
+		k = ((uintptr_t) r->site - h.sites) / sizeof(TraceSite);
+		if ((uintptr_t) r->site < h.sites || k >= h.nsites ||
+		    ((uintptr_t) r->site - h.sites) % sizeof(TraceSite)) {
+			/* a site in a module: not in the adwm_trace section of adwm */
+			printf("adwm: ?: [%f] (call site %p in a module)\n",
+			       (double) ((int64_t) r->time + h.realtime) / 1000000000.0,
+			       (void *) r->site);
+			continue;
+		}
+		s = sites + k;
+		printf("adwm: %c: [%f] %12s: +%4d : %s()", s->kind == TraceCall ? 'T' :
+		       (s->kind == TraceError ? 'E' : 'D'),
+		       (double) ((int64_t) r->time + h.realtime) / 1000000000.0,
+		       s->file, s->line, s->func);
+		if (s->kind == TraceCall) {
+			putchar('\n');
+			continue;
+		}
+		fputs(" : ", stdout);
+		args = r->args;
+		nargs = TRACEARGS;
+		switch (s->kind) {
+		case TraceClient:
+			printf("[0x%08lx] ", (unsigned long) args[0]);
+			args += 1;
+			nargs -= 1;
+			break;
+		case TraceGeometry:
+			printf("%dx%d+%d+%d ", (int) (uint32_t) (args[1] >> 32), (int) (uint32_t) args[1],
+			       (int) (uint32_t) (args[0] >> 32), (int) (uint32_t) args[0]);
+			args += 2;
+			nargs -= 2;
+			break;
+		}
+		printfmt(s->fmt ? : "", args, nargs);
+		if (!s->fmt || !*s->fmt || s->fmt[strlen(s->fmt) - 1] != '\n')
+			putchar('\n');
+	}
+	if (skipped)
+		fprintf(stderr, "%s: %llu records were being written\n", program,
+			(unsigned long long) skipped);
+	return (EXIT_SUCCESS);
+}
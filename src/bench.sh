@@ -0,0 +1,77 @@
+#!/bin/bash
+
+# run the benchmark scenarios against adwm on a headless X server
+#
+# usage: bench.sh ADWM DATADIR
+#
+# BENCH_SCENARIOS	scenarios for benchdrive, arguments separated by colons
+#			(default: map:500 tags:1000 drag:1000 retitle:100:10)
+# BENCH_LOAD		synthclients options for background load (default: none)
+# BENCH_OUTPUT		directory for the results and statistics (default: bench.out)
+#
+# Exits 77 (skipped) when Xvfb is not installed: "make bench" then only runs
+# the benchmarks that need no display.
+
+adwm="$1"
+data="$2"
+bindir="$(pwd)"
+scenarios="${BENCH_SCENARIOS:-map:500 tags:1000 drag:1000 retitle:100:10}"
+out="${BENCH_OUTPUT:-bench.out}"
+
+if test -z "$adwm" -o -z "$data" ; then
+	echo "usage: $0 ADWM DATADIR" >&2
+	exit 2
+fi
+if ! test -x "`which Xvfb 2>/dev/null`" ; then
+	echo "$0: Xvfb not found: skipping benchmarks" >&2
+	exit 77
+fi
+
+mkdir -p "$out/home" || exit 1
+out="$(cd "$out" && pwd)"
+
+xvfb= wm= load=
+cleanup() {
+	test -n "$load" && kill $load 2>/dev/null
+	test -n "$wm" && kill $wm 2>/dev/null
+	test -n "$xvfb" && kill $xvfb 2>/dev/null
+	wait 2>/dev/null
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+# a display that nobody is using
+display=99
+while test -e /tmp/.X$display-lock -o -e /tmp/.X11-unix/X$display ; do
+	display=$((display+1))
+done
+Xvfb :$display -screen 0 1280x1024x24 -nolisten tcp >"$out/Xvfb.log" 2>&1 &
+xvfb=$!
+export DISPLAY=:$display
+for i in $(seq 50) ; do
+	test -e /tmp/.X11-unix/X$display && break
+	sleep 0.1
+done
+
+status=0
+for scenario in $scenarios ; do
+	args="${scenario//:/ }"
+	name="${args%% *}"
+	HOME="$out/home" XDG_CONFIG_HOME="$out/home/.config" TMPDIR="$out" \
+		"$adwm" -f "$data/adwmrc" >"$out/adwm-$name.log" 2>&1 &
+	wm=$!
+	if test -n "$BENCH_LOAD" ; then
+		"$bindir/synthclients" $BENCH_LOAD >"$out/synthclients-$name.log" 2>&1 &
+		load=$!
+	fi
+	if ! "$bindir/benchdrive" -s "$out/adwm-$wm.events" $args | tee "$out/$name.txt" ; then
+		echo "$0: scenario $scenario failed" >&2
+		status=1
+	fi
+	test -n "$load" && kill $load 2>/dev/null
+	kill $wm 2>/dev/null
+	wait $wm $load 2>/dev/null
+	wm= load=
+done
+
+exit $status
@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/Xresource.h>
+
+#include "util.h"
+
+/*
+ * Benchmark scenarios against a running window manager (see bench.sh).  Each
+ * scenario performs a number of operations and measures the latency of each
+ * until the window manager has done its part:
+ *
+ *   map N		map N windows at once; until each is reparented
+ *   tags N		switch desktops N times; until _NET_CURRENT_DESKTOP changes
+ *   drag N		move a window N times by 4 pixels with _NET_MOVERESIZE_WINDOW
+ *   retitle HZ S	retitle a window HZ times a second for S seconds
+ *
+ * For drag and retitle, an operation is complete when the window manager has
+ * answered a _NET_REQUEST_FRAME_EXTENTS sent after it: the window manager
+ * handles requests in order.  When the window manager is adwm, its event
+ * statistics (written on SIGUSR1, see evstat.c) are taken before and after
+ * the scenario to report the X requests, round trips and handler time per
+ * operation.
+ */
+
+int screen;
+Display *dpy;
+Window root;
+
+static pid_t wmpid = 0;
+static const char *statfile = NULL;
+
+enum { NetSupportingWmCheck, NetWmPid, NetCurrentDesktop, NetNumberOfDesktops,
+	NetMoveresizeWindow, NetRequestFrameExtents, NetFrameExtents, NetWmName,
+	Utf8String, NATOMS };
+
+static char *names[NATOMS] = {
+	"_NET_SUPPORTING_WM_CHECK", "_NET_WM_PID", "_NET_CURRENT_DESKTOP",
+	"_NET_NUMBER_OF_DESKTOPS", "_NET_MOVERESIZE_WINDOW", "_NET_REQUEST_FRAME_EXTENTS",
+	"_NET_FRAME_EXTENTS", "_NET_WM_NAME", "UTF8_STRING"
+};
+
+static Atom atoms[NATOMS];
+
+typedef struct {
+	unsigned long count, requests, replies;
+	double ms;
+} WmStats;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0);
+}
+
+static Bool
+getcardinal(Window win, Atom atom, unsigned long *value)
+{
+	Atom real;
+	int format;
+	unsigned long n, extra;
+	unsigned char *data = NULL;
+	Bool ok = False;
+
+	if (XGetWindowProperty(dpy, win, atom, 0, 1, False, AnyPropertyType, &real, &format,
+			       &n, &extra, &data) == Success && format == 32 && n == 1) {
+		*value = *(unsigned long *) data;
+		ok = True;
+	}
+	if (data)
+		XFree(data);
+	return (ok);
+}
+
+/* wait for the next event on win of the given type for up to 10 seconds */
+static Bool
+waitevent(Window win, int type, XEvent *ev)
+{
+	double limit = now() + 10000.0;
+
+	for (;;) {
+		if (XCheckTypedWindowEvent(dpy, win, type, ev))
+			return True;
+		if (!XPending(dpy)) {
+			struct timeval tv = { 0, 100000 };
+			fd_set fds;
+
+			if (now() > limit)
+				return False;
+			FD_ZERO(&fds);
+			FD_SET(ConnectionNumber(dpy), &fds);
+			select(ConnectionNumber(dpy) + 1, &fds, NULL, NULL, &tv);
+			continue;
+		}
+		XNextEvent(dpy, ev);	/* not ours: drop it */
+	}
+}
+
+/* wait until the window manager has handled everything sent so far */
+static Bool
+wmsync(void)
+{
+	static Window probe = None;
+	XEvent ev;
+
+	if (!probe) {
+		XSetWindowAttributes wa;
+
+		wa.event_mask = PropertyChangeMask;
+		probe = XCreateWindow(dpy, root, -10, -10, 1, 1, 0, CopyFromParent, InputOutput,
+				      CopyFromParent, CWEventMask, &wa);
+	}
+	XDeleteProperty(dpy, probe, atoms[NetFrameExtents]);
+	ev.xclient.type = ClientMessage;
+	ev.xclient.serial = 0;
+	ev.xclient.send_event = True;
+	ev.xclient.display = dpy;
+	ev.xclient.window = probe;
+	ev.xclient.message_type = atoms[NetRequestFrameExtents];
+	ev.xclient.format = 32;
+	memset(&ev.xclient.data, 0, sizeof(ev.xclient.data));
+	XSendEvent(dpy, root, False, SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+	XFlush(dpy);
+	do {
+		if (!waitevent(probe, PropertyNotify, &ev))
+			return False;
+	} while (ev.xproperty.atom != atoms[NetFrameExtents] ||
+		 ev.xproperty.state != PropertyNewValue);
+	return True;
+}
+
+static void
+sendroot(Window win, Atom type, long l0, long l1, long l2, long l3, long l4)
+{
+	XEvent ev;
+
+	ev.xclient.type = ClientMessage;
+	ev.xclient.serial = 0;
+	ev.xclient.send_event = True;
+	ev.xclient.display = dpy;
+	ev.xclient.window = win;
+	ev.xclient.message_type = type;
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = l0;
+	ev.xclient.data.l[1] = l1;
+	ev.xclient.data.l[2] = l2;
+	ev.xclient.data.l[3] = l3;
+	ev.xclient.data.l[4] = l4;
+	XSendEvent(dpy, root, False, SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+}
+
+static Window
+newwindow(unsigned n)
+{
+	XSetWindowAttributes wa;
+	XClassHint ch;
+	char name[32];
+	Window win;
+
+	wa.event_mask = StructureNotifyMask | PropertyChangeMask;
+	wa.background_pixel = WhitePixel(dpy, screen);
+	win = XCreateWindow(dpy, root, (n * 17) % 600, (n * 13) % 400, 200, 100, 0,
+			    CopyFromParent, InputOutput, CopyFromParent,
+			    CWEventMask | CWBackPixel, &wa);
+	snprintf(name, sizeof(name), "bench%u", n);
+	ch.res_name = name;
+	ch.res_class = "Bench";
+	XSetClassHint(dpy, win, &ch);
+	XStoreName(dpy, win, name);
+	return (win);
+}
+
+/* map count windows and wait until they are managed; returns when each was */
+static unsigned
+mapwindows(Window *wins, double *when, unsigned count)
+{
+	unsigned i, done = 0;
+	XEvent ev;
+
+	for (i = 0; i < count; i++) {
+		wins[i] = newwindow(i);
+		XMapWindow(dpy, wins[i]);
+	}
+	XFlush(dpy);
+	while (done < count) {
+		if (!XPending(dpy)) {
+			struct timeval tv = { 10, 0 };
+			fd_set fds;
+
+			FD_ZERO(&fds);
+			FD_SET(ConnectionNumber(dpy), &fds);
+			if (select(ConnectionNumber(dpy) + 1, &fds, NULL, NULL, &tv) <= 0)
+				break;
+		}
+		XNextEvent(dpy, &ev);
+		if (ev.type != ReparentNotify || ev.xreparent.parent == root)
+			continue;
+		for (i = 0; i < count; i++)
+			if (wins[i] == ev.xreparent.window) {
+				if (when)
+					when[i] = now();
+				done++;
+				break;
+			}
+	}
+	return (done);
+}
+
+/* ask adwm for its event statistics and total them */
+static Bool
+wmstats(WmStats *st)
+{
+	char line[256], name[64];
+	unsigned long count, requests, replies;
+	double total, mean, max;
+	Bool totals = False;
+	struct stat sb;
+	FILE *f;
+	int i;
+
+	memset(st, 0, sizeof(*st));
+	if (!wmpid || !statfile)
+		return False;
+	unlink(statfile);
+	if (kill(wmpid, SIGUSR1))
+		return False;
+	for (i = 0; i < 100 && stat(statfile, &sb); i++)
+		usleep(50000);
+	if (!(f = fopen(statfile, "r")))
+		return False;
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, "events of", 9)) {
+			totals = True;
+			continue;
+		}
+		if (!totals)
+			continue;
+		if (line[0] == '\n')
+			break;
+		if (sscanf(line, "%63s %lu %lf %lf %lf %lu %lu", name, &count, &total, &mean, &max,
+			   &requests, &replies) != 7)
+			continue;
+		st->count += count;
+		st->requests += requests;
+		st->replies += replies;
+		st->ms += total;
+	}
+	fclose(f);
+	return True;
+}
+
+static int
+bylatency(const void *a, const void *b)
+{
+	double da = *(const double *) a, db = *(const double *) b;
+
+	return (da > db) - (da < db);
+}
+
+static void
+report(const char *scenario, double *lat, unsigned n, unsigned failed, double elapsed,
+       Bool havestats, const WmStats *before, const WmStats *after)
+{
+	double sum = 0.0;
+	unsigned i;
+
+	qsort(lat, n, sizeof(*lat), bylatency);
+	for (i = 0; i < n; i++)
+		sum += lat[i];
+	printf("%-10s %6u ops %9.2f ms", scenario, n, elapsed);
+	if (n)
+		printf("  latency ms: mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f",
+		       sum / n, lat[n / 2], lat[n * 95 / 100], lat[n * 99 / 100], lat[n - 1]);
+	if (failed)
+		printf("  (%u timed out)", failed);
+	printf("\n");
+	if (havestats && n) {
+		unsigned long events = after->count - before->count;
+
+		printf("%-10s wm: %.1f events, %.1f requests, %.2f round trips, %.3f ms per op\n",
+		       "", (double) events / n, (double) (after->requests - before->requests) / n,
+		       (double) (after->replies - before->replies) / n,
+		       (after->ms - before->ms) / n);
+	}
+	fflush(stdout);
+}
+
+static void
+scenario_map(unsigned n, double *lat, unsigned *done)
+{
+	Window *wins = emallocz(n * sizeof(*wins));
+	double start = now(), *when = emallocz(n * sizeof(*when));
+	unsigned i;
+
+	mapwindows(wins, when, n);
+	/* only the windows that were managed, as the other scenarios do */
+	for (*done = 0, i = 0; i < n; i++)
+		if (when[i])
+			lat[(*done)++] = when[i] - start;
+	for (i = 0; i < n; i++)
+		XDestroyWindow(dpy, wins[i]);
+	XSync(dpy, True);
+	free(wins);
+	free(when);
+}
+
+static void
+scenario_tags(unsigned n, double *lat, unsigned *done)
+{
+	Window wins[20];
+	unsigned long ntags = 0, cur;
+	double start;
+	unsigned i;
+	Bool ok;
+	XEvent ev;
+
+	mapwindows(wins, NULL, 20);
+	if (!getcardinal(root, atoms[NetNumberOfDesktops], &ntags) || ntags < 2)
+		eprint("benchdrive: need at least 2 desktops\n");
+	XSelectInput(dpy, root, PropertyChangeMask);
+	for (*done = 0, i = 0; i < n; i++) {
+		start = now();
+		sendroot(root, atoms[NetCurrentDesktop], (i + 1) % ntags, CurrentTime, 0, 0, 0);
+		XFlush(dpy);
+		while ((ok = waitevent(root, PropertyNotify, &ev)) &&
+		       (ev.xproperty.atom != atoms[NetCurrentDesktop] ||
+			!getcardinal(root, atoms[NetCurrentDesktop], &cur) || cur != (i + 1) % ntags)) ;
+		if (ok)
+			lat[(*done)++] = now() - start;
+	}
+	XSelectInput(dpy, root, NoEventMask);
+	for (i = 0; i < 20; i++)
+		XDestroyWindow(dpy, wins[i]);
+	XSync(dpy, True);
+}
+
+static void
+scenario_drag(unsigned n, double *lat, unsigned *done)
+{
+	Window win;
+	double start;
+	unsigned i;
+
+	mapwindows(&win, NULL, 1);
+	for (*done = 0, i = 0; i < n; i++) {
+		start = now();
+		/* NorthWest gravity, x and y given, from a pager */
+		sendroot(win, atoms[NetMoveresizeWindow], 1 | (1 << 8) | (1 << 9) | (2 << 12),
+			 100 + 4 * (i % 200), 100 + 2 * (i % 200), 0, 0);
+		if (wmsync())
+			lat[(*done)++] = now() - start;
+	}
+	XDestroyWindow(dpy, win);
+	XSync(dpy, True);
+}
+
+static void
+scenario_retitle(double hz, double *lat, unsigned n, unsigned *done)
+{
+	Window win;
+	char title[64];
+	double start, next, wait;
+	unsigned i;
+
+	mapwindows(&win, NULL, 1);
+	next = now();
+	for (*done = 0, i = 0; i < n; i++) {
+		if ((wait = next - now()) > 0)
+			usleep(wait * 1000);
+		next += 1000.0 / hz;
+		start = now();
+		snprintf(title, sizeof(title), "benchmark title %u", i);
+		XStoreName(dpy, win, title);
+		XChangeProperty(dpy, win, atoms[NetWmName], atoms[Utf8String], 8,
+				PropModeReplace, (unsigned char *) title, strlen(title));
+		if (wmsync())
+			lat[(*done)++] = now() - start;
+	}
+	XDestroyWindow(dpy, win);
+	XSync(dpy, True);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *usage = "usage: benchdrive [-s statfile] {map N|tags N|drag N|retitle HZ SECONDS}\n";
+	unsigned long check = 0, pid = 0;
+	WmStats before, after;
+	Bool havestats;
+	double *lat, start, hz = 0;
+	unsigned n, done = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "s:")) != -1) {
+		switch (c) {
+		case 's':
+			statfile = optarg;
+			break;
+		default:
+			eprint("%s", usage);
+		}
+	}
+	if (optind >= argc)
+		eprint("%s", usage);
+	dpy = XOpenDisplay(0);
+	if (!dpy)
+		eprint("benchdrive: cannot open display\n");
+	screen = DefaultScreen(dpy);
+	root = RootWindow(dpy, screen);
+	XInternAtoms(dpy, names, NATOMS, False, atoms);
+
+	/* wait for the window manager to be up */
+	for (i = 0; i < 100 && !getcardinal(root, atoms[NetSupportingWmCheck], &check); i++)
+		usleep(100000);
+	if (!check)
+		eprint("benchdrive: no window manager running\n");
+	if (getcardinal(check, atoms[NetWmPid], &pid))
+		wmpid = pid;
+	if (!wmsync())
+		eprint("benchdrive: window manager does not answer _NET_REQUEST_FRAME_EXTENTS\n");
+
+	if (!strcmp(argv[optind], "retitle")) {
+		if (optind + 2 >= argc)
+			eprint("%s", usage);
+		hz = strtod(argv[optind + 1], NULL);
+		n = hz * strtod(argv[optind + 2], NULL);
+	} else {
+		if (optind + 1 >= argc)
+			eprint("%s", usage);
+		n = strtoul(argv[optind + 1], NULL, 0);
+	}
+	if (!n)
+		eprint("benchdrive: nothing to do\n");
+	lat = emallocz(n * sizeof(*lat));
+
+	havestats = wmstats(&before);
+	start = now();
+	if (!strcmp(argv[optind], "map"))
+		scenario_map(n, lat, &done);
+	else if (!strcmp(argv[optind], "tags"))
+		scenario_tags(n, lat, &done);
+	else if (!strcmp(argv[optind], "drag"))
+		scenario_drag(n, lat, &done);
+	else if (!strcmp(argv[optind], "retitle"))
+		scenario_retitle(hz, lat, n, &done);
+	else
+		eprint("%s", usage);
+	start = now() - start;
+	havestats = havestats && wmstats(&after);
+	report(argv[optind], lat, done, n - done, start, havestats, &before, &after);
+	free(lat);
+	XCloseDisplay(dpy);
+	return (done < n);
+}
@@ -5,6 +5,7 @@
 #include "layout.h"
 #include "tags.h"
 #include "resource.h"
+#include "snapshot.h"
 #include "config.h" /* verification */
 
 Options options;
@@ -142,9 +143,12 @@ initdock(Bool reload)
 		l->is.dockapp = True;
 		l->client.client = NULL;
 		l->client.next = NULL;
-		l->client.res_name = res_name;
-		l->client.res_class = res_class;
-		l->client.wm_command = wm_command;
+		l->client.res_name = intern(res_name);
+		l->client.res_class = intern(res_class);
+		l->client.wm_command = intern(wm_command);
+		free(res_name);
+		free(res_class);
+		free(wm_command);
 		appleaf(n, l, False);
 	}
 }
@@ -414,6 +418,7 @@ findrcfile(const char *file)
 					} else {
 						free(buf);
 						XPRINTF("Cannot readlink %s: %s\n", path, strerror(errno));
+						snapshotprobe(path);
 						continue;
 					}
 					free(buf);
@@ -421,10 +426,12 @@ findrcfile(const char *file)
 				break;
 			} else {
 				XPRINTF("Cannot stat %s: %s\n", path, strerror(errno));
+				snapshotprobe(path);
 				continue;
 			}
 		} else {
 			XPRINTF("Cannot access %s: %s\n", path, strerror(errno));
+			snapshotprobe(path);
 			continue;
 		}
 	}
@@ -993,6 +1000,7 @@ initrcfile(const char *conf __attribute__((unused)), Bool reload)
 	char *rcfile, *dir;
 	int i, len;
 	static int initialized = 0;
+	struct timespec t0, t1;
 
 	/* init resource database */
 	if (!initialized) {
@@ -1007,6 +1015,9 @@ initrcfile(const char *conf __attribute__((unused)), Bool reload)
 		if (!strcmp(cargv[i], "-f"))
 			file = cargv[i + 1];
 	initrcdirs(file, reload);
+	if (loadsnapshot(file))
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
 	dir = strdup(config.pdir);
 	rcfile = strdup(config.rcfile);
 	if (chdir(dir))
@@ -1015,6 +1026,7 @@ initrcfile(const char *conf __attribute__((unused)), Bool reload)
 	xrdb = XrmGetFileDatabase(rcfile);
 	if (!xrdb) {
 		XPRINTF("Couldn't find database file '%s', using defaults\n", rcfile);
+		snapshotprobe(rcfile);
 		free(dir);
 		dir = strdup(config.sdir);
 		free(rcfile);
@@ -1036,6 +1048,10 @@ initrcfile(const char *conf __attribute__((unused)), Bool reload)
 	initbtnsfile();		/* read button bindings into the database */
 	initrulefile();		/* read window rules into the database */
 	initdockfile();		/* read dock elements into the database */
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	OPRINTF("parsed configuration files in %.3f ms\n",
+		(t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0);
+	savesnapshot(file, dir, rcfile);
 
 	/* might want to pass these to above, instead of changing directories */
 	/* except we should probably search pdir, rdir, xdir, udir, sdir for
@@ -0,0 +1,186 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "convert.h"
+
+/*
+ * Benchmark the ARGB to XImage row converters (see convert.c) without a
+ * display.  For each common TrueColor layout and byte order, the scalar and
+ * vector converters that adwm would select are checked byte for byte against
+ * the generic one, over all widths up to 67 pixels (so that every vector tail
+ * is taken) and over the whole benchmark image, and each is timed converting
+ * a -w by -h image -n times.  Exits with a failure when any output differs.
+ */
+
+typedef struct {
+	const char *name;
+	unsigned depth, bpp;
+	unsigned long red, green, blue;
+} PixelLayout;
+
+static const PixelLayout layouts[] = {
+	{ "888/32", 24, 32, 0xff0000, 0x00ff00, 0x0000ff },
+	{ "888/24", 24, 24, 0xff0000, 0x00ff00, 0x0000ff },
+	{ "565/16", 16, 16, 0xf800, 0x07e0, 0x001f },
+	{ "555/16", 15, 16, 0x7c00, 0x03e0, 0x001f },
+	{ "bgr888/32", 24, 32, 0x0000ff, 0x00ff00, 0xff0000 },
+	{ "332/8", 8, 8, 0xe0, 0x1c, 0x03 },
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0);
+}
+
+/* the color tables as initimage() builds them for a TrueColor visual */
+static void
+setup(AScreen *ds, Visual *visual, const PixelLayout *l)
+{
+	unsigned long m;
+	int i;
+
+	memset(visual, 0, sizeof(*visual));
+	visual->class = TrueColor;
+	visual->red_mask = l->red;
+	visual->green_mask = l->green;
+	visual->blue_mask = l->blue;
+	ds->visual = visual;
+	ds->depth = l->depth;
+	ds->bpp = l->bpp;
+	for (m = l->red; !(m & 0x1); m >>= 1) ;
+	for (i = 0; i < 256; i++)
+		ds->rctab[i] = i / (255 / m);
+	for (m = l->green; !(m & 0x1); m >>= 1) ;
+	for (i = 0; i < 256; i++)
+		ds->gctab[i] = i / (255 / m);
+	for (m = l->blue; !(m & 0x1); m >>= 1) ;
+	for (i = 0; i < 256; i++)
+		ds->bctab[i] = i / (255 / m);
+}
+
+static double
+convert(AScreen *ds, const ARGB *argb, unsigned char *out, unsigned w, unsigned h,
+	unsigned stride, unsigned times)
+{
+	double start = now();
+	unsigned i, y;
+
+	for (i = 0; i < times; i++)
+		for (y = 0; y < h; y++)
+			ds->convert(ds, argb + (size_t) y * w, out + (size_t) y * stride, w);
+	return ((now() - start) / times);
+}
+
+/* check a converter against the generic one; prints and returns True when it differs */
+static Bool
+differs(AScreen *ds, const char *layout, int msb, const char *name, const ARGB *argb,
+	unsigned char rows[][67 * 4], const unsigned char *ref, unsigned char *out,
+	unsigned w, unsigned h, unsigned stride)
+{
+	const unsigned b = ds->bpp / 8;
+	unsigned char row[67 * 4 + 16];
+	unsigned i;
+
+	/* and only the bytes of the row may be written */
+	for (i = 1; i <= 67; i++) {
+		memset(row, 0xa5, sizeof(row));
+		ds->convert(ds, argb, row, i);
+		if (memcmp(row, rows[i], i * b) || row[i * b] != 0xa5) {
+			printf("%-10s %s: %s differs at width %u\n", layout, msb ? "msb" : "lsb",
+			       name, i);
+			return True;
+		}
+	}
+	memset(out, 0, (size_t) stride * h);
+	convert(ds, argb, out, w, h, stride, 1);
+	if (memcmp(ref, out, (size_t) stride * h)) {
+		printf("%-10s %s: %s differs\n", layout, msb ? "msb" : "lsb", name);
+		return True;
+	}
+	return False;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static unsigned char rows[68][67 * 4];
+	unsigned char rctab[256], gctab[256], bctab[256], *ref, *out;
+	unsigned w = 1920, h = 1080, times = 20, i, k, n, stride;
+	const char *names[3];
+	double ms[3];
+	AScreen ds = { 0, };
+	Visual visual;
+	ARGB *argb;
+	int c, msb, level, failed = 0;
+
+	while ((c = getopt(argc, argv, "w:h:n:")) != -1) {
+		switch (c) {
+		case 'w':
+			w = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			h = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			times = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: convbench [-w width] [-h height] [-n times]\n");
+			return (2);
+		}
+	}
+	if (!w)
+		w = 1;
+	if (!h)
+		h = 1;
+	if (!times)
+		times = 1;
+	n = w * h;
+	argb = calloc(n > 67 ? n : 67, sizeof(*argb));
+	ref = calloc((size_t) n * 4, 1);
+	out = calloc((size_t) n * 4, 1);
+	if (!argb || !ref || !out) {
+		fprintf(stderr, "convbench: out of memory\n");
+		return (1);
+	}
+	srand(1);
+	for (i = 0; i < (n > 67 ? n : 67); i++) {
+		argb[i].red = rand();
+		argb[i].green = rand();
+		argb[i].blue = rand();
+		argb[i].alpha = rand();
+	}
+	ds.rctab = rctab;
+	ds.gctab = gctab;
+	ds.bctab = bctab;
+
+	printf("%ux%u pixels, ms per image (%u times): generic, scalar, vector\n", w, h, times);
+	for (k = 0; k < LENGTH(layouts); k++) {
+		for (msb = 0; msb < 2; msb++) {
+			setup(&ds, &visual, &layouts[k]);
+			stride = w * (ds.bpp / 8);
+			for (level = ConvertGeneric; level <= ConvertVector; level++) {
+				names[level] = selectconvert(&ds, msb, level);
+				if (level == ConvertGeneric) {
+					for (i = 1; i <= 67; i++)
+						ds.convert(&ds, argb, rows[i], i);
+					convert(&ds, argb, ref, w, h, stride, 1);
+				} else if (differs(&ds, layouts[k].name, msb, names[level], argb, rows,
+						   ref, out, w, h, stride))
+					failed = 1;
+				ms[level] = convert(&ds, argb, out, w, h, stride, times);
+			}
+			printf("%-10s %s  %8.3f  %-18s %8.3f  %-18s %8.3f  %5.2fx\n",
+			       layouts[k].name, msb ? "msb" : "lsb", ms[0], names[1], ms[1],
+			       names[2], ms[2], ms[2] > 0 ? ms[0] / ms[2] : 0.0);
+		}
+	}
+	free(argb);
+	free(ref);
+	free(out);
+	return (failed);
+}
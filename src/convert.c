@@ -0,0 +1,411 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "convert.h" /* verification */
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#include <immintrin.h>
+#define X86KERNELS 1
+#endif
+
+/*
+ * Row converters: renderimage() converts ARGB data one row at a time with a
+ * converter that initimage() selects for the screen visual, so that the visual
+ * class, bits per pixel and byte order are not examined for each pixel.  Where
+ * the color tables reduce to simple truncation, packed fast paths are used.
+ * They only depend on the screen fields that describe the visual, so that
+ * convbench can run them without a display.
+ */
+
+static void
+convertcolors(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	unsigned long r, g, b;
+
+	for (; n; n--, c++) {
+		r = ds->rctab[c->red];
+		g = ds->gctab[c->green];
+		b = ds->bctab[c->blue];
+
+		*p++ = ds->colors[(r * ds->cpc * ds->cpc) + (g * ds->cpc) + b].pixel;
+	}
+}
+
+static void
+convertgray(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	unsigned long r, g, b;
+
+	for (; n; n--, c++) {
+		r = ds->rctab[c->red];
+		g = ds->gctab[c->green];
+		b = ds->bctab[c->blue];
+
+		*p++ = ds->colors[((r * 30) + (g * 59) + (b * 11)) / 100].pixel;
+	}
+}
+
+static int
+maskshift(unsigned long mask)
+{
+	int shift;
+
+	if (!mask)
+		return (0);
+	for (shift = 0; !(mask & 0x1); mask >>= 1, shift++) ;
+	return (shift);
+}
+
+static int
+maskloss(unsigned long mask)
+{
+	int bits;
+
+	for (mask >>= maskshift(mask), bits = 0; mask & 0x1; mask >>= 1, bits++) ;
+	return (bits < 8 ? 8 - bits : 0);
+}
+
+static inline void
+truerow(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n, const int msb)
+{
+	const int rs = maskshift(ds->visual->red_mask);
+	const int gs = maskshift(ds->visual->green_mask);
+	const int bs = maskshift(ds->visual->blue_mask);
+	unsigned long pixel;
+
+#define TRUEPIXEL(c) (((unsigned long) ds->rctab[(c)->red] << rs) | \
+		      ((unsigned long) ds->gctab[(c)->green] << gs) | \
+		      ((unsigned long) ds->bctab[(c)->blue] << bs))
+
+	switch (ds->bpp + (msb ? 1 : 0)) {
+	case 8:	/* 8bpp */
+	case 9:
+		for (; n; n--, c++)
+			*p++ = TRUEPIXEL(c);
+		break;
+	case 16:	/* 16bpp LSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel;
+			*p++ = pixel >> 8;
+		}
+		break;
+	case 17:	/* 16bpp MSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel >> 8;
+			*p++ = pixel;
+		}
+		break;
+	case 24:	/* 24bpp LSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel;
+			*p++ = pixel >> 8;
+			*p++ = pixel >> 16;
+		}
+		break;
+	case 25:	/* 24bpp MSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel >> 16;
+			*p++ = pixel >> 8;
+			*p++ = pixel;
+		}
+		break;
+	case 32:	/* 32bpp LSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel;
+			*p++ = pixel >> 8;
+			*p++ = pixel >> 16;
+			*p++ = pixel >> 24;
+		}
+		break;
+	case 33:	/* 32bpp MSB */
+		for (; n; n--, c++) {
+			pixel = TRUEPIXEL(c);
+			*p++ = pixel >> 24;
+			*p++ = pixel >> 16;
+			*p++ = pixel >> 8;
+			*p++ = pixel;
+		}
+		break;
+	}
+#undef TRUEPIXEL
+}
+
+static void
+converttruelsb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	truerow(ds, c, p, n, 0);
+}
+
+static void
+converttruemsb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	truerow(ds, c, p, n, 1);
+}
+
+/*
+ * 8-bit channels at the usual offsets: the ARGB pixel already is the X pixel
+ * (less alpha, which the table conversion never carried), so a 32bpp row is a
+ * masked copy and a 24bpp row drops every fourth byte.
+ */
+
+static void
+convert32lsb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	(void) ds;
+	for (; n; n--, c++) {
+		*p++ = c->blue;
+		*p++ = c->green;
+		*p++ = c->red;
+		*p++ = 0;
+	}
+}
+
+static void
+convert32msb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	(void) ds;
+	for (; n; n--, c++) {
+		*p++ = 0;
+		*p++ = c->red;
+		*p++ = c->green;
+		*p++ = c->blue;
+	}
+}
+
+static void
+convert24lsb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	(void) ds;
+	for (; n; n--, c++) {
+		*p++ = c->blue;
+		*p++ = c->green;
+		*p++ = c->red;
+	}
+}
+
+static void
+convert24msb(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	(void) ds;
+	for (; n; n--, c++) {
+		*p++ = c->red;
+		*p++ = c->green;
+		*p++ = c->blue;
+	}
+}
+
+#ifdef X86KERNELS
+
+#define SSE2  __attribute__((target("sse2")))
+#define SSSE3 __attribute__((target("ssse3")))
+
+static SSE2 void
+convert32lsb_sse2(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	const __m128i m = _mm_set1_epi32(0x00ffffff);
+
+	for (; n >= 4; n -= 4, c += 4, p += 16)
+		_mm_storeu_si128((__m128i *) p,
+				 _mm_and_si128(_mm_loadu_si128((const __m128i *) c), m));
+	convert32lsb(ds, c, p, n);
+}
+
+static SSSE3 void
+convert32msb_ssse3(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	const __m128i s = _mm_setr_epi8(-1, 2, 1, 0, -1, 6, 5, 4,
+					-1, 10, 9, 8, -1, 14, 13, 12);
+
+	for (; n >= 4; n -= 4, c += 4, p += 16)
+		_mm_storeu_si128((__m128i *) p,
+				 _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) c), s));
+	convert32msb(ds, c, p, n);
+}
+
+/*
+ * 24bpp packs 4 pixels into 12 bytes with a 16 byte store: stop 2 pixels short
+ * so that the store never runs past the end of the row.
+ */
+
+static SSSE3 void
+convert24lsb_ssse3(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	const __m128i s = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+					10, 12, 13, 14, -1, -1, -1, -1);
+
+	for (; n >= 6; n -= 4, c += 4, p += 12)
+		_mm_storeu_si128((__m128i *) p,
+				 _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) c), s));
+	convert24lsb(ds, c, p, n);
+}
+
+static SSSE3 void
+convert24msb_ssse3(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	const __m128i s = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+					8, 14, 13, 12, -1, -1, -1, -1);
+
+	for (; n >= 6; n -= 4, c += 4, p += 12)
+		_mm_storeu_si128((__m128i *) p,
+				 _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) c), s));
+	convert24msb(ds, c, p, n);
+}
+
+/*
+ * 16bpp (565, 555): when the color tables only truncate each channel, pixels
+ * are computed 8 at a time with shifts and masks and packed to 16 bits.
+ */
+
+static SSE2 __m128i
+truepixels_sse2(const __m128i v, const __m128i *sh, const __m128i *mk)
+{
+	__m128i r, g, b;
+
+	r = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(v, sh[0]), mk[0]), sh[3]);
+	g = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(v, sh[1]), mk[1]), sh[4]);
+	b = _mm_sll_epi32(_mm_and_si128(_mm_srl_epi32(v, sh[2]), mk[2]), sh[5]);
+	r = _mm_or_si128(_mm_or_si128(r, g), b);
+	/* sign extend the low 16 bits so that the saturating pack is exact */
+	return _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+}
+
+static SSE2 inline void
+row16_sse2(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n, const int msb)
+{
+	const int rl = maskloss(ds->visual->red_mask);
+	const int gl = maskloss(ds->visual->green_mask);
+	const int bl = maskloss(ds->visual->blue_mask);
+	const __m128i sh[6] = {
+		_mm_cvtsi32_si128(16 + rl),
+		_mm_cvtsi32_si128(8 + gl),
+		_mm_cvtsi32_si128(bl),
+		_mm_cvtsi32_si128(maskshift(ds->visual->red_mask)),
+		_mm_cvtsi32_si128(maskshift(ds->visual->green_mask)),
+		_mm_cvtsi32_si128(maskshift(ds->visual->blue_mask)),
+	};
+	const __m128i mk[3] = {
+		_mm_set1_epi32(0xff >> rl),
+		_mm_set1_epi32(0xff >> gl),
+		_mm_set1_epi32(0xff >> bl),
+	};
+	for (; n >= 8; n -= 8, c += 8, p += 16) {
+		__m128i lo = truepixels_sse2(_mm_loadu_si128((const __m128i *) c), sh, mk);
+		__m128i hi = truepixels_sse2(_mm_loadu_si128((const __m128i *) (c + 4)), sh, mk);
+		__m128i v = _mm_packs_epi32(lo, hi);
+
+		if (msb)
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *) p, v);
+	}
+	truerow(ds, c, p, n, msb);
+}
+
+static SSE2 void
+convert16lsb_sse2(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	row16_sse2(ds, c, p, n, 0);
+}
+
+static SSE2 void
+convert16msb_sse2(const AScreen *ds, const ARGB *c, unsigned char *p, unsigned n)
+{
+	row16_sse2(ds, c, p, n, 1);
+}
+
+#endif				/* X86KERNELS */
+
+static Bool
+truncates(const unsigned char *tab, const int loss)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		if (tab[i] != (i >> loss))
+			return False;
+	return True;
+}
+
+/*
+ * Select the row converter for the visual of the screen and the image byte
+ * order, and return its name.  The level limits the converters considered, so
+ * that the faster ones can be checked against the generic ones.
+ */
+const char *
+selectconvert(AScreen *ds, Bool msb, int level)
+{
+	const char *name;
+
+	switch (ds->visual->class) {
+	case StaticColor:
+	case PseudoColor:
+		ds->convert = convertcolors;
+		name = "colormap";
+		break;
+	case StaticGray:
+	case GrayScale:
+		ds->convert = convertgray;
+		name = "grayscale";
+		break;
+	case TrueColor:{
+		const unsigned long rm = ds->visual->red_mask;
+		const unsigned long gm = ds->visual->green_mask;
+		const unsigned long bm = ds->visual->blue_mask;
+		const Bool trunc = level > ConvertGeneric && truncates(ds->rctab, maskloss(rm)) &&
+		    truncates(ds->gctab, maskloss(gm)) && truncates(ds->bctab, maskloss(bm));
+#ifdef X86KERNELS
+		Bool sse2, ssse3;
+
+		__builtin_cpu_init();
+		sse2 = level >= ConvertVector && __builtin_cpu_supports("sse2");
+		ssse3 = level >= ConvertVector && __builtin_cpu_supports("ssse3");
+#endif
+
+		ds->convert = msb ? converttruemsb : converttruelsb;
+		name = "generic truecolor";
+		if (trunc && rm == 0xff0000 && gm == 0xff00 && bm == 0xff) {
+			switch (ds->bpp) {
+			case 32:
+				ds->convert = msb ? convert32msb : convert32lsb;
+				name = msb ? "32bpp msb" : "32bpp lsb";
+#ifdef X86KERNELS
+				if (!msb && sse2) {
+					ds->convert = convert32lsb_sse2;
+					name = "32bpp lsb sse2";
+				} else if (msb && ssse3) {
+					ds->convert = convert32msb_ssse3;
+					name = "32bpp msb ssse3";
+				}
+#endif
+				break;
+			case 24:
+				ds->convert = msb ? convert24msb : convert24lsb;
+				name = msb ? "24bpp msb" : "24bpp lsb";
+#ifdef X86KERNELS
+				if (ssse3) {
+					ds->convert = msb ? convert24msb_ssse3 : convert24lsb_ssse3;
+					name = msb ? "24bpp msb ssse3" : "24bpp lsb ssse3";
+				}
+#endif
+				break;
+			}
+		}
+#ifdef X86KERNELS
+		else if (trunc && ds->bpp == 16 && sse2) {
+			ds->convert = msb ? convert16msb_sse2 : convert16lsb_sse2;
+			name = "16bpp sse2";
+		}
+#endif
+		break;
+	}
+	default:
+		ds->convert = NULL;
+		name = "none";
+		break;
+	}
+	return (name);
+}
@@ -0,0 +1,14 @@
+/* convert.c */
+
+#ifndef __LOCAL_CONVERT_H__
+#define __LOCAL_CONVERT_H__
+
+enum {
+	ConvertGeneric,			/* the table conversion for the visual class */
+	ConvertScalar,			/* and the packed paths for usual layouts */
+	ConvertVector,			/* and their vector versions, when supported */
+};
+
+const char *selectconvert(AScreen *ds, Bool msb, int level);
+
+#endif				/* __LOCAL_CONVERT_H__ */
@@ -0,0 +1,333 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "draw.h"
+#include "image.h"
+#include "scale.h"
+#include "decode.h" /* verification */
+
+#if defined PTHREADS && defined LIBPNG
+#include <pthread.h>
+
+/*
+ * Application icons found in the icon theme are decoded and scaled to the
+ * title height by a small pool of worker threads, so that a large icon or a
+ * slow home directory does not stall window management.  Workers only read
+ * the file and produce ARGB pixels; they never touch the display.  Finished
+ * jobs are handed back through a pipe that run() polls alongside the X
+ * connection, and the main thread then creates the icon and redraws the
+ * client.  Until then the client simply has no icon.
+ *
+ * The last few decoded icons are kept (keyed by file, modification time and
+ * size) so that further windows of the same class get their icon at once.
+ */
+
+#define DECODERS	2		/* worker threads */
+#define DECODEKEEP	16		/* decoded icons kept */
+
+typedef struct DecodeJob DecodeJob;
+
+struct DecodeJob {
+	DecodeJob *next;
+	Client *c;			/* client wanting the icon */
+	Window win;			/* its window, to tell if it is still around */
+	AScreen *ds;
+	char *file;
+	time_t mtime;
+	unsigned size;			/* target height */
+	unsigned w, h;			/* result */
+	long *data;			/* result, as in _NET_WM_ICON */
+};
+
+static pthread_t decoders[DECODERS];
+static unsigned ndecoders = 0;
+static pthread_mutex_t decodelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t decodecond = PTHREAD_COND_INITIALIZER;
+static DecodeJob *pending = NULL, **pendtail = &pending;	/* guarded by decodelock */
+static DecodeJob *finished = NULL;				/* guarded by decodelock */
+static Bool stopping = False;					/* guarded by decodelock */
+static int decodepipe[2] = { -1, -1 };
+
+static DecodeJob *decoded = NULL;	/* kept results, most recent first */
+
+static void
+freejob(DecodeJob *j)
+{
+	free(j->file);
+	free(j->data);
+	free(j);
+}
+
+/* worker side: decode and scale one job */
+static void
+decodejob(DecodeJob *j)
+{
+	unsigned *argb, *scaled, w, h, i;
+
+	if (!(argb = png_read_file_to_argb(j->file, &w, &h)))
+		return;
+	if (h > j->size && j->size) {
+		unsigned nw = max(1U, (unsigned) ((unsigned long) w * j->size / h));
+
+		if ((scaled = scale_argb(argb, w, h, nw, j->size))) {
+			free(argb);
+			argb = scaled;
+			w = nw;
+			h = j->size;
+		}
+	}
+	j->data = ecalloc((size_t) w * h, sizeof(*j->data));
+	for (i = 0; i < w * h; i++)
+		j->data[i] = argb[i];
+	j->w = w;
+	j->h = h;
+	free(argb);
+}
+
+static void *
+decoder(void *arg)
+{
+	DecodeJob *j;
+
+	(void) arg;
+	pthread_mutex_lock(&decodelock);
+	for (;;) {
+		while (!pending && !stopping)
+			pthread_cond_wait(&decodecond, &decodelock);
+		if (stopping)
+			break;
+		j = pending;
+		if (!(pending = j->next))
+			pendtail = &pending;
+		pthread_mutex_unlock(&decodelock);
+
+		decodejob(j);
+
+		pthread_mutex_lock(&decodelock);
+		j->next = finished;
+		finished = j;
+		if (write(decodepipe[1], "", 1) == -1 && errno != EAGAIN)
+			EPRINTF("could not signal decoded icon: %s\n", strerror(errno));
+	}
+	pthread_mutex_unlock(&decodelock);
+	return (NULL);
+}
+
+void
+initdecode(void)
+{
+	sigset_t all, old;
+	unsigned i;
+
+	if (ndecoders)
+		return;
+	if (pipe(decodepipe) == -1) {
+		EPRINTF("could not create decode pipe: %s\n", strerror(errno));
+		decodepipe[0] = decodepipe[1] = -1;
+		return;
+	}
+	for (i = 0; i < 2; i++) {
+		fcntl(decodepipe[i], F_SETFD, FD_CLOEXEC);
+		fcntl(decodepipe[i], F_SETFL, fcntl(decodepipe[i], F_GETFL) | O_NONBLOCK);
+	}
+	/* signals are for the main loop */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < DECODERS; i++)
+		if (!pthread_create(&decoders[ndecoders], NULL, decoder, NULL))
+			ndecoders++;
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (!ndecoders) {
+		EPRINTF("could not start icon decoders: decoding in the foreground\n");
+		close(decodepipe[0]);
+		close(decodepipe[1]);
+		decodepipe[0] = decodepipe[1] = -1;
+		return;
+	}
+	OPRINTF("started %u icon decoding threads\n", ndecoders);
+}
+
+int
+decodefd(void)
+{
+	return (decodepipe[0]);
+}
+
+static void
+applyicon(DecodeJob *j)
+{
+	Client *c;
+
+	if (!(c = getclient(j->win, ClientWindow)) || c != j->c)
+		return;		/* gone */
+	if (getbutton(c))
+		return;		/* got an icon some other way meanwhile */
+	if (createdecodedicon(j->ds, c, j->w, j->h, j->data))
+		drawclient(c);
+}
+
+static DecodeJob *
+finddecoded(const char *file, time_t mtime, unsigned size)
+{
+	DecodeJob *j, **jp;
+
+	for (jp = &decoded; (j = *jp); jp = &j->next)
+		if (j->mtime == mtime && j->size == size && !strcmp(j->file, file)) {
+			/* move to front */
+			*jp = j->next;
+			j->next = decoded;
+			decoded = j;
+			return (j);
+		}
+	return (NULL);
+}
+
+static void
+keepdecoded(DecodeJob *j)
+{
+	DecodeJob **jp;
+	unsigned n;
+
+	j->next = decoded;
+	decoded = j;
+	for (n = 0, jp = &decoded; *jp && n < DECODEKEEP; jp = &(*jp)->next, n++) ;
+	while ((j = *jp)) {
+		*jp = j->next;
+		freejob(j);
+	}
+}
+
+/* main loop side: apply finished jobs */
+void
+decodedone(void)
+{
+	DecodeJob *list, *j;
+	char buf[64];
+
+	while (read(decodepipe[0], buf, sizeof(buf)) > 0) ;
+	pthread_mutex_lock(&decodelock);
+	list = finished;
+	finished = NULL;
+	pthread_mutex_unlock(&decodelock);
+	while ((j = list)) {
+		list = j->next;
+		if (!j->data) {
+			EPRINTF("could not decode icon %s\n", j->file);
+			freejob(j);
+			continue;
+		}
+		applyicon(j);
+		j->c = NULL;
+		j->win = None;
+		if (finddecoded(j->file, j->mtime, j->size))
+			freejob(j);
+		else
+			keepdecoded(j);
+	}
+	XFlush(dpy);
+}
+
+/*
+ * Gives the client the icon in file: at once when it was decoded recently,
+ * otherwise by queueing it for the decoding threads.  Returns False when the
+ * icon cannot be decoded in the background, in which case the caller loads it
+ * itself.
+ */
+Bool
+decodeicon(AScreen *ds, Client *c, const char *file)
+{
+	DecodeJob *j;
+	struct stat st;
+	const char *p;
+	unsigned size = ds->style.titleheight;
+
+	if (!ndecoders || !(p = strrchr(file, '.')) || strcmp(p + 1, "png"))
+		return False;
+	if (stat(file, &st))
+		return False;
+	if (ds->style.outline)
+		size--;
+	if ((j = finddecoded(file, st.st_mtime, size)))
+		return createdecodedicon(ds, c, j->w, j->h, j->data);
+	j = ecalloc(1, sizeof(*j));
+	j->c = c;
+	j->win = c->win;
+	j->ds = ds;
+	j->file = strdup(file);
+	j->mtime = st.st_mtime;
+	j->size = size;
+	pthread_mutex_lock(&decodelock);
+	*pendtail = j;
+	pendtail = &j->next;
+	pthread_cond_signal(&decodecond);
+	pthread_mutex_unlock(&decodelock);
+	return True;
+}
+
+void
+freedecode(void)
+{
+	DecodeJob *j;
+	unsigned i;
+
+	if (!ndecoders)
+		return;
+	pthread_mutex_lock(&decodelock);
+	stopping = True;
+	pthread_cond_broadcast(&decodecond);
+	pthread_mutex_unlock(&decodelock);
+	for (i = 0; i < ndecoders; i++)
+		pthread_join(decoders[i], NULL);
+	ndecoders = 0;
+	while ((j = pending)) {
+		pending = j->next;
+		freejob(j);
+	}
+	pendtail = &pending;
+	while ((j = finished)) {
+		finished = j->next;
+		freejob(j);
+	}
+	while ((j = decoded)) {
+		decoded = j->next;
+		freejob(j);
+	}
+	close(decodepipe[0]);
+	close(decodepipe[1]);
+	decodepipe[0] = decodepipe[1] = -1;
+	stopping = False;
+}
+
+#else				/* !defined PTHREADS || !defined LIBPNG */
+
+void
+initdecode(void)
+{
+}
+
+int
+decodefd(void)
+{
+	return (-1);
+}
+
+void
+decodedone(void)
+{
+}
+
+Bool
+decodeicon(AScreen *ds, Client *c, const char *file)
+{
+	(void) ds;
+	(void) c;
+	(void) file;
+	return False;
+}
+
+void
+freedecode(void)
+{
+}
+
+#endif				/* defined PTHREADS && defined LIBPNG */
@@ -0,0 +1,12 @@
+/* decode.c */
+
+#ifndef __LOCAL_DECODE_H__
+#define __LOCAL_DECODE_H__
+
+void initdecode(void);
+int decodefd(void);
+void decodedone(void);
+Bool decodeicon(AScreen *ds, Client *c, const char *file);
+void freedecode(void);
+
+#endif				/* __LOCAL_DECODE_H__ */
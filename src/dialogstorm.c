@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/Xresource.h>
+
+#include "util.h"
+
+/*
+ * Stress the window manager with storms of short-lived windows: each round
+ * maps a batch of windows, waits until the window manager has reparented
+ * them all, and then destroys them again.  Every window gets its own
+ * WM_CLASS (or one of -c classes), so the per-round time shows whether
+ * registering a window gets slower as the window manager has seen more of
+ * them.
+ */
+
+int screen;
+Display *dpy;
+Window root;
+
+static unsigned rounds = 20;
+static unsigned batch = 100;
+static unsigned classes = 0;		/* 0 = unique class per window */
+static unsigned serial = 0;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0);
+}
+
+static Window
+storm(void)
+{
+	XSetWindowAttributes wa;
+	XClassHint ch;
+	char name[32], clas[32];
+	Window win;
+	unsigned n = serial++;
+
+	wa.event_mask = StructureNotifyMask;
+	win = XCreateWindow(dpy, root, 0, 0, 64, 32, 0, CopyFromParent, InputOutput,
+			    CopyFromParent, CWEventMask, &wa);
+	if (classes)
+		n %= classes;
+	snprintf(name, sizeof(name), "dialog%u", n);
+	snprintf(clas, sizeof(clas), "Storm%u", n);
+	ch.res_name = name;
+	ch.res_class = clas;
+	XSetClassHint(dpy, win, &ch);
+	XStoreName(dpy, win, name);
+	XMapWindow(dpy, win);
+	return (win);
+}
+
+/* wait for count windows to be reparented, giving up after a second of quiet */
+static unsigned
+waitmanaged(unsigned count)
+{
+	unsigned done = 0;
+	XEvent ev;
+
+	while (done < count) {
+		if (!XPending(dpy)) {
+			struct timeval tv = { 1, 0 };
+			fd_set fds;
+
+			FD_ZERO(&fds);
+			FD_SET(ConnectionNumber(dpy), &fds);
+			if (select(ConnectionNumber(dpy) + 1, &fds, NULL, NULL, &tv) <= 0)
+				break;
+		}
+		XNextEvent(dpy, &ev);
+		if (ev.type == ReparentNotify && ev.xreparent.parent != root)
+			done++;
+	}
+	return (done);
+}
+
+int
+main(int argc, char *argv[])
+{
+	Window *wins;
+	double start, total = 0.0;
+	unsigned r, i, managed;
+	int c;
+
+	while ((c = getopt(argc, argv, "r:n:c:")) != -1) {
+		switch (c) {
+		case 'r':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			classes = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			eprint("usage: dialogstorm [-r rounds] [-n windows] [-c classes]\n");
+		}
+	}
+	if (!batch)
+		eprint("dialogstorm: need at least one window per round\n");
+	dpy = XOpenDisplay(0);
+	if (!dpy)
+		eprint("dialogstorm: cannot open display\n");
+	screen = DefaultScreen(dpy);
+	root = RootWindow(dpy, screen);
+	wins = emallocz(batch * sizeof(*wins));
+
+	for (r = 0; r < rounds; r++) {
+		start = now();
+		for (i = 0; i < batch; i++)
+			wins[i] = storm();
+		XFlush(dpy);
+		managed = waitmanaged(batch);
+		for (i = 0; i < batch; i++)
+			XDestroyWindow(dpy, wins[i]);
+		XSync(dpy, True);
+		start = now() - start;
+		total += start;
+		printf("round %u: %u/%u managed in %.2f ms (%.3f ms/window, %u seen)\n",
+		       r + 1, managed, batch, start, start / batch, serial);
+		if (managed < batch)
+			eprint("dialogstorm: is a window manager running?\n");
+	}
+	printf("total: %u windows in %.2f ms (%.3f ms/window)\n", serial, total,
+	       total / serial);
+	free(wins);
+	XCloseDisplay(dpy);
+	return 0;
+}
@@ -7,6 +7,8 @@
 #include "actions.h"
 #include "config.h"
 #include "icons.h"
+#include "decode.h"
+#include "phase.h"
 #if defined IMLIB2 && defined USE_IMLIB2
 #include "imlib.h"
 #endif				/* defined IMLIB2 && defined USE_IMLIB2 */
@@ -319,6 +321,13 @@ createneticon(Client *c, long *data, unsigned long n)
 	return (status);
 }
 
+/* icon from pixels decoded in the background (see decode.c) */
+Bool
+createdecodedicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data)
+{
+	return createdataicon(ds, c, w, h, data);
+}
+
 Bool
 createappicon(Client *c)
 {
@@ -352,6 +361,11 @@ createappicon(Client *c)
 
 	if (!(file = FindBestIcon(names, scr->style.titleheight, exts)))
 		return (result);
+	if (decodeicon(scr, c, file)) {
+		/* icon is set now or once the decoders are done with it */
+		free(file);
+		return (True);
+	}
 	if ((p = strrchr(file, '.'))) {
 		p++;
 		if (!strcmp(p, "xbm"))
@@ -800,6 +814,7 @@ initpixmap(const char *file, ButtonImage *bi)
 
 	if (!file || !(path = findrcpath(file)))
 		return False;
+	phasefile(path);
 	if ((p = strstr(path, ".xpm")) && strlen(p) == 4)
 		if ((bi->present = initxpm(path, &bi->px)))
 			return True;
@@ -1089,39 +1104,24 @@ freecolor(XftColor *color)
 {
 	if (color->pixel)
 		XftColorFree(dpy, scr->visual, scr->colormap, color);
+	memset(color, 0, sizeof(*color));
 }
 
-void
-freestyle()
+static void
+freecolors(void)
 {
 	int i, j;
 
-	freebuttons();
-	for (i = 0; i <= Selected; i++) {
+	for (i = 0; i <= Selected; i++)
 		for (j = 0; j < ColLast; j++)
 			freecolor(&scr->style.color.hue[i][j]);
-		freefont(i);
-	}
-	if (scr->dc.gc) {
-		XFreeGC(dpy, scr->dc.gc);
-		scr->dc.gc = None;
-	}
-	if (scr->dc.draw.xft) {
-		XftDrawDestroy(scr->dc.draw.xft);
-		scr->dc.draw.xft = NULL;
-	}
-	if (scr->dc.draw.pixmap) {
-		XFreePixmap(dpy, scr->dc.draw.pixmap);
-		scr->dc.draw.pixmap = None;
-	}
 }
 
-void
-initstyle(Bool reload __attribute__((unused)))
+/* colors are a phase of their own so that a reload changing only them is cheap */
+static void
+alloccolors(void)
 {
-	Client *c;
-
-	freestyle();
+	InitPhase prev = beginphase(PhaseColors);
 
 	alloccolor(getscreenres("selected.border", SELBORDERCOLOR), &scr->style.color.sele[ColBorder]);
 	alloccolor(getscreenres("selected.bg", SELBGCOLOR), &scr->style.color.sele[ColBG]);
@@ -1138,13 +1138,68 @@ initstyle(Bool reload __attribute__((unused)))
 	alloccolor(getscreenres("normal.fg", NORMFGCOLOR), &scr->style.color.norm[ColFG]);
 	alloccolor(getscreenres("normal.button", NORMBUTTONCOLOR), &scr->style.color.norm[ColButton]);
 
-	if ((scr->style.drop[Selected] = atoi(getscreenres("selected.drop", "0"))))
+	if (scr->style.drop[Selected])
 		alloccolor(getscreenres("selected.shadow", SELBORDERCOLOR), &scr->style.color.sele[ColShadow]);
-	if ((scr->style.drop[Focused] = atoi(getscreenres("focused.drop", "0"))))
+	if (scr->style.drop[Focused])
 		alloccolor(getscreenres("focused.shadow", FOCBORDERCOLOR), &scr->style.color.focu[ColShadow]);
-	if ((scr->style.drop[Normal] = atoi(getscreenres("normal.drop", "0"))))
+	if (scr->style.drop[Normal])
 		alloccolor(getscreenres("normal.shadow", NORMBORDERCOLOR), &scr->style.color.norm[ColShadow]);
 
+	endphase(prev);
+}
+
+/*
+ * Reallocates only the style colors and redraws the clients once: for a
+ * reload that changed nothing else of the style.
+ */
+void
+initcolors(void)
+{
+	Client *c;
+
+	freecolors();
+	alloccolors();
+	XSetForeground(dpy, scr->dc.gc, scr->style.color.norm[ColButton].pixel);
+	XSetBackground(dpy, scr->dc.gc, scr->style.color.norm[ColBG].pixel);
+	for (c = scr->clients; c; c = c->next)
+		drawclient(c);
+}
+
+void
+freestyle()
+{
+	int i;
+
+	freebuttons();
+	freecolors();
+	for (i = 0; i <= Selected; i++)
+		freefont(i);
+	if (scr->dc.gc) {
+		XFreeGC(dpy, scr->dc.gc);
+		scr->dc.gc = None;
+	}
+	if (scr->dc.draw.xft) {
+		XftDrawDestroy(scr->dc.draw.xft);
+		scr->dc.draw.xft = NULL;
+	}
+	if (scr->dc.draw.pixmap) {
+		XFreePixmap(dpy, scr->dc.draw.pixmap);
+		scr->dc.draw.pixmap = None;
+	}
+}
+
+void
+initstyle(Bool reload __attribute__((unused)))
+{
+	Client *c;
+
+	freestyle();
+
+	scr->style.drop[Selected] = atoi(getscreenres("selected.drop", "0"));
+	scr->style.drop[Focused] = atoi(getscreenres("focused.drop", "0"));
+	scr->style.drop[Normal] = atoi(getscreenres("normal.drop", "0"));
+	alloccolors();
+
 	initfont(getscreenres("selected.font", getscreenres("font", FONT)), Selected);
 	initfont(getscreenres("focused.font", getscreenres("font", FONT)), Focused);
 	initfont(getscreenres("normal.font", getscreenres("font", FONT)), Normal);
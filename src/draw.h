@@ -12,6 +12,7 @@ Bool createwmicon(Client *c);
 Bool createkwmicon(Client *c, Pixmap *data, unsigned long n);
 Bool createneticon(Client *c, long *data, unsigned long n);
 Bool createappicon(Client *c);
+Bool createdecodedicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data);
 void removebutton(ButtonImage *bi);
 void drawclient(Client *c);
 #ifdef DAMAGE
@@ -30,5 +31,6 @@ unsigned long getpixel(AScreen *ds, Client *c, int type);
 void initelement(ElementType type, const char *name, const char *dev, Bool (**action) (Client *, XEvent *));
 void freestyle();
 void initstyle(Bool reload);
+void initcolors(void);
 
 #endif				/* __LOCAL_DRAW_H__ */
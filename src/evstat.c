@@ -0,0 +1,243 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "prof.h"
+#include "evstat.h" /* verification */
+
+/*
+ * Event handler statistics.  handle_event() runs each handler through
+ * evstathandle(), which counts the events of each type (extension events by
+ * extension and offset), the time spent handling them (total, maximum and a
+ * histogram in powers of two of microseconds), and the X requests and round
+ * trips that the handlers made.  The times of a handler include those of
+ * the events that it handles itself, as moves and resizes do.  On SIGUSR1,
+ * the statistics are written to a file (see evstatdump()).
+ */
+
+#define NSLOTS		(LASTEvent + EXTRANGE * BaseLast)
+#define NBUCKETS	24		/* < 1us, < 2us, ... < 4.2s, longer */
+
+typedef struct {
+	unsigned long count;
+	unsigned long requests;
+	unsigned long replies;
+	uint64_t total;			/* ns */
+	uint64_t max;			/* ns */
+	unsigned long buckets[NBUCKETS];
+} EventStat;
+
+static EventStat stats[NSLOTS];
+static struct timespec started;
+
+static const char *eventnames[LASTEvent] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent",
+};
+
+static uint64_t
+evstatnow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * 1000000000 + now.tv_nsec);
+}
+
+/* call the handler for the event in the given slot of handler[] */
+Bool
+evstathandle(int slot, Bool (*handler) (XEvent *), XEvent *ev)
+{
+	EventStat *s = stats + slot;
+	unsigned long requests = NextRequest(dpy), replies = profreplies;
+	uint64_t start = evstatnow(), us;
+	unsigned b;
+	Bool result;
+
+	if (!started.tv_sec)
+		clock_gettime(CLOCK_MONOTONIC, &started);
+	result = handler(ev);
+	start = evstatnow() - start;
+	s->count++;
+	s->total += start;
+	if (start > s->max)
+		s->max = start;
+	for (b = 0, us = start / 1000; us && b < NBUCKETS - 1; us >>= 1, b++) ;
+	s->buckets[b]++;
+	/* the handler may have closed the display */
+	if (dpy)
+		s->requests += NextRequest(dpy) - requests;
+	s->replies += profreplies - replies;
+	return (result);
+}
+
+static void
+slotname(int slot, char *buf, size_t len)
+{
+	int base, offset;
+
+	if (slot < LASTEvent) {
+		if (eventnames[slot])
+			snprintf(buf, len, "%s", eventnames[slot]);
+		else
+			snprintf(buf, len, "event %d", slot);
+		return;
+	}
+	base = (slot - LASTEvent) / EXTRANGE;
+	offset = (slot - LASTEvent) % EXTRANGE;
+	snprintf(buf, len, "%s+%d", einfo[base].name, offset);
+}
+
+static int
+bytotal(const void *a, const void *b)
+{
+	const EventStat *sa = stats + *(const int *) a;
+	const EventStat *sb = stats + *(const int *) b;
+
+	return (sa->total < sb->total) - (sa->total > sb->total);
+}
+
+static void
+printstat(FILE *f, const char *name, const EventStat *s)
+{
+	fprintf(f, "%-22s %9lu %12.3f %10.3f %10.3f %9lu %10lu\n", name, s->count,
+		s->total / 1000000.0, s->count ? s->total / 1000.0 / s->count : 0.0,
+		s->max / 1000.0, s->requests, s->replies);
+}
+
+static void
+addstat(EventStat *to, const EventStat *s)
+{
+	unsigned b;
+
+	to->count += s->count;
+	to->requests += s->requests;
+	to->replies += s->replies;
+	to->total += s->total;
+	if (s->max > to->max)
+		to->max = s->max;
+	for (b = 0; b < NBUCKETS; b++)
+		to->buckets[b] += s->buckets[b];
+}
+
+/*
+ * Write the statistics to the file named by the eventStats resource, or to
+ * adwm-PID.events in TMPDIR (or /tmp): the types of event by decreasing
+ * total time, the totals for the core events and for each extension, and the
+ * latency histograms.
+ */
+void
+evstatdump(void)
+{
+	char path[PATH_MAX + 1], tmp[PATH_MAX + 1], name[64];
+	const char *file, *dir;
+	int order[NSLOTS], n = 0, i, j;
+	EventStat sum[BaseLast + 1];
+	unsigned b;
+	double uptime;
+	struct timespec now;
+	FILE *f;
+
+	if (!(file = getresource("eventStats", NULL))) {
+		if (!(dir = getenv("TMPDIR")) || !*dir)
+			dir = "/tmp";
+		if (snprintf(path, sizeof(path), "%s/adwm-%d.events", dir,
+			     (int) getpid()) >= (int) sizeof(path)) {
+			EPRINTF("event statistics file name in %s is too long\n", dir);
+			return;
+		}
+		file = path;
+	}
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", file, (int) getpid()) >= (int) sizeof(tmp)) {
+		EPRINTF("event statistics file name %s is too long\n", file);
+		return;
+	}
+	if (!(f = fopen(tmp, "w"))) {
+		EPRINTF("could not write event statistics %s: %s\n", tmp, strerror(errno));
+		return;
+	}
+	for (i = 0; i < NSLOTS; i++)
+		if (stats[i].count)
+			order[n++] = i;
+	qsort(order, n, sizeof(*order), bytotal);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uptime = started.tv_sec ? (now.tv_sec - started.tv_sec) +
+	    (now.tv_nsec - started.tv_nsec) / 1000000000.0 : 0.0;
+	fprintf(f, "# adwm %s event handler statistics: pid %d, %.3f s of events\n",
+		VERSION, (int) getpid(), uptime);
+	fprintf(f, "# times include events handled within a handler (moves, resizes)\n\n");
+	fprintf(f, "%-22s %9s %12s %10s %10s %9s %10s\n", "event", "count", "total ms",
+		"mean us", "max us", "requests", "roundtrips");
+	memset(sum, 0, sizeof(sum));
+	for (j = 0; j < n; j++) {
+		i = order[j];
+		slotname(i, name, sizeof(name));
+		printstat(f, name, stats + i);
+		addstat(sum + (i < LASTEvent ? BaseLast : (i - LASTEvent) / EXTRANGE), stats + i);
+	}
+
+	fprintf(f, "\n%-22s %9s %12s %10s %10s %9s %10s\n", "events of", "count", "total ms",
+		"mean us", "max us", "requests", "roundtrips");
+	printstat(f, "core", sum + BaseLast);
+	for (i = 0; i < BaseLast; i++)
+		if (sum[i].count)
+			printstat(f, einfo[i].name, sum + i);
+
+	fprintf(f, "\nlatency histograms (events taking less than the time shown)\n");
+	for (j = 0; j < n; j++) {
+		i = order[j];
+		slotname(i, name, sizeof(name));
+		fprintf(f, "%-22s", name);
+		for (b = 0; b < NBUCKETS; b++) {
+			if (!stats[i].buckets[b])
+				continue;
+			if (b == NBUCKETS - 1)
+				fprintf(f, " >=%lus:%lu", (1UL << (b - 1)) / 1000000, stats[i].buckets[b]);
+			else if (b >= 20)
+				fprintf(f, " <%lus:%lu", (1UL << b) / 1000000, stats[i].buckets[b]);
+			else if (b >= 10)
+				fprintf(f, " <%lums:%lu", (1UL << b) / 1000, stats[i].buckets[b]);
+			else
+				fprintf(f, " <%luus:%lu", 1UL << b, stats[i].buckets[b]);
+		}
+		fprintf(f, "\n");
+	}
+	if (fclose(f) || rename(tmp, file)) {
+		EPRINTF("could not write event statistics %s: %s\n", file, strerror(errno));
+		unlink(tmp);
+		return;
+	}
+	OPRINTF("wrote statistics of %d event types to %s\n", n, file);
+}
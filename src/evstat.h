@@ -0,0 +1,9 @@
+/* evstat.c */
+
+#ifndef __LOCAL_EVSTAT_H__
+#define __LOCAL_EVSTAT_H__
+
+Bool evstathandle(int slot, Bool (*handler) (XEvent *), XEvent *ev);
+void evstatdump(void);
+
+#endif				/* __LOCAL_EVSTAT_H__ */
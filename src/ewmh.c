@@ -371,6 +371,26 @@ parse_startup_id(const char *id, char **launcher_p, char **launchee_p, char **ho
 #ifdef STARTUP_NOTIFICATION
 static Notify *notifies = NULL;
 
+#define NOTIFYHASH 64			/* power of two */
+
+/* notifies hashed by startup id */
+static Notify *notifytab[NOTIFYHASH];
+
+static Notify *
+n_find_id(const char *id)
+{
+	Notify *n;
+	unsigned hash;
+
+	if (!id)
+		return (NULL);
+	hash = strhash(HASHINIT, id);
+	for (n = notifytab[hash & (NOTIFYHASH - 1)]; n; n = n->hnext)
+		if (n->hash == hash && !strcmp(n->id, id))
+			break;
+	return (n);
+}
+
 struct SnStartupSequence
 {
 	int refcount;
@@ -418,49 +438,22 @@ n_find_seq(SnStartupSequence *seq)
 		EPRINTF("Passed a nulil pointer\n");
 		return (n);
 	}
-	for (n = notifies; n && n->seq != seq; n = n->next) ;
-	if (!n) {
-		const char *id = sn_startup_sequence_get_id(seq);
-
-		EPRINTF("Could not find sequence %p : %s\n", seq, id);
-		/* let's try harder */
-		for (n = notifies; n && strcmp(n->id, id); n = n->next) ;
-		if (!n)
-			EPRINTF("Still couldn't find sequence %p : %s\n", seq, id);
-		else
-			EPRINTF("Found sequence by id!\n");
-	}
+	if (!(n = n_find_id(sn_startup_sequence_get_id(seq))))
+		EPRINTF("Could not find sequence %p : %s\n", seq,
+			sn_startup_sequence_get_id(seq));
+	else if (n->seq != seq)
+		EPRINTF("Found sequence by id!\n");
 	return (n);
 }
 
 static Client *
-c_find_seq(SnStartupSequence *seq)
+c_find_seq(Notify *n)
 {
 	Client *c = NULL;
 
-	if (!seq) {
-		EPRINTF("Passed a nulil pointer\n");
-		return (c);
-	}
-	for (c = scr->clients; c && c->seq != seq; c = c->next) ;
-	if (!c) {
-		const char *id = sn_startup_sequence_get_id(seq);
-
-		EPRINTF("Could not find sequence %p : %s\n", seq, id);
-		/* let's try harder */
-		for (c = scr->clients; c; c = c->next) {
-			const char *id2;
-
-			if (!c->seq)
-				continue;
-			id2 = sn_startup_sequence_get_id(c->seq);
-			if (!strcmp(id, id2))
-				break;
-		}
-		if (!c)
-			EPRINTF("Still couldn't find sequence %p : %s\n", seq, id);
-		else
-			EPRINTF("Found sequence by id!\n");
+	if (!n->win || !(c = getmanaged(n->win, ClientWindow)) || c->seq != n->seq) {
+		EPRINTF("Could not find client for sequence %p : %s\n", n->seq, n->id);
+		return (NULL);
 	}
 	return (c);
 }
@@ -488,6 +481,9 @@ n_new_notify(SnStartupSequence *seq)
 	XPRINTF("NOTIFY: NEW: %s\n", n->id);
 	n->next = notifies;
 	notifies = n;
+	n->hash = strhash(HASHINIT, n->id);
+	n->hnext = notifytab[n->hash & (NOTIFYHASH - 1)];
+	notifytab[n->hash & (NOTIFYHASH - 1)] = n;
 }
 
 static void ewmh_update_sn_app_props(Client *c, Notify *n);
@@ -502,7 +498,7 @@ n_chg_notify(SnStartupSequence *seq)
 		if (n->assigned) {
 			Client *c;
 
-			if ((c = c_find_seq(seq)))
+			if ((c = c_find_seq(n)))
 				ewmh_update_sn_app_props(c, n);
 		}
 	} else {
@@ -519,6 +515,9 @@ n_del_notify(Notify *n)
 	np = n_find_n(n);
 	assert(np != NULL);
 	*np = n->next;
+	for (np = &notifytab[n->hash & (NOTIFYHASH - 1)]; *np && *np != n; np = &(*np)->hnext) ;
+	if (*np)
+		*np = n->hnext;
 	sn_startup_sequence_unref(n->seq);
 	free(n->id);
 	free(n->launcher);
@@ -559,6 +558,7 @@ n_set_notify(Notify *n, Client *c)
 	}
 	seq = c->seq = n->seq;
 	sn_startup_sequence_ref(seq);
+	n->win = c->win;
 	if (n->assigned)
 		XPRINTF("notify already assigned\n");
 	n->assigned = True;
@@ -1113,6 +1113,7 @@ ewmh_update_net_desktop_names()
 		strcpy(pos, scr->tags[i].name);
 		pos += strlen(scr->tags[i].name) + 1;
 	}
+	invalidateruletags(scr);
 	XChangeProperty(dpy, scr->root, _XA_NET_DESKTOP_NAMES, _XA_UTF8_STRING, 8,
 			PropModeReplace, (unsigned char *) buf, len);
 	XChangeProperty(dpy, scr->root, _XA_WIN_WORKSPACE_NAMES, XA_STRING, 8,
@@ -1509,7 +1510,7 @@ ewmh_update_net_window_desktop_mask(Client *c)
 void
 ewmh_update_net_window_desktop(Client *c)
 {
-	XPRINTF(c, "Updating _NET_WM_DESKTOP\n");
+	XCPRINTF(c, "Updating _NET_WM_DESKTOP\n");
 	if (isomni(c)) {
 		long i = -1;
 
@@ -1707,6 +1708,7 @@ ewmh_process_net_desktop_names(void)
 		XFree(ret);
 		ret = NULL;
 	}
+	invalidateruletags(scr);
 	if (i < scr->ntags)
 		ewmh_update_net_desktop_names();
 }
@@ -2607,102 +2609,102 @@ ewmh_update_sn_app_props(Client *c, Notify *n)
 	if (!win)
 		win = c->win;
 
-	XPRINTF(c, "%s updating startup properties on window 0x%lx\n", n->id, win);
+	XCPRINTF(c, "%s updating startup properties on window 0x%lx\n", n->id, win);
 	if ((text = sn_startup_sequence_get_id(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_STARTUP_ID,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no id!\n", n->id);
+		XCPRINTF(c, "%s sequence has no id!\n", n->id);
 	if ((text = n->launcher)) {
 		XChangeProperty(dpy, win, _XA_NET_APP_LAUNCHER,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no launcher!\n", n->id);
+		XCPRINTF(c, "%s sequence has no launcher!\n", n->id);
 	if ((text = n->launchee)) {
 		XChangeProperty(dpy, win, _XA_NET_APP_LAUNCHEE,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no launchee!\n", n->id);
+		XCPRINTF(c, "%s sequence has no launchee!\n", n->id);
 	if ((text = n->hostname)) {
 		XChangeProperty(dpy, win, _XA_NET_APP_HOSTNAME,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no hostname!\n", n->id);
+		XCPRINTF(c, "%s sequence has no hostname!\n", n->id);
 	if (n->pid != -1) {
 		data = n->pid;
 		XChangeProperty(dpy, win, _XA_NET_APP_PID,
 				XA_CARDINAL, 32, PropModeReplace,
 				(unsigned char *) &data, 1);
 	} else
-		XPRINTF(c, "%s sequence has no pid!\n", n->id);
+		XCPRINTF(c, "%s sequence has no pid!\n", n->id);
 	if (n->sequence != -1) {
 		data = n->sequence;
 		XChangeProperty(dpy, win, _XA_NET_APP_SEQUENCE,
 				XA_CARDINAL, 32, PropModeReplace,
 				(unsigned char *) &data, 1);
 	} else
-		XPRINTF(c, "%s sequence has no sequence!\n", n->id);
+		XCPRINTF(c, "%s sequence has no sequence!\n", n->id);
 	if (n->timestamp != -1UL) {
 		data = n->timestamp;
 		XChangeProperty(dpy, win, _XA_NET_APP_TIMESTAMP,
 				XA_CARDINAL, 32, PropModeReplace,
 				(unsigned char *) &data, 1);
 	} else
-		XPRINTF(c, "%s sequence has no timestamp!\n", n->id);
+		XCPRINTF(c, "%s sequence has no timestamp!\n", n->id);
 	if ((text = sn_startup_sequence_get_application_id(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_APPLICATION_ID,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no application id!\n", n->id);
+		XCPRINTF(c, "%s sequence has no application id!\n", n->id);
 	if ((text = sn_startup_sequence_get_name(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_NAME,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no name!\n", n->id);
+		XCPRINTF(c, "%s sequence has no name!\n", n->id);
 	if ((text = sn_startup_sequence_get_description(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_DESCRIPTION,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no description!\n", n->id);
+		XCPRINTF(c, "%s sequence has no description!\n", n->id);
 	if ((text = sn_startup_sequence_get_icon_name(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_ICON_NAME,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no icon name!\n", n->id);
+		XCPRINTF(c, "%s sequence has no icon name!\n", n->id);
 	if ((text = sn_startup_sequence_get_binary_name(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_BINARY_NAME,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no binary name!\n", n->id);
+		XCPRINTF(c, "%s sequence has no binary name!\n", n->id);
 	if ((text = sn_startup_sequence_get_wmclass(seq))) {
 		XChangeProperty(dpy, win, _XA_NET_APP_WMCLASS,
 				_XA_UTF8_STRING, 8, PropModeReplace,
 				(unsigned char *) text, strlen(text) + 1);
 	} else
-		XPRINTF(c, "%s sequence has no wmclass!\n", n->id);
+		XCPRINTF(c, "%s sequence has no wmclass!\n", n->id);
 	if (sn_startup_sequence_get_screen(seq) != -1) {
 		data = sn_startup_sequence_get_screen(seq);
 		XChangeProperty(dpy, win, _XA_NET_APP_SCREEN,
 				XA_CARDINAL, 32, PropModeReplace,
 				(unsigned char *) &data, 1);
 	} else
-		XPRINTF(c, "%s sequence has no screen!\n", n->id);
+		XCPRINTF(c, "%s sequence has no screen!\n", n->id);
 	if (sn_startup_sequence_get_workspace(seq) != -1) {
 		data = sn_startup_sequence_get_workspace(seq);
 		XChangeProperty(dpy, win, _XA_NET_APP_WORKSPACE,
 				XA_CARDINAL, 32, PropModeReplace,
 				(unsigned char *) &data, 1);
 	} else
-		XPRINTF(c, "%s sequence has no workspace!\n", n->id);
+		XCPRINTF(c, "%s sequence has no workspace!\n", n->id);
 }
 #endif
 
@@ -2750,13 +2752,7 @@ find_startup_seq(Client *c)
 		return seq;
 	do {
 		if ((startup_id = getstartupid(c))) {
-			for (n = notifies; n; n = n->next) {
-				XPRINTF("comparing '%s' with '%s'\n",
-					startup_id, sn_startup_sequence_get_id(n->seq));
-				if (!strcmp(startup_id, sn_startup_sequence_get_id(n->seq)))
-					break;
-			}
-			if (n)
+			if ((n = n_find_id(startup_id)))
 				break;
 			XPRINTF("cannot find startup id '%s'!\n",
 				startup_id);
@@ -2831,7 +2827,7 @@ find_startup_seq(Client *c)
 	if (n) {
 		long workspace;
 
-		XPRINTF(c, "FOUND STARTUP ID '%s'!\n", n->id);
+		XCPRINTF(c, "FOUND STARTUP ID '%s'!\n", n->id);
 		if (!startup_id)
 			setstartupid(c, n->id);
 		/* Note that if the window has mapped itself on the wrong workspace, we
@@ -2840,10 +2836,10 @@ find_startup_seq(Client *c)
 			workspace = sn_startup_sequence_get_workspace(n->seq);
 			if (0 <= workspace && workspace < scr->ntags) {
 				if (c->is.managed) {
-					XPRINTF(c, "moving to workspace %ld for sequence '%s'\n", workspace, n->id);
+					XCPRINTF(c, "moving to workspace %ld for sequence '%s'\n", workspace, n->id);
 					tagonly(c, workspace);
 				} else {
-					XPRINTF(c, "marking for workspace %ld for sequence '%s'\n", workspace, n->id);
+					XCPRINTF(c, "marking for workspace %ld for sequence '%s'\n", workspace, n->id);
 					c->tags = (1ULL << workspace);
 					/* likely have not been read yet */
 					XChangeProperty(dpy, c->win, _XA_NET_WM_DESKTOP,
@@ -2855,7 +2851,7 @@ find_startup_seq(Client *c)
 				}
 			}
 		} else
-			XPRINTF(c, "workspace not defined in sequence '%s'\n", n->id);
+			XCPRINTF(c, "workspace not defined in sequence '%s'\n", n->id);
 		if (strstr(n->id, "xdg-launch") == n->id)
 			if (0 <= n->sequence && n->sequence < scr->nmons)
 				c->monitor = n->sequence + 1;
@@ -2985,11 +2981,11 @@ ewmh_process_net_window_icon(Client *c)
 
 	if ((bi = getbutton(c)))
 		return;
-	if ((card = getcard(c->win, _XA_NET_WM_ICON, &n))) {
+	if ((card = getneticon(c->win, scr->style.titleheight, &n))) {
 		if (n < 2 || n < 2UL + card[0] * card[1])
 			XFree(card);
 		else if (createneticon(c, card, n)) {
-			XPRINTF(c, "using _NET_WM_ICON for icon\n");
+			XCPRINTF(c, "using _NET_WM_ICON for icon\n");
 			return;
 		}
 	}
@@ -2997,20 +2993,34 @@ ewmh_process_net_window_icon(Client *c)
 		if (n < 2)
 			XFree(pixmap);
 		else if (createkwmicon(c, pixmap, n)) {
-			XPRINTF(c, "using KWM_WM_ICON for icon\n");
+			XCPRINTF(c, "using KWM_WM_ICON for icon\n");
 			return;
 		}
 	}
 	if (createwmicon(c)) {
-		XPRINTF(c, "using WM_HINTS icon for icon\n");
+		XCPRINTF(c, "using WM_HINTS icon for icon\n");
 		return;
 	}
 	if (createappicon(c)) {
-		XPRINTF(c, "using app icon for icon\n");
+		XCPRINTF(c, "using app icon for icon\n");
 		return;
 	}
 }
 
+/* write opacity to the frame, but only when it changes */
+static void
+writeopacity(Client *c, unsigned int opacity)
+{
+	long data = opacity;
+
+	if (c->hasframeopacity && c->frameopacity == opacity)
+		return;
+	XChangeProperty(dpy, c->frame, _XA_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32,
+			PropModeReplace, (unsigned char *) &data, 1L);
+	c->frameopacity = opacity;
+	c->hasframeopacity = True;
+}
+
 void
 ewmh_process_net_window_opacity(Client *c)
 {
@@ -3019,12 +3029,16 @@ ewmh_process_net_window_opacity(Client *c)
 
 	if ((opacity = getcard(c->win, _XA_NET_WM_WINDOW_OPACITY, &n))) {
 		c->opacity = opacity[0] & 0xffffffff;
-		XChangeProperty(dpy, c->frame, _XA_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32,
-				PropModeReplace, (unsigned char *) opacity, 1);
+		c->wantsopacity = True;
 		XFree(opacity);
+		writeopacity(c, c->opacity);
 	} else {
 		c->opacity = OPAQUE;
-		XDeleteProperty(dpy, c->frame, _XA_NET_WM_WINDOW_OPACITY);
+		c->wantsopacity = False;
+		if (c->hasframeopacity) {
+			XDeleteProperty(dpy, c->frame, _XA_NET_WM_WINDOW_OPACITY);
+			c->hasframeopacity = False;
+		}
 	}
 }
 
@@ -3206,14 +3220,14 @@ ewmh_process_net_window_sync_request_counter(Client *c)
 							 &aa);
 
 			if (c->sync.alarm) {
-				XPRINTF(c, "allocated alarm 0x%08lx\n", c->sync.alarm);
+				XCPRINTF(c, "allocated alarm 0x%08lx\n", c->sync.alarm);
 				XSaveContext(dpy, c->sync.alarm, context[ClientAny],
 					     (XPointer) c);
 				XSaveContext(dpy, c->sync.alarm, context[ScreenContext],
 					     (XPointer) scr);
 
 			} else
-				XPRINTF(c, "could not allocate alarm!\n");
+				XCPRINTF(c, "could not allocate alarm!\n");
 		} else
 			XPRINTF("SYNC extension not present\n");
 #else
@@ -3652,17 +3666,13 @@ clientmessage(XEvent *e)
 void
 setopacity(Client *c, unsigned int opacity)
 {
-	long data = opacity, *card;
-	unsigned long n = 0;
-
-	/* if the client wants to set opacity, we cannot */
-	if ((card = getcard(c->win, _XA_NET_WM_WINDOW_OPACITY, &n))) {
-		data = card[0];
-		XFree(card);
-	} else if (!data)	/* should not be zero! */
+	/* if the client wants to set opacity, we cannot; the client's value is
+	   tracked from PropertyNotify so no round trip is needed here */
+	if (c->wantsopacity)
+		opacity = c->opacity;
+	else if (!opacity)	/* should not be zero! */
 		return;
-	XChangeProperty(dpy, c->frame, _XA_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32,
-			PropModeReplace, (unsigned char *) &data, 1L);
+	writeopacity(c, opacity);
 }
 
 Atom *
@@ -3735,6 +3745,77 @@ getcard(Window win, Atom atom, unsigned long *nitems)
 	return ret;
 }
 
+/*
+ * _NET_WM_ICON often holds many sizes (up to 256x256), easily more than a
+ * megabyte.  Rather than fetching the whole property, read just the width and
+ * height of each image by offset to find the one closest to the requested size,
+ * and then fetch only that image.  Returns the chosen image with its width and
+ * height header, or NULL when the property is absent or malformed.
+ */
+long *
+getneticon(Window win, unsigned size, unsigned long *nitems)
+{
+	static unsigned long long saved;	/* bytes not transferred */
+	int format, status;
+	long *ret = NULL;
+	unsigned long n, extra, offset, total = 0, bytes = 0;
+	unsigned long boff = 0, bw = 0, bh = 0, w = 0, h = 0;
+	unsigned d, hdiff;
+	Atom real;
+
+	*nitems = 0;
+	for (hdiff = -1U, offset = 0;; offset += 2 + w * h) {
+		status = XGetWindowProperty(dpy, win, _XA_NET_WM_ICON, offset, 2L, False,
+					    XA_CARDINAL, &real, &format, &n, &extra,
+					    (unsigned char **) &ret);
+		if (status != Success || real != XA_CARDINAL || format != 32 || n < 2) {
+			if (ret)
+				XFree(ret);
+			ret = NULL;
+			break;
+		}
+		if (!total)
+			total = 8 + extra;
+		bytes += 8;
+		w = ret[0] & 0xffffffff;
+		h = ret[1] & 0xffffffff;
+		XFree(ret);
+		ret = NULL;
+		/* stop at a truncated or bogus image */
+		if (!w || !h || w > 4096 || h > 4096 || extra < 4 * w * h)
+			break;
+		d = (h <= size) ? size - h : h - size;
+		if (d < hdiff) {
+			boff = offset;
+			bw = w;
+			bh = h;
+			hdiff = d;
+		}
+		if (extra == 4 * w * h)
+			break;
+	}
+	if (!bw)
+		return (NULL);
+	status = XGetWindowProperty(dpy, win, _XA_NET_WM_ICON, boff, 2 + bw * bh, False,
+				    XA_CARDINAL, &real, &format, &n, &extra,
+				    (unsigned char **) &ret);
+	if (status != Success || !ret || n != 2 + bw * bh ||
+	    (unsigned long) (ret[0] & 0xffffffff) != bw ||
+	    (unsigned long) (ret[1] & 0xffffffff) != bh) {
+		/* property changed underneath us */
+		if (ret)
+			XFree(ret);
+		return (NULL);
+	}
+	bytes += 4 * n;
+	if (total > bytes)
+		saved += total - bytes;
+	DPRINTF("_NET_WM_ICON of 0x%lx: fetched %lux%lu, %lu of %lu bytes (%llu saved so far)\n",
+		win, bw, bh, bytes, total, saved);
+	*nitems = n;
+	return (ret);
+}
+
 Pixmap *
 getpixmaps(Window win, Atom atom, unsigned long *nitems)
 {
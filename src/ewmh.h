@@ -10,6 +10,7 @@ Bool clientmessage(XEvent *e);
 void ewmh_release_user_time_window(Client *c);
 Atom *getatom(Window win, Atom atom, unsigned long *nitems);
 long *getcard(Window win, Atom atom, unsigned long *nitems);
+long *getneticon(Window win, unsigned size, unsigned long *nitems);
 Pixmap *getpixmaps(Window win, Atom atom, unsigned long *nitems);
 Window *getwind(Window win, Atom atom, unsigned long *nitems);
 long *gethints(Window win, Atom atom, unsigned long *nitems);
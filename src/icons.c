@@ -6,6 +6,9 @@
 #include "tags.h"
 #include "resource.h"
 #include "config.h"
+#include "probe.h"
+#include "watch.h"
+#include "phase.h"
 #include "icons.h" /* verification */
 
 extern AdwmPlaces config;
@@ -86,6 +89,10 @@ freestringlist(char **list)
 	return (NULL);
 }
 
+/* Chooses among the files named for an icon in one directory.  Only reached
+ * through _LookupIconInDirectory() from _LookupAnyIcon(), whose callers in
+ * _FindBestIcon() and _FindIcon() are disabled: lookups are answered from the
+ * icon index, which selects by theme directory size and never probes files. */
 static char *
 _FindAnyIconHelper(char **files, const char *iconname, int size, const char *ext)
 {
@@ -118,115 +125,17 @@ _FindAnyIconHelper(char **files, const char *iconname, int size, const char *ext
 		return (NULL);
 	if (n == 1)
 		best = good[0];
-#if defined IMLIB2 && defined USE_IMLIB2
 	if (!best) {
-		int hdiff = 0x7fffffff;
+		unsigned w, h, d, hdiff = -1U;
 
-		imlib_context_push(scr->context);
-		for (maybe = good; maybe && *maybe; maybe++) {
-			Imlib_Image image;
-
-			if ((image = imliib_load_image(*maybe))) {
-				int h, d;
-				imlib_context_set_image(image);
-				h = imlib_image_get_height();
-				d = abs(size - h);
-				if (d < hdiff) {
-					hdiff = d;
-					best = *maybe;
-				}
-				imlib_free_image();
-			}
-		}
-		imlib_context_pop();
-	}
-#else
-#if defined PIXBUF && defined USE_PIXBUF
-	if (!best) {
-		int hdiff = 0x7fffffff;
-
-		for (maybe = good; maybe && *maybe; maybe++) {
-			GdkPixbufFormat *format;
-			int w = 0, h = 0;
-
-			if ((format = gdk_pixbuf_get_file_info(*maybe, &w, &h))) {
-				int d = abs(size - h);
-				if (d < hdiff) {
-					hdiff = d;
-					best = *maybe;
-				}
-			}
-		}
-	}
-#else
-	if (!best) {
-		if (!strcmp(ext, "xpm")) {
-#ifdef XPM
-			int hdiff = 0x7fffffff;
-
-			for (maybe = good; maybe && *maybe; maybe++) {
-				XImage *xicon = NULL, *xmask = NULL;
-				XpmAttributes xa = { 0, };
-
-				if (XpmReadFileToImage(dpy, *maybe, &xicon, &xmask, &xa) == XpmSuccess) {
-					int h = xa.height, d = abs(size -h);
-					if (d < hdiff) {
-						hdiff = d;
-						best = *maybe;
-					}
-					if (xicon)
-						XDestroyImage(xicon);
-					if (xmask)
-						XDestroyImage(xmask);
-					XpmFreeAttributes(&xa);
-				}
-			}
-#endif
-		} else
-		if (!strcmp(ext, "png")) {
-#ifdef LIBPNG
-			int hdiff = 0x7fffffff;
-
-			for (maybe = good; maybe && *maybe; maybe++) {
-				FILE *f;
-
-				if ((f = fopen(*maybe, "rb"))) {
-					png_structp png_ptr;
-
-					if ((png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL))) {
-						png_infop info_ptr;
-
-						if ((info_ptr = png_create_info_struct(png_ptr))) {
-							if (setjmp(png_jmpbuf(png_ptr)) == 0) {
-								png_uint_32 width, height;
-								int dummy = 0;
-
-								png_init_io(png_ptr, f);
-								png_read_info(png_ptr, info_ptr);
-								if (png_get_IHDR(png_ptr, info_ptr, &width, &height, &dummy, &dummy, &dummy, &dummy, &dummy)) {
-									if (height < 0x7fffffff) {
-										int h = height, d = abs(h - size);
-										
-										if (d < hdiff) {
-											hdiff = d;
-											best = *maybe;
-										}
-									}
-								} else
-									png_error(png_ptr, "png_get_IHDR failed");
-							}
-							png_destroy_info_struct(png_ptr, &info_ptr);
-						}
-						png_destroy_read_struct(&png_ptr, NULL, NULL);
-					}
-					fclose(f);
-				}
+		/* closest height, from the file headers alone */
+		for (maybe = good; maybe && *maybe; maybe++)
+			if (probeimage(*maybe, &w, &h) &&
+			    (d = abs((int) h - size)) < hdiff) {
+				hdiff = d;
+				best = *maybe;
 			}
-#endif
-		}
 	}
-#endif
-#endif
 	if (!best) {
 		off_t max = 0;
 
@@ -370,54 +279,658 @@ DirectorySizeDistance(IconDirectory *subdir, int iconsize)
 	return (0);
 }
 
-static char *
-_LookupIcon(const char *iconname, int size, IconTheme *theme, const char **fexts)
+/*
+ * Icon file index: rather than probing for every candidate file name with
+ * access() on each lookup, the theme directories (and the fallback pixmap
+ * directories) are read once when the themes are scanned and every file with
+ * a known extension is hashed by icon name.  The directories read are
+ * remembered with their modification times and the index is rebuilt when one
+ * of them changes (checked at most every ICONCHECK seconds).  When the
+ * directories are watched (see watch.c), files being added to or removed from
+ * them are applied to the index one at a time instead.
+ */
+
+typedef struct IconFile IconFile;
+
+struct IconFile {
+	IconFile *next;			/* next in hash bucket */
+	IconDirectory *dir;		/* theme directory (NULL for fallback dirs) */
+	unsigned pos;			/* position of dir in its theme */
+	unsigned base;			/* index into xdgs (or dirs for fallback) */
+	unsigned hash;			/* hash of icon name */
+	size_t len;			/* length of icon name */
+	char *ext;			/* extension in file */
+	char file[];			/* file name */
+};
+
+typedef struct {
+	char *path;
+	time_t mtime;
+	Bool files;			/* its files are indexed one by one, */
+	IconDirectory *dir;		/* as belonging to this theme directory */
+	unsigned pos, base;
+} IconScanned;
+
+/*
+ * GTK icon-theme.cache files: when a theme directory carries a cache that is
+ * newer than the directory, the cache is mapped and used in place of reading
+ * the theme's subdirectories.  The format (all integers big-endian) is:
+ *
+ *   header:	CARD16 major (1), CARD16 minor, CARD32 hash, CARD32 dirlist
+ *   dirlist:	CARD32 n, CARD32 dir[n]		(offsets of directory names)
+ *   hash:	CARD32 n, CARD32 bucket[n]	(offsets of icon chains)
+ *   icon:	CARD32 chain, CARD32 name, CARD32 imagelist
+ *   imagelist:	CARD32 n, { CARD16 dir, CARD16 flags, CARD32 data }[n]
+ */
+
+typedef struct IconCache IconCache;
+
+struct IconCache {
+	IconCache *next;
+	IconTheme *theme;
+	unsigned base;			/* index into xdgs */
+	const unsigned char *map;	/* mapped cache file */
+	size_t size;			/* size of mapping */
+	unsigned ndirs;			/* number of cache directories */
+	IconDirectory **dirs;		/* theme directory for each (or NULL) */
+	unsigned *pos;			/* position of each in theme */
+};
+
+#define CACHE_HAS_XPM	(1<<0)
+#define CACHE_HAS_SVG	(1<<1)
+#define CACHE_HAS_PNG	(1<<2)
+#define CACHE_END	0xffffffff
+
+#define ICONCHECK 5
+
+static IconFile **iconfiles = NULL;
+static unsigned iconbkts = 0, niconfiles = 0;
+static IconCache *iconcaches = NULL;
+static IconScanned *scanned = NULL;
+static unsigned nscanned = 0;
+static time_t iconchecked = 0;
+
+static unsigned
+iconhash(const char *name, size_t len)
+{
+	unsigned hash = HASHINIT;
+
+	while (len--)
+		hash = (hash ^ (unsigned char) *name++) * 16777619U;
+	return (hash);
+}
+
+static Bool
+knownext(const char *ext)
+{
+	char **e;
+
+	for (e = exts; e && *e; e++)
+		if (!strcasecmp(*e, ext))
+			return (True);
+	return (False);
+}
+
+static IconScanned *
+scanned_add(const char *path, time_t mtime)
+{
+	IconScanned *s;
+
+	scanned = reallocarray(scanned, nscanned + 1, sizeof(*scanned));
+	s = scanned + nscanned++;
+	memset(s, 0, sizeof(*s));
+	s->path = strdup(path);
+	s->mtime = mtime;
+	return (s);
+}
+
+static IconFile *
+newiconfile(const char *name, IconScanned *s)
+{
+	IconFile *f;
+	const char *p;
+
+	if (name[0] == '.' || !(p = strrchr(name, '.')) || !knownext(p + 1))
+		return (NULL);
+	f = ecalloc(1, sizeof(*f) + strlen(name) + 1);
+	strcpy(f->file, name);
+	f->len = p - name;
+	f->ext = f->file + f->len + 1;
+	f->hash = iconhash(f->file, f->len);
+	f->dir = s->dir;
+	f->pos = s->pos;
+	f->base = s->base;
+	niconfiles++;
+	return (f);
+}
+
+static IconFile *
+scanicondir(IconFile *list, const char *path, IconDirectory *id, unsigned pos, unsigned base)
+{
+	DIR *dir;
+	struct dirent *d;
+	struct stat st;
+	IconScanned *s;
+	IconFile *f;
+
+	if (stat(path, &st) || !S_ISDIR(st.st_mode) || !(dir = opendir(path)))
+		return (list);
+	s = scanned_add(path, st.st_mtime);
+	s->files = True;
+	s->dir = id;
+	s->pos = pos;
+	s->base = base;
+	while ((d = readdir(dir))) {
+		if (d->d_type == DT_DIR || !(f = newiconfile(d->d_name, s)))
+			continue;
+		f->next = list;
+		list = f;
+	}
+	closedir(dir);
+	return (list);
+}
+
+static unsigned
+cache16(IconCache *c, unsigned off)
+{
+	if (off > c->size - 2)
+		return (0);
+	return ((c->map[off] << 8) | c->map[off + 1]);
+}
+
+static unsigned
+cache32(IconCache *c, unsigned off)
+{
+	if (off > c->size - 4)
+		return (CACHE_END);
+	return (((unsigned) c->map[off] << 24) | (c->map[off + 1] << 16) |
+		(c->map[off + 2] << 8) | c->map[off + 3]);
+}
+
+static const char *
+cachestr(IconCache *c, unsigned off)
 {
+	if (off >= c->size || !memchr(c->map + off, '\0', c->size - off))
+		return (NULL);
+	return ((const char *) c->map + off);
+}
+
+/* map the icon-theme.cache of a theme under a base directory if there is one
+ * that is not older than the theme directory itself */
+static IconCache *
+loadiconcache(IconTheme *it, unsigned base)
+{
+	char path[PATH_MAX + 1];
+	struct stat dst, cst;
+	IconCache *c;
 	IconDirectory *id;
-	char **ext, **xdg, *p;
-	char buf[PATH_MAX + 1] = { 0, };
+	unsigned j, pos, dirlist;
+	const char *name;
+	void *map;
+	int fd;
 
-	if (!fexts)
-		fexts = (const char **) exts;
-	for (id = theme->dirs; id; id = id->next) {
-		if (DirectoryMatchesSize(id, size)) {
-			for (xdg = xdgs; xdg && *xdg; xdg++) {
-				for (ext = exts; ext && *ext; ext++) {
-					snprintf(buf, sizeof(buf), "%s/%s/%s/%s.%s", *xdg, theme->name, id->subdir, iconname, *ext);
-					if (!access(buf, R_OK))
-						return (strdup(buf));
-					/* try lower-casing the file name */
-					for (p = strrchr(buf, '/'); p && *p; p++)
-						*p = tolower(*p);
-					if (!access(buf, R_OK))
-						return (strdup(buf));
-				}
+	snprintf(path, sizeof(path), "%s/%s", xdgs[base], it->name);
+	if (stat(path, &dst))
+		return (NULL);
+	strncat(path, "/icon-theme.cache", PATH_MAX - strlen(path));
+	if (stat(path, &cst) || cst.st_size < 12)
+		return (NULL);
+	if (cst.st_mtime < dst.st_mtime) {
+		OPRINTF("%s is stale: reading directories\n", path);
+		return (NULL);
+	}
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (NULL);
+	map = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (NULL);
+	c = ecalloc(1, sizeof(*c));
+	c->theme = it;
+	c->base = base;
+	c->map = map;
+	c->size = cst.st_size;
+	if (cache16(c, 0) != 1 || (dirlist = cache32(c, 8)) == CACHE_END ||
+	    (c->ndirs = cache32(c, dirlist)) == CACHE_END || c->ndirs > c->size / 4) {
+		EPRINTF("%s: bad icon cache\n", path);
+		munmap(map, c->size);
+		free(c);
+		return (NULL);
+	}
+	c->dirs = ecalloc(c->ndirs, sizeof(*c->dirs));
+	c->pos = ecalloc(c->ndirs, sizeof(*c->pos));
+	for (j = 0; j < c->ndirs; j++) {
+		if (!(name = cachestr(c, cache32(c, dirlist + 4 + 4 * j))))
+			continue;
+		for (pos = 0, id = it->dirs; id; id = id->next, pos++)
+			if (!strcmp(id->subdir, name)) {
+				c->dirs[j] = id;
+				c->pos[j] = pos;
+				break;
+			}
+	}
+	/* the directory mtime covers the cache being regenerated */
+	snprintf(path, sizeof(path), "%s/%s", xdgs[base], it->name);
+	scanned_add(path, dst.st_mtime);
+	return (c);
+}
+
+static void
+freeiconcache(IconCache *c)
+{
+	munmap((void *) c->map, c->size);
+	free(c->dirs);
+	free(c->pos);
+	free(c);
+}
+
+/* the hash function that GTK uses for icon names */
+static unsigned
+cachehash(const char *name)
+{
+	const signed char *p = (const signed char *) name;
+	unsigned h = *p;
+
+	if (h)
+		for (p++; *p; p++)
+			h = (h << 5) - h + *p;
+	return (h);
+}
+
+/*
+ * Results of FindIcon() and FindBestIcon() are remembered per query (lookup,
+ * theme, size, icon names and extensions), including queries that found
+ * nothing, so that every window of a class without an icon does not repeat
+ * the whole theme, inherited theme and fallback directory search.  The memo
+ * is dropped whenever the icon index is rebuilt.
+ */
+
+typedef struct IconMemo IconMemo;
+
+struct IconMemo {
+	IconMemo *next;
+	unsigned hash;
+	char *file;			/* resolved file or NULL */
+	size_t len;			/* length of key */
+	char key[];
+};
+
+#define ICONMEMO	256		/* memo hash buckets */
+#define ICONMEMOMAX	4096		/* memo entries before flushing */
+
+static IconMemo *iconmemo[ICONMEMO];
+static unsigned niconmemo = 0;
+
+static struct {
+	unsigned long hits;		/* lookups answered from the memo */
+	unsigned long negative;		/* ... of which found nothing */
+	unsigned long misses;		/* lookups that searched */
+	unsigned long flushes;		/* times the memo was dropped */
+} memostats;
+
+static void
+flushiconmemo(void)
+{
+	IconMemo *m;
+	unsigned i;
+
+	if (!niconmemo)
+		return;
+	for (i = 0; i < ICONMEMO; i++)
+		while ((m = iconmemo[i])) {
+			iconmemo[i] = m->next;
+			free(m->file);
+			free(m);
+		}
+	niconmemo = 0;
+	memostats.flushes++;
+}
+
+static void
+freeiconindex(void)
+{
+	IconFile *f;
+	IconCache *c;
+	unsigned i;
+
+	flushiconmemo();
+	for (i = 0; i < iconbkts; i++)
+		while ((f = iconfiles[i])) {
+			iconfiles[i] = f->next;
+			free(f);
+		}
+	free(iconfiles);
+	iconfiles = NULL;
+	iconbkts = niconfiles = 0;
+	while ((c = iconcaches)) {
+		iconcaches = c->next;
+		freeiconcache(c);
+	}
+	for (i = 0; i < nscanned; i++)
+		free(scanned[i].path);
+	free(scanned);
+	scanned = NULL;
+	nscanned = 0;
+}
+
+static void
+indexicons(void)
+{
+	IconFile *list = NULL, *f;
+	IconCache *c;
+	IconTheme *it;
+	IconDirectory *id;
+	char path[PATH_MAX + 1];
+	unsigned pos, i, ncaches = 0;
+	struct stat st;
+
+	freeiconindex();
+	for (i = 0; xdgs && xdgs[i]; i++) {
+		/* notice themes being added or removed */
+		if (!stat(xdgs[i], &st))
+			scanned_add(xdgs[i], st.st_mtime);
+		for (it = themes; it; it = it->next) {
+			if ((c = loadiconcache(it, i))) {
+				c->next = iconcaches;
+				iconcaches = c;
+				ncaches++;
+				continue;
+			}
+			for (pos = 0, id = it->dirs; id; id = id->next, pos++) {
+				snprintf(path, sizeof(path), "%s/%s/%s", xdgs[i], it->name, id->subdir);
+				list = scanicondir(list, path, id, pos, i);
 			}
 		}
 	}
-	int minimal_size = 0x7fffffff, dist, missing;
-	char *closest = NULL;
-
-	for (id = theme->dirs; id; id = id->next) {
-		for (xdg = xdgs; xdg && *xdg; xdg++) {
-			for (ext = exts; ext && *ext; ext++) {
-				snprintf(buf, sizeof(buf), "%s/%s/%s/%s.%s", *xdg, theme->name, id->subdir, iconname, *ext);
-				if ((missing = access(buf, R_OK))) {
-					/* try lower-casing the file name */
-					for (p = strrchr(buf, '/'); p && *p; p++)
-						*p = tolower(*p);
-					missing = access(buf, R_OK);
-				}
-				if (!missing && (dist = DirectorySizeDistance(id, size)) < minimal_size) {
-					free(closest);
-					closest = strdup(buf);
-					minimal_size = dist;
-				}
+	for (i = 0; dirs && dirs[i]; i++)
+		list = scanicondir(list, dirs[i], NULL, 0, i);
+	for (iconbkts = 64; iconbkts < niconfiles; iconbkts <<= 1) ;
+	iconfiles = ecalloc(iconbkts, sizeof(*iconfiles));
+	while ((f = list)) {
+		list = f->next;
+		f->next = iconfiles[f->hash & (iconbkts - 1)];
+		iconfiles[f->hash & (iconbkts - 1)] = f;
+	}
+	iconchecked = time(NULL);
+	OPRINTF("indexed %u icon files in %u directories, %u icon caches\n", niconfiles,
+		nscanned, ncaches);
+	watchicons();
+}
+
+/* the directories read for the index, for watching them */
+const char *
+geticondir(unsigned i)
+{
+	return (i < nscanned ? scanned[i].path : NULL);
+}
+
+/*
+ * Updates the index for a file added to (or rewritten in) or removed from
+ * one of its directories.  A change to the directory itself, or to one that
+ * is not indexed file by file (a theme with an icon cache, the base
+ * directories in which themes are found), reindexes everything.
+ */
+void
+iconfilechanged(const char *dir, const char *name, Bool added)
+{
+	IconScanned *s = NULL;
+	IconFile *f, **fp;
+	struct stat st;
+	const char *p;
+	unsigned i, hash;
+
+	if (!iconfiles)
+		return;
+	for (i = 0; dir && i < nscanned; i++)
+		if (!strcmp(scanned[i].path, dir)) {
+			s = scanned + i;
+			break;
+		}
+	if (dir && !s)
+		return;
+	if (!s || !s->files || !name || stat(dir, &st)) {
+		OPRINTF("%s changed: reindexing icons\n", dir ? : "icon directories");
+		indexicons();
+		return;
+	}
+	/* keep checkiconindex() from reindexing for this change */
+	s->mtime = st.st_mtime;
+	if (name[0] == '.' || !(p = strrchr(name, '.')) || !knownext(p + 1))
+		return;
+	hash = iconhash(name, p - name);
+	for (fp = &iconfiles[hash & (iconbkts - 1)]; (f = *fp); fp = &f->next)
+		if (f->dir == s->dir && f->pos == s->pos && f->base == s->base
+		    && !strcmp(f->file, name)) {
+			*fp = f->next;
+			free(f);
+			niconfiles--;
+			break;
+		}
+	if (added && (f = newiconfile(name, s))) {
+		f->next = iconfiles[hash & (iconbkts - 1)];
+		iconfiles[hash & (iconbkts - 1)] = f;
+	}
+	DPRINTF("icon %s %s %s\n", name, added ? "added to" : "removed from", dir);
+	flushiconmemo();
+}
+
+static void
+checkiconindex(void)
+{
+	struct stat st;
+	time_t now = time(NULL);
+	unsigned i;
+
+	if (now - iconchecked < ICONCHECK)
+		return;
+	iconchecked = now;
+	for (i = 0; i < nscanned; i++)
+		if (stat(scanned[i].path, &st) || st.st_mtime != scanned[i].mtime) {
+			OPRINTF("%s changed: reindexing icons\n", scanned[i].path);
+			indexicons();
+			return;
+		}
+}
+
+/* first indexed file with the given icon name */
+static IconFile *
+findiconfile(IconFile *f, const char *name, size_t len, unsigned hash)
+{
+	for (; f; f = f->next)
+		if (f->hash == hash && f->len == len && !memcmp(f->file, name, len))
+			break;
+	return (f);
+}
+
+/* position of an extension in the extension list: exact match for the name as
+ * given, or any case for the lower-cased name */
+static int
+iconextpos(const char *ext, Bool lowered)
+{
+	int k;
+
+	for (k = 0; exts && exts[k]; k++)
+		if (lowered ? !strcasecmp(ext, exts[k]) : !strcmp(ext, exts[k]))
+			return (k);
+	return (-1);
+}
+
+/* a file found for an icon name */
+typedef struct {
+	IconDirectory *dir;		/* theme directory (NULL for fallback dirs) */
+	unsigned base;			/* index into xdgs (or dirs for fallback) */
+	const char *name;		/* icon name */
+	size_t len;			/* length of icon name */
+	const char *ext;		/* file extension */
+} IconHit;
+
+typedef void (*IconEach) (IconHit *, unsigned long, void *);
+
+static void
+eachcachedicon(IconCache *c, const char *name, int pass, unsigned long nbases,
+	       unsigned long nexts, IconEach each, void *data)
+{
+	static const struct {
+		unsigned flag;
+		const char *ext;
+	} suffixes[] = {
+		{ CACHE_HAS_PNG, "png" }, { CACHE_HAS_SVG, "svg" }, { CACHE_HAS_XPM, "xpm" }
+	};
+	unsigned hash, nbuckets, off, list, n, j, d, flags, limit;
+	const char *str;
+	IconHit hit;
+	unsigned i;
+	int k;
+
+	hash = cache32(c, 4);
+	if ((nbuckets = cache32(c, hash)) == CACHE_END || !nbuckets)
+		return;
+	off = cache32(c, hash + 4 + 4 * (cachehash(name) % nbuckets));
+	for (limit = c->size / 12; off != CACHE_END && limit; off = cache32(c, off), limit--) {
+		if (!(str = cachestr(c, cache32(c, off + 4))) || strcmp(str, name))
+			continue;
+		list = cache32(c, off + 8);
+		if ((n = cache32(c, list)) == CACHE_END || n > c->size / 8)
+			return;
+		for (j = 0; j < n; j++) {
+			d = cache16(c, list + 4 + 8 * j);
+			flags = cache16(c, list + 4 + 8 * j + 2);
+			if (d >= c->ndirs || !c->dirs[d])
+				continue;
+			for (i = 0; i < LENGTH(suffixes); i++) {
+				if (!(flags & suffixes[i].flag))
+					continue;
+				if ((k = iconextpos(suffixes[i].ext, pass)) < 0)
+					continue;
+				hit.dir = c->dirs[d];
+				hit.base = c->base;
+				hit.name = str;
+				hit.len = strlen(str);
+				hit.ext = suffixes[i].ext;
+				each(&hit, ((c->pos[d] * nbases + c->base) * nexts + k) * 2 + pass, data);
 			}
 		}
+		return;
+	}
+}
+
+/* Calls each() for every file named iconname (or its lower-cased version) in
+ * the index or the icon caches, with a key ordering the files as the
+ * directory, base and extension search loops of the icon theme specification
+ * would. */
+static void
+eachiconfile(const char *iconname, IconEach each, void *data)
+{
+	char lower[PATH_MAX + 1], *p;
+	const char *name;
+	size_t len = strlen(iconname);
+	unsigned long nexts, nbases, key;
+	unsigned hash;
+	IconFile *f;
+	IconCache *c;
+	IconHit hit;
+	int pass, k;
+
+	if (!iconfiles)
+		return;
+	checkiconindex();
+	for (nexts = 0; exts && exts[nexts]; nexts++) ;
+	for (nbases = 0; xdgs && xdgs[nbases]; nbases++) ;
+	for (k = 0; dirs && dirs[k]; k++) ;
+	nbases = max(nbases, (unsigned long) k);
+	snprintf(lower, sizeof(lower), "%s", iconname);
+	for (p = lower; *p; p++)
+		*p = tolower(*p);
+	for (pass = 0; pass < 2; pass++) {
+		name = pass ? lower : iconname;
+		if (pass && !strcmp(lower, iconname))
+			break;
+		hash = iconhash(name, len);
+		for (f = iconfiles[hash & (iconbkts - 1)];
+		     (f = findiconfile(f, name, len, hash)); f = f->next) {
+			if ((k = iconextpos(f->ext, pass)) < 0)
+				continue;
+			key = ((f->pos * nbases + f->base) * nexts + k) * 2 + pass;
+			hit.dir = f->dir;
+			hit.base = f->base;
+			hit.name = f->file;
+			hit.len = f->len;
+			hit.ext = f->ext;
+			each(&hit, key, data);
+		}
+		for (c = iconcaches; c; c = c->next)
+			eachcachedicon(c, name, pass, nbases, nexts, each, data);
+	}
+}
+
+typedef struct {
+	IconTheme *theme;
+	int size;
+	Bool matched, found;
+	unsigned long matchkey, closestkey;
+	int distance;
+	char match[PATH_MAX + 1];
+	char closest[PATH_MAX + 1];
+} IconSearch;
+
+static void
+iconpath(IconHit *h, char *buf)
+{
+	if (h->dir)
+		snprintf(buf, PATH_MAX + 1, "%s/%s/%s/%.*s.%s", xdgs[h->base],
+			 h->dir->theme->name, h->dir->subdir, (int) h->len, h->name, h->ext);
+	else
+		snprintf(buf, PATH_MAX + 1, "%s/%.*s.%s", dirs[h->base], (int) h->len,
+			 h->name, h->ext);
+}
+
+static void
+searchtheme(IconHit *h, unsigned long key, void *data)
+{
+	IconSearch *s = data;
+	int dist;
+
+	if (!h->dir || h->dir->theme != s->theme)
+		return;
+	if (DirectoryMatchesSize(h->dir, s->size) && (!s->matched || key < s->matchkey)) {
+		s->matched = True;
+		s->matchkey = key;
+		iconpath(h, s->match);
+	}
+	dist = DirectorySizeDistance(h->dir, s->size);
+	if (!s->found || dist < s->distance || (dist == s->distance && key < s->closestkey)) {
+		s->found = True;
+		s->closestkey = key;
+		s->distance = dist;
+		iconpath(h, s->closest);
+	}
+}
+
+static void
+searchfallback(IconHit *h, unsigned long key, void *data)
+{
+	IconSearch *s = data;
+
+	if (h->dir)
+		return;
+	if (!s->matched || key < s->matchkey) {
+		s->matched = True;
+		s->matchkey = key;
+		iconpath(h, s->match);
 	}
-	if (closest)
-		return (closest);
+}
+
+static char *
+_LookupIcon(const char *iconname, int size, IconTheme *theme, const char **fexts)
+{
+	IconSearch search = { theme, size, False, False, 0, 0, 0, "", "" };
+
+	(void) fexts;
+	eachiconfile(iconname, searchtheme, &search);
+	if (search.matched)
+		return strdup(search.match);
+	if (search.found)
+		return strdup(search.closest);
 	return (NULL);
 }
 
@@ -446,28 +959,17 @@ _FindBestIconHelper(const char **iconlist, int size, const char *name, const cha
 static char *
 _LookupFallbackIcon(const char *iconname, const char **fexts)
 {
-	char **dir, **ext, *p;
-	char buf[PATH_MAX + 1] = { 0, };
+	IconSearch search = { NULL, 0, False, False, 0, 0, 0, "", "" };
 
-	if (!fexts)
-		fexts = (const char **) exts;
-	for (dir = dirs; dir && *dir; dir++) {
-		for (ext = exts; ext && *ext; ext++) {
-			snprintf(buf, sizeof(buf), "%s/%s.%s", *dir, iconname, *ext);
-			if (!access(buf, R_OK))
-				return strdup(buf);
-			/* try lower-casing the file name */
-			for (p = strrchr(buf, '/'); p && *p; p++)
-				*p = tolower(*p);
-			if (!access(buf, R_OK))
-				return strdup(buf);
-		}
-	}
+	(void) fexts;
+	eachiconfile(iconname, searchfallback, &search);
+	if (search.matched)
+		return strdup(search.match);
 	return (NULL);
 }
 
-char *
-FindBestIcon(const char **iconlist, int size, const char **fexts)
+static char *
+_FindBestIcon(const char **iconlist, int size, const char **fexts)
 {
 	char *file;
 	const char **icon;
@@ -507,8 +1009,8 @@ _FindIconHelper(const char *icon, int size, const char *name, const char **fexts
 	return (NULL);
 }
 
-char *
-FindIcon(const char *icon, int size, const char **fexts)
+static char *
+_FindIcon(const char *icon, int size, const char **fexts)
 {
 	char *file;
 
@@ -525,6 +1027,115 @@ FindIcon(const char *icon, int size, const char **fexts)
 	return (NULL);
 }
 
+/* key for a lookup: kind, theme, size, names and extensions separated by
+ * nulls; returns zero when the query does not fit */
+static size_t
+iconmemokey(char *buf, size_t size, int kind, const char **iconlist, int isize,
+	    const char **fexts)
+{
+	size_t len;
+	int n;
+
+	n = snprintf(buf, size, "%c%s%c%d", kind, options.icontheme ? : "", '\0', isize);
+	if (n < 0 || (len = n + 1) >= size)
+		return (0);
+	for (; iconlist && *iconlist; iconlist++) {
+		if ((n = snprintf(buf + len, size - len, "%s", *iconlist)) < 0 ||
+		    (len += n + 1) >= size)
+			return (0);
+	}
+	if ((len += 1) >= size)
+		return (0);
+	buf[len - 1] = '\0';
+	for (; fexts && *fexts; fexts++) {
+		if ((n = snprintf(buf + len, size - len, "%s", *fexts)) < 0 ||
+		    (len += n + 1) >= size)
+			return (0);
+	}
+	return (len);
+}
+
+static IconMemo *
+findiconmemo(const char *key, size_t len, unsigned hash)
+{
+	IconMemo *m;
+
+	for (m = iconmemo[hash & (ICONMEMO - 1)]; m; m = m->next)
+		if (m->hash == hash && m->len == len && !memcmp(m->key, key, len))
+			break;
+	return (m);
+}
+
+static void
+addiconmemo(const char *key, size_t len, unsigned hash, const char *file)
+{
+	IconMemo *m;
+
+	if (niconmemo >= ICONMEMOMAX)
+		flushiconmemo();
+	m = ecalloc(1, sizeof(*m) + len);
+	m->hash = hash;
+	m->len = len;
+	memcpy(m->key, key, len);
+	m->file = file ? strdup(file) : NULL;
+	m->next = iconmemo[hash & (ICONMEMO - 1)];
+	iconmemo[hash & (ICONMEMO - 1)] = m;
+	niconmemo++;
+}
+
+static char *
+memoicon(int kind, const char **iconlist, int size, const char **fexts)
+{
+	char key[BUFSIZ], *file;
+	unsigned hash;
+	IconMemo *m;
+	size_t len;
+
+	if (iconfiles)
+		checkiconindex();
+	if ((len = iconmemokey(key, sizeof(key), kind, iconlist, size, fexts))) {
+		hash = iconhash(key, len);
+		if ((m = findiconmemo(key, len, hash))) {
+			memostats.hits++;
+			if (!m->file) {
+				memostats.negative++;
+				return (NULL);
+			}
+			return strdup(m->file);
+		}
+	}
+	memostats.misses++;
+	if (kind == 'I')
+		file = _FindIcon(iconlist[0], size, fexts);
+	else
+		file = _FindBestIcon(iconlist, size, fexts);
+	if (len)
+		addiconmemo(key, len, hash, file);
+	return (file);
+}
+
+char *
+FindBestIcon(const char **iconlist, int size, const char **fexts)
+{
+	return memoicon('B', iconlist, size, fexts);
+}
+
+char *
+FindIcon(const char *icon, int size, const char **fexts)
+{
+	const char *iconlist[2] = { icon, NULL };
+
+	return memoicon('I', iconlist, size, fexts);
+}
+
+void
+iconstats(void)
+{
+	OPRINTF("icon lookups: %lu searched, %lu remembered (%lu found nothing), "
+		"%u memo entries, %lu flushes\n", memostats.misses, memostats.hits,
+		memostats.negative, niconmemo, memostats.flushes);
+}
+
 static IconDirectory *
 allocicondir(IconTheme *theme, char *subdir)
 {
@@ -817,6 +1428,7 @@ rescanicons(void)
 			strncat(path, "/", len);
 			strncat(path, name, len);
 			strncat(path, "/index.theme", len);
+			phasefile(path);
 			if (!access(path, R_OK) && (it = newicontheme(name, path))
 			    && it->inherits && strcmp(it->inherits, name)
 			    && strcmp(it->inherits, "hicolor"))
@@ -825,6 +1437,7 @@ rescanicons(void)
 		}
 		free(name);
 	}
+	indexicons();
 }
 
 static Bool
@@ -863,6 +1476,9 @@ initicons(Bool reload __attribute__((unused)))
 		dirs = reallocarray(dirs, i + 2, sizeof(*dirs));
 		dirs[i + 1] = NULL;
 		dirs[i] = strndup(p, q - p);
+		/* whether each directory exists is an input of the icon phase: the
+		   files within it are watched (see watchicons()) */
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -880,6 +1496,7 @@ initicons(Bool reload __attribute__((unused)))
 		dirs[i] = ecalloc(len + 1, sizeof(*dirs[i]));
 		strncpy(dirs[i], home, len);
 		strncat(dirs[i], "/.icons", len);
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -895,6 +1512,7 @@ initicons(Bool reload __attribute__((unused)))
 		xdgs[j] = ecalloc(len + 1, sizeof(*xdgs[j]));
 		strncpy(xdgs[j], env, len);
 		strncat(xdgs[j], "/icons", len);
+		phasefile(xdgs[j]);
 		if (!already(xdgs, xdgs[j]) && !stat(xdgs[j], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to XDG paths: %s\n", xdgs[j]);
 			j++;
@@ -910,6 +1528,7 @@ initicons(Bool reload __attribute__((unused)))
 		strncpy(xdgs[j], home, len);
 		strncpy(xdgs[j], home, len);
 		strncat(xdgs[j], "/.local/share/icons", len);
+		phasefile(xdgs[j]);
 		if (!already(xdgs, xdgs[j]) && !stat(xdgs[j], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to XDG paths: %s\n", xdgs[j]);
 			j++;
@@ -926,6 +1545,7 @@ initicons(Bool reload __attribute__((unused)))
 		xdgs[j] = ecalloc(len + 1, sizeof(*xdgs[j]));
 		strncpy(xdgs[j], p, q - p);
 		strncat(xdgs[j], "/icons", len);
+		phasefile(xdgs[j]);
 		if (!already(xdgs, xdgs[j]) && !stat(xdgs[j], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to XDG paths: %s\n", xdgs[j]);
 			j++;
@@ -943,6 +1563,7 @@ initicons(Bool reload __attribute__((unused)))
 		dirs[i] = ecalloc(len + 1, sizeof(*dirs[i]));
 		strncpy(dirs[i], env, len);
 		strncat(dirs[i], "/pixmaps", len);
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -957,6 +1578,7 @@ initicons(Bool reload __attribute__((unused)))
 		dirs[i] = ecalloc(len + 1, sizeof(*dirs[i]));
 		strncpy(dirs[i], home, len);
 		strncat(dirs[i], "/.local/share/pixmaps", len);
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -973,6 +1595,7 @@ initicons(Bool reload __attribute__((unused)))
 		dirs[i] = ecalloc(len + 1, sizeof(*dirs[i]));
 		strncpy(dirs[i], p, (q - p));
 		strncat(dirs[i], "/pixmaps", len);
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -987,6 +1610,7 @@ initicons(Bool reload __attribute__((unused)))
 		dirs = reallocarray(dirs, i + 2, sizeof(*dirs));
 		dirs[i + 1] = NULL;
 		dirs[i] = strndup(p, q - p);
+		phasefile(dirs[i]);
 		if (!already(dirs, dirs[i]) && !stat(dirs[i], &st) && S_ISDIR(st.st_mode)) {
 			OPRINTF("added directory to search paths: %s\n", dirs[i]);
 			i++;
@@ -1020,9 +1644,11 @@ initicons(Bool reload __attribute__((unused)))
 			FILE *file;
 			strncpy(buf, home, PATH_MAX);
 			strncat(buf, "/.gtkrc-2.0.xde", PATH_MAX);
+			phasefile(buf);
 			if ((missing = access(buf, R_OK))) {
 				strncpy(buf, home, PATH_MAX);
 				strncat(buf, "/.gtkrc-2.0", PATH_MAX);
+				phasefile(buf);
 				missing = access(buf, R_OK);
 			}
 			if (!missing && (file = fopen(buf, "r"))) {
@@ -6,5 +6,8 @@
 void initicons(Bool reload);
 char *FindBestIcon(const char **iconlist, int size, const char **fexts);
 char *FindIcon(const char *icon, int size, const char **fexts);
+void iconstats(void);
+const char *geticondir(unsigned i);
+void iconfilechanged(const char *dir, const char *name, Bool added);
 
 #endif				/* __LOCAL_ICON_H__ */
@@ -7,6 +7,8 @@
 #include "tags.h"
 #include "actions.h"
 #include "config.h"
+#include "convert.h"
+#include "scale.h"
 #include "image.h" /* verification */
 
 #define ALPHAMAX
@@ -148,12 +150,14 @@ combine_pixmap_and_mask(AScreen *ds, XImage *xdraw, XImage *xmask)
 }
 
 #ifdef LIBPNG
-XImage *
-png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
+/* Decode a PNG file to non-premultiplied ARGB pixels (as in _NET_WM_ICON but
+ * 32 bits per pixel).  Does not touch the display, so it may be called from
+ * the icon decoding threads. */
+unsigned *
+png_read_file_to_argb(const char *file, unsigned *wret, unsigned *hret)
 {
-	XImage *xicon = NULL;
+	unsigned *volatile argb = NULL;	/* set before and after the setjmp */
 	volatile void *vol_png_pixels = NULL, *vol_row_pointers = NULL;
-	volatile void *vol_xicon = NULL;
 	png_structp png_ptr;
 	png_infop info_ptr;
 	png_byte buf[8];
@@ -179,8 +183,8 @@ png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
 	png_uint_32 width, height, row_bytes;
 	png_byte *png_pixels = NULL, **row_pointers = NULL, *p;
 	int bit_depth, color_type, channels;
-	unsigned i, j;
-	unsigned long pixel; unsigned long A, R, G, B;
+	unsigned i, j, *q;
+	unsigned A, R, G, B;
 
 	png_init_io(png_ptr, f);
 	png_set_sig_bytes(png_ptr, 8);
@@ -217,11 +221,10 @@ png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
 		row_pointers[i] = png_pixels + i * row_bytes;
 	png_read_image(png_ptr, row_pointers);
 	png_read_end(png_ptr, info_ptr);
-	if (!(xicon = XCreateImage(display, visual, 32, ZPixmap, 0, NULL, width, height, 32, 0)))
-		goto pngerr;
-	vol_xicon = xicon;
-	xicon->data = ecalloc(xicon->bytes_per_line, xicon->height);
-	for (p = png_pixels, j = 0; j < height; j++) {
+	/* no libpng calls below here, so argb cannot be lost to a longjmp */
+	argb = ecalloc((size_t) width * height, sizeof(*argb));
+	for (q = argb, j = 0; j < height; j++) {
+		p = row_pointers[j];
 		for (i = 0; i < width; i++, p += channels) {
 			switch(color_type) {
 			case PNG_COLOR_TYPE_GRAY:
@@ -239,6 +242,7 @@ png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
 				A = 255;
 				break;
 			case PNG_COLOR_TYPE_RGB_ALPHA:
+			default:
 				R = p[0];
 				G = p[1];
 				B = p[2];
@@ -247,12 +251,12 @@ png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
 			}
 			if (!A)
 				R = G = B = 0;
-			pixel = (A << 24)|(R <<16)|(G<<8)|(B<<0);
-			XPutPixel(xicon, i, j, pixel);
+			*q++ = (A << 24)|(R <<16)|(G<<8)|(B<<0);
 		}
 	}
+	*wret = width;
+	*hret = height;
       pngerr:
-	xicon = (typeof(xicon)) vol_xicon;
 	png_pixels = (typeof(png_pixels)) vol_png_pixels;
 	free(png_pixels);
 	row_pointers = (typeof(row_pointers)) vol_row_pointers;
@@ -264,467 +268,147 @@ png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
       noread:
 	fclose(f);
       nofile:
-	return (xicon);
+	return (argb);
 }
-#endif
 
 XImage *
-dn_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
+png_read_file_to_ximage(Display *display, Visual *visual, const char *file)
 {
-	XImage *xscale = NULL;
-	size_t elements = nw * nh;
-	double *counts = NULL;
-	double *colors = NULL;
-
-	if (!(xscale = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, nw, nh, 8, 0))) {
-		EPRINTF("could not create ximage\n");
-		goto error;
-	}
-	if (!(xscale->data = calloc(xscale->bytes_per_line, xscale->height))) {
-		EPRINTF("could not allocate ximage data\n");
-		goto error;
-	}
-	if (!(counts = ecalloc(elements, sizeof(*counts)))) {
-		EPRINTF("could not allocate %zu counts\n", elements);
-		goto error;
-	}
-	if (!(colors = ecalloc(elements, sizeof(*colors) << 2))) {
-		EPRINTF("could not allocate %zu colors\n", elements<<2);
-		goto error;
-	}
-
-	unsigned w = ximage->width;
-	unsigned h = ximage->height;
-	unsigned i, j, k, l, m, n;
-
-	double pppx = (double) nw / (double) w;
-	double pppy = (double) nh / (double) h;
-
-	double ty, by, lx, rx, xf, yf, ff;
-
-	unsigned long A, R, G, B, pixel;
-
-	XPRINTF("downscaling image %ux%ux%u to %ux%ux%u\n",
-			ximage->width, ximage->height, ximage->depth,
-			xscale->width, xscale->height, xscale->depth);
+	XImage *xicon = NULL;
+	unsigned *argb, *q, width, height, i, j;
 
-	for (ty = 0.0, by = pppy, l = 0; l < h; l++, ty = by, by = (l + 1) * pppy) {
-
-		for (j = floor(ty); j < by; j++) {
-
-			if (ty < (j + 1) && (j + 1) < by) yf = (j + 1) - ty;
-			else if (ty < j && j < by) yf = by - j;
-			else yf = 1.0;
-
-			for (lx = 0.0, rx = pppx, k = 0; k < w; k++, lx = rx, rx = (k + 1) * pppx) {
-
-				for (i = floor(lx); i < rx; i++) {
-
-					if (lx < (i + 1) && (i + 1) < rx) xf = (i + 1) - lx;
-					else if (lx < i && i < rx) xf = rx - i;
-					else xf = 1.0;
-
-					ff = xf * yf;
-					m = j * nw + i;
-					n = m << 2;
-					counts[m] += ff;
-					pixel = XGetPixel(ximage, k, l);
-					if (bitmap && (pixel & 0x00ffffff))
-						pixel |= 0x00ffffff;
-					A = (pixel >> 24) & 0xff;
-					R = (pixel >> 16) & 0xff;
-					G = (pixel >> 8) & 0xff;
-					B = (pixel >> 0) & 0xff;
-					colors[n + 0] += A * ff;
-					colors[n + 1] += R * ff;
-					colors[n + 2] += G * ff;
-					colors[n + 3] += B * ff;
-				}
-			}
-		}
-	}
-	unsigned long amax = 0;
-
-	for (j = 0; j < nh; j++) {
-		for (i = 0; i < nw; i++) {
-			m = j * nw + i;
-			n = m << 2;
-			if (counts[m]) {
-				pixel = ((A = min(255, lround(colors[n + 0] / counts[m]))) << 24) |
-					((R = min(255, lround(colors[n + 1] / counts[m]))) << 16) |
-					((G = min(255, lround(colors[n + 2] / counts[m]))) <<  8) |
-					((B = min(255, lround(colors[n + 3] / counts[m]))) <<  0);
-				XPutPixel(xscale, i, j, pixel);
-				amax = max(amax, A);
-			}
-		}
+	if (!(argb = png_read_file_to_argb(file, &width, &height)))
+		return (NULL);
+	if ((xicon = XCreateImage(display, visual, 32, ZPixmap, 0, NULL, width, height, 32, 0))) {
+		xicon->data = ecalloc(xicon->bytes_per_line, xicon->height);
+		for (q = argb, j = 0; j < height; j++)
+			for (i = 0; i < width; i++)
+				XPutPixel(xicon, i, j, *q++);
 	}
-	/* no opacity, add some */
-	if (!amax)
-		for (j = 0; j < nh; j++)
-			for (i = 0; i < nw; i++)
-				XPutPixel(xscale, i, j, XGetPixel(xscale, i, j) | 0xff000000);
-#ifdef ALPHAMAX
-	else if (amax < 255UL) {
-		double bump = (double) 255 / (double) amax;
+	free(argb);
+	return (xicon);
+}
+#endif
 
-		for (j = 0; j < nh; j++) {
-			for (i = 0; i < nw; i++) {
-				pixel = XGetPixel(xscale, i, j);
-				A = (pixel >> 24) & 0xff;
-				A = min(255, lround(A * bump));
-				pixel = (pixel & 0x00ffffff) | (A << 24);
-				XPutPixel(xscale, i, j, pixel);
-			}
-		}
-	}
+static Bool
+directimage(XImage *ximage)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const int order = LSBFirst;
+#else
+	const int order = MSBFirst;
 #endif
-	free(counts);
-	free(colors);
-	XDestroyImage(ximage);
-	return (xscale);
-      error:
-	if (xscale)
-		XDestroyImage(xscale);
-	if (counts)
-		free(counts);
-	if (colors)
-		free(colors);
-	return (ximage);
+	return (ximage->format == ZPixmap && ximage->depth == 32 &&
+		ximage->bits_per_pixel == 32 && ximage->byte_order == order);
 }
 
-XImage *
-up_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
+static void
+getximagerow(const void *src, unsigned j, unsigned *row)
 {
-	XImage *xscale = NULL;
-	size_t elements = nw * nh;
-
-	xscale = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, nw, nh, 8, 0);
-	if (!xscale)
-		return (ximage);
-	xscale->data = ecalloc(xscale->bytes_per_line, xscale->height);
-	if (!xscale->data) {
-		XDestroyImage(xscale);
-		return (ximage);
-	}
-	double *counts = ecalloc(elements, sizeof(*counts));
-	double *colors = ecalloc(elements, sizeof(*colors) << 2);
-
-	unsigned w = ximage->width;
-	unsigned h = ximage->height;
-	unsigned i, j, k, l, m, n;
+	const XImage *ximage = src;
+	unsigned i, w = ximage->width;
 
-	double pppx = (double) w / (double) nw;
-	double pppy = (double) h / (double) nh;
-	double ty, by, lx, rx, xf, yf, ff;
-	unsigned long A, R, G, B, pixel;
+	if (directimage((XImage *) ximage))
+		memcpy(row, ximage->data + j * ximage->bytes_per_line, w * sizeof(*row));
+	else
+		for (i = 0; i < w; i++)
+			row[i] = XGetPixel((XImage *) ximage, i, j);
+}
 
-	for (ty = 0.0, by = pppy, l = 0; l < nh; l++, ty = by, by = (l + 1) *pppy) {
+static void
+getbitmaprow(const void *src, unsigned j, unsigned *row)
+{
+	const XImage *ximage = src;
+	unsigned i;
 
-		for (j = floor(ty); j < by; j++) {
+	getximagerow(src, j, row);
+	for (i = 0; i < (unsigned) ximage->width; i++)
+		if (row[i] & 0x00ffffff)
+			row[i] |= 0x00ffffff;
+}
 
-			if (ty < (j + 1) && (j + 1) < by)
-				yf = (j + 1) - ty;
-			else if (ty < j && j < by)
-				yf = by - j;
-			else
-				yf = 1.0;
-
-			for (lx = 0.0, rx = pppx, k = 0; k < nw; k++, lx = rx, rx = (k + 1) * pppx) {
-
-				for (i = floor(lx); i < rx; i++) {
-
-					if (lx < (i + 1) && (i + 1) < rx)
-						xf = (i + 1) - lx;
-					else if (lx < i && i < rx)
-						xf = rx - i;
-					else
-						xf = 1.0;
-
-					ff = xf * yf;
-
-					m = l * nw + k;
-					n = m << 2;
-					counts[m] += ff;
-					pixel = XGetPixel(ximage, i, j);
-					if (bitmap && (pixel & 0x00ffffff))
-						pixel |= 0x00ffffff;
-					A = (pixel >> 24) & 0xff;
-					R = (pixel >> 16) & 0xff;
-					G = (pixel >> 8) & 0xff;
-					B = (pixel >> 0) & 0xff;
-					colors[n + 0] += A * ff;
-					colors[n + 1] += R * ff;
-					colors[n + 2] += G * ff;
-					colors[n + 3] += B * ff;
-				}
-			}
-		}
-	}
-	unsigned long amax = 0;
-
-	for (j = 0; j < nh; j++) {
-		for (i = 0; i < nw; i++) {
-			m = j * nw + i;
-			n = m << 2;
-			if (counts[m]) {
-				pixel = ((A = min(255, lround(colors[n + 0] / counts[m]))) << 24) |
-					((R = min(255, lround(colors[n + 1] / counts[m]))) << 16) |
-					((G = min(255, lround(colors[n + 2] / counts[m]))) <<  8) |
-					((B = min(255, lround(colors[n + 3] / counts[m]))) <<  0);
-				XPutPixel(xscale, i, j, pixel);
-				amax = max(amax, A);
-			}
-		}
-	}
-	/* no opacity, add some */
-	if (!amax)
-		for (j = 0; j < nh; j++)
-			for (i = 0; i < nw; i++)
-				XPutPixel(xscale, i, j, XGetPixel(xscale, i, j) | 0xff000000);
-#ifdef ALPHAMAX
-	else if (amax < 255UL) {
-		double bump = (double) 255 / (double) amax;
+static void
+putximagerow(void *dst, unsigned j, const unsigned *row)
+{
+	XImage *ximage = dst;
+	unsigned i, w = ximage->width;
 
-		for (j = 0; j < nh; j++) {
-			for (i = 0; i < nw; i++) {
-				pixel = XGetPixel(xscale, i, j);
-				A = (pixel >> 24) & 0xff;
-				A = min(255, lround(A * bump));
-				pixel = (pixel & 0x00ffffff) | (A << 24);
-				XPutPixel(xscale, i, j, pixel);
-			}
-		}
-	}
-#endif
-	free(counts);
-	free(colors);
-	XDestroyImage(ximage);
-	return (xscale);
+	if (directimage(ximage))
+		memcpy(ximage->data + j * ximage->bytes_per_line, row, w * sizeof(*row));
+	else
+		for (i = 0; i < w; i++)
+			XPutPixel(ximage, i, j, row[i]);
 }
 
-/* upscaling width, downscaling height */
 static XImage *
-wh_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
+box_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
 {
 	XImage *xscale = NULL;
-	size_t elements = nw * nh;
-
-	xscale = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, nw, nh, 8, 0);
-	if (!xscale)
-		return(ximage);
-	xscale->data = ecalloc(xscale->bytes_per_line, xscale->height);
-	if (!xscale->data) {
-		XDestroyImage(xscale);
-		return (ximage);
-	}
-	double *counts = ecalloc(elements, sizeof(*counts));
-	double *colors = ecalloc(elements, sizeof(*colors) << 2);
-
 	unsigned w = ximage->width;
 	unsigned h = ximage->height;
-	unsigned i, j, k, l, m, n;
-
-	double pppx = (double) w / (double) nw;
-	double pppy = (double) nh / (double) h;
-	double ty, by, lx, rx, xf, yf, ff;
-	unsigned long A, R, G, B, pixel;
-
-	for (ty = 0.0, by = pppy, l = 0; l < h; l++, ty = by, by = (l + 1) * pppy) {
-
-		for (j = floor(ty); j < by; j++) {
-
-			if (ty < (j + 1) && (j + 1) < by)
-				yf = (j + 1) - ty;
-			else if (ty < j && j < by)
-				yf = by - j;
-			else
-				yf = 1.0;
-
-			for (lx = 0.0, rx = pppx, k = 0; k < nw; k++, lx = rx, rx = (k + 1) * pppx) {
-
-				for (i = floor(lx); i < rx; i++) {
-
-					if (lx < (i + 1) && (i + 1) < rx)
-						xf = (i + 1) - lx;
-					else if (lx < i && i < rx)
-						xf = rx - i;
-					else
-						xf = 1.0;
-
-					ff = xf * yf;
-
-					m = l * nw + k;
-					n = m << 2;
-					counts[m] += ff;
-					pixel = XGetPixel(ximage, i, j);
-					if (bitmap && (pixel & 0x00ffffff))
-						pixel |= 0x00ffffff;
-					A = (pixel >> 24) & 0xff;
-					R = (pixel >> 16) & 0xff;
-					G = (pixel >> 8) & 0xff;
-					B = (pixel >> 0) & 0xff;
-					colors[n + 0] += A * ff;
-					colors[n + 1] += R * ff;
-					colors[n + 2] += G * ff;
-					colors[n + 3] += B * ff;
-				}
-			}
-		}
-	}
-	unsigned long amax = 0;
-
-	for (j = 0; j < nh; j++) {
-		for (i = 0; i < nw; i++) {
-			m = j * nw + i;
-			n = m << 2;
-			if (counts[m]) {
-				pixel = ((A = min(255, lround(colors[n + 0] / counts[m]))) << 24) |
-					((R = min(255, lround(colors[n + 1] / counts[m]))) << 16) |
-					((G = min(255, lround(colors[n + 2] / counts[m]))) <<  8) |
-					((B = min(255, lround(colors[n + 3] / counts[m]))) <<  0);
-				XPutPixel(xscale, i, j, pixel);
-				amax = max(amax, A);
-			}
-		}
-	}
-	/* no opacity, add some */
-	if (!amax)
-		for (j = 0; j < nh; j++)
-			for (i = 0; i < nw; i++)
-				XPutPixel(xscale, i, j, XGetPixel(xscale, i, j) | 0xff000000);
+	unsigned i, j, amax;
+	ScaleRows sr;
 #ifdef ALPHAMAX
-	else if (amax < 255UL) {
-		double bump = (double) 255 / (double) amax;
-
-		for (j = 0; j < nh; j++) {
-			for (i = 0; i < nw; i++) {
-				pixel = XGetPixel(xscale, i, j);
-				A = (pixel >> 24) & 0xff;
-				A = min(255, lround(A * bump));
-				pixel = (pixel & 0x00ffffff) | (A << 24);
-				XPutPixel(xscale, i, j, pixel);
-			}
-		}
-	}
+	unsigned long pixel;
+	unsigned A;
 #endif
-	free(counts);
-	free(colors);
-	XDestroyImage(ximage);
-	return (xscale);
-}
 
-/* downscaling width, upscaling height */
-static XImage *
-hw_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
-{
-	XImage *xscale = NULL;
-	size_t elements = nw * nh;
-
-	xscale = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, nw, nh, 8, 0);
-	if (!xscale)
-		return(ximage);
-	xscale->data = ecalloc(xscale->bytes_per_line, xscale->height);
-	if (!xscale->data) {
+	if (!nw || !nh || !w || !h)
+		return (ximage);
+	if (!(xscale = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, nw, nh, 8, 0))) {
+		EPRINTF("could not create ximage\n");
+		return (ximage);
+	}
+	if (!(xscale->data = calloc(xscale->bytes_per_line, xscale->height))) {
+		EPRINTF("could not allocate ximage data\n");
 		XDestroyImage(xscale);
 		return (ximage);
 	}
-	double *counts = ecalloc(elements, sizeof(*counts));
-	double *colors = ecalloc(elements, sizeof(*colors) << 2);
-
-	unsigned w = ximage->width;
-	unsigned h = ximage->height;
-	unsigned i, j, k, l, m, n;
-
-	double pppx = (double) nw / (double) w;
-	double pppy = (double) h / (double) nh;
-	double ty, by, lx, rx, xf, yf, ff;
-	unsigned long A, R, G, B, pixel;
 
-	for (ty = 0.0, by = pppy, l = 0; l < nh; l++, ty = by, by = (l + 1) *pppy) {
+	XPRINTF("scaling image %ux%ux%u to %ux%ux%u\n",
+			ximage->width, ximage->height, ximage->depth,
+			xscale->width, xscale->height, xscale->depth);
 
-		for (j = floor(ty); j < by; j++) {
+	sr.getrow = bitmap ? getbitmaprow : getximagerow;
+	sr.putrow = putximagerow;
+	sr.src = ximage;
+	sr.dst = xscale;
+	amax = box_scale(&sr, w, h, nw, nh);
 
-			if (ty < (j + 1) && (j + 1) < by)
-				yf = (j + 1) - ty;
-			else if (ty < j && j < by)
-				yf = by - j;
-			else
-				yf = 1.0;
-
-			for (lx = 0.0, rx = pppx, k = 0; k < w; k++, lx = rx, rx = (k + 1) * pppx) {
-
-				for (i = floor(lx); i < rx; i++) {
-
-					if (lx < (i + 1) && (i + 1) < rx)
-						xf = (i + 1) - lx;
-					else if (lx < i && i < rx)
-						xf = rx - i;
-					else
-						xf = 1.0;
-
-					ff = xf * yf;
-
-					m = j * nw + i;
-					n = m << 2;
-					counts[m] += ff;
-					pixel = XGetPixel(ximage, i, j);
-					if (bitmap && (pixel & 0x00ffffff))
-						pixel |= 0x00ffffff;
-					A = (pixel >> 24) & 0xff;
-					R = (pixel >> 16) & 0xff;
-					G = (pixel >> 8) & 0xff;
-					B = (pixel >> 0) & 0xff;
-					colors[n + 0] += A * ff;
-					colors[n + 1] += R * ff;
-					colors[n + 2] += G * ff;
-					colors[n + 3] += B * ff;
-				}
-			}
-		}
-	}
-	unsigned long amax = 0;
-
-	for (j = 0; j < nh; j++) {
-		for (i = 0; i < nw; i++) {
-			m = j * nw + i;
-			n = m << 2;
-			if (counts[m]) {
-				pixel = ((A = min(255, lround(colors[n + 0] / counts[m]))) << 24) |
-					((R = min(255, lround(colors[n + 1] / counts[m]))) << 16) |
-					((G = min(255, lround(colors[n + 2] / counts[m]))) <<  8) |
-					((B = min(255, lround(colors[n + 3] / counts[m]))) <<  0);
-				XPutPixel(xscale, i, j, pixel);
-				amax = max(amax, A);
-			}
-		}
-	}
 	/* no opacity, add some */
 	if (!amax)
 		for (j = 0; j < nh; j++)
 			for (i = 0; i < nw; i++)
 				XPutPixel(xscale, i, j, XGetPixel(xscale, i, j) | 0xff000000);
 #ifdef ALPHAMAX
-	else if (amax < 255UL) {
-		double bump = (double) 255 / (double) amax;
-
+	else if (amax < 255U) {
 		for (j = 0; j < nh; j++) {
 			for (i = 0; i < nw; i++) {
 				pixel = XGetPixel(xscale, i, j);
 				A = (pixel >> 24) & 0xff;
-				A = min(255, lround(A * bump));
-				pixel = (pixel & 0x00ffffff) | (A << 24);
+				A = min(255U, (A * 255U + (amax >> 1)) / amax);
+				pixel = (pixel & 0x00ffffff) | ((unsigned long) A << 24);
 				XPutPixel(xscale, i, j, pixel);
 			}
 		}
 	}
 #endif
-	free(counts);
-	free(colors);
 	XDestroyImage(ximage);
 	return (xscale);
 }
 
+XImage *
+dn_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
+{
+	return box_scale_image(ds, ximage, nw, nh, bitmap);
+}
+
+XImage *
+up_scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap)
+{
+	return box_scale_image(ds, ximage, nw, nh, bitmap);
+}
+
 /* crop ARGB image down to non-transparent extents, consuming passed image */
 XImage *
 crop_image(AScreen *ds, XImage *ximage)
@@ -785,20 +469,9 @@ scale_image(AScreen *ds, XImage *ximage, unsigned nw, unsigned nh, Bool bitmap,
 	if (crop)
 		ximage = crop_image(ds, ximage);
 
-	if (nw == w && nh == h) {
+	if (nw == w && nh == h)
 		return (ximage);
-	} else if (nw <= w && nh <= h) {
-		return dn_scale_image(ds, ximage, nw, nh, bitmap);
-	} else if (nw >= w && nh >= h) {
-		return up_scale_image(ds, ximage, nw, nh, bitmap);
-	} else if (nw >= w && nh <= h) {
-		return wh_scale_image(ds, ximage, nw, nh, bitmap);
-	} else if (nw <= w && nh >= h) {
-		return hw_scale_image(ds, ximage, nw, nh, bitmap);
-	} else {
-		/* can't happen */
-		return (NULL);
-	}
+	return box_scale_image(ds, ximage, nw, nh, bitmap);
 }
 
 #if 0
@@ -821,106 +494,198 @@ static const unsigned char dither8[8][8] = {
 };
 #endif
 
-void
+static void
+initconvert(AScreen *ds)
+{
+	/* not passed to DPRINTF() directly: that compiles to nothing without TRACE */
+	const char *name __attribute__((unused)) =
+		selectconvert(ds, ImageByteOrder(dpy) == MSBFirst, ConvertVector);
+
+	DPRINTF("using %s image converter for depth %u bpp %u\n", name, ds->depth, ds->bpp);
+}
+
+XImage *
 renderimage(AScreen *ds, const ARGB *argb, const unsigned width, const unsigned height)
 {
 	XImage *image;
-	unsigned long r, g, b, pixel;
-	unsigned char *p, *pp, *data;
-	unsigned x, y;
-	const ARGB *c;
+	unsigned char *data;
+	unsigned y;
 
-	image = XCreateImage(dpy, ds->visual, ds->bpp, ZPixmap, 0, NULL, width, height, 32, 0);
+	if (!ds->convert) {
+		XPRINTF("Unsupported visual class\n");
+		return (NULL);
+	}
+	image = XCreateImage(dpy, ds->visual, ds->depth, ZPixmap, 0, NULL, width, height, 32, 0);
 	if (!image) {
 		XPRINTF("Could not create image\n");
-		return;
+		return (NULL);
 	}
 	image->data = NULL;
-	p = pp = data = calloc(image->bytes_per_line * (height + 1), sizeof(*data));
+	data = calloc(image->bytes_per_line * (height + 1), sizeof(*data));
+
+	for (y = 0; y < height; y++, argb += width)
+		ds->convert(ds, argb, data + y * image->bytes_per_line, width);
 
-	switch (ds->visual->class) {
-	case StaticColor:
-	case PseudoColor:
-		for (c = argb, y = 0; y < height; y++) {
-			for (x = 0; x < width; x++, c++) {
-				r = ds->rctab[c->red];
-				g = ds->gctab[c->green];
-				b = ds->bctab[c->blue];
-
-				pixel = (r * ds->cpc * ds->cpc) + (g * ds->cpc) + b;
-				*p++ = ds->colors[pixel].pixel;
-			}
-			p = (pp += image->bytes_per_line);
-		}
-		break;
-	case TrueColor:
-		for (c = argb, y = 0; y < height; y++) {
-			for (x = 0; x < width; x++, c++) {
-				r = ds->rctab[c->red];
-				g = ds->gctab[c->green];
-				b = ds->bctab[c->blue];
-
-				pixel = (((r << ds->visual->bits_per_rgb) | g) << ds->visual->bits_per_rgb) | b;
-				switch (ds->bpp + ((image->byte_order == MSBFirst) ? 1 : 0)) {
-				case 8:	/* 8bpp */
-					*p++ = pixel;
-					break;
-				case 16:	/* 16bpp LSB */
-					*p++ = pixel;
-					*p++ = pixel >> 8;
-					break;
-				case 17:	/* 16bpp MSB */
-					*p++ = pixel >> 8;
-					*p++ = pixel;
-					break;
-				case 24:	/* 24bpp LSB */
-					*p++ = pixel;
-					*p++ = pixel >> 8;
-					*p++ = pixel >> 16;
-					break;
-				case 25:	/* 24bpp MSB */
-					*p++ = pixel >> 16;
-					*p++ = pixel >> 8;
-					*p++ = pixel;
-					break;
-				case 32:	/* 32bpp LSB */
-					*p++ = pixel;
-					*p++ = pixel >> 8;
-					*p++ = pixel >> 16;
-					*p++ = pixel >> 24;
-					break;
-				case 33:	/* 32bpp MSB */
-					*p++ = pixel >> 24;
-					*p++ = pixel >> 16;
-					*p++ = pixel >> 8;
-					*p++ = pixel;
-					break;
-				}
-			}
-			p = (pp += image->bytes_per_line);
-		}
-		break;
-	case StaticGray:
-	case GrayScale:
-		for (c = argb, y = 0; y < height; y++) {
-			for (x = 0; x < width; x++, c++) {
-				r = ds->rctab[c->red];
-				g = ds->gctab[c->green];
-				b = ds->bctab[c->blue];
-
-				g = ((r * 30) + (g * 59) + (b * 11)) / 100;
-				*p++ = ds->colors[g].pixel;
-			}
-			p = (pp += image->bytes_per_line);
-		}
-		break;
-	default:
-		XPRINTF("Unsupported visual class\n");
-		free(data);
-		XDestroyImage(image);
-		return;
-	}
 	image->data = (char *) data;
+	return (image);
+}
+
+/*
+ * Image upload: XPutImage() copies the pixel data through the connection.  When
+ * the MIT-SHM extension is present and the server can attach our segments (it
+ * is local), larger ZPixmap uploads are instead copied into one of a small pool
+ * of shared memory segments and sent with XShmPutImage().  A segment is only
+ * rewritten once the server has processed the request that last read from it.
+ */
+
+static unsigned long long sockbytes;	/* bytes uploaded through the connection */
+static unsigned long long shmbytes;	/* bytes uploaded through shared memory */
+
+#ifdef XSHM
+
+#define SHMSEGS 4
+#define SHMMIN	16384			/* smaller uploads are not worth it */
+
+static struct {
+	XShmSegmentInfo info;
+	size_t size;
+	unsigned long serial;		/* request that last read the segment */
+} shmsegs[SHMSEGS];
+
+static unsigned shmnext;
+static Bool shmbroken;
+static Bool shmerror;
+
+static int
+xerrorshm(Display *dsply, XErrorEvent *ee)
+{
+	(void) dsply;
+	(void) ee;
+	shmerror = True;
+	return 0;
+}
+
+static void
+freeshmseg(unsigned i)
+{
+	if (!shmsegs[i].size)
+		return;
+	/* the server keeps its own attachment until it processes the detach */
+	XShmDetach(dpy, &shmsegs[i].info);
+	shmdt(shmsegs[i].info.shmaddr);
+	memset(&shmsegs[i], 0, sizeof(shmsegs[i]));
+}
+
+static Bool
+getshmseg(unsigned i, size_t size)
+{
+	XShmSegmentInfo *info = &shmsegs[i].info;
+	int (*handler) (Display *, XErrorEvent *);
+
+	if (shmsegs[i].size >= size) {
+		if (LastKnownRequestProcessed(dpy) < shmsegs[i].serial)
+			XSync(dpy, False);
+		return True;
+	}
+	freeshmseg(i);
+	size = (size + 0xffff) & ~(size_t) 0xffff;
+	if ((info->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600)) == -1) {
+		EPRINTF("shmget: %s\n", strerror(errno));
+		shmbroken = True;
+		return False;
+	}
+	if ((info->shmaddr = shmat(info->shmid, NULL, 0)) == (char *) -1) {
+		EPRINTF("shmat: %s\n", strerror(errno));
+		shmctl(info->shmid, IPC_RMID, NULL);
+		shmbroken = True;
+		return False;
+	}
+	info->readOnly = True;
+	/* attach fails with BadAccess on a remote server */
+	XSync(dpy, False);
+	shmerror = False;
+	handler = XSetErrorHandler(xerrorshm);
+	XShmAttach(dpy, info);
+	XSync(dpy, False);
+	XSetErrorHandler(handler);
+	/* the segment goes away once both sides have detached */
+	shmctl(info->shmid, IPC_RMID, NULL);
+	if (shmerror) {
+		OPRINTF("cannot attach shared memory: not using MIT-SHM\n");
+		shmdt(info->shmaddr);
+		memset(info, 0, sizeof(*info));
+		shmbroken = True;
+		return False;
+	}
+	shmsegs[i].size = size;
+	return True;
+}
+
+static Bool
+putshmimage(Drawable d, GC gc, XImage *image, int sx, int sy, int dx, int dy,
+	    unsigned w, unsigned h)
+{
+	const unsigned i = shmnext;
+	const size_t len = (size_t) w * image->bits_per_pixel / 8;
+	XImage *shm;
+	unsigned y;
+
+	if (!(shm = XShmCreateImage(dpy, NULL, image->depth, ZPixmap, NULL,
+				    &shmsegs[i].info, w, h)))
+		return False;
+	if (shm->bits_per_pixel != image->bits_per_pixel ||
+	    !getshmseg(i, (size_t) shm->bytes_per_line * h)) {
+		XDestroyImage(shm);
+		return False;
+	}
+	shm->data = shmsegs[i].info.shmaddr;
+	for (y = 0; y < h; y++)
+		memcpy(shm->data + y * shm->bytes_per_line,
+		       image->data + (sy + y) * image->bytes_per_line +
+		       sx * image->bits_per_pixel / 8, len);
+	shmsegs[i].serial = NextRequest(dpy);
+	XShmPutImage(dpy, d, gc, shm, 0, 0, dx, dy, w, h, False);
+	shm->data = NULL;
+	XDestroyImage(shm);
+	shmnext = (i + 1) % SHMSEGS;
+	shmbytes += len * h;
+	return True;
+}
+
+#endif				/* XSHM */
+
+/*
+ * Drop-in replacement for XPutImage() that uses shared memory when it can.
+ */
+void
+putimage(Drawable d, GC gc, XImage *image, int sx, int sy, int dx, int dy,
+	 unsigned w, unsigned h)
+{
+#ifdef XSHM
+	if (einfo[XshmBase].have && !shmbroken && image->format == ZPixmap &&
+	    !(image->bits_per_pixel & 7) && image->byte_order == ImageByteOrder(dpy) &&
+	    sx >= 0 && sy >= 0 && sx + w <= (unsigned) image->width &&
+	    sy + h <= (unsigned) image->height &&
+	    (size_t) w * h * image->bits_per_pixel / 8 >= SHMMIN &&
+	    putshmimage(d, gc, image, sx, sy, dx, dy, w, h))
+		return;
+#endif
+	XPutImage(dpy, d, gc, image, sx, sy, dx, dy, w, h);
+	sockbytes += (size_t) h * ((w * (image->format == ZPixmap ?
+					  image->bits_per_pixel : image->depth) + 7) / 8);
+}
+
+void
+freeimage(void)
+{
+#ifdef XSHM
+	unsigned i;
+
+	for (i = 0; i < SHMSEGS; i++)
+		freeshmseg(i);
+#endif
+	OPRINTF("uploaded %llu image bytes by shared memory, %llu by connection\n",
+		shmbytes, sockbytes);
 }
 
 void
@@ -1246,5 +1011,6 @@ initimage(void)
 		eprint("Unsuppoted visual class\n");
 		break;
 	}
+	initconvert(scr);
 }
 
@@ -20,10 +20,14 @@ int XReadBitmapFileImage(Display *display, Visual * visual, const char *file,
 			 unsigned *width, unsigned *height, XImage **image_return,
 			 int *x_hot, int *y_hot);
 #ifdef LIBPNG
+unsigned *png_read_file_to_argb(const char *file, unsigned *width, unsigned *height);
 XImage *png_read_file_to_ximage(Display *display, Visual* visual, const char *file);
 #endif
-void renderimage(AScreen *ds, const ARGB *argb, const unsigned width,
-		 const unsigned height);
+XImage *renderimage(AScreen *ds, const ARGB *argb, const unsigned width,
+		    const unsigned height);
+void putimage(Drawable d, GC gc, XImage *image, int sx, int sy, int dx, int dy,
+	      unsigned w, unsigned h);
 void initimage(void);
+void freeimage(void);
 
 #endif				/* __LOCAL_IMAGE_H__ */
@@ -8,6 +8,7 @@
 #include "config.h"
 #include "icons.h"
 #include "draw.h"
+#include "image.h"
 #if 1
 #include "ximage.h"
 #else
@@ -377,7 +378,7 @@ imlib2_createpngicon(AScreen *ds, Client *c, const char *file)
 	imlib_free_image();
 	imlib_context_pop();
 	pixmap = XCreatePixmap(dpy, ds->drawable, w, h, ds->depth);
-	XPutImage(dpy, pixmap, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
+	putimage(pixmap, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
 
 	pa.repeat = RepeatNone;
 	valuemask |= CPRepeat;
@@ -539,7 +540,7 @@ imlib2_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying bitmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -589,7 +590,7 @@ imlib2_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying pixmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -787,7 +788,7 @@ imlib2_drawdockapp(AScreen *ds, Client *c)
 			ds->dc.x, ds->dc.y, ds->dc.w, ds->dc.h);
 	if (!status)
 		XPRINTF("Could not fill rectangle, error %d\n", status);
-	XPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
+	XCPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
 		ds->dc.y);
 	/* note that ParentRelative dockapps need the background set to the foregroudn */
 	XSetWindowBackground(dpy, c->frame, pixel);
@@ -0,0 +1,185 @@
+/* See COPYING file for copyright and license details. */
+
+/* keytab.c is included below: nothing to trace to without the rest of adwm */
+#undef TRACE
+#undef DEBUG
+
+#include "adwm.h"
+#include "keytab.h"
+
+/*
+ * Benchmark the key binding table (see keytab.c) without a display.  Tables
+ * of 10, 100, 1000 and 5000 bindings are built, the top level keys using
+ * every printable keysym under each combination of four modifiers and the
+ * rest continuing them as chains.  Every binding is looked up with findkey()
+ * and by walking the chain lists (as dispatch did before the table), along
+ * with as many keys that are not bound, and each lookup is timed -n times over
+ * the table.  Exits with a failure when either lookup misses a binding or
+ * findkey() finds a key that is not bound.
+ */
+
+#include "keytab.c"
+
+AScreen *scr;
+
+static const unsigned sizes[] = { 10, 100, 1000, 5000 };
+static const unsigned long modsets[] = {
+	0, ShiftMask, ControlMask, ControlMask | ShiftMask,
+	Mod1Mask, Mod1Mask | ShiftMask, Mod1Mask | ControlMask,
+	Mod1Mask | ControlMask | ShiftMask,
+	Mod4Mask, Mod4Mask | ShiftMask, Mod4Mask | ControlMask,
+	Mod4Mask | ControlMask | ShiftMask, Mod4Mask | Mod1Mask,
+	Mod4Mask | Mod1Mask | ShiftMask, Mod4Mask | Mod1Mask | ControlMask,
+	Mod4Mask | Mod1Mask | ControlMask | ShiftMask
+};
+
+#define NSYMS	(0x7f - 0x20)		/* printable keysyms */
+#define NTOP	(NSYMS * LENGTH(modsets))
+
+void *
+ecalloc(size_t nmemb, size_t size)
+{
+	void *res;
+
+	if (!(res = calloc(nmemb, size))) {
+		fprintf(stderr, "keybench: out of memory\n");
+		exit(1);
+	}
+	return res;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0);
+}
+
+/* the i'th distinct keysym and modifier mask */
+static void
+keyof(unsigned i, KeySym *keysym, unsigned long *mod)
+{
+	*keysym = 0x20 + i % NSYMS;
+	*mod = modsets[(i / NSYMS) % LENGTH(modsets)];
+}
+
+/* n bindings: the first NTOP at top level, the rest spread over their chains */
+static Key **
+build(unsigned n)
+{
+	Key **keys = ecalloc(n, sizeof(*keys)), *k, *p;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		k = keys[i] = ecalloc(1, sizeof(*k));
+		if (i < NTOP) {
+			keyof(i, &k->keysym, &k->mod);
+			k->cnext = scr->keylist;
+			scr->keylist = k;
+		} else {
+			p = keys[(i - NTOP) % NTOP];
+			keyof((i - NTOP) / NTOP, &k->keysym, &k->mod);
+			k->parent = p;
+			k->cnext = p->chain;
+			p->chain = k;
+		}
+	}
+	unhashkeys();
+	return (keys);
+}
+
+static void
+release(Key **keys, unsigned n)
+{
+	unsigned i;
+
+	for (i = 0; i < n; i++)
+		free(keys[i]);
+	free(keys);
+	scr->keylist = NULL;
+	unhashkeys();
+}
+
+/* the lookup that findkey() replaced */
+static Key *
+walkkey(Key *parent, KeySym keysym, unsigned long mod)
+{
+	Key *k;
+
+	for (k = parent ? parent->chain : scr->keylist; k; k = k->cnext)
+		if (k->keysym == keysym && k->mod == mod)
+			break;
+	return (k);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned times = 1000, s, i, t, n;
+	AScreen screen = { 0, };
+	Key **keys, *k, *volatile found;
+	double start, hit, miss, walk;
+	int c, failed = 0;
+
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			times = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: keybench [-n times]\n");
+			return (2);
+		}
+	}
+	if (!times)
+		times = 1;
+	scr = &screen;
+
+	printf("ns per lookup (%u times over each table)\n", times);
+	printf("%8s %8s %10s %10s %10s\n", "bindings", "buckets", "findkey", "unbound", "walk");
+	for (s = 0; s < LENGTH(sizes); s++) {
+		n = sizes[s];
+		keys = build(n);
+		hashkeys();
+		for (i = 0; i < n; i++) {
+			k = keys[i];
+			if (findkey(k->parent, k->keysym, k->mod) != k ||
+			    walkkey(k->parent, k->keysym, k->mod) != k) {
+				printf("binding %u of %u not found\n", i, n);
+				failed = 1;
+			}
+			/* DEL is never bound */
+			if (findkey(k->parent, 0x7f, k->mod) || findkey(k, 0x7f, k->mod)) {
+				printf("unbound key found for binding %u of %u\n", i, n);
+				failed = 1;
+			}
+		}
+		start = now();
+		for (t = 0; t < times; t++)
+			for (i = 0; i < n; i++) {
+				k = keys[i];
+				found = findkey(k->parent, k->keysym, k->mod);
+			}
+		hit = (now() - start) * 1000000.0 / ((double) times * n);
+		start = now();
+		for (t = 0; t < times; t++)
+			for (i = 0; i < n; i++) {
+				k = keys[i];
+				found = findkey(k->parent, 0x7f, k->mod);
+			}
+		miss = (now() - start) * 1000000.0 / ((double) times * n);
+		start = now();
+		for (t = 0; t < times; t++)
+			for (i = 0; i < n; i++) {
+				k = keys[i];
+				found = walkkey(k->parent, k->keysym, k->mod);
+			}
+		walk = (now() - start) * 1000000.0 / ((double) times * n);
+		printf("%8u %8u %10.2f %10.2f %10.2f\n", n, scr->keybkts, hit, miss, walk);
+		release(keys, n);
+	}
+	(void) found;
+	return (failed);
+}
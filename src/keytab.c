@@ -0,0 +1,73 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "keytab.h" /* verification */
+
+/*
+ * Key bindings form a trie: top level keys are on scr->keylist and the keys
+ * that continue a chain are on its ->chain list.  For dispatch, each key is
+ * also hashed by its parent, keysym and modifier mask into scr->keytab, so
+ * that finding the binding for a key press does not depend on the number of
+ * bindings.  The table is discarded whenever bindings are added or freed and
+ * rebuilt on the next lookup.  keybench times it for up to 5000 bindings.
+ */
+
+#define KEYHASH(p, s, m) ((unsigned) (((uintptr_t) (p) >> 4) * 31 + (s) * 131 + (m)))
+
+static unsigned
+countkeys(Key *k)
+{
+	unsigned n;
+
+	for (n = 0; k; k = k->cnext)
+		n += 1 + countkeys(k->chain);
+	return (n);
+}
+
+static void
+hashchain(Key *parent, Key *k)
+{
+	unsigned h;
+
+	for (; k; k = k->cnext) {
+		k->parent = parent;
+		h = KEYHASH(parent, k->keysym, k->mod) & (scr->keybkts - 1);
+		k->hnext = scr->keytab[h];
+		scr->keytab[h] = k;
+		hashchain(k, k->chain);
+	}
+}
+
+void
+hashkeys(void)
+{
+	unsigned n = countkeys(scr->keylist);
+
+	free(scr->keytab);
+	for (scr->keybkts = 64; scr->keybkts < 2 * n; scr->keybkts <<= 1) ;
+	scr->keytab = ecalloc(scr->keybkts, sizeof(*scr->keytab));
+	hashchain(NULL, scr->keylist);
+	XPRINTF("Hashed %u keys into %u buckets\n", n, scr->keybkts);
+}
+
+void
+unhashkeys(void)
+{
+	free(scr->keytab);
+	scr->keytab = NULL;
+	scr->keybkts = 0;
+}
+
+/* find the key that follows parent (or a top level key for NULL) */
+Key *
+findkey(Key *parent, KeySym keysym, unsigned long mod)
+{
+	Key *k;
+
+	if (!scr->keytab)
+		hashkeys();
+	for (k = scr->keytab[KEYHASH(parent, keysym, mod) & (scr->keybkts - 1)]; k; k = k->hnext)
+		if (k->parent == parent && k->keysym == keysym && k->mod == mod)
+			break;
+	return (k);
+}
@@ -0,0 +1,10 @@
+/* keytab.c */
+
+#ifndef __LOCAL_KEYTAB_H__
+#define __LOCAL_KEYTAB_H__
+
+void hashkeys(void);
+void unhashkeys(void);
+Key *findkey(Key *parent, KeySym keysym, unsigned long mod);
+
+#endif				/* __LOCAL_KEYTAB_H__ */
@@ -34,7 +34,7 @@ setfocused(Client *c)
 	Container *cp, *cc;
 
 	if (c) {
-		XPRINTF(c, "setting as focused\n");
+		XCPRINTF(c, "setting as focused\n");
 		for (l = c->leaves; l; l = l->client.next)
 			for (cc = (Container *)l; (cp = cc->parent); cc = cp)
 				cp->node.children.focused = cc;
@@ -48,7 +48,7 @@ setselected(Client *c)
 	Container *cp, *cc;
 
 	if (c) {
-		XPRINTF(c, "setting as selected\n");
+		XCPRINTF(c, "setting as selected\n");
 		if (c->cview)
 			c->cview->lastsel = c;
 		for (l = c->leaves; l; l = l->client.next)
@@ -563,15 +563,15 @@ sloppyfocus(Client *c)
 	case Clk2Focus:
 		break;
 	case SloppyFloat:
-		XPRINTF(c, "FOCUS: sloppy focus\n");
+		XCPRINTF(c, "FOCUS: sloppy focus\n");
 		focus(c);
 		break;
 	case AllSloppy:
-		XPRINTF(c, "FOCUS: sloppy focus\n");
+		XCPRINTF(c, "FOCUS: sloppy focus\n");
 		focus(c);
 		break;
 	case SloppyRaise:
-		XPRINTF(c, "FOCUS: sloppy focus\n");
+		XCPRINTF(c, "FOCUS: sloppy focus\n");
 		focus(c);
 		raiseclient(c);	/* probably should not do this here */
 		break;
@@ -623,23 +623,23 @@ static Bool
 wouldfocus(XEvent *e, Client *c)
 {
 	if (!c || !canselect(c)) {
-		XPRINTF(c, "FOCUS: cannot select client.\n");
+		XCPRINTF(c, "FOCUS: cannot select client.\n");
 		return False;
 	}
 	if (c->skip.focus) {
-		XPRINTF(c, "FOCUS: should not focus (nor casually select) client.\n");
+		XCPRINTF(c, "FOCUS: should not focus (nor casually select) client.\n");
 		return False;
 	}
 	if (c->skip.sloppy || scr->options.focus == Clk2Focus) {
-		XPRINTF(c, "FOCUS: will not sloppy-focus client.\n");
+		XCPRINTF(c, "FOCUS: will not sloppy-focus client.\n");
 		return False;
 	}
 	if (scr->options.focus == SloppyFloat && !isfloating(c, c->cview)) {
-		XPRINTF(c, "FOCUS: will not sloppy-focus tiled client.\n");
+		XCPRINTF(c, "FOCUS: will not sloppy-focus tiled client.\n");
 		return False;
 	}
 	if (checkfocuslock(c, e->xany.serial)) {
-		XPRINTF(c, "FOCUS: cannot focus while focus locked.\n");
+		XCPRINTF(c, "FOCUS: cannot focus while focus locked.\n");
 		return False;
 	}
 	return True;
@@ -651,11 +651,11 @@ enterclient(XEvent *e, Client *c)
 	XCrossingEvent *ev = &e->xcrossing;
 
 	if (!wouldfocus(e, c)) {
-		XPRINTF(c, "FOCUS: cannot autofocus client.\n");
+		XCPRINTF(c, "FOCUS: cannot autofocus client.\n");
 		return True;
 	}
 	if (delayedfocus(c, ev->time)) {
-		XPRINTF(c, "FOCUS: delaying focus that would raise struts.\n");
+		XCPRINTF(c, "FOCUS: delaying focus that would raise struts.\n");
 		return True;
 	}
 	sloppyfocus(c);
@@ -1077,7 +1077,7 @@ constrain(Client *c, ClientGeometry *g)
 	int w = g->w, h = g->h;
 	Bool ret = False;
 
-	XPRINTF(c, "geometry before constraint: %dx%d+%d+%d:%d[%d,%d]\n",
+	XCPRINTF(c, "geometry before constraint: %dx%d+%d+%d:%d[%d,%d]\n",
 		g->w, g->h, g->x, g->y, g->b, g->t, g->g);
 
 	/* remove decoration */
@@ -1133,7 +1133,7 @@ constrain(Client *c, ClientGeometry *g)
 		g->h = h;
 		ret = True;
 	}
-	XPRINTF(c, "geometry after constraints: %dx%d+%d+%d:%d[%d,%d]\n",
+	XCPRINTF(c, "geometry after constraints: %dx%d+%d+%d:%d[%d,%d]\n",
 		g->w, g->h, g->x, g->y, g->b, g->t, g->g);
 	return ret;
 }
@@ -1141,7 +1141,7 @@ constrain(Client *c, ClientGeometry *g)
 static void
 save(Client *c)
 {
-	XPRINTF(c, "%dx%d+%d+%d:%d <= %dx%d+%d+%d:%d\n",
+	XCPRINTF(c, "%dx%d+%d+%d:%d <= %dx%d+%d+%d:%d\n",
 		c->r.w, c->r.h, c->r.x, c->r.y, c->r.b,
 		c->c.w, c->c.h, c->c.x, c->c.y, c->c.b);
 	c->r = c->c;
@@ -2138,7 +2138,7 @@ tile(View *v)
 		g.w -= 2 * (ma.g + g.b);
 		g.h -= 2 * (ma.g + g.b);
 		if (!c->is.moveresize) {
-			XPRINTF(&g, "CALLING reconfigure()\n");
+			XGPRINTF(&g, "CALLING reconfigure()\n");
 			reconfigure(c, &g, False);
 		} else {
 			ClientGeometry C = g;
@@ -2146,7 +2146,7 @@ tile(View *v)
 			/* center it where it was before */
 			C.x = (c->c.x + c->c.w / 2) - C.w / 2;
 			C.y = (c->c.y + c->c.h / 2) - C.h / 2;
-			XPRINTF(&C, "CALLING reconfigure()\n");
+			XGPRINTF(&C, "CALLING reconfigure()\n");
 			reconfigure(c, &C, False);
 		}
 		if (c->is.shaded && (c != sel || !scr->options.autoroll))
@@ -2234,7 +2234,7 @@ tile(View *v)
 		g.w -= 2 * (sa.g + g.b);
 		g.h -= 2 * (sa.g + g.b);
 		if (!c->is.moveresize) {
-			XPRINTF(&g, "CALLING reconfigure()\n");
+			XGPRINTF(&g, "CALLING reconfigure()\n");
 			reconfigure(c, &g, False);
 		} else {
 			ClientGeometry C = g;
@@ -2242,7 +2242,7 @@ tile(View *v)
 			/* center it where it was before */
 			C.x = (c->c.x + c->c.w / 2) - C.w / 2;
 			C.y = (c->c.y + c->c.h / 2) - C.h / 2;
-			XPRINTF(&C, "CALLING reconfigure()\n");
+			XGPRINTF(&C, "CALLING reconfigure()\n");
 			reconfigure(c, &C, False);
 		}
 		if (c->is.shaded && (c != sel || !scr->options.autoroll))
@@ -3211,7 +3211,7 @@ raisefloater(Client *c)
 {
 	if (c->is.floater || c->skip.arrange || c->is.full ||
 		(c->cview && VFEATURES(c->cview, OVERLAP))) {
-		XPRINTF(c, "raising floating client for focus\n");
+		XCPRINTF(c, "raising floating client for focus\n");
 		raiseclient(c);
 	}
 }
@@ -3220,7 +3220,7 @@ void
 raisetiled(Client *c)
 {
 	if (!c->is.dockapp && (c->is.bastard || !isfloating(c, c->cview))) {
-		XPRINTF(c, "raising non-floating client on focus\n");
+		XCPRINTF(c, "raising non-floating client on focus\n");
 		raiseclient(c);
 	}
 }
@@ -3231,7 +3231,7 @@ lowertiled(Client *c)
 #if 0
 	/* NEVER do this! */
 	if (!c->is.dockapp && (c->is.bastard || !isfloating(c, c->cview))) {
-		XPRINTF(c, "lowering non-floating client on loss of focus\n");
+		XCPRINTF(c, "lowering non-floating client on loss of focus\n");
 		lowerclient(c);
 	}
 #else
@@ -3940,7 +3940,7 @@ mousemove_from(Client *c, int from, XEvent *e, Bool toggle)
 			if (ev.xclient.message_type == _XA_NET_WM_MOVERESIZE) {
 				if (ev.xclient.data.l[2] == 11) {
 					/* _NET_WM_MOVERESIZE_CANCEL */
-					XPRINTF(c, "Move cancelled!\n");
+					XCPRINTF(c, "Move cancelled!\n");
 					ev.xclient.data.l[4] = 1; /* moving */
 					XChangeProperty(dpy, c->win, _XA_NET_WM_MOVING, XA_CARDINAL, 32,
 							PropModeReplace, (unsigned char *) ev.xclient.data.l, 5);
@@ -4159,12 +4159,12 @@ mousemove_from(Client *c, int from, XEvent *e, Bool toggle)
 										continue;
 									if (wind_overlap(n.y, ny2, s->c.y, sy2)) {
 										if (sl && (abs(n.x - sx2) < snap)) {
-											XPRINTF(s, "snapping left edge to other window right edge");
+											XCPRINTF(s, "snapping left edge to other window right edge");
 											n.x = sx2;
 											data[0] = sx2;
 											x_snapping = True;
 										} else if (sr && (abs(nx2 - s->c.x) < snap)) {
-											XPRINTF(s, "snapping right edge to other window left edge");
+											XCPRINTF(s, "snapping right edge to other window left edge");
 											n.x = s->c.x - (n.w + 2 * n.b);
 											data[0] = s->c.x;
 											x_snapping = True;
@@ -4181,12 +4181,12 @@ mousemove_from(Client *c, int from, XEvent *e, Bool toggle)
 										continue;
 									if (wind_overlap(n.y, ny2, s->c.y, sy2)) {
 										if (sl && (abs(n.x - s->c.x) < snap)) {
-											XPRINTF(s, "snapping left edge to other window left edge");
+											XCPRINTF(s, "snapping left edge to other window left edge");
 											n.x = s->c.x;
 											data[0] = s->c.x;
 											x_snapping = True;
 										} else if (sr && (abs(nx2 - sx2) < snap)) {
-											XPRINTF(s, "snapping right edge to other window right edge");
+											XCPRINTF(s, "snapping right edge to other window right edge");
 											n.x = sx2 - (n.w + 2 * n.b);
 											data[0] = sx2;
 											x_snapping = True;
@@ -4229,12 +4229,12 @@ mousemove_from(Client *c, int from, XEvent *e, Bool toggle)
 										continue;
 									if (wind_overlap(n.x, nx2, s->c.x, sx2)) {
 										if (st && (abs(n.y - sy2) < snap)) {
-											XPRINTF(s, "snapping top edge to other window bottom edge");
+											XCPRINTF(s, "snapping top edge to other window bottom edge");
 											n.y = sy2;
 											data[1] = sy2;
 											y_snapping = True;
 										} else if (sb && (abs(ny2 - s->c.y) < snap)) {
-											XPRINTF(s, "snapping bottom edge to other window top edge");
+											XCPRINTF(s, "snapping bottom edge to other window top edge");
 											n.y += s->c.y - ny2;
 											data[1] = s->c.y;
 											y_snapping = True;
@@ -4251,12 +4251,12 @@ mousemove_from(Client *c, int from, XEvent *e, Bool toggle)
 										continue;
 									if (wind_overlap(n.x, nx2, s->c.x, sx2)) {
 										if (st && (abs(n.y - s->c.y) < snap)) {
-											XPRINTF(s, "snapping top edge to other window top edge");
+											XCPRINTF(s, "snapping top edge to other window top edge");
 											n.y = s->c.y;
 											data[1] = s->c.y;
 											y_snapping = True;
 										} else if (sb && (abs(ny2 - sy2) < snap)) {
-											XPRINTF(s, "snapping bottom edge to other window bottom edge");
+											XCPRINTF(s, "snapping bottom edge to other window bottom edge");
 											n.y += sy2 - ny2;
 											data[1] = sy2;
 											y_snapping = True;
@@ -4736,12 +4736,12 @@ mouseresize_from(Client *c, int from, XEvent *e, Bool toggle)
 									continue;
 								if (wind_overlap(n.y, ny2, s->c.y, sy2)) {
 									if (sl && (abs(n.x - sx2) < snap)) {
-										XPRINTF(s, "snapping left edge to other window right edge");
+										XCPRINTF(s, "snapping left edge to other window right edge");
 										n.w += n.x - sx2;
 										data[0] = sx2;
 										x_snapping = True;
 									} else if (sr && (abs(nx2 - s->c.x) < snap)) {
-										XPRINTF(s, "snapping right edge to other window left edge");
+										XCPRINTF(s, "snapping right edge to other window left edge");
 										n.w += s->c.x - nx2;
 										data[0] = s->c.x;
 										x_snapping = True;
@@ -4758,12 +4758,12 @@ mouseresize_from(Client *c, int from, XEvent *e, Bool toggle)
 									continue;
 								if (wind_overlap(n.y, ny2, s->c.y, sy2)) {
 									if (sl && (abs(n.x - s->c.x) < snap)) {
-										XPRINTF(s, "snapping left edge to other window left edge");
+										XCPRINTF(s, "snapping left edge to other window left edge");
 										n.w += n.x - s->c.x;
 										data[0] = s->c.x;
 										x_snapping = True;
 									} else if (sr && (abs(nx2 - sx2) < snap)) {
-										XPRINTF(s, "snapping right edge to other window right edge");
+										XCPRINTF(s, "snapping right edge to other window right edge");
 										n.w += sx2 - nx2;
 										data[0] = sx2;
 										x_snapping = True;
@@ -4806,12 +4806,12 @@ mouseresize_from(Client *c, int from, XEvent *e, Bool toggle)
 									continue;
 								if (wind_overlap(n.x, nx2, s->c.x, sx2)) {
 									if (st && (abs(n.y - sy2) < snap)) {
-										XPRINTF(s, "snapping top edge to other window bottom edge");
+										XCPRINTF(s, "snapping top edge to other window bottom edge");
 										n.h += n.y - sy2;
 										data[1] = sy2;
 										y_snapping = True;
 									} else if (sb && (abs(ny2 - s->c.y) < snap)) {
-										XPRINTF(s, "snapping bottom edge to other window top edge");
+										XCPRINTF(s, "snapping bottom edge to other window top edge");
 										n.h += s->c.y - ny2;
 										data[1] = s->c.y;
 										y_snapping = True;
@@ -4828,12 +4828,12 @@ mouseresize_from(Client *c, int from, XEvent *e, Bool toggle)
 									continue;
 								if (wind_overlap(n.x, nx2, s->c.x, sx2)) {
 									if (st && (abs(n.y - s->c.y) < snap)) {
-										XPRINTF(s, "snapping top edge to other window top edge");
+										XCPRINTF(s, "snapping top edge to other window top edge");
 										n.h += n.y - s->c.y;
 										data[1] = s->c.y;
 										y_snapping = True;
 									} else if (sb && (abs(ny2 - sy2) < snap)) {
-										XPRINTF(s, "snapping bottom edge to other window bottom edge");
+										XCPRINTF(s, "snapping bottom edge to other window bottom edge");
 										n.h += sy2 - ny2;
 										data[1] = sy2;
 										y_snapping = True;
@@ -5259,7 +5259,7 @@ configureclient(Client *c, XEvent *e, int gravity)
 	    restack = False;
 	View *v;
 
-	XPRINTF(c, "request to configure client\n");
+	XCPRINTF(c, "request to configure client\n");
 	if (ev->value_mask & CWX)
 		XPRINTF("x = %d\n", ev->x);
 	if (ev->value_mask & CWY)
@@ -5345,14 +5345,14 @@ configureclient(Client *c, XEvent *e, int gravity)
 		if (restack)
 			restack_client(c, stack_mode, o);
 		if (move) {
-			XPRINTF(&c->c, "before setframereference\n");
+			XGPRINTF(&c->c, "before setframereference\n");
 			setframereference(c, xr, yr, &g, &n, gravity);
-			XPRINTF(&n, "after setframereference\n");
+			XGPRINTF(&n, "after setframereference\n");
 			reconfigure(c, &n, notify);
 		} else {
-			XPRINTF(&c->c, "before putframereference\n");
+			XGPRINTF(&c->c, "before putframereference\n");
 			putframereference(c, xr, yr, &g, &n, gravity);
-			XPRINTF(&n, "after putframereference\n");
+			XGPRINTF(&n, "after putframereference\n");
 			reconfigure(c, &n, notify);
 		}
 		/* need to set for restore geometries that were changed */
@@ -5828,21 +5828,19 @@ place(Client *c, WindowPlacement p)
 	c->r.y = g.y;
 }
 
+/* returns interned strings that the caller must unintern() */
 Bool
-getclientstrings(Client *c, char **name, char **clas, char **cmd)
+getclientstrings(Client *c, const char **name, const char **clas, const char **cmd)
 {
 	char **argv = NULL;
 	int argc = 0;
-	char *str = NULL, *nam = NULL, *cls = NULL;
+	char *str = NULL;
+	const char *nam, *cls;
 	int i;
 	size_t tot = 0;
 
-	if (c->ch.res_name || c->ch.res_class) {
-		if (c->ch.res_name)
-			nam = strdup(c->ch.res_name);
-		if (c->ch.res_class)
-			cls = strdup(c->ch.res_class);
-	}
+	nam = intern(c->ch.res_name);
+	cls = intern(c->ch.res_class);
 	*name = nam;
 	*clas = cls;
 	if (getcommand(c, &argv, &argc)) {
@@ -5886,12 +5884,13 @@ getclientstrings(Client *c, char **name, char **clas, char **cmd)
 		if (argv)
 			XFreeStringList(argv);
 	}
-	*cmd = str;
-	return ((nam || cls || str) ? True : False);
+	*cmd = intern(str);
+	free(str);
+	return ((nam || cls || *cmd) ? True : False);
 }
 
 static Leaf *
-findleaf(Container *n, char *res_name, char *res_class, char *wm_command)
+findleaf(Container *n, const char *res_name, const char *res_class, const char *wm_command)
 {
 	Leaf *l = NULL;
 	Container *c;
@@ -5906,17 +5905,18 @@ findleaf(Container *n, char *res_name, char *res_class, char *wm_command)
 	case TreeTypeLeaf:
 		if (n->leaf.client.client)
 			break;
-		if (n->leaf.client.res_name && res_name && strcmp(n->leaf.client.res_name, res_name))
+		/* strings are interned */
+		if (n->leaf.client.res_name && res_name && n->leaf.client.res_name != res_name)
 			break;
-		if (n->leaf.client.res_class && res_class && strcmp(n->leaf.client.res_class, res_class))
+		if (n->leaf.client.res_class && res_class && n->leaf.client.res_class != res_class)
 			break;
 #if 0
-		if (n->leaf.client.wm_name && wm_name && strcmp(n->leaf.client.wm_name, wm_name))
+		if (n->leaf.client.wm_name && wm_name && n->leaf.client.wm_name != wm_name)
 			break;
-		if (n->leaf.client.wm_role && wm_role && strcmp(n->leaf.client.wm_role, wm_role))
+		if (n->leaf.client.wm_role && wm_role && n->leaf.client.wm_role != wm_role)
 			break;
 #endif
-		if (n->leaf.client.wm_command && wm_command && strcmp(n->leaf.client.wm_command, wm_command))
+		if (n->leaf.client.wm_command && wm_command && n->leaf.client.wm_command != wm_command)
 			break;
 		l = &n->leaf;
 		break;
@@ -6017,7 +6017,7 @@ adddockapp(Client *c)
 {
 	Container *t, *n;
 	Leaf *l = NULL;
-	char *res_name = NULL, *res_class = NULL, *wm_command = NULL;
+	const char *res_name = NULL, *res_class = NULL, *wm_command = NULL;
 
 	if (!(t = scr->dock.tree)) {
 		XPRINTF("WARNING: no dock tree!\n");
@@ -6047,23 +6047,27 @@ adddockapp(Client *c)
 	l->client.next = c->leaves;
 	c->leaves = l;
 	if (res_name) {
-		free(l->client.res_name);
+		unintern(l->client.res_name);
 		l->client.res_name = res_name;
 	}
 	if (res_class) {
-		free(l->client.res_class);
+		unintern(l->client.res_class);
 		l->client.res_class = res_class;
 	}
 	if (c->wm_name) {
-		free(l->client.wm_name);
-		l->client.wm_name = strdup(c->wm_name);
+		const char *old = l->client.wm_name;
+
+		l->client.wm_name = intern(c->wm_name);
+		unintern(old);
 	}
 	if (c->wm_role) {
-		free(l->client.wm_role);
-		l->client.wm_role = strdup(c->wm_role);
+		const char *old = l->client.wm_role;
+
+		l->client.wm_role = intern(c->wm_role);
+		unintern(old);
 	}
 	if (wm_command) {
-		free(l->client.wm_command);
+		unintern(l->client.wm_command);
 		l->client.wm_command = wm_command;
 	}
 }
@@ -6073,13 +6077,13 @@ addclient(Client *c, Bool choseme, Bool focusme, Bool raiseme)
 {
 	View *v;
 
-	XPRINTF(c, "initial geometry c: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "initial geometry c: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->c.w, c->c.h, c->c.x, c->c.y, c->c.b, c->c.t, c->c.g, c->c.v);
-	XPRINTF(c, "initial geometry r: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "initial geometry r: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->r.w, c->r.h, c->r.x, c->r.y, c->r.b, c->c.t, c->c.g, c->c.v);
-	XPRINTF(c, "initial geometry s: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "initial geometry s: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->s.w, c->s.h, c->s.x, c->s.y, c->s.b, c->c.t, c->c.g, c->c.v);
-	XPRINTF(c, "initial geometry u: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "initial geometry u: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->u.w, c->u.h, c->u.x, c->u.y, c->u.b, c->c.t, c->c.g, c->c.v);
 
 	if (!c->u.x && !c->u.y && c->can.move && !c->is.dockapp) {
@@ -6090,13 +6094,13 @@ addclient(Client *c, Bool choseme, Bool focusme, Bool raiseme)
 		place(c, ColSmartPlacement);
 	}
 
-	XPRINTF(c, "placed geometry c: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "placed geometry c: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->c.w, c->c.h, c->c.x, c->c.y, c->c.b, c->c.t, c->c.g, c->c.h);
-	XPRINTF(c, "placed geometry r: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "placed geometry r: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->r.w, c->r.h, c->r.x, c->r.y, c->r.b, c->c.t, c->c.g, c->c.h);
-	XPRINTF(c, "placed geometry s: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "placed geometry s: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->s.w, c->s.h, c->s.x, c->s.y, c->s.b, c->c.t, c->c.g, c->c.h);
-	XPRINTF(c, "initial geometry u: %dx%d+%d+%d:%d t %d g %d v %d\n",
+	XCPRINTF(c, "initial geometry u: %dx%d+%d+%d:%d t %d g %d v %d\n",
 		c->u.w, c->u.h, c->u.x, c->u.y, c->u.b, c->c.t, c->c.g, c->c.v);
 
 	if (!c->can.move) {
@@ -129,7 +129,7 @@ void insleaf(Container *cp, Leaf *l, Bool active);
 void delnode(Container *cc);
 void appnode(Container *cp, Container *cc);
 void insnode(Container *cp, Container *cc);
-Bool getclientstrings(Client *c, char **name, char **clas, char **cmd);
+Bool getclientstrings(Client *c, const char **name, const char **clas, const char **cmd);
 Container *adddocknode(Container *t);
 
 extern Layout layouts[];
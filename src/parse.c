@@ -4,6 +4,7 @@
 #include "layout.h"
 #include "tags.h"
 #include "actions.h"
+#include "keytab.h"
 #include "parse.h" /* verification */
 
 typedef struct {
@@ -392,6 +393,7 @@ addchain(Key *k)
 {
 	Key **kp;
 
+	unhashkeys();
 	XPRINTF("Adding chain: %s ...\n", showchain(k));
 	for (kp = &scr->keylist; *kp; kp = &(*kp)->cnext)
 		if ((*kp)->mod == k->mod && (*kp)->keysym == k->keysym)
@@ -588,6 +590,7 @@ freekeys(void)
 {
 	Key *k, *knext;
 
+	unhashkeys();
 	knext = scr->keylist;
 	scr->keylist = NULL;
 	while ((k = knext)) {
@@ -1018,6 +1021,28 @@ parserule(const char *s, Rule *r)
 	r->has.set.grips = 1;
 }
 
+/* literal prefix that any string matching an anchored extended regular
+ * expression must start with (or NULL) */
+static char *
+literalprefix(const char *pat, size_t *lenp)
+{
+	const char *p;
+	size_t len;
+	char *prefix;
+
+	if (*pat != '^' || strchr(pat, '|'))
+		return (NULL);
+	for (p = pat + 1; *p && !strchr(".[]()*+?{}\\^$", *p); p++) ;
+	len = p - (pat + 1);
+	if (len && *p && strchr("*?{", *p))
+		len--;		/* last character is optional */
+	if (!len)
+		return (NULL);
+	prefix = strndup(pat + 1, len);
+	*lenp = len;
+	return (prefix);
+}
+
 static void
 compileregs(void)
 {
@@ -1029,8 +1054,11 @@ compileregs(void)
 			reg = emallocz(sizeof(regex_t));
 			if (regcomp(reg, rules[i]->prop, REG_EXTENDED))
 				free(reg);
-			else
+			else {
 				rules[i]->propregex = reg;
+				rules[i]->prefix = literalprefix(rules[i]->prop,
+								 &rules[i]->prefixlen);
+			}
 		}
 		if (rules[i]->tags && strcmp(rules[i]->tags, "NULL")) {
 			reg = emallocz(sizeof(regex_t));
@@ -1040,6 +1068,7 @@ compileregs(void)
 				rules[i]->tagregex = reg;
 		}
 	}
+	invalidaterules();
 }
 
 static void
@@ -1060,11 +1089,14 @@ freerules(void)
 		rules[i]->prop = NULL;
 		free(rules[i]->tags);
 		rules[i]->tags = NULL;
+		free(rules[i]->prefix);
+		rules[i]->prefix = NULL;
 		free(rules[i]);
 		rules[i] = NULL;
 	}
 	free(rules);
 	rules = NULL;
+	nrules = 0;
 }
 
 void
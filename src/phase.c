@@ -0,0 +1,209 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "phase.h" /* verification */
+
+/*
+ * Inputs of the initialization phases, for differential reload.  While a
+ * phase runs, every resource that it looks up (name, class and the value
+ * found) and every file that it reads (modification time and size) is
+ * recorded.  On reload, once the new resource database has been read, the
+ * lookups of each phase are repeated against it: when each finds the same
+ * value as before and no file has changed, the phase would do exactly what it
+ * did the last time, and initialize() skips it.  The values are kept (interned)
+ * and compared as strings, so that no collision can skip a phase.
+ *
+ * Phases that run for each screen are recorded separately for each screen.
+ */
+
+typedef struct {
+	const char *name;		/* resource name or file path (interned) */
+	const char *clas;		/* resource class (interned), NULL for a file */
+	const char *value;		/* value found or file stamp (interned), or NULL */
+} PhaseDep;
+
+typedef struct PhaseRec PhaseRec;
+
+struct PhaseRec {
+	PhaseRec *next;
+	InitPhase phase;
+	int screen;			/* -1 for global phases */
+	unsigned ndeps, size;
+	PhaseDep *deps;
+};
+
+static PhaseRec *records = NULL;
+static PhaseRec *current = NULL;	/* being recorded */
+static InitPhase curphase = PhaseNone;
+
+static int
+phasescreen(InitPhase phase)
+{
+	switch (phase) {
+	case PhaseConfig:
+	case PhaseRules:
+	case PhaseIcons:
+		return (-1);
+	default:
+		return (scr ? scr->screen : -1);
+	}
+}
+
+static PhaseRec *
+findphase(InitPhase phase, int screen)
+{
+	PhaseRec *r;
+
+	for (r = records; r; r = r->next)
+		if (r->phase == phase && r->screen == screen)
+			break;
+	return (r);
+}
+
+static void
+clearphase(PhaseRec *r)
+{
+	unsigned i;
+
+	for (i = 0; i < r->ndeps; i++) {
+		unintern(r->deps[i].name);
+		unintern(r->deps[i].clas);
+		unintern(r->deps[i].value);
+	}
+	r->ndeps = 0;
+}
+
+/* a resource that is not found is different from one that is empty */
+static Bool
+samevalue(const char *a, const char *b)
+{
+	if (!a || !b)
+		return (a == b);
+	return (!strcmp(a, b));
+}
+
+static const char *
+filestamp(const char *path, char *buf, size_t len)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return (NULL);
+	snprintf(buf, len, "%lld.%09ld:%lld", (long long) st.st_mtim.tv_sec,
+		 st.st_mtim.tv_nsec, (long long) st.st_size);
+	return (buf);
+}
+
+static void
+adddep(const char *name, const char *clas, const char *value)
+{
+	PhaseRec *r = current;
+
+	if (r->ndeps >= r->size) {
+		r->size = r->size ? r->size << 1 : 64;
+		r->deps = erealloc(r->deps, r->size * sizeof(*r->deps));
+	}
+	r->deps[r->ndeps].name = intern(name);
+	r->deps[r->ndeps].clas = intern(clas);
+	r->deps[r->ndeps].value = intern(value);
+	r->ndeps++;
+}
+
+/* record the lookup of a resource by the phase that is running, if any */
+void
+phaseres(const char *name, const char *clas, const char *value)
+{
+	if (current)
+		adddep(name, clas, value);
+}
+
+/* record the reading of a file by the phase that is running, if any */
+void
+phasefile(const char *path)
+{
+	char buf[64];
+
+	if (current)
+		adddep(path, NULL, filestamp(path, buf, sizeof(buf)));
+}
+
+/*
+ * Starts recording the inputs of a phase (for the current screen when it is
+ * run per screen), replacing those recorded the last time it ran.  Returns
+ * the phase that was being recorded, to be passed to endphase().
+ */
+InitPhase
+beginphase(InitPhase phase)
+{
+	InitPhase prev = curphase;
+	int screen = phasescreen(phase);
+	PhaseRec *r;
+
+	if (!(r = findphase(phase, screen))) {
+		r = ecalloc(1, sizeof(*r));
+		r->phase = phase;
+		r->screen = screen;
+		r->next = records;
+		records = r;
+	}
+	clearphase(r);
+	curphase = phase;
+	current = r;
+	return (prev);
+}
+
+void
+endphase(InitPhase prev)
+{
+	curphase = prev;
+	current = (prev != PhaseNone) ? findphase(prev, phasescreen(prev)) : NULL;
+}
+
+/*
+ * Tells whether the phase would now find different inputs than the last time
+ * that it ran: always when it has not run yet.
+ */
+Bool
+phasechanged(InitPhase phase)
+{
+	PhaseRec *r;
+	XrmValue value;
+	char *type, buf[64];
+	const char *now;
+	unsigned i;
+
+	if (!(r = findphase(phase, phasescreen(phase))))
+		return True;
+	for (i = 0; i < r->ndeps; i++) {
+		PhaseDep *d = r->deps + i;
+
+		if (d->clas) {
+			value.addr = NULL;
+			if (!XrmGetResource(xrdb, d->name, d->clas, &type, &value))
+				value.addr = NULL;
+			now = value.addr;
+		} else
+			now = filestamp(d->name, buf, sizeof(buf));
+		if (!samevalue(now, d->value)) {
+			DPRINTF("phase %d of screen %d changed: %s (input %u of %u)\n", phase,
+				r->screen, d->name, i + 1, r->ndeps);
+			return True;
+		}
+	}
+	return False;
+}
+
+void
+freephases(void)
+{
+	PhaseRec *r;
+
+	while ((r = records)) {
+		records = r->next;
+		clearphase(r);
+		free(r->deps);
+		free(r);
+	}
+	current = NULL;
+	curphase = PhaseNone;
+}
@@ -0,0 +1,13 @@
+/* phase.c */
+
+#ifndef __LOCAL_PHASE_H__
+#define __LOCAL_PHASE_H__
+
+InitPhase beginphase(InitPhase phase);
+void endphase(InitPhase prev);
+void phaseres(const char *name, const char *clas, const char *value);
+void phasefile(const char *path);
+Bool phasechanged(InitPhase phase);
+void freephases(void);
+
+#endif				/* __LOCAL_PHASE_H__ */
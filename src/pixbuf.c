@@ -8,6 +8,7 @@
 #include "config.h"
 #include "icons.h"
 #include "draw.h"
+#include "image.h"
 #if 1
 #include "ximage.h"
 #else
@@ -251,7 +252,7 @@ pixbuf_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying bitmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -301,7 +302,7 @@ pixbuf_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying pixmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -500,7 +501,7 @@ pixbuf_drawdockapp(AScreen *ds, Client *c)
 			ds->dc.x, ds->dc.y, ds->dc.w, ds->dc.h);
 	if (!status)
 		XPRINTF("Could not fill rectangle, error %d\n", status);
-	XPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
+	XCPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
 		ds->dc.y);
 	/* note that ParentRelative dockapps need the background set to the foregroudn */
 	XSetWindowBackground(dpy, c->frame, pixel);
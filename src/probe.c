@@ -0,0 +1,202 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "probe.h" /* verification */
+
+/*
+ * Image dimensions from file headers alone.  Choosing between several
+ * candidate icon files only needs their sizes, so rather than decoding each
+ * one with whichever image library is built in, the format is sniffed from
+ * the first few bytes and the dimensions are read from the header: the IHDR
+ * chunk of a PNG, the values line of an XPM, the #define lines of an XBM,
+ * the width, height or viewBox of the outer <svg> element and the SOF
+ * marker of a JPEG.  Its one caller, _FindAnyIconHelper() in icons.c, is on
+ * the unindexed directory scan, which is currently disabled.
+ */
+
+#define PROBESIZE 4096			/* bytes examined for text formats */
+
+static unsigned
+be16(const unsigned char *p)
+{
+	return ((p[0] << 8) | p[1]);
+}
+
+static unsigned
+be32(const unsigned char *p)
+{
+	return (((unsigned) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+static Bool
+probepng(const unsigned char *buf, size_t len, unsigned *w, unsigned *h)
+{
+	if (len < 24 || memcmp(buf + 12, "IHDR", 4))
+		return False;
+	*w = be32(buf + 16);
+	*h = be32(buf + 20);
+	return True;
+}
+
+static Bool
+probejpeg(FILE *f, unsigned *w, unsigned *h)
+{
+	unsigned char seg[7];
+	unsigned marker, len;
+	int c;
+
+	if (fseek(f, 2, SEEK_SET))
+		return False;
+	for (;;) {
+		if ((c = getc(f)) != 0xff)
+			return False;
+		while ((c = getc(f)) == 0xff) ;
+		if (c == EOF)
+			return False;
+		marker = c;
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7))
+			continue;	/* no length */
+		if (marker == 0xd9 || marker == 0xda)
+			return False;	/* end of image or start of scan */
+		if (fread(seg, 1, 2, f) != 2 || (len = be16(seg)) < 2)
+			return False;
+		if (marker >= 0xc0 && marker <= 0xcf &&
+		    marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+			if (len < 7 || fread(seg, 1, 5, f) != 5)
+				return False;
+			*h = be16(seg + 1);
+			*w = be16(seg + 3);
+			return True;
+		}
+		if (fseek(f, len - 2, SEEK_CUR))
+			return False;
+	}
+}
+
+static Bool
+probexpm(const char *buf, unsigned *w, unsigned *h)
+{
+	const char *p;
+
+	/* the first string is "width height ncolors chars_per_pixel ..." */
+	if (!(p = strchr(buf, '"')))
+		return False;
+	return (sscanf(p + 1, "%u %u", w, h) == 2);
+}
+
+static Bool
+probexbm(const char *buf, unsigned *w, unsigned *h)
+{
+	const char *p;
+	char name[64];
+	unsigned v;
+	int found = 0;
+
+	for (p = buf; (p = strstr(p, "#define")); p++) {
+		if (sscanf(p, "#define %63s %u", name, &v) != 2)
+			continue;
+		if (strlen(name) >= 6 && !strcmp(name + strlen(name) - 6, "_width")) {
+			*w = v;
+			found |= 1;
+		} else
+		if (strlen(name) >= 7 && !strcmp(name + strlen(name) - 7, "_height")) {
+			*h = v;
+			found |= 2;
+		}
+	}
+	return (found == 3);
+}
+
+/* value of a quoted attribute in the tag starting at tag */
+static const char *
+svgattr(const char *tag, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p;
+
+	for (p = tag; *p && *p != '>'; p++) {
+		if (!isspace((unsigned char) *p) || strncmp(p + 1, name, len))
+			continue;
+		p += len + 1;
+		while (isspace((unsigned char) *p))
+			p++;
+		if (*p != '=')
+			continue;
+		for (p++; isspace((unsigned char) *p); p++) ;
+		if (*p == '"' || *p == '\'')
+			return (p + 1);
+	}
+	return (NULL);
+}
+
+/* a length in user units or pixels; relative units do not give a size */
+static Bool
+svglength(const char *p, unsigned *v)
+{
+	char *e;
+	double d;
+
+	if (!p || (d = strtod(p, &e)) <= 0 || e == p)
+		return False;
+	if (*e != '"' && *e != '\'' && strncmp(e, "px", 2))
+		return False;
+	*v = d + 0.5;
+	return True;
+}
+
+static Bool
+probesvg(const char *buf, unsigned *w, unsigned *h)
+{
+	const char *tag, *p;
+	double vb[4];
+
+	if (!(tag = strstr(buf, "<svg")))
+		return False;
+	if (svglength(svgattr(tag, "width"), w) && svglength(svgattr(tag, "height"), h))
+		return True;
+	if ((p = svgattr(tag, "viewBox")) &&
+	    sscanf(p, "%lf%*[ ,]%lf%*[ ,]%lf%*[ ,]%lf", &vb[0], &vb[1], &vb[2], &vb[3]) == 4 &&
+	    vb[2] > 0 && vb[3] > 0) {
+		*w = vb[2] + 0.5;
+		*h = vb[3] + 0.5;
+		return True;
+	}
+	return False;
+}
+
+/*
+ * Fills in the width and height of the image in file, reading no more of it
+ * than the header.  Returns False when the format is not recognized or the
+ * header does not give a size (e.g. an SVG sized in percent).
+ */
+Bool
+probeimage(const char *file, unsigned *width, unsigned *height)
+{
+	char buf[PROBESIZE + 1];
+	unsigned char *ubuf = (unsigned char *) buf;
+	unsigned w = 0, h = 0;
+	Bool result = False;
+	size_t len;
+	FILE *f;
+
+	if (!(f = fopen(file, "rb")))
+		return False;
+	len = fread(buf, 1, PROBESIZE, f);
+	buf[len] = '\0';
+	if (len >= 8 && !memcmp(buf, "\x89PNG\r\n\x1a\n", 8))
+		result = probepng(ubuf, len, &w, &h);
+	else if (len >= 3 && ubuf[0] == 0xff && ubuf[1] == 0xd8 && ubuf[2] == 0xff)
+		result = probejpeg(f, &w, &h);
+	else if (strstr(buf, "/* XPM */"))
+		result = probexpm(buf, &w, &h);
+	else if (strstr(buf, "<svg"))
+		result = probesvg(buf, &w, &h);
+	else if (strstr(buf, "#define"))
+		result = probexbm(buf, &w, &h);
+	fclose(f);
+	if (!result || !w || !h)
+		return False;
+	*width = w;
+	*height = h;
+	return True;
+}
@@ -0,0 +1,8 @@
+/* probe.c */
+
+#ifndef __LOCAL_PROBE_H__
+#define __LOCAL_PROBE_H__
+
+Bool probeimage(const char *file, unsigned *width, unsigned *height);
+
+#endif				/* __LOCAL_PROBE_H__ */
@@ -0,0 +1,195 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <X11/Xlibint.h>
+#include "prof.h" /* verification */
+
+/*
+ * Startup and reload profile.  Each step of initialize(), the scan of
+ * existing windows and startup and reload as a whole are recorded as spans
+ * with their monotonic start time and duration, the X requests issued, the
+ * round trips made (replies waited for), the allocations made through
+ * ecalloc() and erealloc() and the change in heap use.  Recording is always
+ * on (it costs a few dozen spans per start or reload); the spans are written
+ * as a Chrome trace (JSON, loadable in chrome://tracing or Perfetto) when a
+ * file is given with -p or --profile, or with the profile resource, after
+ * startup and after every reload.  Each reload replaces the spans of the one
+ * before it, so that the profile holds startup and the last reload however
+ * long adwm runs.  Allocations are counted atomically, as the icon decoding
+ * threads allocate too: their allocations count towards whichever spans are
+ * open at the time.
+ */
+
+#define PROFSPANS	4096		/* spans kept */
+#define PROFDEPTH	16		/* nesting of spans */
+
+typedef struct {
+	const char *name;
+	int screen;			/* -1 when not per screen */
+	int depth;
+	int64_t start, end;		/* ns since the process started */
+	unsigned long requests, replies, allocs;
+	long heap;			/* change in bytes */
+} ProfSpan;
+
+static ProfSpan spans[PROFSPANS];
+static unsigned nspans = 0;
+static unsigned nstartup = 0;		/* spans of startup, kept over reloads */
+static unsigned stack[PROFDEPTH];
+static int depth = 0;
+static struct timespec epoch;
+static char *proffile = NULL;
+
+unsigned long profallocs = 0;		/* counted (atomically) by ecalloc() and erealloc() */
+unsigned long profreplies = 0;		/* counted by _XReply() */
+
+/* counts round trips: libX11 calls _XReply() for every reply it waits for */
+Status
+_XReply(Display *d, xReply *rep, int extra, Bool discard)
+{
+	static Status (*real) (Display *, xReply *, int, Bool) = NULL;
+
+	if (!real && !(real = (typeof(real)) dlsym(RTLD_NEXT, "_XReply")))
+		eprint("fatal: could not find _XReply()\n");
+	profreplies++;
+	return real(d, rep, extra, discard);
+}
+
+static int64_t
+profnow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((int64_t) (now.tv_sec - epoch.tv_sec) * 1000000000 +
+		(now.tv_nsec - epoch.tv_nsec));
+}
+
+static long
+profheap(void)
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+
+	return ((long) mi.uordblks + (long) mi.hblkhd);
+#else
+	return (0);
+#endif
+}
+
+/* called first thing in main() */
+void
+initprof(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+}
+
+void
+profoutput(const char *file)
+{
+	free(proffile);
+	proffile = file ? strdup(file) : NULL;
+}
+
+void
+profbegin(const char *name, int screen)
+{
+	ProfSpan *s;
+
+	if (depth >= PROFDEPTH) {
+		depth++;
+		return;
+	}
+	if (nspans >= PROFSPANS) {
+		if (nspans++ == PROFSPANS)
+			EPRINTF("profile full: no longer recording\n");
+		stack[depth++] = PROFSPANS;
+		return;
+	}
+	s = spans + nspans;
+	s->name = name;
+	s->screen = screen;
+	s->depth = depth;
+	s->requests = dpy ? NextRequest(dpy) : 0;
+	s->replies = profreplies;
+	s->allocs = __atomic_load_n(&profallocs, __ATOMIC_RELAXED);
+	s->heap = profheap();
+	s->start = profnow();
+	s->end = -1;
+	stack[depth++] = nspans++;
+}
+
+void
+profend(void)
+{
+	ProfSpan *s;
+
+	if (depth <= 0)
+		return;
+	if (--depth >= PROFDEPTH || stack[depth] >= PROFSPANS)
+		return;
+	s = spans + stack[depth];
+	s->end = profnow();
+	s->requests = (dpy ? NextRequest(dpy) : 0) - s->requests;
+	s->replies = profreplies - s->replies;
+	s->allocs = __atomic_load_n(&profallocs, __ATOMIC_RELAXED) - s->allocs;
+	s->heap = profheap() - s->heap;
+	if (!s->depth && !nstartup)
+		nstartup = min(nspans, (unsigned) PROFSPANS);
+	if (!s->depth)
+		OPRINTF("%s took %.3f ms: %lu requests, %lu round trips, %lu allocations\n",
+			s->name, (s->end - s->start) / 1000000.0, s->requests, s->replies,
+			s->allocs);
+}
+
+/* discard the spans of the previous reload: called before a reload begins */
+void
+profreset(void)
+{
+	if (!depth && nstartup)
+		nspans = nstartup;
+}
+
+/* write the spans recorded so far, if asked to */
+void
+profwrite(void)
+{
+	const char *file = proffile ? : getresource("profile", NULL);
+	char tmp[PATH_MAX + 1];
+	unsigned i, w, n = min(nspans, (unsigned) PROFSPANS);
+	ProfSpan *s;
+	FILE *f;
+
+	if (!file || !*file)
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", file, (int) getpid());
+	if (!(f = fopen(tmp, "w"))) {
+		EPRINTF("could not write profile %s: %s\n", tmp, strerror(errno));
+		return;
+	}
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (i = 0, w = 0; i < n; i++) {
+		s = spans + i;
+		if (s->end < 0)
+			continue;	/* still open */
+		fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,"
+			"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"requests\":%lu,\"roundtrips\":%lu,"
+			"\"allocs\":%lu,\"heap\":%ld", w++ ? "," : "", s->name,
+			s->screen < 0 ? "global" : "screen", (int) getpid(), s->start / 1000.0,
+			(s->end - s->start) / 1000.0, s->requests, s->replies, s->allocs, s->heap);
+		if (s->screen >= 0)
+			fprintf(f, ",\"screen\":%d", s->screen);
+		fprintf(f, "}}\n");
+	}
+	fprintf(f, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"version\":\"adwm %s\"}}\n",
+		VERSION);
+	if (fclose(f) || rename(tmp, file)) {
+		EPRINTF("could not write profile %s: %s\n", file, strerror(errno));
+		unlink(tmp);
+		return;
+	}
+	OPRINTF("wrote profile of %u spans to %s\n", w, file);
+}
@@ -0,0 +1,16 @@
+/* prof.c */
+
+#ifndef __LOCAL_PROF_H__
+#define __LOCAL_PROF_H__
+
+extern unsigned long profallocs;
+extern unsigned long profreplies;
+
+void initprof(void);
+void profoutput(const char *file);
+void profbegin(const char *name, int screen);
+void profend(void);
+void profreset(void);
+void profwrite(void);
+
+#endif				/* __LOCAL_PROF_H__ */
@@ -0,0 +1,1213 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include <sys/resource.h>
+#include <X11/Xlibint.h>
+#include "evstat.h"
+#include "prof.h"
+#include "record.h" /* verification */
+
+/*
+ * Event recording and replay.  With -R, every event that adwm takes from the
+ * queue is written to a file, whichever function takes it: libX11 calls
+ * _XDeq() for each of them.  When an event is handled, the windows that it
+ * refers to and that were not seen before are written with their attributes
+ * and properties, and so is the new value of a changed property, before the
+ * handler can read them.  Windows of adwm are written as the client and which
+ * of its windows they are.  The windows that exist when recording starts are
+ * written first.
+ *
+ * With -P, adwm replays such a file instead of handling the events from the
+ * server, which are dropped in _XEnq().  A second connection creates stand-in
+ * windows for those of the clients, with their recorded attributes and
+ * properties, and makes the recorded changes to them.  A recorded event is
+ * appended to the queue wherever libX11 would read events from the server,
+ * in the order in which they were taken, with the windows, atoms, keycodes
+ * and times translated for this server.  When all have been handled, the
+ * time taken is printed and the event statistics are written (see
+ * evstat.c): replaying the same recording with two builds compares them.
+ */
+
+#define QUEUED		256		/* recorded events in the queue that are tracked */
+
+typedef struct {
+	Window rec;			/* the window when recorded */
+	Window win;			/* its stand-in */
+	Bool override;
+	Bool gone;			/* destroyed */
+} Standin;
+
+int recording = 0;
+int replaying = 0;
+
+static char *recordfile = NULL;
+static char *replayfile = NULL;
+
+static FILE *rec = NULL;
+static struct timespec recstart;
+static unsigned long taken = 0;		/* events taken from the queue */
+static XContext seenwindow, seenatom;
+
+static Display *sdpy = NULL;		/* owns the stand-ins */
+static Bool dirty = False;		/* stand-ins changed since the last sync */
+static char *buf = NULL;
+static RecordHead **events = NULL, **changes = NULL;
+static RecordWindowData **initial = NULL;
+static unsigned nevents = 0, nchanges = 0, ninitial = 0;
+static unsigned nextevent = 0, nextchange = 0;
+static unsigned current = 0;		/* events taken, as numbered when recorded */
+static XContext standins, bystandin, owned, windows, atoms;
+static Window *recroots = NULL;
+static int nrecroots = 0;
+static struct {
+	int event;			/* first event when recorded */
+	int base;			/* index into einfo[] */
+} exts[BaseLast];
+static int nexts = 0;
+static KeyCode keycodes[256];
+static struct {
+	_XQEvent *qelt;
+	unsigned index;
+} queued[QUEUED];
+static unsigned nqueued = 0;
+static Time timebase;			/* server time when the replay started */
+static struct timespec replaystart;
+static Bool started = False;
+static struct timespec wallstart;
+static struct rusage usagestart;
+static unsigned long requeststart, replystart;
+
+static size_t
+eventsize(int type)
+{
+	switch (type) {
+	case KeyPress:
+	case KeyRelease:
+		return sizeof(XKeyEvent);
+	case ButtonPress:
+	case ButtonRelease:
+		return sizeof(XButtonEvent);
+	case MotionNotify:
+		return sizeof(XMotionEvent);
+	case EnterNotify:
+	case LeaveNotify:
+		return sizeof(XCrossingEvent);
+	case FocusIn:
+	case FocusOut:
+		return sizeof(XFocusChangeEvent);
+	case KeymapNotify:
+		return sizeof(XKeymapEvent);
+	case Expose:
+		return sizeof(XExposeEvent);
+	case GraphicsExpose:
+		return sizeof(XGraphicsExposeEvent);
+	case NoExpose:
+		return sizeof(XNoExposeEvent);
+	case VisibilityNotify:
+		return sizeof(XVisibilityEvent);
+	case CreateNotify:
+		return sizeof(XCreateWindowEvent);
+	case DestroyNotify:
+		return sizeof(XDestroyWindowEvent);
+	case UnmapNotify:
+		return sizeof(XUnmapEvent);
+	case MapNotify:
+		return sizeof(XMapEvent);
+	case MapRequest:
+		return sizeof(XMapRequestEvent);
+	case ReparentNotify:
+		return sizeof(XReparentEvent);
+	case ConfigureNotify:
+		return sizeof(XConfigureEvent);
+	case ConfigureRequest:
+		return sizeof(XConfigureRequestEvent);
+	case GravityNotify:
+		return sizeof(XGravityEvent);
+	case ResizeRequest:
+		return sizeof(XResizeRequestEvent);
+	case CirculateNotify:
+		return sizeof(XCirculateEvent);
+	case CirculateRequest:
+		return sizeof(XCirculateRequestEvent);
+	case PropertyNotify:
+		return sizeof(XPropertyEvent);
+	case SelectionClear:
+		return sizeof(XSelectionClearEvent);
+	case SelectionRequest:
+		return sizeof(XSelectionRequestEvent);
+	case SelectionNotify:
+		return sizeof(XSelectionEvent);
+	case ColormapNotify:
+		return sizeof(XColormapEvent);
+	case ClientMessage:
+		return sizeof(XClientMessageEvent);
+	case MappingNotify:
+		return sizeof(XMappingEvent);
+	default:
+		return sizeof(XEvent);
+	}
+}
+
+/* the fields of a core event that hold windows */
+static int
+eventwindows(XEvent *ev, Window *w[4])
+{
+	int n = 0;
+
+	w[n++] = &ev->xany.window;
+	switch (ev->type) {
+	case KeyPress:
+	case KeyRelease:
+		w[n++] = &ev->xkey.root;
+		w[n++] = &ev->xkey.subwindow;
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		w[n++] = &ev->xbutton.root;
+		w[n++] = &ev->xbutton.subwindow;
+		break;
+	case MotionNotify:
+		w[n++] = &ev->xmotion.root;
+		w[n++] = &ev->xmotion.subwindow;
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		w[n++] = &ev->xcrossing.root;
+		w[n++] = &ev->xcrossing.subwindow;
+		break;
+	case CreateNotify:
+		w[n++] = &ev->xcreatewindow.window;
+		break;
+	case DestroyNotify:
+		w[n++] = &ev->xdestroywindow.window;
+		break;
+	case UnmapNotify:
+		w[n++] = &ev->xunmap.window;
+		break;
+	case MapNotify:
+		w[n++] = &ev->xmap.window;
+		break;
+	case MapRequest:
+		w[n++] = &ev->xmaprequest.window;
+		break;
+	case ReparentNotify:
+		w[n++] = &ev->xreparent.window;
+		w[n++] = &ev->xreparent.parent;
+		break;
+	case ConfigureNotify:
+		w[n++] = &ev->xconfigure.window;
+		w[n++] = &ev->xconfigure.above;
+		break;
+	case ConfigureRequest:
+		w[n++] = &ev->xconfigurerequest.window;
+		w[n++] = &ev->xconfigurerequest.above;
+		break;
+	case GravityNotify:
+		w[n++] = &ev->xgravity.window;
+		break;
+	case CirculateNotify:
+		w[n++] = &ev->xcirculate.window;
+		break;
+	case CirculateRequest:
+		w[n++] = &ev->xcirculaterequest.window;
+		break;
+	case SelectionRequest:
+		w[n++] = &ev->xselectionrequest.requestor;
+		break;
+	case ClientMessage:
+		if (ev->xclient.format != 32)
+			break;
+		if (ev->xclient.message_type == _XA_NET_RESTACK_WINDOW)
+			w[n++] = (Window *) &ev->xclient.data.l[1];
+		else if (ev->xclient.message_type == _XA_NET_ACTIVE_WINDOW)
+			w[n++] = (Window *) &ev->xclient.data.l[2];
+		break;
+	}
+	return (n);
+}
+
+/* the fields of a core event that hold atoms, but for the type of a message */
+static int
+eventatoms(XEvent *ev, Atom *a[3])
+{
+	switch (ev->type) {
+	case PropertyNotify:
+		a[0] = &ev->xproperty.atom;
+		return (1);
+	case SelectionClear:
+		a[0] = &ev->xselectionclear.selection;
+		return (1);
+	case SelectionRequest:
+		a[0] = &ev->xselectionrequest.selection;
+		a[1] = &ev->xselectionrequest.target;
+		a[2] = &ev->xselectionrequest.property;
+		return (3);
+	case SelectionNotify:
+		a[0] = &ev->xselection.selection;
+		a[1] = &ev->xselection.target;
+		a[2] = &ev->xselection.property;
+		return (3);
+	case ClientMessage:
+		if (ev->xclient.format != 32)
+			break;
+		if (ev->xclient.message_type == _XA_NET_WM_STATE) {
+			a[0] = (Atom *) &ev->xclient.data.l[1];
+			a[1] = (Atom *) &ev->xclient.data.l[2];
+			return (2);
+		}
+		if (ev->xclient.message_type == _XA_WM_PROTOCOLS) {
+			a[0] = (Atom *) &ev->xclient.data.l[0];
+			return (1);
+		}
+		break;
+	}
+	return (0);
+}
+
+/* whether adwm created the window */
+static Bool
+ours(Window w)
+{
+	return ((w & ~dpy->resource_mask) == dpy->resource_base);
+}
+
+void
+recordoutput(const char *file)
+{
+	free(recordfile);
+	recordfile = strdup(file);
+}
+
+static void
+recordput(unsigned kind, const void *data, size_t size, const void *more, size_t extra)
+{
+	static const char zeros[8] = { 0, };
+	RecordHead h = { kind, (size + extra + 7) & ~7 };
+
+	if (!rec)
+		return;
+	if (fwrite(&h, sizeof(h), 1, rec) != 1 || fwrite(data, size, 1, rec) != 1 ||
+	    (extra && fwrite(more, extra, 1, rec) != 1) ||
+	    (h.size > size + extra && fwrite(zeros, h.size - size - extra, 1, rec) != 1)) {
+		EPRINTF("could not write recording %s: %s\n", recordfile, strerror(errno));
+		fclose(rec);
+		rec = NULL;
+		recording = 0;
+	}
+}
+
+static void
+recordatom(Atom a)
+{
+	XPointer seen;
+	uint32_t id = a;
+	char *name;
+
+	if (a == None || a <= XA_LAST_PREDEFINED || !XFindContext(dpy, a, seenatom, &seen))
+		return;
+	XSaveContext(dpy, a, seenatom, (XPointer) 1);
+	if ((name = XGetAtomName(dpy, a))) {
+		recordput(RecordAtom, &id, sizeof(id), name, strlen(name));
+		XFree(name);
+	}
+}
+
+static void
+recordproperty(Window w, Atom prop, unsigned tag)
+{
+	RecordPropertyData pd = { tag, w, prop, None, 0, 0 };
+	unsigned char *data = NULL;
+	uint32_t *items = NULL;
+	unsigned long n = 0, extra, i;
+	size_t len = 0;
+	Atom type = None;
+	int format = 0;
+
+	if (XGetWindowProperty(dpy, w, prop, 0L, 0x7fffffffL, False, AnyPropertyType, &type,
+			       &format, &n, &extra, &data) == Success && type != None) {
+		switch (type) {
+		case XA_PIXMAP:
+		case XA_BITMAP:
+		case XA_DRAWABLE:
+		case XA_CURSOR:
+		case XA_COLORMAP:
+		case XA_FONT:
+		case XA_VISUALID:
+			/* resources of the client: nothing to replay them with */
+			XFree(data);
+			return;
+		}
+		pd.type = type;
+		pd.format = format;
+		pd.nitems = n;
+		if (format == 32) {
+			items = ecalloc(n + 1, sizeof(*items));
+			for (i = 0; i < n; i++)
+				items[i] = ((long *) data)[i];
+			if (type == XA_ATOM)
+				for (i = 0; i < n; i++)
+					recordatom(items[i]);
+			if (type == XA_WM_HINTS && n >= 9) {
+				/* no icon pixmaps or windows either */
+				items[0] &= ~(IconPixmapHint | IconWindowHint | IconMaskHint);
+				items[3] = items[4] = items[7] = None;
+			}
+			len = n * sizeof(*items);
+		} else
+			len = n * format / 8;
+		recordatom(type);
+	}
+	recordatom(prop);
+	recordput(RecordProperty, &pd, sizeof(pd), items ? (void *) items : (void *) data, len);
+	free(items);
+	if (data)
+		XFree(data);
+}
+
+static void
+recordwindow(Window w, unsigned tag)
+{
+	RecordWindowData wd = { 0, };
+	XWindowAttributes wa;
+	Window root = None, parent = None, *children = NULL;
+	unsigned int nchild = 0;
+	Atom *props = NULL;
+	int i, n = 0;
+
+	wd.tag = tag;
+	wd.window = w;
+	XSaveContext(dpy, w, seenwindow, (XPointer) 1);
+	xtrap_push(1, NULL);
+	if (XGetWindowAttributes(dpy, w, &wa) &&
+	    XQueryTree(dpy, w, &root, &parent, &children, &nchild)) {
+		wd.parent = parent;
+		wd.x = wa.x;
+		wd.y = wa.y;
+		wd.width = wa.width;
+		wd.height = wa.height;
+		wd.border = wa.border_width;
+		wd.override = wa.override_redirect;
+		wd.mapped = (wa.map_state == IsViewable);
+		wd.inputonly = (wa.class == InputOnly);
+		props = XListProperties(dpy, w, &n);
+	} else
+		wd.gone = 1;
+	if (children)
+		XFree(children);
+	recordput(RecordWindow, &wd, sizeof(wd), NULL, 0);
+	for (i = 0; i < n; i++)
+		recordproperty(w, props[i], tag);
+	xtrap_pop();
+	if (props)
+		XFree(props);
+}
+
+/* record a window that an event refers to when it was not seen before */
+static void
+recordseen(Window w, unsigned tag, Bool core)
+{
+	RecordOwnedData od = { w, None, RecordOwnOther };
+	XPointer seen;
+	Client *c;
+
+	if (w == None || w == PointerRoot || !XFindContext(dpy, w, seenwindow, &seen))
+		return;
+	if ((c = getclient(w, ClientAny)) && w != c->win && w != c->icon) {
+		od.client = c->win;
+		if (w == c->frame)
+			od.part = RecordOwnFrame;
+		else if (w == c->title)
+			od.part = RecordOwnTitle;
+		else if (w == c->grips)
+			od.part = RecordOwnGrips;
+		else if (w == c->tgrip)
+			od.part = RecordOwnTGrip;
+		else if (w == c->lgrip)
+			od.part = RecordOwnLGrip;
+		else if (w == c->rgrip)
+			od.part = RecordOwnRGrip;
+		XSaveContext(dpy, w, seenwindow, (XPointer) 1);
+		recordput(RecordOwned, &od, sizeof(od), NULL, 0);
+		recordseen(c->win, tag, True);
+	} else if (!c && ours(w)) {
+		XSaveContext(dpy, w, seenwindow, (XPointer) 1);
+		recordput(RecordOwned, &od, sizeof(od), NULL, 0);
+	} else if (c || core)
+		recordwindow(w, tag);
+}
+
+/* write an event as it is taken from the queue: libX11 is locked, no requests */
+static void
+recordevent(XEvent *ev)
+{
+	RecordEventData ed = { 0, };
+	struct timespec now;
+	XEvent copy;
+
+	if (ev->type == GenericEvent)
+		return;		/* the data of the cookie is not in the event */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ed.time = (int64_t) (now.tv_sec - recstart.tv_sec) * 1000000000 +
+	    (now.tv_nsec - recstart.tv_nsec);
+	ed.lag = NextRequest(dpy) - ev->xany.serial;
+	copy = *ev;
+	copy.xany.display = NULL;
+	recordput(RecordEvent, &ed, sizeof(ed), &copy, eventsize(ev->type));
+	taken++;
+}
+
+/* called by handle_event() before the handler */
+void
+recordhandle(XEvent *ev)
+{
+	Window *w[4];
+	Atom *a[3];
+	int i, n;
+
+	if (ev->type == ClientMessage)
+		recordatom(ev->xclient.message_type);
+	n = eventwindows(ev, w);
+	for (i = 0; i < (ev->type < LASTEvent ? n : 1); i++)
+		recordseen(*w[i], taken, ev->type < LASTEvent);
+	if (ev->type < LASTEvent) {
+		n = eventatoms(ev, a);
+		for (i = 0; i < n; i++)
+			recordatom(*a[i]);
+	}
+	if (ev->type == PropertyNotify && !ours(ev->xproperty.window)) {
+		xtrap_push(1, NULL);
+		recordproperty(ev->xproperty.window, ev->xproperty.atom, taken);
+		xtrap_pop();
+	}
+	if (rec && !QLength(dpy))
+		fflush(rec);
+}
+
+static void
+startrecording(void)
+{
+	Window root, parent, *children = NULL;
+	unsigned int i, n;
+	int s, min, max, per, nprops, k;
+	KeySym *syms;
+	uint32_t *items;
+	Atom *props;
+
+	if (!(rec = fopen(recordfile, "w")))
+		eprint("adwm: cannot write recording %s: %s\n", recordfile, strerror(errno));
+	setvbuf(rec, NULL, _IOFBF, 1 << 16);
+	fwrite(RECORDMAGIC, 8, 1, rec);
+	seenwindow = XUniqueContext();
+	seenatom = XUniqueContext();
+	clock_gettime(CLOCK_MONOTONIC, &recstart);
+	for (s = 0; s < nscr; s++) {
+		uint32_t r[2] = { s, screens[s].root };
+
+		recordput(RecordRoot, r, sizeof(r), NULL, 0);
+		XSaveContext(dpy, screens[s].root, seenwindow, (XPointer) 1);
+	}
+	for (k = 0; k < BaseLast; k++)
+		if (einfo[k].have) {
+			int32_t event = einfo[k].event;
+
+			recordput(RecordExtension, &event, sizeof(event), einfo[k].name,
+				  strlen(einfo[k].name));
+		}
+	XDisplayKeycodes(dpy, &min, &max);
+	if ((syms = XGetKeyboardMapping(dpy, min, max - min + 1, &per))) {
+		uint32_t km[2] = { min, per };
+
+		n = (max - min + 1) * per;
+		items = ecalloc(n, sizeof(*items));
+		for (i = 0; i < n; i++)
+			items[i] = syms[i];
+		recordput(RecordKeymap, km, sizeof(km), items, n * sizeof(*items));
+		free(items);
+		XFree(syms);
+	}
+	for (s = 0; s < nscr; s++) {
+		if (!screens[s].managed)
+			continue;
+		if ((props = XListProperties(dpy, screens[s].root, &nprops))) {
+			for (k = 0; k < nprops; k++)
+				recordproperty(screens[s].root, props[k], 0);
+			XFree(props);
+		}
+		if (XQueryTree(dpy, screens[s].root, &root, &parent, &children, &n)) {
+			for (i = 0; i < n; i++)
+				recordwindow(children[i], 0);
+			if (children)
+				XFree(children);
+			children = NULL;
+		}
+	}
+	fflush(rec);
+	recording = 1;
+	OPRINTF("recording events to %s\n", recordfile);
+}
+
+void
+recordclose(void)
+{
+	if (rec) {
+		if (fclose(rec))
+			EPRINTF("could not write recording %s: %s\n", recordfile, strerror(errno));
+		rec = NULL;
+	}
+	recording = 0;
+}
+
+/* whether an argument is -R or -P, and whether the file is the next argument */
+static Bool
+isrecordarg(const char *arg, Bool *more)
+{
+	static const char *names[] = { "record", "replay" };
+	const char *eq;
+	size_t len;
+	int i;
+
+	if (arg[0] != '-' || !arg[1])
+		return False;
+	if (arg[1] == 'R' || arg[1] == 'P') {
+		*more = !arg[2];
+		return True;
+	}
+	arg += (arg[1] == '-') ? 2 : 1;
+	len = (eq = strchr(arg, '=')) ? (size_t) (eq - arg) : strlen(arg);
+	/* long options can be abbreviated: --rec, -replay=FILE, ... */
+	for (i = 0; i < 2; i++)
+		if (len >= 3 && len <= strlen(names[i]) && !strncmp(arg, names[i], len)) {
+			*more = !eq;
+			return True;
+		}
+	return False;
+}
+
+/*
+ * The arguments to restart with: those given but -R and -P, so that a restart
+ * does not truncate the recording, nor replay it again from the start.
+ */
+char **
+recordargv(int argc, char *argv[])
+{
+	char **args = ecalloc(argc + 1, sizeof(*args));
+	Bool more = False;
+	int i, n = 0;
+
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "--")) {
+			while (i < argc)
+				args[n++] = strdup(argv[i++]);
+			break;
+		}
+		if (i > 0 && isrecordarg(argv[i], &more)) {
+			if (more)
+				i++;
+			continue;
+		}
+		args[n++] = strdup(argv[i]);
+	}
+	return (args);
+}
+
+void
+replayinput(const char *file)
+{
+	free(replayfile);
+	replayfile = strdup(file);
+}
+
+static int
+standinerror(Display *d __attribute__((unused)), XErrorEvent *ee __attribute__((unused)))
+{
+	return 0;
+}
+
+/* have the server make the changes to the stand-ins before adwm looks */
+static void
+standinsync(void)
+{
+	int (*old) (Display *, XErrorEvent *);
+
+	if (!dirty)
+		return;
+	old = XSetErrorHandler(standinerror);
+	XSync(sdpy, False);
+	XSetErrorHandler(old);
+	dirty = False;
+}
+
+static Window standin(Window rec, Bool create);
+
+static Standin *
+newstandin(Window w)
+{
+	static int depth = 0;
+	RecordWindowData *wd = NULL;
+	RecordOwnedData *od;
+	XSetWindowAttributes wa;
+	Window parent = None;
+	Standin *s;
+
+	XFindContext(dpy, w, windows, (XPointer *) &wd);
+	if (wd && wd->parent && wd->parent != w && depth < 16 &&
+	    XFindContext(dpy, wd->parent, owned, (XPointer *) &od)) {
+		depth++;
+		parent = standin(wd->parent, True);
+		depth--;
+	}
+	if (!parent)
+		parent = screens->root;
+	wa.override_redirect = wd ? wd->override : False;
+	s = ecalloc(1, sizeof(*s));
+	s->rec = w;
+	s->override = wa.override_redirect;
+	s->win = XCreateWindow(sdpy, parent, wd ? wd->x : 0, wd ? wd->y : 0,
+			       wd && wd->width ? wd->width : 1, wd && wd->height ? wd->height : 1,
+			       wd && !wd->inputonly ? wd->border : 0, CopyFromParent,
+			       wd && wd->inputonly ? InputOnly : InputOutput, CopyFromParent,
+			       CWOverrideRedirect, &wa);
+	XSaveContext(dpy, w, standins, (XPointer) s);
+	XSaveContext(dpy, s->win, bystandin, (XPointer) s);
+	dirty = True;
+	return (s);
+}
+
+/* the window on this server for a recorded window */
+static Window
+standin(Window w, Bool create)
+{
+	RecordOwnedData *od;
+	Standin *s;
+	Client *c;
+	Window cw;
+	int i;
+
+	if (w == None || w == PointerRoot)
+		return (w);
+	for (i = 0; i < nrecroots; i++)
+		if (recroots[i] == w)
+			return (screens[i < nscr ? i : 0].root);
+	if (!XFindContext(dpy, w, owned, (XPointer *) &od)) {
+		if (!od->client || !(cw = standin(od->client, False)) ||
+		    !(c = getclient(cw, ClientWindow)))
+			return (None);
+		switch (od->part) {
+		case RecordOwnFrame:
+			return (c->frame);
+		case RecordOwnTitle:
+			return (c->title);
+		case RecordOwnGrips:
+			return (c->grips);
+		case RecordOwnTGrip:
+			return (c->tgrip);
+		case RecordOwnLGrip:
+			return (c->lgrip);
+		case RecordOwnRGrip:
+			return (c->rgrip);
+		default:
+			return (None);
+		}
+	}
+	if (!XFindContext(dpy, w, standins, (XPointer *) &s))
+		return (s->win);
+	return (create ? newstandin(w)->win : None);
+}
+
+static Atom
+replayatom(Atom a)
+{
+	XPointer p;
+
+	if (a > XA_LAST_PREDEFINED && !XFindContext(dpy, a, atoms, &p))
+		return ((Atom) (uintptr_t) p);
+	return (a);
+}
+
+static void
+applyproperty(RecordPropertyData *pd)
+{
+	const uint32_t *items = (const uint32_t *) (pd + 1);
+	Atom prop = replayatom(pd->atom), type = replayatom(pd->type);
+	unsigned long i;
+	Window w;
+	long *l;
+
+	if (!(w = standin(pd->window, True)))
+		return;
+	dirty = True;
+	if (!pd->format) {
+		XDeleteProperty(sdpy, w, prop);
+		return;
+	}
+	if (pd->format != 32) {
+		XChangeProperty(sdpy, w, prop, type, pd->format, PropModeReplace,
+				(unsigned char *) items, pd->nitems);
+		return;
+	}
+	l = ecalloc(pd->nitems + 1, sizeof(*l));
+	for (i = 0; i < pd->nitems; i++) {
+		if (pd->type == XA_ATOM)
+			l[i] = replayatom(items[i]);
+		else if (pd->type == XA_WINDOW)
+			l[i] = standin(items[i], True);
+		else
+			l[i] = items[i];
+	}
+	if (pd->type == XA_WM_HINTS && pd->nitems >= 9)
+		l[8] = standin(items[8], True);
+	XChangeProperty(sdpy, w, prop, type, 32, PropModeReplace, (unsigned char *) l,
+			pd->nitems);
+	free(l);
+}
+
+/* make the changes recorded before the tag-th event was taken */
+static void
+applychanges(unsigned tag)
+{
+	RecordPropertyData *pd;
+
+	while (nextchange < nchanges) {
+		pd = (RecordPropertyData *) (changes[nextchange] + 1);
+		if (pd->tag > tag)
+			break;
+		nextchange++;
+		applyproperty(pd);
+	}
+	standinsync();
+}
+
+static Time
+replaytime(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (timebase + (now.tv_sec - replaystart.tv_sec) * 1000 +
+		(now.tv_nsec - replaystart.tv_nsec) / 1000000);
+}
+
+/* translate a recorded event for this server: False when it cannot be */
+static Bool
+translate(XEvent *ev)
+{
+	Window *w[4], win;
+	Atom *a[3];
+	int i, n;
+
+	if (ev->type >= LASTEvent) {
+		for (i = 0; i < nexts; i++)
+			if (ev->type >= exts[i].event && ev->type < exts[i].event + EXTRANGE)
+				break;
+		if (i == nexts || !einfo[exts[i].base].have)
+			return False;
+		ev->type += einfo[exts[i].base].event - exts[i].event;
+		/* not necessarily a window: only translate known windows */
+		if ((win = standin(ev->xany.window, False)))
+			ev->xany.window = win;
+		return True;
+	}
+	if (ev->type == GenericEvent)
+		return False;
+	if (ev->type == ClientMessage)
+		ev->xclient.message_type = replayatom(ev->xclient.message_type);
+	n = eventwindows(ev, w);
+	for (i = 0; i < n; i++)
+		*w[i] = standin(*w[i], True);
+	n = eventatoms(ev, a);
+	for (i = 0; i < n; i++)
+		*a[i] = replayatom(*a[i]);
+	switch (ev->type) {
+	case KeyPress:
+	case KeyRelease:
+		ev->xkey.keycode = keycodes[ev->xkey.keycode & 0xff];
+		ev->xkey.time = replaytime();
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		ev->xbutton.time = replaytime();
+		break;
+	case MotionNotify:
+		ev->xmotion.time = replaytime();
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		ev->xcrossing.time = replaytime();
+		break;
+	case PropertyNotify:
+		ev->xproperty.time = replaytime();
+		break;
+	case SelectionClear:
+		ev->xselectionclear.time = replaytime();
+		break;
+	case SelectionRequest:
+		ev->xselectionrequest.time = replaytime();
+		break;
+	case SelectionNotify:
+		ev->xselection.time = replaytime();
+		break;
+	}
+	return True;
+}
+
+/* append the next recorded event to the queue */
+static Bool
+replayfeed(void)
+{
+	RecordEventData *ed;
+	RecordHead *h;
+	_XQEvent *q;
+	XEvent ev;
+	size_t len;
+
+	while (nextevent < nevents) {
+		h = events[nextevent++];
+		ed = (RecordEventData *) (h + 1);
+		len = h->size - sizeof(*ed);
+		memset(&ev, 0, sizeof(ev));
+		memcpy(&ev, ed + 1, len < sizeof(ev) ? len : sizeof(ev));
+		if (!translate(&ev))
+			continue;
+		standinsync();
+		ev.xany.display = dpy;
+		ev.xany.serial = NextRequest(dpy) - ed->lag;
+		if ((q = dpy->qfree))
+			dpy->qfree = q->next;
+		else if (!(q = Xmalloc(sizeof(*q))))
+			eprint("adwm: out of memory\n");
+		q->next = NULL;
+		q->event = ev;
+		q->qserial_num = dpy->next_event_serial_num++;
+		if (dpy->tail)
+			dpy->tail->next = q;
+		else
+			dpy->head = q;
+		dpy->tail = q;
+		dpy->qlen++;
+		queued[nqueued % QUEUED].qelt = q;
+		queued[nqueued % QUEUED].index = nextevent;
+		nqueued++;
+		return True;
+	}
+	return False;
+}
+
+static void
+initreplay(void)
+{
+	RecordHead *h;
+	RecordWindowData *wd;
+	RecordPropertyData *pd;
+	RecordOwnedData *od;
+	XSetWindowAttributes wa;
+	XPointer p;
+	XEvent ev;
+	Window w;
+	uint32_t *u;
+	char name[256];
+	size_t off, len, n;
+	unsigned i, k;
+	long size = 0;
+	FILE *f;
+
+	if (!(f = fopen(replayfile, "r")) || fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET))
+		eprint("adwm: cannot read recording %s: %s\n", replayfile, strerror(errno));
+	len = size;
+	buf = ecalloc(len + 8, 1);
+	if (fread(buf, 1, len, f) != len)
+		eprint("adwm: cannot read recording %s: %s\n", replayfile, strerror(errno));
+	fclose(f);
+	if (len < 8 || memcmp(buf, RECORDMAGIC, 8))
+		eprint("adwm: %s is not a recording\n", replayfile);
+	if (!(sdpy = XOpenDisplay(DisplayString(dpy))))
+		eprint("adwm: cannot open a second display for stand-in windows\n");
+	standins = XUniqueContext();
+	bystandin = XUniqueContext();
+	owned = XUniqueContext();
+	windows = XUniqueContext();
+	atoms = XUniqueContext();
+	for (i = 0; i < LENGTH(keycodes); i++)
+		keycodes[i] = i;
+
+	for (off = 8; off + sizeof(*h) <= len; off += sizeof(*h) + h->size) {
+		h = (RecordHead *) (buf + off);
+		if (h->size > len - off - sizeof(*h)) {
+			EPRINTF("recording %s is truncated\n", replayfile);
+			break;
+		}
+		u = (uint32_t *) (h + 1);
+		switch (h->kind) {
+		case RecordRoot:
+			if (h->size < 2 * sizeof(*u))
+				break;
+			if ((int) u[0] >= nrecroots) {
+				recroots = erealloc(recroots, (u[0] + 1) * sizeof(*recroots));
+				while (nrecroots <= (int) u[0])
+					recroots[nrecroots++] = None;
+			}
+			recroots[u[0]] = u[1];
+			break;
+		case RecordExtension:
+			if (h->size < sizeof(*u) || nexts >= BaseLast)
+				break;
+			n = strnlen((char *) (u + 1), h->size - sizeof(*u));
+			for (k = 0; k < BaseLast; k++)
+				if (strlen(einfo[k].name) == n && !strncmp(einfo[k].name, (char *) (u + 1), n)) {
+					exts[nexts].event = (int32_t) u[0];
+					exts[nexts++].base = k;
+					break;
+				}
+			break;
+		case RecordKeymap:
+			if (h->size < 2 * sizeof(*u) || !u[1])
+				break;
+			n = (h->size - 2 * sizeof(*u)) / sizeof(*u) / u[1];
+			for (k = 0; k < n && u[0] + k < LENGTH(keycodes); k++) {
+				KeySym sym = u[2 + k * u[1]];
+				KeyCode kc;
+
+				if (sym != NoSymbol && (kc = XKeysymToKeycode(dpy, sym)))
+					keycodes[u[0] + k] = kc;
+			}
+			break;
+		case RecordAtom:
+			if (h->size < sizeof(*u) || XFindContext(dpy, u[0], atoms, &p) == XCSUCCESS)
+				break;
+			n = strnlen((char *) (u + 1), h->size - sizeof(*u));
+			snprintf(name, sizeof(name), "%.*s", (int) n, (char *) (u + 1));
+			XSaveContext(dpy, u[0], atoms, (XPointer) (uintptr_t) XInternAtom(dpy, name, False));
+			break;
+		case RecordWindow:
+			if (h->size < sizeof(*wd))
+				break;
+			wd = (RecordWindowData *) u;
+			if (XFindContext(dpy, wd->window, windows, &p) == XCSUCCESS)
+				break;
+			XSaveContext(dpy, wd->window, windows, (XPointer) wd);
+			if (!wd->tag && !wd->gone) {
+				initial = erealloc(initial, (ninitial + 1) * sizeof(*initial));
+				initial[ninitial++] = wd;
+			}
+			break;
+		case RecordProperty:
+			if (h->size < sizeof(*pd))
+				break;
+			pd = (RecordPropertyData *) u;
+			n = pd->format == 32 ? 4 : pd->format / 8;
+			if (pd->format && (n == 0 || pd->nitems > (h->size - sizeof(*pd)) / n))
+				break;
+			if (!(nchanges & (nchanges + 1)) || !changes)
+				changes = erealloc(changes, 2 * (nchanges + 1) * sizeof(*changes));
+			changes[nchanges++] = h;
+			break;
+		case RecordOwned:
+			if (h->size < sizeof(*od))
+				break;
+			od = (RecordOwnedData *) u;
+			XSaveContext(dpy, od->window, owned, (XPointer) od);
+			break;
+		case RecordEvent:
+			if (h->size <= sizeof(RecordEventData))
+				break;
+			if (!(nevents & (nevents + 1)) || !events)
+				events = erealloc(events, 2 * (nevents + 1) * sizeof(*events));
+			events[nevents++] = h;
+			break;
+		}
+	}
+
+	/* the time on the server: that of a change to a property */
+	wa.event_mask = PropertyChangeMask;
+	w = XCreateWindow(sdpy, screens->root, -1, -1, 1, 1, 0, CopyFromParent, InputOnly,
+			  CopyFromParent, CWEventMask, &wa);
+	XChangeProperty(sdpy, w, XA_WM_NAME, XA_STRING, 8, PropModeAppend,
+			(unsigned char *) "", 0);
+	XWindowEvent(sdpy, w, PropertyChangeMask, &ev);
+	XDestroyWindow(sdpy, w);
+	timebase = ev.xproperty.time;
+	clock_gettime(CLOCK_MONOTONIC, &replaystart);
+
+	/* the windows that existed when recording started, before the scan */
+	for (i = 0; i < ninitial; i++) {
+		w = standin(initial[i]->window, True);
+		if (initial[i]->mapped)
+			XMapWindow(sdpy, w);
+	}
+	applychanges(0);
+	replaying = 1;
+	OPRINTF("replaying %u events from %s\n", nevents, replayfile);
+}
+
+void
+initrecord(void)
+{
+	if (recordfile && replayfile)
+		eprint("adwm: cannot record and replay at once\n");
+	if (recordfile)
+		startrecording();
+	else if (replayfile)
+		initreplay();
+}
+
+/* called by handle_event() before the handler */
+void
+replayhandle(XEvent *ev)
+{
+	Standin *s = NULL;
+
+	applychanges(current);
+	/* what the client of an override-redirect window did itself */
+	switch (ev->type) {
+	case MapNotify:
+		if (!XFindContext(dpy, ev->xmap.window, bystandin, (XPointer *) &s) &&
+		    s->override && !s->gone) {
+			XMapWindow(sdpy, s->win);
+			dirty = True;
+		}
+		break;
+	case UnmapNotify:
+		if (!XFindContext(dpy, ev->xunmap.window, bystandin, (XPointer *) &s) &&
+		    s->override && !s->gone) {
+			XUnmapWindow(sdpy, s->win);
+			dirty = True;
+		}
+		break;
+	case ConfigureNotify:
+		if (!XFindContext(dpy, ev->xconfigure.window, bystandin, (XPointer *) &s) &&
+		    s->override && !s->gone) {
+			XMoveResizeWindow(sdpy, s->win, ev->xconfigure.x, ev->xconfigure.y,
+					  ev->xconfigure.width ? : 1, ev->xconfigure.height ? : 1);
+			dirty = True;
+		}
+		break;
+	case DestroyNotify:
+		/* any client */
+		if (!XFindContext(dpy, ev->xdestroywindow.window, bystandin, (XPointer *) &s) &&
+		    !s->gone) {
+			XDestroyWindow(sdpy, s->win);
+			s->gone = True;
+			dirty = True;
+		}
+		break;
+	}
+	standinsync();
+}
+
+/* the next recorded event, False when there are no more */
+Bool
+replaynext(XEvent *ev)
+{
+	if (!started) {
+		clock_gettime(CLOCK_MONOTONIC, &wallstart);
+		getrusage(RUSAGE_SELF, &usagestart);
+		requeststart = NextRequest(dpy);
+		replystart = profreplies;
+		started = True;
+	}
+	if (!QLength(dpy) && !replayfeed())
+		return False;
+	XNextEvent(dpy, ev);
+	return True;
+}
+
+void
+replaydone(void)
+{
+	struct timespec now;
+	struct rusage usage;
+	double wall, cpu, span = 0.0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	getrusage(RUSAGE_SELF, &usage);
+	wall = (now.tv_sec - wallstart.tv_sec) + (now.tv_nsec - wallstart.tv_nsec) / 1000000000.0;
+	cpu = (usage.ru_utime.tv_sec - usagestart.ru_utime.tv_sec) +
+	    (usage.ru_stime.tv_sec - usagestart.ru_stime.tv_sec) +
+	    ((usage.ru_utime.tv_usec - usagestart.ru_utime.tv_usec) +
+	     (usage.ru_stime.tv_usec - usagestart.ru_stime.tv_usec)) / 1000000.0;
+	if (nevents)
+		span = ((RecordEventData *) (events[nevents - 1] + 1))->time / 1000000000.0;
+	fprintf(stderr, "adwm: replayed %u of %u events (%.3f s recorded) in %.3f s, "
+		"%.3f s cpu, %lu requests, %lu round trips\n", nextevent, nevents, span, wall,
+		cpu, NextRequest(dpy) - requeststart, profreplies - replystart);
+	evstatdump();
+	replaying = 0;
+}
+
+/*
+ * libX11 takes every event from the queue with _XDeq(), reads events with
+ * _XReadEvents() when it must wait for one and with _XEventsQueued() when it
+ * must not, and queues each event read with _XEnq().
+ */
+void
+_XDeq(Display *d, _XQEvent *prev, _XQEvent *qelt)
+{
+	static void (*real) (Display *, _XQEvent *, _XQEvent *) = NULL;
+	unsigned i;
+
+	if (!real && !(real = (typeof(real)) dlsym(RTLD_NEXT, "_XDeq")))
+		eprint("fatal: could not find _XDeq()\n");
+	if (d == dpy && recording)
+		recordevent(&qelt->event);
+	else if (d == dpy && replaying)
+		for (i = 0; i < QUEUED; i++)
+			if (queued[i].qelt == qelt) {
+				current = queued[i].index;
+				queued[i].qelt = NULL;
+				break;
+			}
+	real(d, prev, qelt);
+}
+
+void
+_XEnq(Display *d, xEvent *event)
+{
+	static void (*real) (Display *, xEvent *) = NULL;
+
+	if (!real && !(real = (typeof(real)) dlsym(RTLD_NEXT, "_XEnq")))
+		eprint("fatal: could not find _XEnq()\n");
+	if (d == dpy && replaying)
+		return;		/* only recorded events */
+	real(d, event);
+}
+
+static int
+eventsqueued(Display *d, int mode)
+{
+	static int (*real) (Display *, int) = NULL;
+
+	if (!real && !(real = (typeof(real)) dlsym(RTLD_NEXT, "_XEventsQueued")))
+		eprint("fatal: could not find _XEventsQueued()\n");
+	return real(d, mode);
+}
+
+int
+_XEventsQueued(Display *d, int mode)
+{
+	if (d == dpy && replaying) {
+		if (mode != QueuedAlready) {
+			eventsqueued(d, mode);	/* flush, and drop what was sent */
+			replayfeed();
+		}
+		return (d->qlen);
+	}
+	return eventsqueued(d, mode);
+}
+
+void
+_XReadEvents(Display *d)
+{
+	static void (*real) (Display *) = NULL;
+
+	if (!real && !(real = (typeof(real)) dlsym(RTLD_NEXT, "_XReadEvents")))
+		eprint("fatal: could not find _XReadEvents()\n");
+	if (d == dpy && replaying) {
+		eventsqueued(d, QueuedAfterFlush);
+		if (replayfeed())
+			return;
+		/* ended within a loop that waits for an event, as a move does */
+		replaydone();
+		exit(EXIT_SUCCESS);
+	}
+	real(d);
+}
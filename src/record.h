@@ -0,0 +1,83 @@
+/* record.c */
+
+#ifndef __LOCAL_RECORD_H__
+#define __LOCAL_RECORD_H__
+
+#define RECORDMAGIC	"ADWMREC1"
+
+/*
+ * A recording is RECORDMAGIC followed by records, each a RecordHead and size
+ * bytes of data.  Events are recorded as the structure of their type in the
+ * XEvent union (the whole XEvent for extension events), so that a recording
+ * can only be replayed by a build for the same architecture.  Windows and
+ * properties are tagged with the number of events that had been taken from
+ * the queue when they were recorded: a change tagged n is made before the
+ * event that was taken n-th is handled.
+ */
+enum {
+	RecordRoot,			/* screen, root window */
+	RecordExtension,		/* first event, name */
+	RecordKeymap,			/* first keycode, keysyms per keycode, keysyms */
+	RecordAtom,			/* atom, name */
+	RecordWindow,			/* a window when first seen */
+	RecordProperty,			/* a property of a window when seen or changed */
+	RecordOwned,			/* a window of adwm: the client and which of its windows */
+	RecordEvent,			/* an event taken from the queue */
+};
+
+enum {
+	RecordOwnFrame,
+	RecordOwnTitle,
+	RecordOwnGrips,
+	RecordOwnTGrip,
+	RecordOwnLGrip,
+	RecordOwnRGrip,
+	RecordOwnOther,			/* not of a client */
+};
+
+typedef struct {
+	uint32_t kind;
+	uint32_t size;			/* of the data that follows */
+} RecordHead;
+
+typedef struct {
+	uint64_t time;			/* ns since recording started */
+	uint32_t lag;			/* next request - serial of the event */
+	uint32_t pad;
+	/* then the event */
+} RecordEventData;
+
+typedef struct {
+	uint32_t tag;
+	uint32_t window, parent;
+	int16_t x, y;
+	uint16_t width, height, border;
+	uint8_t override, mapped, inputonly, gone;
+} RecordWindowData;
+
+typedef struct {
+	uint32_t tag;
+	uint32_t window, atom, type;
+	uint32_t format;		/* 0 when deleted */
+	uint32_t nitems;
+	/* then the items: those of format 32 as uint32_t */
+} RecordPropertyData;
+
+typedef struct {
+	uint32_t window, client, part;
+} RecordOwnedData;
+
+extern int recording;
+extern int replaying;
+
+void recordoutput(const char *file);
+void replayinput(const char *file);
+void initrecord(void);
+void recordhandle(XEvent *ev);
+void recordclose(void);
+char **recordargv(int argc, char *argv[]);
+void replayhandle(XEvent *ev);
+Bool replaynext(XEvent *ev);
+void replaydone(void);
+
+#endif				/* __LOCAL_RECORD_H__ */
@@ -142,7 +142,7 @@ createicon_bitmap(AScreen *ds, Client *c, XImage *xdraw, XImage *xmask, Bool cro
 		EPRINTF("could not create gc\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 
 	format = XRenderFindStandardFormat(dpy, PictStandardA8);
 
@@ -339,7 +339,7 @@ createicon_pixmap(AScreen *ds, Client *c, XImage *xdraw, XImage *xmask, Bool cro
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 
 	for (bis = getbuttons(c); bis && *bis; bis++) {
 		if ((pict = XRenderCreatePicture(dpy, draw, ds->format, pamask, &pa))) {
@@ -434,7 +434,7 @@ render_createbitmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
+	putimage(draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
 
 	for (bis = getbuttons(c); bis && *bis; bis++) {
 		if ((pict = XRenderCreatePicture(dpy, draw, ds->format, pamask, &pa))) {
@@ -545,7 +545,7 @@ render_createpixmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 
 	for (bis = getbuttons(c); bis && *bis; bis++) {
 		if ((pict = XRenderCreatePicture(dpy, draw, ds->format, pamask, &pa))) {
@@ -670,7 +670,7 @@ render_createdataicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 
 	for (bis = getbuttons(c); bis && *bis; bis++) {
 		if ((pict = XRenderCreatePicture(dpy, draw, ds->format, pamask, &pa))) {
@@ -752,7 +752,7 @@ render_createpngicon(AScreen *ds, Client *c, const char *file)
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, ds->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 	result = createicon_pixmap(ds, c, draw, None, ximage->width, ximage->height, ximage->depth, True);
 	if (result)
 		XPRINTF("created icon from %s\n", file);
@@ -1280,7 +1280,7 @@ render_initpng(char *path, AdwmPixmap *px)
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, scr->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
+	putimage(draw, scr->dc.gc, ximage, 0, 0, 0, 0, ximage->width, ximage->height);
 
 	if (!(pict = XRenderCreatePicture(dpy, draw, scr->format, pamask, &pa))) {
 		EPRINTF("could not create picture\n");
@@ -1454,7 +1454,7 @@ render_initxpm(char *path, AdwmPixmap *px)
 		EPRINTF("could not create pixmap\n");
 		goto error;
 	}
-	XPutImage(dpy, draw, scr->dc.gc, ximage, 0, 0, 0, 0, w, h);
+	putimage(draw, scr->dc.gc, ximage, 0, 0, 0, 0, w, h);
 
 	if (!(pict = XRenderCreatePicture(dpy, draw, scr->format, pamask, &pa))) {
 		EPRINTF("could not create picture\n");
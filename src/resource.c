@@ -16,6 +16,7 @@
 #include "xlib.h"
 #endif
 #include "config.h"
+#include "texture.h"
 #include "resource.h" /* verification */
 
 XrmDatabase xresdb;
@@ -409,6 +410,7 @@ readtexture(const char *name, const char *clas, Texture *t, const char *defcol,
 void
 freetexture(Texture *t)
 {
+	purgetextures(t);
 	freexftcolor(&t->textColor);
 }
 
@@ -392,7 +392,8 @@ save(FILE *file, Bool permanent)
 
 		/* in creation order */
 		for (c = scr->clist; c; c = c->cnext) {
-			char *clientid, *res_name = NULL, *res_class = NULL, *wm_command = NULL;
+			char *clientid;
+			const char *res_name = NULL, *res_class = NULL, *wm_command = NULL;
 			Bool strings;
 
 			clientid = getclientid(c);
@@ -450,6 +451,9 @@ save(FILE *file, Bool permanent)
 					 */
 				}
 			}
+			unintern(res_name);
+			unintern(res_class);
+			unintern(wm_command);
 
 		}
 	}
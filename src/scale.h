@@ -0,0 +1,16 @@
+/* scale.c */
+
+#ifndef __LOCAL_SCALE_H__
+#define __LOCAL_SCALE_H__
+
+typedef struct {
+	void (*getrow) (const void *src, unsigned j, unsigned *row);
+	void (*putrow) (void *dst, unsigned j, const unsigned *row);
+	const void *src;
+	void *dst;
+} ScaleRows;
+
+unsigned box_scale(ScaleRows *sr, unsigned w, unsigned h, unsigned nw, unsigned nh);
+unsigned *scale_argb(const unsigned *argb, unsigned w, unsigned h, unsigned nw, unsigned nh);
+
+#endif				/* __LOCAL_SCALE_H__ */
@@ -0,0 +1,160 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "scale.h"
+
+/*
+ * Benchmark the icon scaler (see scale.c) without a display.  Icons of the
+ * sizes that applications commonly supply in _NET_WM_ICON are scaled to common
+ * title heights (and the small ones up to larger sizes), both for random and
+ * for smooth images.  Each result is compared with an exact area average
+ * computed in floating point (what the floating point scalers that the box
+ * filter replaced set out to compute) and each scale is timed -n times.  Exits
+ * with a failure when any channel is more than one level from the average.
+ */
+
+#define TOLERANCE	1
+
+static const unsigned sources[] = { 16, 22, 24, 32, 48, 64, 128, 256 };
+static const unsigned targets[] = { 12, 16, 20, 24, 32, 48, 64 };
+
+void *
+ecalloc(size_t nmemb, size_t size)
+{
+	void *res;
+
+	if (!(res = calloc(nmemb, size))) {
+		fprintf(stderr, "scalebench: out of memory\n");
+		exit(1);
+	}
+	return res;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0);
+}
+
+/* the overlap of source pixel i with destination pixel d, in source pixels */
+static double
+overlap(unsigned i, unsigned d, unsigned w, unsigned n)
+{
+	const double a = (double) d * w / n, b = (double) (d + 1) * w / n;
+	const double lo = a > i ? a : i, hi = b < i + 1 ? b : i + 1;
+
+	return (hi > lo ? hi - lo : 0.0);
+}
+
+/* the exact area average of each channel; returns the largest difference */
+static unsigned
+difference(const unsigned *argb, const unsigned *scaled, unsigned w, unsigned h,
+	   unsigned nw, unsigned nh)
+{
+	const double area = ((double) w / nw) * ((double) h / nh);
+	unsigned x, y, i, j, c, diff = 0;
+	double sum[4], f;
+	unsigned v;
+
+	for (y = 0; y < nh; y++) {
+		for (x = 0; x < nw; x++) {
+			memset(sum, 0, sizeof(sum));
+			for (j = y * h / nh; j < h && j * nh < (y + 1) * h; j++) {
+				for (i = x * w / nw; i < w && i * nw < (x + 1) * w; i++) {
+					f = overlap(i, x, w, nw) * overlap(j, y, h, nh);
+					for (c = 0; c < 4; c++)
+						sum[c] += ((argb[j * w + i] >> (c * 8)) & 0xff) * f;
+				}
+			}
+			for (c = 0; c < 4; c++) {
+				v = (unsigned) (sum[c] / area + 0.5);
+				f = (double) ((scaled[y * nw + x] >> (c * 8)) & 0xff) - v;
+				diff = max(diff, (unsigned) (f < 0 ? -f : f));
+			}
+		}
+	}
+	return (diff);
+}
+
+static void
+fill(unsigned *argb, unsigned w, unsigned h, Bool smooth)
+{
+	unsigned x, y, a, r, g, b;
+
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			/* never all transparent, which would have opacity added */
+			if (smooth) {
+				a = 0xff - (x + y) * 0x7f / (w + h);
+				r = x * 0xff / w;
+				g = y * 0xff / h;
+				b = (x * y) * 0xff / (w * h);
+			} else {
+				a = 1 + rand() % 0xff;
+				r = rand() & 0xff;
+				g = rand() & 0xff;
+				b = rand() & 0xff;
+			}
+			argb[y * w + x] = (a << 24) | (r << 16) | (g << 8) | b;
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned times = 1000, s, t, i, n, diff, worst = 0;
+	unsigned *argb, *scaled;
+	double start, ms;
+	int c, smooth, failed = 0;
+
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			times = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: scalebench [-n times]\n");
+			return (2);
+		}
+	}
+	if (!times)
+		times = 1;
+	argb = ecalloc(256 * 256, sizeof(*argb));
+	srand(1);
+
+	printf("us per icon (%u times) and largest difference from the exact average\n",
+	       times);
+	printf("%-9s", "from\\to");
+	for (t = 0; t < LENGTH(targets); t++)
+		printf(" %11u", targets[t]);
+	printf("\n");
+	for (smooth = 0; smooth < 2; smooth++) {
+		for (s = 0; s < LENGTH(sources); s++) {
+			n = sources[s];
+			fill(argb, n, n, smooth);
+			printf("%3u %-5s", n, smooth ? "smth" : "rand");
+			for (t = 0; t < LENGTH(targets); t++) {
+				scaled = scale_argb(argb, n, n, targets[t], targets[t]);
+				diff = difference(argb, scaled, n, n, targets[t], targets[t]);
+				free(scaled);
+				start = now();
+				for (i = 0; i < times; i++)
+					free(scale_argb(argb, n, n, targets[t], targets[t]));
+				ms = (now() - start) / times;
+				printf(" %8.2f %2u", ms * 1000.0, diff);
+				worst = max(worst, diff);
+			}
+			printf("\n");
+		}
+	}
+	if (worst > TOLERANCE) {
+		printf("largest difference %u exceeds %u\n", worst, TOLERANCE);
+		failed = 1;
+	}
+	free(argb);
+	return (failed);
+}
@@ -0,0 +1,551 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "config.h"
+#include "snapshot.h" /* verification */
+
+extern AdwmPlaces config;
+
+/*
+ * Configuration snapshots: locating adwmrc and the theme, style, keys,
+ * buttons, rules and dock files, parsing each with XrmGetFileDatabase() and
+ * merging them is repeated on every start, restart and reload.  After it is
+ * done, the merged resource database and the located files are written to
+ * ${XDG_CACHE_HOME}/adwm as a binary snapshot; the next time the snapshot is
+ * mapped and the database rebuilt from it directly when none of its inputs
+ * have changed.
+ *
+ * The snapshot name is keyed by a hash of what determines the search (the -f
+ * file, the private and system directories and the version).  Inside, every
+ * file read is recorded with its modification time, size and content hash,
+ * and every directory searched (and the directory of each file read) with its
+ * modification time, so that adding a file that would now be found first
+ * also invalidates the snapshot.  So does every path that findrcfile()
+ * tried without finding the file, and every file named by an #include in a
+ * file read.  A file whose time changed but whose contents did not is still
+ * accepted.
+ *
+ * The layout (native byte order, this is a cache for this host only):
+ *
+ *   header:	char magic[8], CARD32 ndeps, CARD32 nstrings, CARD32 nres
+ *   dep:	INT64 mtime (ns), INT64 size, CARD32 hash, CARD32 kind, STRING path
+ *   strings:	STRING[nstrings]		(see snapshotstrings())
+ *   resource:	STRING specifier, STRING value
+ *
+ * where STRING is a CARD32 length (0xffffffff for none) followed by the bytes
+ * and a terminating null.
+ */
+
+#define SNAPMAGIC	"ADWMSNP1"
+#define SNAPNONE	0xffffffff
+
+enum { DepMissing, DepFile, DepDir };
+
+typedef struct {
+	const unsigned char *p, *end;
+	Bool bad;
+} SnapReader;
+
+typedef struct {
+	FILE *f;
+	uint32_t nres;
+	Bool bad;
+} SnapWriter;
+
+#define MAXPROBES	64
+
+/* the paths searched without finding the file since the last snapshot */
+static char *probes[MAXPROBES];
+static unsigned nprobes = 0;
+
+/* the config strings saved in the snapshot, in order */
+static char ***
+snapshotstrings(unsigned *n)
+{
+	static char **strings[] = {
+		&config.themefile, &config.themename, &config.stylefile, &config.stylename,
+		&config.keysfile, &config.btnsfile, &config.rulefile, &config.dockfile
+	};
+
+	*n = LENGTH(strings);
+	return (strings);
+}
+
+static char *
+snapshotpath(const char *conf)
+{
+	char *path;
+	unsigned key = HASHINIT;
+	size_t len;
+
+	if (!xdgdirs.cach)
+		return (NULL);
+	key = strhash(key, conf ? : "");
+	key = strhash(key, config.pdir);
+	key = strhash(key, config.rcfile);
+	key = strhash(key, config.sdir);
+	key = strhash(key, VERSION);
+	len = strlen(xdgdirs.cach) + strlen("/adwm/config-00000000.snap");
+	path = ecalloc(len + 1, sizeof(*path));
+	snprintf(path, len + 1, "%s/adwm/config-%08x.snap", xdgdirs.cach, key);
+	return (path);
+}
+
+static int64_t
+mtimens(struct stat *st)
+{
+	return ((int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec);
+}
+
+static uint32_t
+hashfilecontents(const char *path)
+{
+	unsigned char buf[BUFSIZ];
+	uint32_t hash = HASHINIT;
+	size_t n, i;
+	FILE *f;
+
+	if (!(f = fopen(path, "rb")))
+		return (0);
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		for (i = 0; i < n; i++)
+			hash = (hash ^ buf[i]) * 16777619U;
+	fclose(f);
+	return (hash);
+}
+
+/* a path that was searched but not found: the snapshot is stale when it appears */
+void
+snapshotprobe(const char *path)
+{
+	unsigned i;
+
+	for (i = 0; i < nprobes; i++)
+		if (!strcmp(probes[i], path))
+			return;
+	if (nprobes < MAXPROBES)
+		probes[nprobes] = strdup(path);
+	nprobes++;		/* too many: no snapshot is written */
+}
+
+static void
+freeprobes(void)
+{
+	unsigned i;
+
+	for (i = 0; i < nprobes && i < MAXPROBES; i++)
+		free(probes[i]);
+	nprobes = 0;
+}
+
+/* reading */
+
+static Bool
+rdbytes(SnapReader *r, void *buf, size_t n)
+{
+	if (r->bad || (size_t) (r->end - r->p) < n) {
+		r->bad = True;
+		return False;
+	}
+	memcpy(buf, r->p, n);
+	r->p += n;
+	return True;
+}
+
+static uint32_t
+rd32(SnapReader *r)
+{
+	uint32_t v = 0;
+
+	rdbytes(r, &v, sizeof(v));
+	return (v);
+}
+
+static int64_t
+rd64(SnapReader *r)
+{
+	int64_t v = 0;
+
+	rdbytes(r, &v, sizeof(v));
+	return (v);
+}
+
+/* a string in place in the mapping; NULL for none or on error */
+static const char *
+rdstr(SnapReader *r)
+{
+	const char *s;
+	uint32_t len;
+
+	if ((len = rd32(r)) == SNAPNONE || r->bad)
+		return (NULL);
+	if ((size_t) (r->end - r->p) <= len || r->p[len]) {
+		r->bad = True;
+		return (NULL);
+	}
+	s = (const char *) r->p;
+	r->p += len + 1;
+	return (s);
+}
+
+static Bool
+checkdep(const char *path, int64_t mtime, int64_t size, uint32_t hash, uint32_t kind)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return (kind == DepMissing);
+	switch (kind) {
+	case DepDir:
+		return (S_ISDIR(st.st_mode) && mtimens(&st) == mtime);
+	case DepFile:
+		if (!S_ISREG(st.st_mode) || st.st_size != size)
+			return False;
+		if (mtimens(&st) == mtime)
+			return True;
+		/* touched: same contents are still good */
+		return (hashfilecontents(path) == hash);
+	default:
+		return False;
+	}
+}
+
+Bool
+loadsnapshot(const char *conf)
+{
+	char *path, ***strings;
+	const char *dir, *spec, *value, *dep;
+	struct timespec t0, t1, t2;
+	struct stat st;
+	SnapReader r;
+	XrmDatabase db = NULL;
+	uint32_t ndeps, nstrings, nres, i, hash, kind;
+	int64_t mtime, size;
+	unsigned n;
+	char magic[8];
+	void *map;
+	int fd;
+
+	if (!(path = snapshotpath(conf)))
+		return False;
+	freeprobes();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		free(path);
+		return False;
+	}
+	if (fstat(fd, &st) || !st.st_size) {
+		close(fd);
+		free(path);
+		return False;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		free(path);
+		return False;
+	}
+	r.p = map;
+	r.end = r.p + st.st_size;
+	r.bad = False;
+
+	strings = snapshotstrings(&n);
+	if (!rdbytes(&r, magic, sizeof(magic)) || memcmp(magic, SNAPMAGIC, sizeof(magic)))
+		goto stale;
+	ndeps = rd32(&r);
+	nstrings = rd32(&r);
+	nres = rd32(&r);
+	if (r.bad || nstrings != n + 1)
+		goto stale;
+	for (i = 0; i < ndeps; i++) {
+		mtime = rd64(&r);
+		size = rd64(&r);
+		hash = rd32(&r);
+		kind = rd32(&r);
+		if (!(dep = rdstr(&r)))
+			goto stale;
+		if (!checkdep(dep, mtime, size, hash, kind)) {
+			OPRINTF("configuration snapshot %s is stale: %s changed\n", path, dep);
+			goto stale;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	/* the working directory the files were read from, then the config strings */
+	dir = rdstr(&r);
+	for (i = 0; i < n; i++) {
+		value = rdstr(&r);
+		if (r.bad)
+			goto stale;
+		free(*strings[i]);
+		*strings[i] = value ? strdup(value) : NULL;
+	}
+	for (i = 0; i < nres; i++) {
+		spec = rdstr(&r);
+		value = rdstr(&r);
+		if (!spec || !value)
+			goto stale;
+		XrmPutStringResource(&db, spec, value);
+	}
+	if (r.bad)
+		goto stale;
+	if (dir && chdir(dir))
+		XPRINTF("Could not change directory to %s: %s\n", dir, strerror(errno));
+	if (xrdb)
+		XrmDestroyDatabase(xrdb);
+	xresdb = xrdb = db;
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	OPRINTF("read configuration snapshot %s: %u files checked in %.3f ms, "
+		"%u resources loaded in %.3f ms\n", path, ndeps,
+		(t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0,
+		nres, (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_nsec - t1.tv_nsec) / 1000000.0);
+	munmap(map, st.st_size);
+	free(path);
+	return True;
+      stale:
+	if (r.bad)
+		EPRINTF("configuration snapshot %s is corrupt\n", path);
+	if (db)
+		XrmDestroyDatabase(db);
+	munmap(map, st.st_size);
+	free(path);
+	return False;
+}
+
+/* writing */
+
+static void
+wr(SnapWriter *w, const void *buf, size_t n)
+{
+	if (!w->bad && fwrite(buf, 1, n, w->f) != n)
+		w->bad = True;
+}
+
+static void
+wr32(SnapWriter *w, uint32_t v)
+{
+	wr(w, &v, sizeof(v));
+}
+
+static void
+wr64(SnapWriter *w, int64_t v)
+{
+	wr(w, &v, sizeof(v));
+}
+
+static void
+wrstr(SnapWriter *w, const char *s)
+{
+	if (!s) {
+		wr32(w, SNAPNONE);
+		return;
+	}
+	wr32(w, strlen(s));
+	wr(w, s, strlen(s) + 1);
+}
+
+static void
+wrdep(SnapWriter *w, const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st)) {
+		wr64(w, 0);
+		wr64(w, 0);
+		wr32(w, 0);
+		wr32(w, DepMissing);
+	} else if (S_ISDIR(st.st_mode)) {
+		wr64(w, mtimens(&st));
+		wr64(w, 0);
+		wr32(w, 0);
+		wr32(w, DepDir);
+	} else {
+		wr64(w, mtimens(&st));
+		wr64(w, st.st_size);
+		wr32(w, hashfilecontents(path));
+		wr32(w, DepFile);
+	}
+	wrstr(w, path);
+}
+
+static Bool
+wrresource(XrmDatabase *db, XrmBindingList bindings, XrmQuarkList quarks,
+	   XrmRepresentation *type, XrmValue *value, XPointer closure)
+{
+	SnapWriter *w = (typeof(w)) closure;
+	char spec[BUFSIZ];
+	size_t len = 0;
+	int i;
+
+	(void) db;
+	if (*type != XrmPermStringToQuark("String") || !value->addr)
+		return False;
+	for (i = 0; quarks[i] != NULLQUARK; i++)
+		len += snprintf(spec + len, sizeof(spec) - min(len, sizeof(spec)), "%s%s",
+				bindings[i] == XrmBindLoosely ? "*" : (i ? "." : ""),
+				XrmQuarkToString(quarks[i]));
+	if (len >= sizeof(spec))
+		return False;
+	wrstr(w, spec);
+	wrstr(w, value->addr);
+	w->nres++;
+	return False;		/* continue */
+}
+
+static Bool
+adddep(const char **deps, unsigned *n, unsigned max, const char *path)
+{
+	unsigned i;
+
+	if (!path || *n >= max)
+		return False;
+	for (i = 0; i < *n; i++)
+		if (!strcmp(deps[i], path))
+			return False;
+	deps[(*n)++] = path;
+	return True;
+}
+
+/*
+ * The files named by #include "FILE" lines, which XrmGetFileDatabase() reads
+ * relative to the directory of the including file.  Returns False when there
+ * are more than fit.
+ */
+static Bool
+addincludes(const char **files, unsigned *n, unsigned max, char **incs, unsigned *ninc,
+	    const char *path)
+{
+	char line[BUFSIZ], *p, *q, *inc;
+	const char *slash;
+	Bool ok = True;
+	unsigned i;
+	FILE *f;
+
+	if (!(f = fopen(path, "r")))
+		return True;
+	while (ok && fgets(line, sizeof(line), f)) {
+		for (p = line; *p == ' ' || *p == '\t'; p++) ;
+		if (*p++ != '#')
+			continue;
+		for (; *p == ' ' || *p == '\t'; p++) ;
+		if (strncmp(p, "include", 7))
+			continue;
+		for (p += 7; *p == ' ' || *p == '\t'; p++) ;
+		if (*p++ != '"' || !(q = strchr(p, '"')))
+			continue;
+		*q = '\0';
+		if (*p != '/' && (slash = strrchr(path, '/'))) {
+			inc = ecalloc((slash - path) + strlen(p) + 2, sizeof(*inc));
+			sprintf(inc, "%.*s/%s", (int) (slash - path), path, p);
+		} else
+			inc = strdup(p);
+		for (i = 0; i < *n && strcmp(files[i], inc); i++) ;
+		if (i == *n && *n < max) {
+			files[(*n)++] = inc;
+			incs[(*ninc)++] = inc;
+			continue;
+		}
+		if (i == *n)
+			ok = False;
+		free(inc);
+	}
+	fclose(f);
+	return (ok);
+}
+
+void
+savesnapshot(const char *conf, const char *dir, const char *rcfile)
+{
+	const char *files[32], *dirs[32];
+	char *path, *tmp = NULL, *p, ***strings, subdirs[32][PATH_MAX + 1], *incs[32];
+	unsigned nfiles = 0, ndirs = 0, nsub = 0, ninc = 0, n, i;
+	XrmQuark empty = NULLQUARK;
+	SnapWriter w = { NULL, 0, False };
+	long nresoff;
+
+	if (!xrdb || !(path = snapshotpath(conf))) {
+		freeprobes();
+		return;
+	}
+	strings = snapshotstrings(&n);
+
+	/* inputs: the files read, the search directories and their parents */
+	adddep(files, &nfiles, LENGTH(files), rcfile);
+	for (i = 0; i < n; i++)
+		if (*strings[i] && **strings[i] == '/')
+			adddep(files, &nfiles, LENGTH(files), *strings[i]);
+	/* nested includes are appended, and scanned in turn */
+	for (i = 0; i < nfiles; i++)
+		if (!addincludes(files, &nfiles, LENGTH(files), incs, &ninc, files[i])) {
+			XPRINTF("Too many included files for a configuration snapshot\n");
+			goto done;
+		}
+	if (nprobes > MAXPROBES) {
+		XPRINTF("Too many paths searched for a configuration snapshot\n");
+		goto done;
+	}
+	for (i = 0; i < 5; i++) {
+		if (!config.dirs[i])
+			continue;
+		adddep(dirs, &ndirs, LENGTH(dirs), config.dirs[i]);
+		snprintf(subdirs[nsub], PATH_MAX, "%sthemes", config.dirs[i]);
+		if (adddep(dirs, &ndirs, LENGTH(dirs), subdirs[nsub]))
+			nsub++;
+		snprintf(subdirs[nsub], PATH_MAX, "%sstyles", config.dirs[i]);
+		if (adddep(dirs, &ndirs, LENGTH(dirs), subdirs[nsub]))
+			nsub++;
+	}
+	for (i = 0; i < nfiles && nsub < LENGTH(subdirs); i++) {
+		snprintf(subdirs[nsub], PATH_MAX, "%s", files[i]);
+		if ((p = strrchr(subdirs[nsub], '/')) && p != subdirs[nsub]) {
+			*p = '\0';
+			if (adddep(dirs, &ndirs, LENGTH(dirs), subdirs[nsub]))
+				nsub++;
+		}
+	}
+
+	/* ${XDG_CACHE_HOME}/adwm */
+	if ((p = strrchr(path, '/'))) {
+		*p = '\0';
+		mkdir(xdgdirs.cach, 0700);
+		mkdir(path, 0700);
+		*p = '/';
+	}
+	tmp = ecalloc(strlen(path) + 16, sizeof(*tmp));
+	sprintf(tmp, "%s.%d", path, (int) getpid());
+	if (!(w.f = fopen(tmp, "wb"))) {
+		XPRINTF("Could not write %s: %s\n", tmp, strerror(errno));
+		goto done;
+	}
+	wr(&w, SNAPMAGIC, 8);
+	wr32(&w, nfiles + ndirs + nprobes);
+	wr32(&w, n + 1);
+	nresoff = ftell(w.f);
+	wr32(&w, 0);		/* nres, filled in below */
+	for (i = 0; i < nfiles; i++)
+		wrdep(&w, files[i]);
+	for (i = 0; i < ndirs; i++)
+		wrdep(&w, dirs[i]);
+	for (i = 0; i < nprobes; i++)
+		wrdep(&w, probes[i]);
+	wrstr(&w, dir);
+	for (i = 0; i < n; i++)
+		wrstr(&w, *strings[i]);
+	XrmEnumerateDatabase(xrdb, &empty, &empty, XrmEnumAllLevels, wrresource, (XPointer) &w);
+	if (!w.bad && !fseek(w.f, nresoff, SEEK_SET))
+		wr32(&w, w.nres);
+	if (fclose(w.f))
+		w.bad = True;
+	if (w.bad || rename(tmp, path)) {
+		EPRINTF("Could not write configuration snapshot %s\n", path);
+		unlink(tmp);
+	} else
+		OPRINTF("wrote configuration snapshot %s: %u resources, %u inputs\n", path,
+			w.nres, nfiles + ndirs + nprobes);
+      done:
+	for (i = 0; i < ninc; i++)
+		free(incs[i]);
+	freeprobes();
+	free(tmp);
+	free(path);
+}
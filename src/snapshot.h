@@ -0,0 +1,10 @@
+/* snapshot.c */
+
+#ifndef __LOCAL_SNAPSHOT_H__
+#define __LOCAL_SNAPSHOT_H__
+
+Bool loadsnapshot(const char *conf);
+void savesnapshot(const char *conf, const char *dir, const char *rcfile);
+void snapshotprobe(const char *path);
+
+#endif				/* __LOCAL_SNAPSHOT_H__ */
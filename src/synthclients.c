@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/Xresource.h>
+
+#include "util.h"
+
+/*
+ * Synthetic clients for benchmarking the window manager: creates a number of
+ * top-level windows that look like ordinary applications and keeps them busy.
+ * Windows get a WM_CLASS (one class per window, or -k classes shared), an
+ * optional _NET_WM_ICON with the -i sizes, and can be put in transient
+ * groups of -g windows (the first of each group being the leader).  The
+ * first -s windows are docks with partial struts along the top of the screen,
+ * like ewmhpanel.  While running, -t titles per second are changed and -m
+ * windows per second are unmapped or mapped again, round robin.  Runs for -d
+ * seconds, or until interrupted, and then prints what it did.
+ */
+
+int screen;
+Display *dpy;
+Window root;
+
+static unsigned nclients = 50;
+static const char *clas = "Synth";
+static unsigned classes = 0;		/* 0 = a class per window */
+static unsigned isizes[8];
+static unsigned nisizes = 0;
+static unsigned group = 0;		/* windows per transient group, 0 = none */
+static unsigned docks = 0;
+static double titlerate = 0.0;		/* retitles per second */
+static double churnrate = 0.0;		/* maps or unmaps per second */
+static double duration = 0.0;		/* seconds, 0 = until interrupted */
+
+static volatile sig_atomic_t running = 1;
+
+enum { NetWmName, NetWmIcon, NetWmStrutPartial, NetWmWindowType, NetWmWindowTypeDock,
+	Utf8String, WmClientLeader, NATOMS };
+
+static char *names[NATOMS] = {
+	"_NET_WM_NAME", "_NET_WM_ICON", "_NET_WM_STRUT_PARTIAL", "_NET_WM_WINDOW_TYPE",
+	"_NET_WM_WINDOW_TYPE_DOCK", "UTF8_STRING", "WM_CLIENT_LEADER"
+};
+
+static Atom atoms[NATOMS];
+
+typedef struct {
+	Window win;
+	Bool mapped;
+	unsigned titles;
+} Synth;
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+static void
+stop(int sig __attribute__((unused)))
+{
+	running = 0;
+}
+
+static void
+parsesizes(const char *arg)
+{
+	char *buf = estrdup(arg), *p, *save = NULL;
+
+	for (p = strtok_r(buf, ",", &save); p && nisizes < 8; p = strtok_r(NULL, ",", &save))
+		if ((isizes[nisizes] = strtoul(p, NULL, 0)))
+			nisizes++;
+	free(buf);
+}
+
+/* an icon of each size, in a color depending on the window */
+static void
+seticon(Window win, unsigned n)
+{
+	unsigned long len = 0, i, j, *data, *p;
+
+	for (i = 0; i < nisizes; i++)
+		len += 2 + isizes[i] * isizes[i];
+	if (!len)
+		return;
+	data = emallocz(len * sizeof(*data));
+	for (p = data, i = 0; i < nisizes; i++) {
+		*p++ = isizes[i];
+		*p++ = isizes[i];
+		for (j = 0; j < isizes[i] * isizes[i]; j++)
+			*p++ = 0xff000000UL | ((n * 0x2f4f6fUL + j) & 0xffffffUL);
+	}
+	XChangeProperty(dpy, win, atoms[NetWmIcon], XA_CARDINAL, 32, PropModeReplace,
+			(unsigned char *) data, len);
+	free(data);
+}
+
+static void
+settitle(Synth *s, unsigned n)
+{
+	char title[64];
+
+	snprintf(title, sizeof(title), "synthetic client %u (%u)", n, s->titles++);
+	XStoreName(dpy, s->win, title);
+	XChangeProperty(dpy, s->win, atoms[NetWmName], atoms[Utf8String], 8, PropModeReplace,
+			(unsigned char *) title, strlen(title));
+}
+
+static void
+setdock(Window win, unsigned n)
+{
+	long struts[12] = { 0, };
+	unsigned w = DisplayWidth(dpy, screen) / (docks ? : 1);
+
+	struts[2] = 20;			/* top */
+	struts[8] = n * w;		/* top_start_x */
+	struts[9] = (n + 1) * w - 1;	/* top_end_x */
+	XChangeProperty(dpy, win, atoms[NetWmStrutPartial], XA_CARDINAL, 32, PropModeReplace,
+			(unsigned char *) struts, 12);
+	XChangeProperty(dpy, win, atoms[NetWmWindowType], XA_ATOM, 32, PropModeReplace,
+			(unsigned char *) &atoms[NetWmWindowTypeDock], 1);
+}
+
+static void
+create(Synth *synths, unsigned n)
+{
+	Synth *s = synths + n;
+	XSetWindowAttributes wa;
+	XClassHint ch;
+	XWMHints wmh;
+	char name[32], cname[64];
+	unsigned k = classes ? n % classes : n;
+	Window leader;
+
+	wa.event_mask = StructureNotifyMask;
+	wa.background_pixel = WhitePixel(dpy, screen);
+	s->win = XCreateWindow(dpy, root, (n * 17) % 600, (n * 13) % 400, 200, 100, 0,
+			       CopyFromParent, InputOutput, CopyFromParent,
+			       CWEventMask | CWBackPixel, &wa);
+	snprintf(name, sizeof(name), "synth%u", k);
+	snprintf(cname, sizeof(cname), "%s%u", clas, k);
+	ch.res_name = name;
+	ch.res_class = cname;
+	XSetClassHint(dpy, s->win, &ch);
+	settitle(s, n);
+	seticon(s->win, n);
+	if (n < docks)
+		setdock(s->win, n);
+	else if (group > 1) {
+		leader = synths[n - (n - docks) % group].win;
+		wmh.flags = WindowGroupHint;
+		wmh.window_group = leader;
+		XSetWMHints(dpy, s->win, &wmh);
+		XChangeProperty(dpy, s->win, atoms[WmClientLeader], XA_WINDOW, 32,
+				PropModeReplace, (unsigned char *) &leader, 1);
+		if (leader != s->win)
+			XSetTransientForHint(dpy, s->win, leader);
+	}
+	XMapWindow(dpy, s->win);
+	s->mapped = True;
+}
+
+int
+main(int argc, char *argv[])
+{
+	Synth *synths;
+	double start, next, nexttitle, nextchurn, t;
+	unsigned i, ntitle = 0, nchurn = 0, titles = 0, churns = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:c:k:i:g:s:t:m:d:")) != -1) {
+		switch (c) {
+		case 'n':
+			nclients = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			clas = optarg;
+			break;
+		case 'k':
+			classes = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			parsesizes(optarg);
+			break;
+		case 'g':
+			group = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			docks = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			titlerate = strtod(optarg, NULL);
+			break;
+		case 'm':
+			churnrate = strtod(optarg, NULL);
+			break;
+		case 'd':
+			duration = strtod(optarg, NULL);
+			break;
+		default:
+			eprint("usage: synthclients [-n clients] [-c class] [-k classes] "
+			       "[-i size,...] [-g group] [-s docks] [-t titles/s] [-m maps/s] "
+			       "[-d seconds]\n");
+		}
+	}
+	if (!nclients)
+		eprint("synthclients: need at least one client\n");
+	if (docks > nclients)
+		docks = nclients;
+	dpy = XOpenDisplay(0);
+	if (!dpy)
+		eprint("synthclients: cannot open display\n");
+	screen = DefaultScreen(dpy);
+	root = RootWindow(dpy, screen);
+	XInternAtoms(dpy, names, NATOMS, False, atoms);
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	synths = emallocz(nclients * sizeof(*synths));
+	for (i = 0; i < nclients; i++)
+		create(synths, i);
+	XSync(dpy, False);
+
+	start = nexttitle = nextchurn = now();
+	while (running) {
+		t = now();
+		if (duration > 0 && t - start >= duration)
+			break;
+		if (titlerate > 0) {
+			for (; nexttitle <= t; nexttitle += 1.0 / titlerate, titles++) {
+				i = docks + ntitle++ % (nclients - docks ? : 1);
+				if (i < nclients)
+					settitle(synths + i, i);
+			}
+		}
+		if (churnrate > 0) {
+			for (; nextchurn <= t; nextchurn += 1.0 / churnrate, churns++) {
+				i = docks + nchurn++ % (nclients - docks ? : 1);
+				if (i >= nclients)
+					continue;
+				if (synths[i].mapped)
+					XUnmapWindow(dpy, synths[i].win);
+				else
+					XMapWindow(dpy, synths[i].win);
+				synths[i].mapped = !synths[i].mapped;
+			}
+		}
+		XFlush(dpy);
+		while (XPending(dpy)) {
+			XEvent ev;
+
+			XNextEvent(dpy, &ev);
+		}
+		/* sleep until the next change is due, or until events arrive */
+		next = start + (duration > 0 ? duration : 3600.0);
+		if (titlerate > 0 && nexttitle < next)
+			next = nexttitle;
+		if (churnrate > 0 && nextchurn < next)
+			next = nextchurn;
+		if ((t = next - now()) > 0) {
+			struct timeval tv = { (long) t, (long) ((t - (long) t) * 1000000) };
+			fd_set fds;
+
+			FD_ZERO(&fds);
+			FD_SET(ConnectionNumber(dpy), &fds);
+			select(ConnectionNumber(dpy) + 1, &fds, NULL, NULL, &tv);
+		}
+	}
+	t = now() - start;
+	printf("synthclients: %u clients (%u docks) for %.2f s: %u retitles (%.1f/s), "
+	       "%u maps/unmaps (%.1f/s)\n", nclients, docks, t, titles, t > 0 ? titles / t : 0.0,
+	       churns, t > 0 ? churns / t : 0.0);
+	for (i = 0; i < nclients; i++)
+		XDestroyWindow(dpy, synths[i].win);
+	free(synths);
+	XCloseDisplay(dpy);
+	return 0;
+}
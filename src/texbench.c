@@ -0,0 +1,480 @@
+/* See COPYING file for copyright and license details. */
+
+/* always the ARGB generators, which are what the row kernels serve */
+#undef IMLIB2
+#undef USE_IMLIB2
+#undef DEBUG
+
+#include "adwm.h"
+#include "image.h"
+
+/*
+ * Check and benchmark the gradient row kernels (see texture.c) without a
+ * display.  texture.c is included so that its generators can be driven with
+ * each kernel set in turn.  Every pattern, gradient, relief, bevel, border and
+ * interlace combination is rendered over odd and even sizes with each vector
+ * kernel set that the CPU supports and compared pixel for pixel against the
+ * scalar kernels; then each gradient and relief is timed rendering a -w by -h
+ * texture -n times.  The texture cache behind drawtexture() is checked too:
+ * drawing a texture twice must render it once, and changing any field of the
+ * texture that changes its pixels must render it again.  Exits with a failure
+ * when any output differs or the cache returns a stale texture.
+ */
+
+Display *dpy = NULL;
+
+/* the X calls that drawtexture() makes, counted rather than made */
+static unsigned nrenders, npixmaps, ncopies, nfrees;
+
+static int
+destroyimage(XImage *image)
+{
+	(void) image;
+	return (1);
+}
+
+static XImage stubimage = { .f = { .destroy_image = destroyimage } };
+
+Pixmap
+XCreatePixmap(Display *display, Drawable d, unsigned width, unsigned height,
+	      unsigned depth)
+{
+	(void) display;
+	(void) d;
+	(void) width;
+	(void) height;
+	(void) depth;
+	return (++npixmaps);
+}
+
+int
+XCopyArea(Display *display, Drawable src, Drawable dest, GC gc, int src_x, int src_y,
+	  unsigned width, unsigned height, int dest_x, int dest_y)
+{
+	(void) display;
+	(void) src;
+	(void) dest;
+	(void) gc;
+	(void) src_x;
+	(void) src_y;
+	(void) width;
+	(void) height;
+	(void) dest_x;
+	(void) dest_y;
+	ncopies++;
+	return (1);
+}
+
+int
+XFreePixmap(Display *display, Pixmap pixmap)
+{
+	(void) display;
+	(void) pixmap;
+	nfrees++;
+	return (1);
+}
+
+void *
+ecalloc(size_t nmemb, size_t size)
+{
+	void *res;
+
+	if (!(res = calloc(nmemb, size))) {
+		fprintf(stderr, "texbench: out of memory\n");
+		exit(1);
+	}
+	return res;
+}
+
+XImage *
+renderimage(AScreen *ds, const ARGB *argb, const unsigned width, const unsigned height)
+{
+	(void) ds;
+	(void) argb;
+	(void) width;
+	(void) height;
+	nrenders++;
+	return (&stubimage);
+}
+
+void
+putimage(Drawable d, GC gc, XImage *image, int sx, int sy, int dx, int dy,
+	 unsigned w, unsigned h)
+{
+	(void) d;
+	(void) gc;
+	(void) image;
+	(void) sx;
+	(void) sy;
+	(void) dx;
+	(void) dy;
+	(void) w;
+	(void) h;
+}
+
+#include "texture.c"
+
+static const struct {
+	Gradient gradient;
+	const char *name;
+} gradients[] = {
+	{ GradientDiagonal, "diagonal" },
+	{ GradientCrossDiagonal, "crossdiagonal" },
+	{ GradientRectangle, "rectangle" },
+	{ GradientPyramid, "pyramid" },
+	{ GradientPipeCross, "pipecross" },
+	{ GradientElliptic, "elliptic" },
+	{ GradientMirrorHorizontal, "mirrorhorizontal" },
+	{ GradientHorizontal, "horizontal" },
+	{ GradientSplitVertical, "splitvertical" },
+	{ GradientVertical, "vertical" },
+};
+
+static const struct {
+	Relief relief;
+	const char *name;
+} reliefs[] = {
+	{ ReliefRaised, "raised" },
+	{ ReliefFlat, "flat" },
+	{ ReliefSunken, "sunken" },
+};
+
+/* odd sizes take the vector tails and the odd mirror and reflect paths */
+static const unsigned sizes[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 100 };
+
+/* color pairs rising, falling and mixed per channel, plus the extremes */
+static const unsigned char colors[][6] = {
+	{ 0x00, 0x00, 0x00, 0xff, 0xff, 0xff },
+	{ 0xff, 0xff, 0xff, 0x00, 0x00, 0x00 },
+	{ 0x20, 0xc0, 0x70, 0xe0, 0x10, 0x70 },
+	{ 0x9a, 0x3c, 0xf1, 0x41, 0xd7, 0x05 },
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0);
+}
+
+static void
+render(const GradientKernels *k, const Texture *t, ARGB *data, unsigned w, unsigned h,
+       unsigned char alpha)
+{
+	kernels = k;
+	memset(data, 0, (size_t) w * h * sizeof(*data));
+	drawpattern(t, w, h, data, alpha);
+}
+
+/* compare a kernel set against the scalar kernels; prints and returns True when it differs */
+static Bool
+differs(const GradientKernels *k, const Texture *t, ARGB *ref, ARGB *out, unsigned w,
+	unsigned h, unsigned char alpha)
+{
+	render(&scalarkernels, t, ref, w, h, alpha);
+	render(k, t, out, w, h, alpha);
+	if (!memcmp(ref, out, (size_t) w * h * sizeof(*out)))
+		return False;
+	printf("%s differs: pattern %d gradient %d relief %d bevel %d interlaced %d border %d "
+	       "width %d alpha 0x%02x %ux%u\n", k->name, t->appearance.pattern,
+	       t->appearance.gradient, t->appearance.relief, t->appearance.bevel,
+	       t->appearance.interlaced, t->appearance.border, t->borderWidth, alpha, w, h);
+	return True;
+}
+
+static Bool
+check(const GradientKernels *k)
+{
+	static ARGB ref[100 * 100], out[100 * 100];
+	unsigned g, r, c, i, j, flags, failed = 0;
+	Texture t;
+
+	for (g = 0; g <= LENGTH(gradients); g++) {
+		for (r = 0; r < LENGTH(reliefs); r++) {
+			for (flags = 0; flags < 8; flags++) {
+				for (c = 0; c < LENGTH(colors); c++) {
+					memset(&t, 0, sizeof(t));
+					/* one past the gradients is a solid texture */
+					if (g < LENGTH(gradients)) {
+						t.appearance.pattern = PatternGradient;
+						t.appearance.gradient = gradients[g].gradient;
+					} else
+						t.appearance.pattern = PatternSolid;
+					t.appearance.relief = reliefs[r].relief;
+					t.appearance.bevel = (flags & 0x1) ? Bevel2 : Bevel1;
+					t.appearance.interlaced = (flags & 0x2) ? True : False;
+					t.appearance.border = (flags & 0x4) ? True : False;
+					t.color.red = colors[c][0];
+					t.color.green = colors[c][1];
+					t.color.blue = colors[c][2];
+					t.colorTo.red = colors[c][3];
+					t.colorTo.green = colors[c][4];
+					t.colorTo.blue = colors[c][5];
+					t.borderColor = t.colorTo;
+					t.borderWidth = 1 + c;
+					for (i = 0; i < LENGTH(sizes); i++)
+						for (j = 0; j < LENGTH(sizes); j++)
+							if (differs(k, &t, ref, out, sizes[i], sizes[j],
+								    c & 0x1 ? 0x80 : 0xff)
+							    && ++failed >= 10)
+								return True;
+				}
+			}
+		}
+	}
+	return (failed != 0);
+}
+
+/* the changes to a texture that the cache must notice */
+static void
+change(Texture *t, unsigned field)
+{
+	switch (field) {
+	case 0:
+		t->appearance.pattern = PatternSolid;
+		break;
+	case 1:
+		t->appearance.gradient = GradientElliptic;
+		break;
+	case 2:
+		t->appearance.relief = ReliefSunken;
+		break;
+	case 3:
+		t->appearance.bevel = Bevel2;
+		break;
+	case 4:
+		t->appearance.interlaced = True;
+		break;
+	case 5:
+		t->appearance.border = False;
+		break;
+	case 6:
+		t->color.red ^= 0x40;
+		break;
+	case 7:
+		t->color.green ^= 0x40;
+		break;
+	case 8:
+		t->color.blue ^= 0x40;
+		break;
+	case 9:
+		t->colorTo.red ^= 0x40;
+		break;
+	case 10:
+		t->colorTo.green ^= 0x40;
+		break;
+	case 11:
+		t->colorTo.blue ^= 0x40;
+		break;
+	case 12:
+		t->borderColor.red ^= 0x40;
+		break;
+	case 13:
+		t->borderColor.green ^= 0x40;
+		break;
+	case 14:
+		t->borderColor.blue ^= 0x40;
+		break;
+	case 15:
+		t->borderWidth = 3;
+		break;
+	}
+}
+
+static const char *fields[] = {
+	"pattern", "gradient", "relief", "bevel", "interlaced", "border",
+	"color.red", "color.green", "color.blue",
+	"colorTo.red", "colorTo.green", "colorTo.blue",
+	"borderColor.red", "borderColor.green", "borderColor.blue", "borderWidth",
+};
+
+static unsigned uncopied;
+
+/* draw through the cache; returns True when the texture was rendered */
+static Bool
+draw(const AScreen *ds, const Texture *t, unsigned w, unsigned h, unsigned char alpha)
+{
+	const unsigned n = nrenders, c = ncopies;
+
+	drawtexture(ds, t, None, 0, 0, w, h, alpha);
+	if (ncopies != c + 1)
+		uncopied++;
+	return (nrenders != n);
+}
+
+static Bool
+cachecheck(void)
+{
+	static ARGB ref[40 * 20], out[40 * 20];
+	static AScreen ds;
+	unsigned f, i, failed = 0;
+	Texture base, t;
+
+	memset(&base, 0, sizeof(base));
+	base.appearance.pattern = PatternGradient;
+	base.appearance.gradient = GradientDiagonal;
+	base.appearance.relief = ReliefFlat;
+	base.appearance.bevel = Bevel1;
+	base.appearance.border = True;
+	base.color.red = 0x20;
+	base.color.green = 0x80;
+	base.color.blue = 0xc0;
+	base.colorTo.red = 0xe0;
+	base.colorTo.green = 0x60;
+	base.colorTo.blue = 0x10;
+	base.borderColor.red = 0x30;
+	base.borderColor.green = 0x50;
+	base.borderColor.blue = 0x70;
+	base.borderWidth = 1;
+
+	t = base;
+	if (!draw(&ds, &t, 40, 20, 0xff) || draw(&ds, &t, 40, 20, 0xff)) {
+		printf("cache: a texture drawn twice is not rendered exactly once\n");
+		failed++;
+	}
+	if (!draw(&ds, &t, 41, 20, 0xff) || !draw(&ds, &t, 40, 21, 0xff) ||
+	    !draw(&ds, &t, 40, 20, 0x80)) {
+		printf("cache: another size or alpha hits the cached texture\n");
+		failed++;
+	}
+	for (f = 0; f < LENGTH(fields); f++) {
+		t = base;
+		render(&scalarkernels, &t, ref, 40, 20, 0xff);
+		change(&t, f);
+		render(&scalarkernels, &t, out, 40, 20, 0xff);
+		if (!memcmp(ref, out, sizeof(out))) {
+			printf("cache: changing %s does not change the texture\n", fields[f]);
+			failed++;
+			continue;
+		}
+		/* changed in place, as a style reload does */
+		if (!draw(&ds, &t, 40, 20, 0xff)) {
+			printf("cache: changing %s hits the stale texture\n", fields[f]);
+			failed++;
+		}
+		t = base;
+		if (draw(&ds, &t, 40, 20, 0xff)) {
+			printf("cache: changing %s back misses the cached texture\n", fields[f]);
+			failed++;
+		}
+	}
+	/* eviction frees the least recently used pixmap */
+	purgetextures(NULL);
+	f = nfrees;
+	for (i = 0; i <= TEXTUREMAX; i++)
+		draw(&ds, &t, 1 + i, 20, 0xff);
+	if (nfrees != f + 1 || ntextures != TEXTUREMAX || !draw(&ds, &t, 1, 20, 0xff)) {
+		printf("cache: eviction does not drop exactly the oldest texture\n");
+		failed++;
+	}
+	purgetextures(&t);
+	if (ntextures || nfrees != npixmaps) {
+		printf("cache: purge leaves %u textures and %u pixmaps\n", ntextures,
+		       npixmaps - nfrees);
+		failed++;
+	}
+	if (uncopied) {
+		printf("cache: %u draws copied nothing\n", uncopied);
+		failed++;
+	}
+	return (failed != 0);
+}
+
+static double
+bench(const GradientKernels *k, const Texture *t, ARGB *data, unsigned w, unsigned h,
+      unsigned times)
+{
+	double start = now();
+	unsigned i;
+
+	for (i = 0; i < times; i++)
+		render(k, t, data, w, h, 0xff);
+	return ((now() - start) / times);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const GradientKernels *sets[3];
+	unsigned w = 800, h = 20, times = 1000, g, r, i, n = 0;
+	double ms[3];
+	ARGB *data;
+	Texture t;
+	int c, failed = 0;
+
+	while ((c = getopt(argc, argv, "w:h:n:")) != -1) {
+		switch (c) {
+		case 'w':
+			w = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			h = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			times = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: texbench [-w width] [-h height] [-n times]\n");
+			return (2);
+		}
+	}
+	if (!w)
+		w = 1;
+	if (!h)
+		h = 1;
+	if (!times)
+		times = 1;
+	data = ecalloc((size_t) w * h, sizeof(*data));
+
+	getkernels();		/* fills sqrttab */
+	sets[n++] = &scalarkernels;
+#ifdef X86KERNELS
+	if (__builtin_cpu_supports("sse2"))
+		sets[n++] = &sse2kernels;
+	if (__builtin_cpu_supports("avx2"))
+		sets[n++] = &avx2kernels;
+#endif
+	if (cachecheck())
+		failed = 1;
+	else
+		printf("texture cache covers every field\n");
+	for (i = 1; i < n; i++) {
+		if (check(sets[i]))
+			failed = 1;
+		else
+			printf("%s kernels match scalar kernels\n", sets[i]->name);
+	}
+
+	printf("%ux%u texture, ms per texture (%u times):", w, h, times);
+	for (i = 0; i < n; i++)
+		printf(" %s", sets[i]->name);
+	printf("\n");
+	for (g = 0; g < LENGTH(gradients); g++) {
+		for (r = 0; r < LENGTH(reliefs); r++) {
+			memset(&t, 0, sizeof(t));
+			t.appearance.pattern = PatternGradient;
+			t.appearance.gradient = gradients[g].gradient;
+			t.appearance.relief = reliefs[r].relief;
+			t.appearance.bevel = Bevel1;
+			t.color.red = colors[2][0];
+			t.color.green = colors[2][1];
+			t.color.blue = colors[2][2];
+			t.colorTo.red = colors[2][3];
+			t.colorTo.green = colors[2][4];
+			t.colorTo.blue = colors[2][5];
+			t.borderWidth = 1;
+			for (i = 0; i < n; i++)
+				ms[i] = bench(sets[i], &t, data, w, h, times);
+			printf("%-16s %-6s", gradients[g].name, reliefs[r].name);
+			for (i = 0; i < n; i++)
+				printf("  %8.4f", ms[i]);
+			if (n > 1)
+				printf("  %5.2fx", ms[n - 1] > 0 ? ms[0] / ms[n - 1] : 0.0);
+			printf("\n");
+		}
+	}
+	free(data);
+	return (failed);
+}
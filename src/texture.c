@@ -1,8 +1,14 @@
 /* See COPYING file for copyright and license details. */
 
 #include "adwm.h"
+#include "image.h"
 #include "texture.h" /* verification */
 
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#include <immintrin.h>
+#define X86KERNELS 1
+#endif
+
 #if !defined(IMLIB2) || !defined(USE_IMLIB2)
 static void solid(const Texture *t, const unsigned width, const unsigned height,
 		  ARGB *data, unsigned char alpha);
@@ -56,7 +62,7 @@ mirrorpoints(ARGB *data, const unsigned h, const unsigned width)
 	unsigned y;
 	ARGB *yp;
 	const unsigned w = (width + 1) / 2;
-	const unsigned d = (w & 0x1);
+	const unsigned d = (width & 0x1);
 
 	/* horizontally reflect points from 0 to (h-1) */
 	for (y = 0, yp = data; y < h; y++, yp += width)
@@ -71,7 +77,7 @@ reflectpoints(ARGB *data, const unsigned width, const unsigned height)
 	register const ARGB *yp;
 	register ARGB *p;
 	const unsigned h = (height + 1) / 2;
-	const unsigned d = (h & 0x1);
+	const unsigned d = (height & 0x1);
 	const size_t stride = width * sizeof(*p);
 
 	/* vertically reflect points from 0 to (w-1) */
@@ -89,7 +95,44 @@ wheelpoints(ARGB *data, const unsigned width, const unsigned height)
 	reflectpoints(data, width, height);
 }
 
-#if !defined(IMLIB2) || !defined(USE_IMLIB2)
+/*
+ * Row kernels: the per-pixel inner loops of the gradient generators and the
+ * bevel passes are factored into the row kernels below so that vectorized
+ * versions can be selected at runtime.  The scalar kernels are the reference
+ * implementation: the SSE2 and AVX2 kernels must produce identical pixels.
+ *
+ * The combining kernels take a row of the X table, one entry of the Y table,
+ * the colorTo pixel and a mask of the channels for which the combined offset
+ * is subtracted from (rather than added to) colorTo.  Table entries always
+ * have a zero alpha channel so that the alpha of colorTo passes through.
+ */
+
+typedef struct {
+	const char *name;
+	void (*add) (ARGB *p, const ARGB *xp, ARGB y, unsigned n);
+	void (*pyramid) (ARGB *p, const ARGB *xp, ARGB y, ARGB to, ARGB neg, unsigned n);
+	void (*rectangle) (ARGB *p, const ARGB *xp, ARGB y, ARGB to, ARGB neg, unsigned n);
+	void (*pipecross) (ARGB *p, const ARGB *xp, ARGB y, ARGB to, ARGB neg, unsigned n);
+	void (*elliptic) (ARGB *p, const ARGB *xp, ARGB y, ARGB to, ARGB neg, unsigned n);
+	void (*fill) (ARGB *p, ARGB v, unsigned n);
+	void (*raise) (ARGB *p, unsigned n);
+	void (*lower) (ARGB *p, unsigned n);
+} GradientKernels;
+
+static unsigned char sqrttab[511];	/* sqrt(0..255 + 0..255) */
+
+static ARGB
+negmask(const double dr, const double dg, const double db)
+{
+	const ARGB neg = {
+		.red = (dr < 0) ? 0 : 0xff,
+		.green = (dg < 0) ? 0 : 0xff,
+		.blue = (db < 0) ? 0 : 0xff,
+		.alpha = 0,
+	};
+
+	return neg;
+}
 
 static void
 sumpoint(ARGB *r, const ARGB *a, const ARGB *b)
@@ -100,32 +143,539 @@ sumpoint(ARGB *r, const ARGB *a, const ARGB *b)
 	r->alpha = a->alpha + b->alpha;
 }
 
+static void
+raisepoint(ARGB *p)
+{
+	unsigned char r, g, b;
+
+	r = p->red + (p->red >> 1);
+	if (r < p->red)
+		r = ~0;
+	g = p->green + (p->green >> 1);
+	if (g < p->green)
+		g = ~0;
+	b = p->blue + (p->blue >> 1);
+	if (b < p->blue)
+		b = ~0;
+	p->red = r;
+	p->green = g;
+	p->blue = b;
+}
+
+static void
+lowerpoint(ARGB *p)
+{
+	unsigned char r, g, b;
+
+	r = (p->red >> 2) + (p->red >> 1);
+	if (r > p->red)
+		r = 0;
+	g = (p->green >> 2) + (p->green >> 1);
+	if (g > p->green)
+		g = 0;
+	b = (p->blue >> 2) + (p->blue >> 1);
+	if (b > p->blue)
+		b = 0;
+	p->red = r;
+	p->green = g;
+	p->blue = b;
+}
+
+static void
+addrow(ARGB *p, const ARGB *xp, const ARGB y, unsigned n)
+{
+	for (; n; n--, p++, xp++)
+		sumpoint(p, xp, &y);
+}
+
+static void
+pyramidrow(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+	   unsigned n)
+{
+	for (; n; n--, p++, xp++) {
+		const unsigned char sr = xp->red + y.red;
+		const unsigned char sg = xp->green + y.green;
+		const unsigned char sb = xp->blue + y.blue;
+
+		p->red = to.red + (neg.red ? -sr : sr);
+		p->green = to.green + (neg.green ? -sg : sg);
+		p->blue = to.blue + (neg.blue ? -sb : sb);
+		p->alpha = to.alpha;
+	}
+}
+
+static void
+rectanglerow(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+	     unsigned n)
+{
+	for (; n; n--, p++, xp++) {
+		const unsigned char mr = max(xp->red, y.red);
+		const unsigned char mg = max(xp->green, y.green);
+		const unsigned char mb = max(xp->blue, y.blue);
+
+		p->red = to.red + 2 * (neg.red ? -mr : mr);
+		p->green = to.green + 2 * (neg.green ? -mg : mg);
+		p->blue = to.blue + 2 * (neg.blue ? -mb : mb);
+		p->alpha = to.alpha;
+	}
+}
+
+static void
+pipecrossrow(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+	     unsigned n)
+{
+	for (; n; n--, p++, xp++) {
+		const unsigned char mr = min(xp->red, y.red);
+		const unsigned char mg = min(xp->green, y.green);
+		const unsigned char mb = min(xp->blue, y.blue);
+
+		p->red = to.red + 2 * (neg.red ? -mr : mr);
+		p->green = to.green + 2 * (neg.green ? -mg : mg);
+		p->blue = to.blue + 2 * (neg.blue ? -mb : mb);
+		p->alpha = to.alpha;
+	}
+}
+
+static void
+ellipticrow(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+	    unsigned n)
+{
+	for (; n; n--, p++, xp++) {
+		const unsigned char sr = sqrttab[xp->red + y.red];
+		const unsigned char sg = sqrttab[xp->green + y.green];
+		const unsigned char sb = sqrttab[xp->blue + y.blue];
+
+		p->red = to.red + (neg.red ? -sr : sr);
+		p->green = to.green + (neg.green ? -sg : sg);
+		p->blue = to.blue + (neg.blue ? -sb : sb);
+		p->alpha = to.alpha;
+	}
+}
+
+static void
+fillrow(ARGB *p, const ARGB v, unsigned n)
+{
+	for (; n; n--, p++)
+		*p = v;
+}
+
+static void
+raiserow(ARGB *p, unsigned n)
+{
+	for (; n; n--, p++)
+		raisepoint(p);
+}
+
+static void
+lowerrow(ARGB *p, unsigned n)
+{
+	for (; n; n--, p++)
+		lowerpoint(p);
+}
+
+static const GradientKernels scalarkernels = {
+	.name = "scalar",
+	.add = addrow,
+	.pyramid = pyramidrow,
+	.rectangle = rectanglerow,
+	.pipecross = pipecrossrow,
+	.elliptic = ellipticrow,
+	.fill = fillrow,
+	.raise = raiserow,
+	.lower = lowerrow,
+};
+
+#ifdef X86KERNELS
+
+/*
+ * The vector kernels treat each pixel as four independent bytes.  Wrapping
+ * byte arithmetic reproduces the truncation that the scalar kernels get from
+ * storing into the 8-bit ARGB bit fields, and negation of the masked channels
+ * is done as ((v ^ neg) - neg).  Remaining pixels at the end of a row are
+ * handed to the scalar kernel.
+ */
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+static unsigned
+argbword(const ARGB v)
+{
+	unsigned w;
+
+	memcpy(&w, &v, sizeof(w));
+	return w;
+}
+
+static SSE2 __m128i
+offset_sse2(const __m128i d, const __m128i to, const __m128i neg)
+{
+	return _mm_add_epi8(to, _mm_sub_epi8(_mm_xor_si128(d, neg), neg));
+}
+
+static SSE2 __m128i
+sqrt_sse2(const __m128i v)
+{
+	return _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(v)));
+}
+
+static SSE2 void
+addrow_sse2(ARGB *p, const ARGB *xp, const ARGB y, unsigned n)
+{
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+
+		_mm_storeu_si128((__m128i *) p, _mm_add_epi8(vx, vy));
+	}
+	addrow(p, xp, y, n);
+}
+
+static SSE2 void
+pyramidrow_sse2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		unsigned n)
+{
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+	const __m128i vt = _mm_set1_epi32(argbword(to));
+	const __m128i vn = _mm_set1_epi32(argbword(neg));
+
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+		__m128i vs = _mm_add_epi8(vx, vy);
+
+		_mm_storeu_si128((__m128i *) p, offset_sse2(vs, vt, vn));
+	}
+	pyramidrow(p, xp, y, to, neg, n);
+}
+
+static SSE2 void
+rectanglerow_sse2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		  unsigned n)
+{
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+	const __m128i vt = _mm_set1_epi32(argbword(to));
+	const __m128i vn = _mm_set1_epi32(argbword(neg));
+
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+		__m128i vm = _mm_max_epu8(vx, vy);
+
+		_mm_storeu_si128((__m128i *) p, offset_sse2(_mm_add_epi8(vm, vm), vt, vn));
+	}
+	rectanglerow(p, xp, y, to, neg, n);
+}
+
+static SSE2 void
+pipecrossrow_sse2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		  unsigned n)
+{
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+	const __m128i vt = _mm_set1_epi32(argbword(to));
+	const __m128i vn = _mm_set1_epi32(argbword(neg));
+
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+		__m128i vm = _mm_min_epu8(vx, vy);
+
+		_mm_storeu_si128((__m128i *) p, offset_sse2(_mm_add_epi8(vm, vm), vt, vn));
+	}
+	pipecrossrow(p, xp, y, to, neg, n);
+}
+
+static SSE2 void
+ellipticrow_sse2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		 unsigned n)
+{
+	const __m128i vz = _mm_setzero_si128();
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+	const __m128i vt = _mm_set1_epi32(argbword(to));
+	const __m128i vn = _mm_set1_epi32(argbword(neg));
+
+	/* sums reach 510, so widen to 32 bits for the square root; truncating
+	   the single precision root gives the same integer part as double */
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(vx, vz), _mm_unpacklo_epi8(vy, vz));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(vx, vz), _mm_unpackhi_epi8(vy, vz));
+		__m128i vs;
+
+		lo = _mm_packs_epi32(sqrt_sse2(_mm_unpacklo_epi16(lo, vz)),
+				     sqrt_sse2(_mm_unpackhi_epi16(lo, vz)));
+		hi = _mm_packs_epi32(sqrt_sse2(_mm_unpacklo_epi16(hi, vz)),
+				     sqrt_sse2(_mm_unpackhi_epi16(hi, vz)));
+		vs = _mm_packus_epi16(lo, hi);
+		_mm_storeu_si128((__m128i *) p, offset_sse2(vs, vt, vn));
+	}
+	ellipticrow(p, xp, y, to, neg, n);
+}
+
+static SSE2 void
+fillrow_sse2(ARGB *p, const ARGB v, unsigned n)
+{
+	const __m128i vv = _mm_set1_epi32(argbword(v));
+
+	for (; n >= 4; n -= 4, p += 4)
+		_mm_storeu_si128((__m128i *) p, vv);
+	fillrow(p, v, n);
+}
+
+static SSE2 void
+raiserow_sse2(ARGB *p, unsigned n)
+{
+	const ARGB alpha = {.alpha = 0xff };
+	const __m128i va = _mm_set1_epi32(argbword(alpha));
+	const __m128i v7 = _mm_set1_epi8(0x7f);
+
+	for (; n >= 4; n -= 4, p += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		__m128i r = _mm_adds_epu8(v, _mm_and_si128(_mm_srli_epi16(v, 1), v7));
+
+		r = _mm_or_si128(_mm_andnot_si128(va, r), _mm_and_si128(va, v));
+		_mm_storeu_si128((__m128i *) p, r);
+	}
+	raiserow(p, n);
+}
+
+static SSE2 void
+lowerrow_sse2(ARGB *p, unsigned n)
+{
+	const ARGB alpha = {.alpha = 0xff };
+	const __m128i va = _mm_set1_epi32(argbword(alpha));
+	const __m128i v3 = _mm_set1_epi8(0x3f);
+	const __m128i v7 = _mm_set1_epi8(0x7f);
+
+	for (; n >= 4; n -= 4, p += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		__m128i r = _mm_add_epi8(_mm_and_si128(_mm_srli_epi16(v, 2), v3),
+					 _mm_and_si128(_mm_srli_epi16(v, 1), v7));
+
+		r = _mm_or_si128(_mm_andnot_si128(va, r), _mm_and_si128(va, v));
+		_mm_storeu_si128((__m128i *) p, r);
+	}
+	lowerrow(p, n);
+}
+
+static const GradientKernels sse2kernels = {
+	.name = "sse2",
+	.add = addrow_sse2,
+	.pyramid = pyramidrow_sse2,
+	.rectangle = rectanglerow_sse2,
+	.pipecross = pipecrossrow_sse2,
+	.elliptic = ellipticrow_sse2,
+	.fill = fillrow_sse2,
+	.raise = raiserow_sse2,
+	.lower = lowerrow_sse2,
+};
+
+static AVX2 __m256i
+offset_avx2(const __m256i d, const __m256i to, const __m256i neg)
+{
+	return _mm256_add_epi8(to, _mm256_sub_epi8(_mm256_xor_si256(d, neg), neg));
+}
+
+static AVX2 __m256i
+sqrt_avx2(const __m128i x, const __m128i y)
+{
+	__m256i s = _mm256_add_epi32(_mm256_cvtepu8_epi32(x), _mm256_cvtepu8_epi32(y));
+
+	return _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(s)));
+}
+
+static AVX2 void
+addrow_avx2(ARGB *p, const ARGB *xp, const ARGB y, unsigned n)
+{
+	const __m256i vy = _mm256_set1_epi32(argbword(y));
+
+	for (; n >= 8; n -= 8, p += 8, xp += 8) {
+		__m256i vx = _mm256_loadu_si256((const __m256i *) xp);
+
+		_mm256_storeu_si256((__m256i *) p, _mm256_add_epi8(vx, vy));
+	}
+	addrow_sse2(p, xp, y, n);
+}
+
+static AVX2 void
+pyramidrow_avx2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		unsigned n)
+{
+	const __m256i vy = _mm256_set1_epi32(argbword(y));
+	const __m256i vt = _mm256_set1_epi32(argbword(to));
+	const __m256i vn = _mm256_set1_epi32(argbword(neg));
+
+	for (; n >= 8; n -= 8, p += 8, xp += 8) {
+		__m256i vx = _mm256_loadu_si256((const __m256i *) xp);
+		__m256i vs = _mm256_add_epi8(vx, vy);
+
+		_mm256_storeu_si256((__m256i *) p, offset_avx2(vs, vt, vn));
+	}
+	pyramidrow_sse2(p, xp, y, to, neg, n);
+}
+
+static AVX2 void
+rectanglerow_avx2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		  unsigned n)
+{
+	const __m256i vy = _mm256_set1_epi32(argbword(y));
+	const __m256i vt = _mm256_set1_epi32(argbword(to));
+	const __m256i vn = _mm256_set1_epi32(argbword(neg));
+
+	for (; n >= 8; n -= 8, p += 8, xp += 8) {
+		__m256i vx = _mm256_loadu_si256((const __m256i *) xp);
+		__m256i vm = _mm256_max_epu8(vx, vy);
+
+		_mm256_storeu_si256((__m256i *) p,
+				    offset_avx2(_mm256_add_epi8(vm, vm), vt, vn));
+	}
+	rectanglerow_sse2(p, xp, y, to, neg, n);
+}
+
+static AVX2 void
+pipecrossrow_avx2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		  unsigned n)
+{
+	const __m256i vy = _mm256_set1_epi32(argbword(y));
+	const __m256i vt = _mm256_set1_epi32(argbword(to));
+	const __m256i vn = _mm256_set1_epi32(argbword(neg));
+
+	for (; n >= 8; n -= 8, p += 8, xp += 8) {
+		__m256i vx = _mm256_loadu_si256((const __m256i *) xp);
+		__m256i vm = _mm256_min_epu8(vx, vy);
+
+		_mm256_storeu_si256((__m256i *) p,
+				    offset_avx2(_mm256_add_epi8(vm, vm), vt, vn));
+	}
+	pipecrossrow_sse2(p, xp, y, to, neg, n);
+}
+
+static AVX2 void
+ellipticrow_avx2(ARGB *p, const ARGB *xp, const ARGB y, const ARGB to, const ARGB neg,
+		 unsigned n)
+{
+	const __m128i vy = _mm_set1_epi32(argbword(y));
+	const __m128i vt = _mm_set1_epi32(argbword(to));
+	const __m128i vn = _mm_set1_epi32(argbword(neg));
+	/* gathers the low dword of each 128-bit lane after packing */
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (; n >= 4; n -= 4, p += 4, xp += 4) {
+		__m128i vx = _mm_loadu_si128((const __m128i *) xp);
+		__m256i lo = sqrt_avx2(vx, vy);
+		__m256i hi = sqrt_avx2(_mm_srli_si128(vx, 8), vy);
+		__m256i vs;
+
+		vs = _mm256_packus_epi16(_mm256_packs_epi32(lo, hi), _mm256_setzero_si256());
+		vs = _mm256_permutevar8x32_epi32(vs, order);
+		_mm_storeu_si128((__m128i *) p,
+				 offset_sse2(_mm256_castsi256_si128(vs), vt, vn));
+	}
+	ellipticrow(p, xp, y, to, neg, n);
+}
+
+static AVX2 void
+fillrow_avx2(ARGB *p, const ARGB v, unsigned n)
+{
+	const __m256i vv = _mm256_set1_epi32(argbword(v));
+
+	for (; n >= 8; n -= 8, p += 8)
+		_mm256_storeu_si256((__m256i *) p, vv);
+	fillrow_sse2(p, v, n);
+}
+
+static AVX2 void
+raiserow_avx2(ARGB *p, unsigned n)
+{
+	const ARGB alpha = {.alpha = 0xff };
+	const __m256i va = _mm256_set1_epi32(argbword(alpha));
+	const __m256i v7 = _mm256_set1_epi8(0x7f);
+
+	for (; n >= 8; n -= 8, p += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		__m256i r = _mm256_adds_epu8(v, _mm256_and_si256(_mm256_srli_epi16(v, 1), v7));
+
+		r = _mm256_blendv_epi8(r, v, va);
+		_mm256_storeu_si256((__m256i *) p, r);
+	}
+	raiserow_sse2(p, n);
+}
+
+static AVX2 void
+lowerrow_avx2(ARGB *p, unsigned n)
+{
+	const ARGB alpha = {.alpha = 0xff };
+	const __m256i va = _mm256_set1_epi32(argbword(alpha));
+	const __m256i v3 = _mm256_set1_epi8(0x3f);
+	const __m256i v7 = _mm256_set1_epi8(0x7f);
+
+	for (; n >= 8; n -= 8, p += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		__m256i r = _mm256_add_epi8(_mm256_and_si256(_mm256_srli_epi16(v, 2), v3),
+					    _mm256_and_si256(_mm256_srli_epi16(v, 1), v7));
+
+		r = _mm256_blendv_epi8(r, v, va);
+		_mm256_storeu_si256((__m256i *) p, r);
+	}
+	lowerrow_sse2(p, n);
+}
+
+static const GradientKernels avx2kernels = {
+	.name = "avx2",
+	.add = addrow_avx2,
+	.pyramid = pyramidrow_avx2,
+	.rectangle = rectanglerow_avx2,
+	.pipecross = pipecrossrow_avx2,
+	.elliptic = ellipticrow_avx2,
+	.fill = fillrow_avx2,
+	.raise = raiserow_avx2,
+	.lower = lowerrow_avx2,
+};
+
+#endif				/* X86KERNELS */
+
+static const GradientKernels *kernels = NULL;
+
+static const GradientKernels *
+getkernels(void)
+{
+	unsigned i;
+
+	if (kernels)
+		return kernels;
+	for (i = 0; i < LENGTH(sqrttab); i++)
+		sqrttab[i] = sqrt(i);
+	kernels = &scalarkernels;
+#ifdef X86KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		kernels = &avx2kernels;
+	else if (__builtin_cpu_supports("sse2"))
+		kernels = &sse2kernels;
+#endif
+	DPRINTF("using %s gradient kernels\n", kernels->name);
+	return kernels;
+}
+
+#if !defined(IMLIB2) || !defined(USE_IMLIB2)
+
 static void
 solid(const Texture *t, const unsigned width, const unsigned height, ARGB *data,
       const unsigned char alpha)
 {
-	ARGB *p = data;
-	unsigned i, j;
-
-	const unsigned char r = t->color.red;
-	const unsigned char g = t->color.green;
-	const unsigned char b = t->color.blue;
-
-	for (i = 0; i < width; i++) {
-		for (j = 0; j < height; j++) {
-			p->red = r;
-			p->green = g;
-			p->blue = b;
-			p->alpha = alpha;
-			p++;
-		}
-	}
+	const ARGB v = {
+		.red = t->color.red,
+		.green = t->color.green,
+		.blue = t->color.blue,
+		.alpha = alpha,
+	};
+
+	getkernels()->fill(data, v, width * height);
 }
 
 static void
 dgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *data,
 	  unsigned char alpha)
 {
+	const GradientKernels *k = getkernels();
 	const ARGB *xt = ecalloc(width, sizeof(*xt));
 	const ARGB *yt = ecalloc(height, sizeof(*yt));
 	ARGB *p;
@@ -186,9 +736,8 @@ dgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 	}
 
 	/* Combine tables to create gradient */
-	for (p = data, y = 0; y < height; y++)
-		for (x = 0; x < width; x++, p++)
-			sumpoint(p, xt + x, yt + y);
+	for (p = data, y = 0; y < height; y++, p += width)
+		k->add(p, xt, yt[y], width);
 	free((void *) xt);
 	free((void *) yt);
 }
@@ -197,6 +746,7 @@ static void
 cdgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *data,
 	   unsigned char alpha)
 {
+	const GradientKernels *k = getkernels();
 	const ARGB *xt = ecalloc(width, sizeof(*xt));
 	const ARGB *yt = ecalloc(height, sizeof(*yt));
 	ARGB *p;
@@ -257,9 +807,8 @@ cdgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *
 	}
 
 	/* Combine tables to create gradient */
-	for (p = data, y = 0; y < height; y++)
-		for (x = 0; x < width; x++, p++)
-			sumpoint(p, xt + x, yt + y);
+	for (p = data, y = 0; y < height; y++, p += width)
+		k->add(p, xt, yt[y], width);
 	free((void *) xt);
 	free((void *) yt);
 }
@@ -385,14 +934,14 @@ mhgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *
 static void
 smearpoints(ARGB *data, const ARGB *yt, const unsigned width, const unsigned height)
 {
-	register unsigned x, y;
+	const GradientKernels *k = getkernels();
+	register unsigned y;
 	register const ARGB *yp;
 	register ARGB *p;
 
 	/* copy column yt to all columns */
-	for (p = data, y = 0, yp = yt; y < height; y++, yp++)
-		for (x = 0; x < width; x++, p++)
-			*p = *yp;
+	for (p = data, y = 0, yp = yt; y < height; y++, yp++, p += width)
+		k->fill(p, *yp, width);
 }
 
 static void
@@ -564,11 +1113,10 @@ pgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 
 	/* Combine tables to create gradient in quadrant I */
 	{
-		const int rsign = (dr < 0) ? -1 : 1;
-		const int gsign = (dg < 0) ? -1 : 1;
-		const int bsign = (db < 0) ? -1 : 1;
+		const GradientKernels *k = getkernels();
+		const ARGB neg = negmask(dr, dg, db);
 
-		const ARGB *yp, *xp, to = {
+		const ARGB *yp, to = {
 			.red = t->colorTo.red,
 			.green = t->colorTo.green,
 			.blue = t->colorTo.blue,
@@ -576,18 +1124,8 @@ pgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 		};
 		ARGB *rp;
 
-		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width) {
-			for (p = rp, x = 0, xp = xt; x < w; x++, xp++, p++) {
-				const unsigned char sr = xp->red + yp->red;
-				const unsigned char sg = xp->green + yp->green;
-				const unsigned char sb = xp->blue + yp->blue;
-
-				p->red = to.red + ((rsign < 0) ? sr : -sr);
-				p->green = to.green + ((gsign < 0) ? sg : -sg);
-				p->blue = to.blue + ((bsign < 0) ? sb : -sb);
-				p->alpha = to.alpha;
-			}
-		}
+		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width)
+			k->pyramid(rp, xt, *yp, to, neg, w);
 	}
 
 	/* Complete other quadrants */
@@ -663,12 +1201,10 @@ rgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 
 	/* Combine tables to create gradient in quadrant I */
 	{
+		const GradientKernels *k = getkernels();
+		const ARGB neg = negmask(dr, dg, db);
 
-		const int rsign = (dr < 0) ? -2 : 2;
-		const int gsign = (dg < 0) ? -2 : 2;
-		const int bsign = (db < 0) ? -2 : 2;
-
-		const ARGB *yp, *xp, to = {
+		const ARGB *yp, to = {
 			.red = t->colorTo.red,
 			.green = t->colorTo.green,
 			.blue = t->colorTo.blue,
@@ -676,18 +1212,8 @@ rgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 		};
 		ARGB *rp;
 
-		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width) {
-			for (p = rp, x = 0, xp = xt; x < w; x++, p++, xp++) {
-				const unsigned char mr = max(xp->red, yp->red);
-				const unsigned char mg = max(xp->green, yp->green);
-				const unsigned char mb = max(xp->blue, yp->blue);
-
-				p->red = to.red + 2 * ((rsign < 0) ? mr : -mr);
-				p->green = to.green + 2 * ((gsign < 0) ? mg : -mg);
-				p->blue = to.blue + 2 * ((bsign < 0) ? mb : -mb);
-				p->alpha = to.alpha;
-			}
-		}
+		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width)
+			k->rectangle(rp, xt, *yp, to, neg, w);
 	}
 
 	/* Complete other quadrants */
@@ -703,79 +1229,74 @@ pcgradient(const Texture *t, const unsigned width, const unsigned height, ARGB *
 	/* pipe cross gradient - based on original dgradient, written by Mosfet
 	   (mosfet@kde.org) adapted from kde sources for Blackbox by Brad Hughes */
 
-	double drx, dgx, dbx, dry, dgy, dby, xr, xg, xb, yr, yg, yb;
-	int rsign, gsign, bsign;
-	unsigned tr = t->colorTo.red;
-	unsigned tg = t->colorTo.green;
-	unsigned tb = t->colorTo.blue;
+	const ARGB *xt = ecalloc(width, sizeof(*xt));
+	const ARGB *yt = ecalloc(height, sizeof(*yt));
+	ARGB *p;
 	unsigned x, y;
 
-	const unsigned dimension = max(width, height);
-	unsigned *xt[3], *yt[3];
+	const double dr = t->colorTo.red - t->color.red;
+	const double dg = t->colorTo.green - t->color.green;
+	const double db = t->colorTo.blue - t->color.blue;
 
-	unsigned *alloc = calloc(dimension * 6, sizeof(*alloc));
+	/* Create X table */
+	{
+		const double drx = dr / (double) width;
+		const double dgx = dg / (double) width;
+		const double dbx = db / (double) width;
 
-	ARGB *p = data;
+		double xr = dr / 2;
+		double xg = dg / 2;
+		double xb = db / 2;
 
-	xt[0] = alloc + (dimension * 0);
-	xt[1] = alloc + (dimension * 1);
-	xt[2] = alloc + (dimension * 2);
-	yt[0] = alloc + (dimension * 3);
-	yt[1] = alloc + (dimension * 4);
-	yt[2] = alloc + (dimension * 5);
+		for (x = 0, p = (ARGB *) xt; x < width; x++, p++) {
+			p->red = fabs(xr);
+			p->green = fabs(xg);
+			p->blue = fabs(xb);
 
-	dry = drx = t->colorTo.red - t->color.red;
-	dgy = dgx = t->colorTo.green - t->color.green;
-	dby = dbx = t->colorTo.blue - t->color.blue;
+			xr -= drx;
+			xg -= dgx;
+			xb -= dbx;
+		}
+	}
 
-	rsign = (drx < 0) ? -2 : 2;
-	gsign = (dgx < 0) ? -2 : 2;
-	bsign = (dbx < 0) ? -2 : 2;
+	/* Create Y table */
+	{
+		const double dry = dr / (double) height;
+		const double dgy = dg / (double) height;
+		const double dby = db / (double) height;
 
-	xr = yr = drx / 2;
-	xg = yg = dgx / 2;
-	xb = yb = dbx / 2;
+		double yr = dr / 2;
+		double yg = dg / 2;
+		double yb = db / 2;
 
-	/* Create X table */
-	drx /= width;
-	dgx /= width;
-	dbx /= width;
-
-	for (x = 0; x < width; ++x) {
-		xt[0][x] = fabs(xr);
-		xt[1][x] = fabs(xg);
-		xt[2][x] = fabs(xb);
-
-		xr -= drx;
-		xg -= dgx;
-		xb -= dbx;
-	}
+		for (y = 0, p = (ARGB *) yt; y < height; y++, p++) {
+			p->red = fabs(yr);
+			p->green = fabs(yg);
+			p->blue = fabs(yb);
 
-	/* Create Y table */
-	dry /= height;
-	dgy /= height;
-	dby /= height;
-
-	for (y = 0; y < height; ++y) {
-		yt[0][y] = fabs(yr);
-		yt[1][y] = fabs(yg);
-		yt[2][y] = fabs(yb);
-
-		yr -= dry;
-		yg -= dgy;
-		yb -= dby;
+			yr -= dry;
+			yg -= dgy;
+			yb -= dby;
+		}
 	}
 
 	/* Combine tables to create gradient */
-	for (y = 0; y < height; ++y) {
-		for (x = 0; x < width; ++x, ++p) {
-			p->red = tr - (rsign * min(xt[0][x], yt[0][y]));
-			p->green = tg - (gsign * min(xt[1][x], yt[1][y]));
-			p->blue = tb - (bsign * min(xt[2][x], yt[2][y]));
-			p->alpha = 0xff;
-		}
+	{
+		const GradientKernels *k = getkernels();
+		const ARGB neg = negmask(dr, dg, db);
+
+		const ARGB to = {
+			.red = t->colorTo.red,
+			.green = t->colorTo.green,
+			.blue = t->colorTo.blue,
+			.alpha = 0xff,
+		};
+
+		for (p = data, y = 0; y < height; y++, p += width)
+			k->pipecross(p, xt, yt[y], to, neg, width);
 	}
-	free(alloc);
+	free((void *) xt);
+	free((void *) yt);
 }
 
 static void
@@ -842,11 +1363,10 @@ egradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 
 	/* Combine tables to create gradient in quadrant I */
 	{
-		const int rsign = (dr < 0) ? -1 : 1;
-		const int gsign = (dg < 0) ? -1 : 1;
-		const int bsign = (db < 0) ? -1 : 1;
+		const GradientKernels *k = getkernels();
+		const ARGB neg = negmask(dr, dg, db);
 
-		const ARGB *xp, *yp, to = {
+		const ARGB *yp, to = {
 			.red = t->colorTo.red,
 			.green = t->colorTo.green,
 			.blue = t->colorTo.blue,
@@ -854,18 +1374,8 @@ egradient(const Texture *t, const unsigned width, const unsigned height, ARGB *d
 		};
 		ARGB *rp;
 
-		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width) {
-			for (p = rp, x = 0, xp = xt; x < w; x++, xp++, p++) {
-				const unsigned char sr = sqrt(xp->red + yp->red);
-				const unsigned char sg = sqrt(xp->green + yp->green);
-				const unsigned char sb = sqrt(xp->blue + yp->blue);
-
-				p->red = to.red + ((rsign < 0) ? sr : -sr);
-				p->green = to.green + ((gsign < 0) ? sg : -sg);
-				p->blue = to.blue + ((bsign < 0) ? sb : -sb);
-				p->alpha = to.alpha;
-			}
-		}
+		for (rp = data, y = 0, yp = yt; y < h; y++, yp++, rp += width)
+			k->elliptic(rp, xt, *yp, to, neg, w);
 	}
 
 	/* Complete other quadrants */
@@ -1034,53 +1544,15 @@ setpoint(ARGB *p, unsigned char r, unsigned char g, unsigned char b)
 	p->blue = b;
 }
 
-static void
-raisepoint(ARGB *p)
-{
-	unsigned char r, g, b;
-
-	r = p->red + (p->red >> 1);
-	if (r < p->red)
-		r = ~0;
-	g = p->green + (p->green >> 1);
-	if (g < p->green)
-		g = ~0;
-	b = p->blue + (p->blue >> 1);
-	if (b < p->blue)
-		b = ~0;
-	p->red = r;
-	p->green = g;
-	p->blue = b;
-}
-
-static void
-lowerpoint(ARGB *p)
-{
-	unsigned char r, g, b;
-
-	r = (p->red >> 2) + (p->red >> 1);
-	if (r > p->red)
-		r = 0;
-	g = (p->green >> 2) + (p->green >> 1);
-	if (g > p->green)
-		g = 0;
-	b = (p->blue >> 2) + (p->blue >> 1);
-	if (b > p->blue)
-		b = 0;
-	p->red = r;
-	p->green = g;
-	p->blue = b;
-}
-
 static void
 interlace(const unsigned width, const unsigned height, ARGB *data)
 {
-	register unsigned i, j;
+	const GradientKernels *k = getkernels();
+	register unsigned i;
 	register ARGB *p;
 
-	for (p = data + width, i = 1; i < height; i += 2, p += width)
-		for (j = 0; j < width; j++, p++)
-			lowerpoint(p);
+	for (p = data + width, i = 1; i < height; i += 2, p += 2 * width)
+		k->lower(p, width);
 }
 
 static void
@@ -1102,6 +1574,8 @@ border(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 		h = height;
 		break;
 	case Bevel2:
+		if (width < 3 || height < 3)
+			return;
 		x = 1;
 		y = 1;
 		w = width - 2;
@@ -1123,7 +1597,7 @@ border(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 			setpoint(data + j + w - 1, r, g, b);
 		}
 		/* bottom */
-		for (j = x + (y + h) * width; j < x + (y + h) * width + w; j++)
+		for (j = x + (y + h - 1) * width; j < x + (y + h - 1) * width + w; j++)
 			setpoint(data + j, r, g, b);
 	}
 }
@@ -1131,6 +1605,7 @@ border(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 static void
 raised(const Texture *t, const unsigned width, const unsigned height, ARGB *data)
 {
+	const GradientKernels *k = getkernels();
 	unsigned i, j, w, h, l;
 	int x, y;
 
@@ -1143,6 +1618,8 @@ raised(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 		h = height;
 		break;
 	case Bevel2:
+		if (width < 3 || height < 3)
+			return;
 		x = 1;
 		y = 1;
 		w = width - 2;
@@ -1156,24 +1633,21 @@ raised(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 		l = h / 4;
 	for (i = 0; i < l && w > 0 && h > 0; i++, x++, y++, w -= 2, h -= 2) {
 		/* top */
-		for (j = x + y * width; j < x + y * width + w; j++) {
-			raisepoint(data + j);
-		}
+		k->raise(data + x + y * width, w);
 		/* sides */
 		for (j = x + (y + 1) * width; j < x + (y + h - 1) * width; j += width) {
 			raisepoint(data + j);
 			lowerpoint(data + j + w - 1);
 		}
 		/* bottom */
-		for (j = x + (y + h) * width; j < x + (y + h) * width + w; j++) {
-			lowerpoint(data + j);
-		}
+		k->lower(data + x + (y + h - 1) * width, w);
 	}
 }
 
 static void
 sunken(const Texture *t, const unsigned width, const unsigned height, ARGB *data)
 {
+	const GradientKernels *k = getkernels();
 	unsigned i, j, w, h, l;
 	int x, y;
 
@@ -1186,6 +1660,8 @@ sunken(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 		h = height;
 		break;
 	case Bevel2:
+		if (width < 3 || height < 3)
+			return;
 		x = 1;
 		y = 1;
 		w = width - 2;
@@ -1199,22 +1675,188 @@ sunken(const Texture *t, const unsigned width, const unsigned height, ARGB *data
 		l = h / 4;
 	for (i = 0; i < l && w > 0 && h > 0; i++, x++, y++, w -= 2, h -= 2) {
 		/* top */
-		for (j = x + y * width; j < x + y * width + w; j++) {
-			lowerpoint(data + j);
-		}
+		k->lower(data + x + y * width, w);
 		/* sides */
 		for (j = x + (y + 1) * width; j < x + (y + h - 1) * width; j += width) {
 			lowerpoint(data + j);
 			raisepoint(data + j + w - 1);
 		}
 		/* bottom */
-		for (j = x + (y + h) * width; j < x + (y + h) * width + w; j++) {
-			raisepoint(data + j);
-		}
+		k->raise(data + x + (y + h - 1) * width, w);
 	}
 }
 #endif				/* !defined(IMLIB2) || !defined(USE_IMLIB2) */
 
+/*
+ * Scratch buffers: generating a texture needs a width x height ARGB buffer (and
+ * the imlib2 bevel passes need two more).  Rather than allocating and freeing
+ * these on each draw, a small pool of buffers is kept that only grows when a
+ * larger texture is drawn.
+ */
+
+#define SCRATCHMAX 4
+
+static struct {
+	ARGB *data;
+	size_t size;
+	Bool busy;
+} scratch[SCRATCHMAX];
+
+static ARGB *
+getscratch(const size_t n)
+{
+	unsigned i, j = SCRATCHMAX;
+
+	for (i = 0; i < SCRATCHMAX; i++) {
+		if (scratch[i].busy)
+			continue;
+		if (scratch[i].size >= n)
+			break;
+		if (j == SCRATCHMAX || scratch[i].size > scratch[j].size)
+			j = i;
+	}
+	if (i == SCRATCHMAX) {
+		if ((i = j) == SCRATCHMAX) {
+			/* pool exhausted: caller frees through putscratch */
+			return ecalloc(n, sizeof(ARGB));
+		}
+		free(scratch[i].data);
+		scratch[i].data = ecalloc(n, sizeof(ARGB));
+		scratch[i].size = n;
+	} else
+		memset(scratch[i].data, 0, n * sizeof(ARGB));
+	scratch[i].busy = True;
+	return scratch[i].data;
+}
+
+static void
+putscratch(ARGB *data)
+{
+	unsigned i;
+
+	for (i = 0; i < SCRATCHMAX; i++) {
+		if (scratch[i].data == data) {
+			scratch[i].busy = False;
+			return;
+		}
+	}
+	free(data);
+}
+
+/*
+ * Texture cache: rendered textures are kept as pixmaps keyed by screen,
+ * texture and size, so that titles of the same width drawn with the same
+ * texture (e.g. all of the tiled clients in a column) are only generated once.
+ * The texture is also identified by a hash of the fields that affect rendering
+ * so that a texture that is modified in place (e.g. by a style reload) does not
+ * hit stale entries.  The cache is bounded and evicts the least recently used
+ * entry.
+ */
+
+#define TEXTUREMAX 64
+
+typedef struct TextureEntry TextureEntry;
+
+struct TextureEntry {
+	TextureEntry *next;		/* next in most recently used order */
+	const AScreen *ds;
+	const Texture *t;
+	unsigned long hash;
+	unsigned width, height;
+	unsigned char alpha;
+	Pixmap pixmap;
+};
+
+static TextureEntry *textures;
+static unsigned ntextures;
+
+static unsigned long
+hashtexture(const Texture *t)
+{
+	unsigned long h = 5381;
+	unsigned i;
+	const unsigned long v[] = {
+		t->appearance.pattern, t->appearance.gradient, t->appearance.relief,
+		t->appearance.bevel, t->appearance.interlaced, t->appearance.border,
+		t->color.red, t->color.green, t->color.blue,
+		t->colorTo.red, t->colorTo.green, t->colorTo.blue,
+		t->borderColor.red, t->borderColor.green, t->borderColor.blue,
+		t->borderWidth,
+	};
+
+	for (i = 0; i < LENGTH(v); i++)
+		h = (h * 33) ^ v[i];
+	return h;
+}
+
+static Pixmap
+findtexture(const AScreen *ds, const Texture *t, const unsigned long hash,
+	    const unsigned width, const unsigned height, const unsigned char alpha)
+{
+	TextureEntry *e, **ep;
+
+	for (ep = &textures; (e = *ep); ep = &e->next) {
+		if (e->ds == ds && e->t == t && e->hash == hash && e->width == width &&
+		    e->height == height && e->alpha == alpha) {
+			/* move to front */
+			*ep = e->next;
+			e->next = textures;
+			textures = e;
+			return e->pixmap;
+		}
+	}
+	return None;
+}
+
+static void
+addtexture(const AScreen *ds, const Texture *t, const unsigned long hash,
+	   const unsigned width, const unsigned height, const unsigned char alpha,
+	   const Pixmap pixmap)
+{
+	TextureEntry *e, **ep;
+
+	if (ntextures >= TEXTUREMAX) {
+		/* evict least recently used */
+		for (ep = &textures; (*ep)->next; ep = &(*ep)->next) ;
+		e = *ep;
+		*ep = NULL;
+		XFreePixmap(dpy, e->pixmap);
+		free(e);
+		ntextures--;
+	}
+	e = ecalloc(1, sizeof(*e));
+	e->ds = ds;
+	e->t = t;
+	e->hash = hash;
+	e->width = width;
+	e->height = height;
+	e->alpha = alpha;
+	e->pixmap = pixmap;
+	e->next = textures;
+	textures = e;
+	ntextures++;
+}
+
+/*
+ * Discard cached renderings of the texture, or of all textures when t is NULL.
+ * Called when textures are freed (style reload, shutdown).
+ */
+void
+purgetextures(const Texture *t)
+{
+	TextureEntry *e, **ep;
+
+	for (ep = &textures; (e = *ep);) {
+		if (!t || e->t == t) {
+			*ep = e->next;
+			XFreePixmap(dpy, e->pixmap);
+			free(e);
+			ntextures--;
+		} else
+			ep = &e->next;
+	}
+}
+
 #ifdef IMLIB2
 
 #ifdef USE_IMLIB2
@@ -1349,7 +1991,7 @@ drawrectangle(const Texture *t, const unsigned width, const unsigned height,
 	Imlib_Image image, buffer;
 	ARGB *data;
 
-	data = ecalloc(width * height, sizeof(*data));
+	data = getscratch(width * height);
 	rgradient(t, width, height, data, alpha);
 	buffer = imlib_create_image_using_data(width, height, (DATA32 *) data);
 	imlib_context_set_operation(IMLIB_OP_COPY);
@@ -1359,7 +2001,7 @@ drawrectangle(const Texture *t, const unsigned width, const unsigned height,
 	imlib_context_set_image(buffer);
 	imlib_free_image_and_decache();
 	imlib_context_set_image(image);
-	free(data);
+	putscratch(data);
 }
 
 static void
@@ -1369,7 +2011,7 @@ drawpipecross(const Texture *t, const unsigned width, const unsigned height,
 	Imlib_Image image, buffer;
 	ARGB *data;
 
-	data = ecalloc(width * height, sizeof(*data));
+	data = getscratch(width * height);
 	pcgradient(t, width, height, data);
 	buffer = imlib_create_image_using_data(width, height, (DATA32 *) data);
 	imlib_context_set_operation(IMLIB_OP_COPY);
@@ -1379,7 +2021,7 @@ drawpipecross(const Texture *t, const unsigned width, const unsigned height,
 	imlib_context_set_image(buffer);
 	imlib_free_image_and_decache();
 	imlib_context_set_image(image);
-	free(data);
+	putscratch(data);
 }
 
 static void
@@ -1389,7 +2031,7 @@ drawelliptic(const Texture *t, const unsigned width, const unsigned height,
 	Imlib_Image image, buffer;
 	ARGB *data;
 
-	data = ecalloc(width * height, sizeof(*data));
+	data = getscratch(width * height);
 	egradient(t, width, height, data, alpha);
 	buffer = imlib_create_image_using_data(width, height, (DATA32 *) data);
 	imlib_context_set_operation(IMLIB_OP_COPY);
@@ -1399,7 +2041,7 @@ drawelliptic(const Texture *t, const unsigned width, const unsigned height,
 	imlib_context_set_image(buffer);
 	imlib_free_image_and_decache();
 	imlib_context_set_image(image);
-	free(data);
+	putscratch(data);
 }
 
 static void
@@ -1495,8 +2137,8 @@ drawsunken(const Texture *t, unsigned width, unsigned height)
 	ARGB *rdata, *ldata;
 
 	data = imlib_image_get_data_for_reading_only();
-	rdata = ecalloc(width * height, sizeof(*rdata));
-	ldata = ecalloc(width * height, sizeof(*ldata));
+	rdata = getscratch(width * height);
+	ldata = getscratch(width * height);
 	memcpy(rdata, data, width * height * sizeof(*rdata));
 	memcpy(ldata, data, width * height * sizeof(*ldata));
 
@@ -1513,10 +2155,10 @@ drawsunken(const Texture *t, unsigned width, unsigned height)
 	image = imlib_context_get_image();
 	imlib_context_set_image(rbuffer);
 	imlib_free_image();
-	free(rdata);
+	putscratch(rdata);
 	imlib_context_set_image(lbuffer);
 	imlib_free_image();
-	free(ldata);
+	putscratch(ldata);
 	imlib_context_set_image(image);
 	imlib_context_set_operation(IMLIB_OP_COPY);
 	imlib_context_set_blend(1);
@@ -1530,8 +2172,8 @@ drawraised(const Texture *t, unsigned width, unsigned height)
 	ARGB *rdata, *ldata;
 
 	data = imlib_image_get_data_for_reading_only();
-	rdata = ecalloc(width * height, sizeof(*rdata));
-	ldata = ecalloc(width * height, sizeof(*ldata));
+	rdata = getscratch(width * height);
+	ldata = getscratch(width * height);
 	memcpy(rdata, data, width * height * sizeof(*rdata));
 	memcpy(ldata, data, width * height * sizeof(*ldata));
 
@@ -1548,10 +2190,10 @@ drawraised(const Texture *t, unsigned width, unsigned height)
 	image = imlib_context_get_image();
 	imlib_context_set_image(rbuffer);
 	imlib_free_image();
-	free(rdata);
+	putscratch(rdata);
 	imlib_context_set_image(lbuffer);
 	imlib_free_image();
-	free(ldata);
+	putscratch(ldata);
 	imlib_context_set_image(image);
 	imlib_context_set_operation(IMLIB_OP_COPY);
 	imlib_context_set_blend(1);
@@ -1601,7 +2243,7 @@ drawinterlace(const Texture *t, const unsigned width, const unsigned height)
 	ARGB *p, *data;
 
 	data32 = imlib_image_get_data_for_reading_only();
-	data = ecalloc(width * height, sizeof(*data));
+	data = getscratch(width * height);
 	memcpy(data, data32, width * height * sizeof(*data));
 
 	for (p = data, y = 0; y < height; y++)
@@ -1621,7 +2263,7 @@ drawinterlace(const Texture *t, const unsigned width, const unsigned height)
 	imlib_context_set_image(buffer);
 	imlib_free_image();
 	imlib_context_set_image(image);
-	free(data);
+	putscratch(data);
 }
 
 static void
@@ -1697,7 +2339,7 @@ drawpattern(const Texture *t, unsigned width, unsigned height, const unsigned ch
 	Imlib_Image image, buffer;
 	ARGB *data;
 
-	data = ecalloc(width * height, sizeof(*data));
+	data = getscratch(width * height);
 
 	switch (t->appearance.pattern) {
 	case PatternSolid:
@@ -1770,7 +2412,7 @@ drawpattern(const Texture *t, unsigned width, unsigned height, const unsigned ch
 	imlib_context_set_image(buffer);
 	imlib_free_image();
 	imlib_context_set_image(image);
-	free(data);
+	putscratch(data);
 }
 
 #endif				/* USE_IMLIB2 */
@@ -1780,29 +2422,38 @@ drawtexture(const AScreen *ds, const Texture *t, const Drawable d, const int x,
 	    const int y, const unsigned width, const unsigned height,
 	    const unsigned char alpha)
 {
-	Imlib_Image image;
+	const unsigned long hash = hashtexture(t);
+	Pixmap pixmap;
 
-	imlib_context_push(ds->context);
+	if (!(pixmap = findtexture(ds, t, hash, width, height, alpha))) {
+		Imlib_Image image;
 
-	image = imlib_create_image(width, height);
+		imlib_context_push(ds->context);
 
-	imlib_context_set_operation(IMLIB_OP_COPY);
-	imlib_context_set_anti_alias(1);
-	imlib_context_set_dither(1);
-	imlib_context_set_blend(1);
-	imlib_context_set_image(image);
-	imlib_context_set_mask(None);
+		image = imlib_create_image(width, height);
 
-	drawpattern(t, width, height, alpha);
+		imlib_context_set_operation(IMLIB_OP_COPY);
+		imlib_context_set_anti_alias(1);
+		imlib_context_set_dither(1);
+		imlib_context_set_blend(1);
+		imlib_context_set_image(image);
+		imlib_context_set_mask(None);
 
-	imlib_context_set_drawable(d);
-	imlib_context_set_image(image);
-	imlib_context_set_mask(None);
-	imlib_render_image_on_drawable(x, y);
+		drawpattern(t, width, height, alpha);
 
-	imlib_free_image();
+		pixmap = XCreatePixmap(dpy, ds->drawable, width, height, ds->depth);
+		imlib_context_set_drawable(pixmap);
+		imlib_context_set_image(image);
+		imlib_context_set_mask(None);
+		imlib_render_image_on_drawable(0, 0);
 
-	imlib_context_pop();
+		imlib_free_image();
+
+		imlib_context_pop();
+
+		addtexture(ds, t, hash, width, height, alpha, pixmap);
+	}
+	XCopyArea(dpy, pixmap, d, ds->dc.gc, 0, 0, width, height, x, y);
 }
 
 #else				/* IMLIB2 */
@@ -1873,18 +2524,19 @@ drawpattern(const Texture *t, const unsigned width, const unsigned height, ARGB
 	}
 }
 
-void
-rendertexture(const AScreen *ds, const Texture *t, const Drawable d, const int x,
-	      const int y, const unsigned width, const unsigned height)
+static Pixmap
+rendertexture(const AScreen *ds, const ARGB *data, const unsigned width,
+	      const unsigned height)
 {
-	/* for now */
-	(void) ds;
-	(void) t;
-	(void) d;
-	(void) x;
-	(void) y;
-	(void) width;
-	(void) height;
+	XImage *image;
+	Pixmap pixmap;
+
+	if (!(image = renderimage((AScreen *) ds, data, width, height)))
+		return None;
+	pixmap = XCreatePixmap(dpy, ds->drawable, width, height, ds->depth);
+	putimage(pixmap, ds->dc.gc, image, 0, 0, 0, 0, width, height);
+	XDestroyImage(image);
+	return pixmap;
 }
 
 void
@@ -1892,12 +2544,21 @@ drawtexture(const AScreen *ds, const Texture *t, const Drawable d, const int x,
 	    const int y, const unsigned width, const unsigned height,
 	    const unsigned char alpha)
 {
-	ARGB *data;
-
-	data = ecalloc(width * height, sizeof(*data));
-	drawpattern(t, width, height, data, alpha);
-	rendertexture(ds, t, d, x, y, width, height);
-	free(data);
+	const unsigned long hash = hashtexture(t);
+	Pixmap pixmap;
+
+	if (!(pixmap = findtexture(ds, t, hash, width, height, alpha))) {
+		ARGB *data;
+
+		data = getscratch(width * height);
+		drawpattern(t, width, height, data, alpha);
+		pixmap = rendertexture(ds, data, width, height);
+		putscratch(data);
+		if (!pixmap)
+			return;
+		addtexture(ds, t, hash, width, height, alpha, pixmap);
+	}
+	XCopyArea(dpy, pixmap, d, ds->dc.gc, 0, 0, width, height, x, y);
 }
 
 #endif				/* IMLIB2 */
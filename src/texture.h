@@ -3,5 +3,9 @@
 #ifndef __LOCAL_TEXTURE_H__
 #define __LOCAL_TEXTURE_H__
 
+void drawtexture(const AScreen *ds, const Texture *t, const Drawable d, const int x,
+		 const int y, const unsigned width, const unsigned height,
+		 const unsigned char alpha);
+void purgetextures(const Texture *t);
 
 #endif				/* __LOCAL_TEXTURE_H__ */
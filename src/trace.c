@@ -0,0 +1,180 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "trace.h" /* verification */
+
+/*
+ * Binary trace ring.  With -T, the debug macros of adwm.h call traceput()
+ * rather than formatting and writing to standard error: a record is claimed
+ * with an atomic increment, so that the decoding threads can trace as well,
+ * and the ring only ever holds the last records written.  The ring is dumped
+ * to a file when adwm receives SIGUSR2, on a fatal signal and on a fatal X
+ * I/O error: everything used for the dump is async-signal-safe.  The
+ * adwmtrace program formats a dump.  The ring is only compiled in with TRACE
+ * (configure --enable-trace).
+ */
+
+#define TRACERECORDS	65536		/* default size of the ring */
+
+int tracing = 0;
+
+#ifdef TRACE
+
+static TraceRecord *ring = NULL;
+static uint64_t ringmask = 0;
+static uint64_t head = 0;		/* next record number */
+static char dumpfile[PATH_MAX + 1];
+static char dumptemp[PATH_MAX + 1];	/* written, then renamed to dumpfile */
+
+/* the call sites placed in the section by __TRACE() */
+extern const TraceSite __start_adwm_trace[];
+extern const TraceSite __stop_adwm_trace[];
+
+void
+traceput(const TraceSite *site, uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4)
+{
+	uint64_t n = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+	TraceRecord *r = ring + (n & ringmask);
+	struct timespec now;
+
+	__atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	r->time = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+	r->site = site;
+	r->args[0] = a0;
+	r->args[1] = a1;
+	r->args[2] = a2;
+	r->args[3] = a3;
+	r->args[4] = a4;
+	__atomic_store_n(&r->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+static Bool
+writeall(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, p, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return False;
+		}
+		p += n;
+		len -= n;
+	}
+	return True;
+}
+
+static Bool
+writelen(int fd, const char *s)
+{
+	uint32_t len = s ? strlen(s) : 0;
+
+	return writeall(fd, &len, sizeof(len));
+}
+
+/* write the ring to the dump file: may be called from a signal handler */
+void
+tracedump(void)
+{
+	const TraceSite *s;
+	TraceHeader h;
+	struct timespec rt, mt;
+	int fd, err = errno;
+	Bool ok;
+
+	if (!ring)
+		return;
+	/* never through a link or into a file that someone else placed there */
+	fd = open(dumptemp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd == -1 && errno == EEXIST && unlink(dumptemp) == 0)
+		fd = open(dumptemp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		errno = err;
+		return;
+	}
+	clock_gettime(CLOCK_REALTIME, &rt);
+	clock_gettime(CLOCK_MONOTONIC, &mt);
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TRACEMAGIC, sizeof(h.magic));
+	h.nsites = __stop_adwm_trace - __start_adwm_trace;
+	h.nrecords = ringmask + 1;
+	h.head = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	h.sites = (uintptr_t) __start_adwm_trace;
+	h.realtime = ((int64_t) (rt.tv_sec - mt.tv_sec) * 1000000000 + (rt.tv_nsec - mt.tv_nsec));
+	ok = writeall(fd, &h, sizeof(h));
+	for (s = __start_adwm_trace; ok && s < __stop_adwm_trace; s++) {
+		uint32_t w[2] = { s->line, s->kind };
+
+		ok = writeall(fd, w, sizeof(w)) && writelen(fd, s->file) &&
+		    writelen(fd, s->func) && writelen(fd, s->fmt) &&
+		    writeall(fd, s->file, strlen(s->file)) &&
+		    writeall(fd, s->func, strlen(s->func)) &&
+		    (!s->fmt || writeall(fd, s->fmt, strlen(s->fmt)));
+	}
+	if (ok)
+		ok = writeall(fd, ring, (ringmask + 1) * sizeof(*ring));
+	if (close(fd) || !ok || rename(dumptemp, dumpfile))
+		unlink(dumptemp);
+	errno = err;
+}
+
+static void
+tracecrash(int sig)
+{
+	tracedump();
+	raise(sig);		/* the handler was reset: die as we would have */
+}
+
+/* start tracing into a ring of (at least) the given number of records */
+void
+inittrace(unsigned records)
+{
+	static const int fatal[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+	struct sigaction sa;
+	const char *dir;
+	unsigned i, n;
+
+	if (ring)
+		return;
+	if (!(dir = getenv("XDG_RUNTIME_DIR")) || !*dir)
+		if (!(dir = getenv("TMPDIR")) || !*dir)
+			dir = "/tmp";
+	if (snprintf(dumpfile, sizeof(dumpfile), "%s/adwm-%d.trace", dir,
+		     (int) getpid()) >= (int) sizeof(dumpfile) ||
+	    snprintf(dumptemp, sizeof(dumptemp), "%s.tmp", dumpfile) >= (int) sizeof(dumptemp)) {
+		EPRINTF("trace file name in %s is too long: not tracing\n", dir);
+		return;
+	}
+	for (n = 64; n < (records ? : TRACERECORDS) && n < (1U << 24); n <<= 1) ;
+	ring = ecalloc(n, sizeof(*ring));
+	ringmask = n - 1;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = tracecrash;
+	sa.sa_flags = SA_RESETHAND;
+	sigemptyset(&sa.sa_mask);
+	for (i = 0; i < LENGTH(fatal); i++)
+		sigaction(fatal[i], &sa, NULL);
+	tracing = 1;
+	OPRINTF("tracing %u records: send SIGUSR2 to dump them to %s\n", n, dumpfile);
+}
+
+#else				/* TRACE */
+
+void
+tracedump(void)
+{
+}
+
+void
+inittrace(unsigned records)
+{
+	(void) records;
+	EPRINTF("tracing is not compiled in: configure with --enable-trace\n");
+}
+
+#endif				/* TRACE */
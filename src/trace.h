@@ -0,0 +1,28 @@
+/* trace.c */
+
+#ifndef __LOCAL_TRACE_H__
+#define __LOCAL_TRACE_H__
+
+#define TRACEMAGIC	"ADWMTRC1"
+
+/*
+ * A dump is this header, the nsites call sites of the adwm_trace section
+ * (each the line and kind as two uint32_t, then the lengths of the file,
+ * function and format names as three uint32_t and then those names without
+ * terminating nulls) and then the nrecords records of the ring, in ring
+ * order.  Record n (counting from 0) is in slot n % nrecords and is valid
+ * when its seq is n + 1.
+ */
+typedef struct {
+	char magic[8];			/* TRACEMAGIC */
+	uint32_t nsites;		/* call sites that follow */
+	uint32_t nrecords;		/* size of the ring */
+	uint64_t head;			/* records written since tracing started */
+	uint64_t sites;			/* address of the first call site */
+	int64_t realtime;		/* CLOCK_REALTIME - CLOCK_MONOTONIC, ns */
+} TraceHeader;
+
+void inittrace(unsigned records);
+void tracedump(void);
+
+#endif				/* __LOCAL_TRACE_H__ */
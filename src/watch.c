@@ -0,0 +1,365 @@
+/* See COPYING file for copyright and license details. */
+
+#include "adwm.h"
+#include "config.h"
+#include "icons.h"
+#include "watch.h" /* verification */
+
+extern AdwmPlaces config;
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+
+/*
+ * Watching the configuration and the icon directories with inotify.
+ *
+ * The directories holding the files read by initrcfile(), and the
+ * directories searched for them, are watched rather than the files
+ * themselves, which editors tend to replace.  When one of the files read, or
+ * one that would now be found in its place, is written, created, removed or
+ * renamed, a reload is scheduled for WATCHDELAY milliseconds after the last
+ * such change, so that saving several files at once or an editor's sequence
+ * of renames results in a single reload; reload() then only redoes what the
+ * change affects.
+ *
+ * The directories indexed by icons.c are watched for files being added or
+ * removed, which are applied to the icon index one at a time.
+ */
+
+#define WATCHDELAY	300		/* ms without changes before reloading */
+#define WATCHMASK	(IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+			 IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+enum { WatchConfig = (1 << 0), WatchIcons = (1 << 1) };
+
+typedef struct {
+	int wd;
+	char *path;			/* without trailing slash */
+	unsigned what;
+} Watch;
+
+static int inotifyfd = -1;
+static Watch *watches = NULL;
+static unsigned nwatches = 0;
+
+static char *cfgfiles[8];		/* configuration files read */
+static Bool pending = False;		/* reload scheduled */
+static struct timespec deadline;
+
+/* names looked for in the configuration directories */
+static const char *rcnames[] = {
+	"adwmrc", "themerc", "stylerc", "keysrc", "buttonrc", "rulerc", "dockrc",
+	"themes", "styles", NULL
+};
+
+void
+initwatch(void)
+{
+	if (inotifyfd != -1)
+		return;
+	if ((inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+		EPRINTF("could not watch configuration: %s\n", strerror(errno));
+		return;
+	}
+	OPRINTF("watching configuration and icon directories\n");
+}
+
+int
+watchfd(void)
+{
+	return (inotifyfd);
+}
+
+static void
+normalize(char *buf, size_t size, const char *path)
+{
+	size_t len;
+
+	snprintf(buf, size, "%s", path);
+	for (len = strlen(buf); len > 1 && buf[len - 1] == '/'; buf[--len] = '\0') ;
+}
+
+static Watch *
+findwatch(int wd)
+{
+	unsigned i;
+
+	for (i = 0; i < nwatches; i++)
+		if (watches[i].wd == wd)
+			return (watches + i);
+	return (NULL);
+}
+
+static void
+addwatch(const char *path, unsigned what)
+{
+	char buf[PATH_MAX + 1];
+	Watch *w;
+	int wd;
+
+	normalize(buf, sizeof(buf), path);
+	if ((wd = inotify_add_watch(inotifyfd, buf, WATCHMASK)) == -1) {
+		DPRINTF("could not watch %s: %s\n", buf, strerror(errno));
+		return;
+	}
+	/* the same directory (possibly by another path) is watched once */
+	if ((w = findwatch(wd))) {
+		w->what |= what;
+		return;
+	}
+	watches = reallocarray(watches, nwatches + 1, sizeof(*watches));
+	w = watches + nwatches++;
+	w->wd = wd;
+	w->path = strdup(buf);
+	w->what = what;
+}
+
+static void
+unmarkwatches(unsigned what)
+{
+	unsigned i;
+
+	for (i = 0; i < nwatches; i++)
+		watches[i].what &= ~what;
+}
+
+/* remove watches no longer wanted for anything */
+static void
+sweepwatches(void)
+{
+	unsigned i, j;
+
+	for (i = 0, j = 0; i < nwatches; i++) {
+		if (!watches[i].what) {
+			inotify_rm_watch(inotifyfd, watches[i].wd);
+			free(watches[i].path);
+			continue;
+		}
+		watches[j++] = watches[i];
+	}
+	nwatches = j;
+}
+
+/* (re)watch the configuration found by initrcfile(): called after each reload */
+void
+watchconfig(void)
+{
+	char *files[] = {
+		config.rcfile, config.themefile, config.stylefile, config.keysfile,
+		config.btnsfile, config.rulefile, config.dockfile
+	};
+	char dir[PATH_MAX + 1], *p;
+	unsigned i;
+
+	pending = False;
+	if (inotifyfd == -1)
+		return;
+	unmarkwatches(WatchConfig);
+	for (i = 0; i < LENGTH(files); i++) {
+		free(cfgfiles[i]);
+		cfgfiles[i] = files[i] ? strdup(files[i]) : NULL;
+		if (!files[i])
+			continue;
+		snprintf(dir, sizeof(dir), "%s", files[i]);
+		if ((p = strrchr(dir, '/')) && p != dir) {
+			*p = '\0';
+			addwatch(dir, WatchConfig);
+		}
+	}
+	for (i = 0; i < LENGTH(config.dirs); i++)
+		if (config.dirs[i])
+			addwatch(config.dirs[i], WatchConfig);
+	sweepwatches();
+}
+
+/* (re)watch the icon directories: called when the icon index is rebuilt */
+void
+watchicons(void)
+{
+	const char *dir;
+	unsigned i;
+
+	if (inotifyfd == -1)
+		return;
+	unmarkwatches(WatchIcons);
+	for (i = 0; (dir = geticondir(i)); i++)
+		addwatch(dir, WatchIcons);
+	sweepwatches();
+}
+
+static Bool
+isconfigfile(const char *dir, const char *name)
+{
+	char path[PATH_MAX + 1], buf[PATH_MAX + 1];
+	const char **n;
+	unsigned i;
+
+	if (!name)
+		return True;	/* the directory itself went away */
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int) sizeof(path))
+		return False;	/* too long to be a file that we read */
+	for (i = 0; i < LENGTH(cfgfiles); i++)
+		if (cfgfiles[i] && !strcmp(cfgfiles[i], path))
+			return True;
+	for (i = 0; i < LENGTH(config.dirs); i++) {
+		if (!config.dirs[i])
+			continue;
+		normalize(buf, sizeof(buf), config.dirs[i]);
+		if (strcmp(buf, dir))
+			continue;
+		for (n = rcnames; *n; n++)
+			if (!strcmp(*n, name))
+				return True;
+	}
+	return False;
+}
+
+static void
+schedule(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += WATCHDELAY * 1000000L;
+	deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+	deadline.tv_nsec %= 1000000000L;
+	pending = True;
+}
+
+/* read and dispatch the pending notifications */
+void
+watchevents(void)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	const char *name;
+	char path[PATH_MAX + 1];
+	unsigned what;
+	ssize_t len;
+	Watch *w;
+	char *p;
+
+	while ((len = read(inotifyfd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *) p;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				EPRINTF("missed file changes: reloading\n");
+				schedule();
+				iconfilechanged(NULL, NULL, False);
+				continue;
+			}
+			if (!(w = findwatch(ev->wd)))
+				continue;
+			if (ev->mask & IN_IGNORED) {
+				/* the directory is gone: the watch removed itself */
+				free(w->path);
+				*w = watches[--nwatches];
+				continue;
+			}
+			name = ev->len ? ev->name : NULL;
+			what = w->what;
+			/* the icon index may rewatch, moving the watches */
+			snprintf(path, sizeof(path), "%s", w->path);
+			if ((what & WatchConfig) && isconfigfile(path, name)) {
+				DPRINTF("%s/%s changed\n", path, name ? : "");
+				schedule();
+			}
+			if (what & WatchIcons)
+				iconfilechanged(path, name,
+						(ev->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) ?
+						True : False);
+		}
+	}
+	if (len == -1 && errno != EAGAIN && errno != EINTR)
+		EPRINTF("could not read file notifications: %s\n", strerror(errno));
+}
+
+/* milliseconds poll() may wait before a scheduled reload is due, -1 for none */
+int
+watchtimeout(void)
+{
+	struct timespec now;
+	long ms;
+
+	if (!pending)
+		return (-1);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec) / 1000000;
+	return (ms > 0 ? (int) ms : 0);
+}
+
+/* reload once the configuration has stopped changing */
+void
+watchexpire(void)
+{
+	if (!pending || watchtimeout() > 0)
+		return;
+	pending = False;
+	OPRINTF("configuration changed: reloading\n");
+	reload();
+}
+
+void
+freewatch(void)
+{
+	unsigned i;
+
+	if (inotifyfd == -1)
+		return;
+	for (i = 0; i < nwatches; i++)
+		free(watches[i].path);
+	free(watches);
+	watches = NULL;
+	nwatches = 0;
+	for (i = 0; i < LENGTH(cfgfiles); i++) {
+		free(cfgfiles[i]);
+		cfgfiles[i] = NULL;
+	}
+	close(inotifyfd);
+	inotifyfd = -1;
+	pending = False;
+}
+
+#else				/* HAVE_SYS_INOTIFY_H */
+
+void
+initwatch(void)
+{
+}
+
+int
+watchfd(void)
+{
+	return (-1);
+}
+
+void
+watchconfig(void)
+{
+}
+
+void
+watchicons(void)
+{
+}
+
+void
+watchevents(void)
+{
+}
+
+int
+watchtimeout(void)
+{
+	return (-1);
+}
+
+void
+watchexpire(void)
+{
+}
+
+void
+freewatch(void)
+{
+}
+
+#endif				/* HAVE_SYS_INOTIFY_H */
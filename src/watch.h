@@ -0,0 +1,15 @@
+/* watch.c */
+
+#ifndef __LOCAL_WATCH_H__
+#define __LOCAL_WATCH_H__
+
+void initwatch(void);
+int watchfd(void);
+void watchconfig(void);
+void watchicons(void);
+void watchevents(void);
+int watchtimeout(void);
+void watchexpire(void);
+void freewatch(void);
+
+#endif				/* __LOCAL_WATCH_H__ */
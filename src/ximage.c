@@ -215,6 +215,161 @@ scale_pixmap_and_mask(AScreen *ds, XImage *xdraw, XImage *xmask, int newh)
 	return (ximage);
 }
 
+/*
+ * Icon cache: converted and scaled icons are shared by the Appl, Class and
+ * Client button images of a client, and between clients, keyed by a hash of
+ * the source (pixels, or file name and modification time), the title height
+ * and the screen visual.  Entries are reference counted by the AdwmPixmaps
+ * that point at them.  The key is two independent 64-bit hashes, so that a
+ * collision of one does not show the icon of another client.
+ */
+
+typedef struct {
+	unsigned long long fnv;		/* FNV-1a */
+	unsigned long long mix;		/* rotate, xor and multiply */
+} IconKey;
+
+typedef struct IconEntry IconEntry;
+
+struct IconEntry {
+	IconEntry *next;
+	IconKey key;
+	XImage *ximage;
+	Bool ispixmap;
+	unsigned refs;
+};
+
+static IconEntry *iconcache;
+
+static IconKey
+hashbytes(IconKey h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	for (; len--; p++) {
+		h.fnv = (h.fnv ^ *p) * 0x100000001b3ULL;
+		h.mix = (((h.mix << 23) | (h.mix >> 41)) ^ *p) * 0x9e3779b97f4a7c15ULL;
+	}
+	return (h);
+}
+
+static IconKey
+iconkey(AScreen *ds, const char *kind)
+{
+	IconKey h = { 0xcbf29ce484222325ULL, 0x243f6a8885a308d3ULL };
+	int th = ds->style.titleheight - (ds->style.outline ? 1 : 0);
+	VisualID vid = XVisualIDFromVisual(ds->visual);
+
+	h = hashbytes(h, kind, strlen(kind));
+	h = hashbytes(h, &th, sizeof(th));
+	h = hashbytes(h, &ds->depth, sizeof(ds->depth));
+	return hashbytes(h, &vid, sizeof(vid));
+}
+
+static IconKey
+hashximage(IconKey h, XImage *ximage)
+{
+	size_t len;
+
+	if (!ximage)
+		return (h);
+	len = (size_t) ximage->bytes_per_line * ximage->height;
+	if (ximage->format == XYPixmap)
+		len *= ximage->depth;
+	h = hashbytes(h, &ximage->width, sizeof(ximage->width));
+	h = hashbytes(h, &ximage->height, sizeof(ximage->height));
+	h = hashbytes(h, &ximage->depth, sizeof(ximage->depth));
+	return hashbytes(h, ximage->data, len);
+}
+
+static IconKey
+hashfile(IconKey h, const char *file)
+{
+	struct stat st;
+
+	h = hashbytes(h, file, strlen(file));
+	if (!stat(file, &st)) {
+		h = hashbytes(h, &st.st_mtime, sizeof(st.st_mtime));
+		h = hashbytes(h, &st.st_size, sizeof(st.st_size));
+	}
+	return (h);
+}
+
+static IconEntry *
+findicon(IconKey key)
+{
+	IconEntry *e;
+
+	for (e = iconcache; e; e = e->next)
+		if (e->key.fnv == key.fnv && e->key.mix == key.mix)
+			return (e);
+	return (NULL);
+}
+
+static IconEntry *
+addicon(IconKey key, XImage *ximage, Bool ispixmap)
+{
+	IconEntry *e = ecalloc(1, sizeof(*e));
+
+	e->key = key;
+	e->ximage = ximage;
+	e->ispixmap = ispixmap;
+	e->next = iconcache;
+	iconcache = e;
+	return (e);
+}
+
+/* drop a reference to an icon image, destroying it with its last reference;
+ * images that are not in the cache are simply destroyed */
+static void
+releaseicon(XImage *ximage)
+{
+	IconEntry *e, **ep;
+
+	for (ep = &iconcache; (e = *ep); ep = &e->next) {
+		if (e->ximage == ximage) {
+			if (--e->refs)
+				return;
+			*ep = e->next;
+			XDestroyImage(e->ximage);
+			free(e);
+			return;
+		}
+	}
+	XDestroyImage(ximage);
+}
+
+/* point all of the client's button images at a cached icon */
+static Bool
+ximage_seticon(AScreen *ds, Client *c, IconEntry *e)
+{
+	ButtonImage **bis;
+
+	for (bis = getbuttons(c); bis && *bis; bis++) {
+		ButtonImage *bi = *bis;
+		AdwmPixmap *px = &bi->px;
+		XImage **xp = e->ispixmap ? &px->pixmap.ximage : &px->bitmap.ximage;
+
+		px->x = px->y = px->b = 0;
+		px->d = ds->depth;
+		px->w = e->ximage->width;
+		px->h = e->ximage->height;
+		XPRINTF(__CFMTS(c) "assigning ximage %p\n", __CARGS(c), e->ximage);
+		e->refs++;
+		if (*xp)
+			releaseicon(*xp);
+		*xp = e->ximage;
+		bi->present = True;
+	}
+	if (!e->refs) {
+		/* no buttons took it */
+		e->refs = 1;
+		releaseicon(e->ximage);
+		return (False);
+	}
+	return (True);
+}
+
 void
 ximage_removepixmap(AdwmPixmap *p)
 {
@@ -227,7 +382,7 @@ ximage_removepixmap(AdwmPixmap *p)
 		p->pixmap.mask = None;
 	}
 	if (p->pixmap.ximage) {
-		XDestroyImage(p->pixmap.ximage);
+		releaseicon(p->pixmap.ximage);
 		p->pixmap.ximage = NULL;
 	}
 	if (p->bitmap.draw) {
@@ -239,16 +394,16 @@ ximage_removepixmap(AdwmPixmap *p)
 		p->bitmap.mask = None;
 	}
 	if (p->bitmap.ximage) {
-		XDestroyImage(p->bitmap.ximage);
+		releaseicon(p->bitmap.ximage);
 		p->bitmap.ximage = NULL;
 	}
 }
 
 static Bool
-ximage_createicon(AScreen *ds, Client *c, XImage **xicon, XImage **xmask, Bool cropscale)
+ximage_createicon(AScreen *ds, Client *c, IconKey key, XImage **xicon,
+		  XImage **xmask, Bool cropscale)
 {
 	XImage *ximage = NULL;
-	ButtonImage **bis;
 	int th = ds->style.titleheight;
 	Bool ispixmap = ((*xicon)->depth > 1) ? True : False;
 
@@ -262,45 +417,11 @@ ximage_createicon(AScreen *ds, Client *c, XImage **xicon, XImage **xmask, Bool c
 	    : combine_pixmap_and_mask(ds, (*xicon), xmask ? (*xmask) : NULL);
 	if (!ximage) {
 		EPRINTF("could not scale or combine xicon and xmask\n");
-		goto error;
-	}
-	XPRINTF("scaled xicon to %ux%u\n", icon, mask, ximage->width, ximage->height);
-
-	for (bis = getbuttons(c); bis && *bis; bis++) {
-		ButtonImage *bi = *bis;
-		AdwmPixmap *px = &bi->px;
-
-		px->x = px->y = px->b = 0;
-		px->d = ds->depth;
-		px->w = ximage->width;
-		px->h = ximage->height;
-		if (ispixmap) {
-			if (px->pixmap.ximage) {
-				XDestroyImage(px->pixmap.ximage);
-				px->pixmap.ximage = NULL;
-			}
-			XPRINTF(__CFMTS(c) "assigning ximage %p\n", __CARGS(c), ximage);
-			if ((px->pixmap.ximage = XSubImage(ximage, 0, 0,
-							   ximage->width, ximage->height)))
-				bi->present = True;
-		} else {
-			if (px->bitmap.ximage) {
-				XDestroyImage(px->bitmap.ximage);
-				px->bitmap.ximage = NULL;
-			}
-			XPRINTF(__CFMTS(c) "assigning ximage %p\n", __CARGS(c), ximage);
-			if ((px->bitmap.ximage = XSubImage(ximage, 0, 0,
-							   ximage->width, ximage->height)))
-				bi->present = True;
-		}
+		return (False);
 	}
-	XDestroyImage(ximage);
-	return (True);
+	XPRINTF("scaled xicon to %ux%u\n", ximage->width, ximage->height);
 
-      error:
-	if (ximage)
-		XDestroyImage(ximage);
-	return (False);
+	return ximage_seticon(ds, c, addicon(key, ximage, ispixmap));
 }
 
 Bool
@@ -308,6 +429,8 @@ ximage_createbitmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 			unsigned h)
 {
 	XImage *xicon = NULL, *xmask = NULL;
+	IconKey key;
+	IconEntry *e;
 	Bool result = False;
 
 	if (!(xicon = XGetImage(dpy, icon, 0, 0, w, h, 0x1, XYPixmap))) {
@@ -318,7 +441,11 @@ ximage_createbitmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 		EPRINTF("could not get bitmap 0x%lx %ux%u\n", mask, w, h);
 		goto error;
 	}
-	result = ximage_createicon(ds, c, &xicon, &xmask, False);
+	key = hashximage(hashximage(iconkey(ds, "pixmap"), xicon), xmask);
+	if ((e = findicon(key)))
+		result = ximage_seticon(ds, c, e);
+	else
+		result = ximage_createicon(ds, c, key, &xicon, &xmask, False);
       error:
 	if (xmask)
 		XDestroyImage(xmask);
@@ -332,6 +459,8 @@ ximage_createpixmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 			unsigned h, unsigned d)
 {
 	XImage *xicon = NULL, *xmask = NULL;
+	IconKey key;
+	IconEntry *e;
 	Bool result = False;
 
 	(void) d;	/* XXX */
@@ -344,7 +473,11 @@ ximage_createpixmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsign
 		EPRINTF("could not get bitmap 0x%lx %ux%u\n", mask, w, h);
 		goto error;
 	}
-	result = ximage_createicon(ds, c, &xicon, &xmask, False);
+	key = hashximage(hashximage(iconkey(ds, "pixmap"), xicon), xmask);
+	if ((e = findicon(key)))
+		result = ximage_seticon(ds, c, e);
+	else
+		result = ximage_createicon(ds, c, key, &xicon, &xmask, False);
       error:
 	if (xmask)
 		XDestroyImage(xmask);
@@ -358,8 +491,16 @@ ximage_createdataicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data
 {
 	XImage *xicon = NULL;
 	unsigned i, j;
+	IconKey key;
+	IconEntry *e;
 	Bool result = False;
 
+	key = iconkey(ds, "data");
+	key = hashbytes(key, &w, sizeof(w));
+	key = hashbytes(key, &h, sizeof(h));
+	key = hashbytes(key, data, (size_t) w * h * sizeof(*data));
+	if ((e = findicon(key)))
+		return ximage_seticon(ds, c, e);
 	if (!(xicon = XCreateImage(dpy, ds->visual, 32, ZPixmap, 0, NULL, w, h, 8, 0))) {
 		EPRINTF("could not create image %ux%ux%u\n", w, h, 32);
 		goto error;
@@ -368,7 +509,7 @@ ximage_createdataicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data
 	for (j = 0; j < h; j++)
 		for (i = 0; i < w; i++, data++)
 			XPutPixel(xicon, i, j, *data);
-	result = ximage_createicon(ds, c, &xicon, NULL, False);
+	result = ximage_createicon(ds, c, key, &xicon, NULL, False);
       error:
 	if (xicon) {
 		free(xicon->data);
@@ -385,12 +526,16 @@ ximage_createpngicon(AScreen *ds, Client *c, const char *file)
 
 #ifdef LIBPNG
 	XImage *xicon = NULL;
+	IconKey key = hashfile(iconkey(ds, "png"), file);
+	IconEntry *e;
 
+	if ((e = findicon(key)))
+		return ximage_seticon(ds, c, e);
 	if (!(xicon = png_read_file_to_ximage(dpy, ds->visual, file))) {
 		EPRINTF("could not read png file %s\n", file);
 		goto error;
 	}
-	result = ximage_createicon(ds, c, &xicon, NULL, True);
+	result = ximage_createicon(ds, c, key, &xicon, NULL, True);
       error:
 	if (xicon) {
 		free(xicon->data);
@@ -429,8 +574,12 @@ ximage_createxpmicon(AScreen *ds, Client *c, const char *file)
 	Bool result = False;
 #ifdef XPM
 	XImage *xicon = NULL, *xmask = NULL;
+	IconKey key = hashfile(iconkey(ds, "xpm"), file);
+	IconEntry *e;
 	int status;
 
+	if ((e = findicon(key)))
+		return ximage_seticon(ds, c, e);
 	{
 		XpmAttributes xa = { 0, };
 
@@ -448,7 +597,7 @@ ximage_createxpmicon(AScreen *ds, Client *c, const char *file)
 		}
 		XpmFreeAttributes(&xa);
 	}
-	result = ximage_createicon(ds, c, &xicon, &xmask, True);
+	result = ximage_createicon(ds, c, key, &xicon, &xmask, True);
       error:
 	if (xmask)
 		XDestroyImage(xmask);
@@ -464,14 +613,18 @@ ximage_createxbmicon(AScreen *ds, Client *c, const char *file)
 	XImage *xicon = NULL;
 	unsigned w, h;
 	int x, y, status;
+	IconKey key = hashfile(iconkey(ds, "xbm"), file);
+	IconEntry *e;
 	Bool result = False;
 
+	if ((e = findicon(key)))
+		return ximage_seticon(ds, c, e);
 	status = XReadBitmapFileImage(dpy, ds->visual, file, &w, &h, &xicon, &x, &y);
 	if (status != BitmapSuccess || !xicon) {
 		EPRINTF("could not load xbm file: %s on %s\n", xbm_status_string(status), file);
 		goto error;
 	}
-	result = ximage_createicon(ds, c, &xicon, &xicon, True);
+	result = ximage_createicon(ds, c, key, &xicon, &xicon, True);
       error:
 	if (xicon)
 		XDestroyImage(xicon);
@@ -570,7 +723,7 @@ ximage_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying bitmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -621,7 +774,7 @@ ximage_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x
 			}
 			XPRINTF(__CFMTS(c) "copying pixmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -738,7 +891,7 @@ ximage_drawdockapp(AScreen *ds, Client *c)
 				ds->dc.x, ds->dc.y, ds->dc.w, ds->dc.h);
 	if (!status)
 		XPRINTF("Could not fill rectangle, error %d\n", status);
-	XPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
+	XCPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
 		ds->dc.y);
 	/* note that ParentRelative dockapps need the background set to the foregroudn */
 	XSetWindowBackground(dpy, c->frame, pixel);
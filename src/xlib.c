@@ -260,7 +260,7 @@ xlib_createbitmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsigned
 		}
 		px->pixmap.draw = XCreatePixmap(dpy, ds->drawable, w, h, ds->depth);
 		XPRINTF(__CFMTS(c) "assigning pixmap 0x%lx\n", __CARGS(c), px->pixmap.draw);
-		XPutImage(dpy, px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
+		putimage(px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
 		bi->present = True;
 	}
 	XDestroyImage(ximage);
@@ -508,7 +508,7 @@ xlib_createpixmapicon(AScreen *ds, Client *c, Pixmap icon, Pixmap mask, unsigned
 		}
 		px->pixmap.draw = XCreatePixmap(dpy, ds->drawable, w, h, ds->depth);
 		XPRINTF(__CFMTS(c) "assigning pixmap 0x%lx\n", __CARGS(c), px->pixmap.draw);
-		XPutImage(dpy, px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
+		putimage(px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
 		bi->present = True;
 	}
 	XDestroyImage(ximage);
@@ -742,7 +742,7 @@ xlib_createdataicon(AScreen *ds, Client *c, unsigned w, unsigned h, long *data)
 		}
 		px->pixmap.draw = XCreatePixmap(dpy, ds->drawable, w, h, d);
 		XPRINTF(__CFMTS(c) "assigning pixmap 0x%lx\n", __CARGS(c), px->pixmap.draw);
-		XPutImage(dpy, px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
+		putimage(px->pixmap.draw, ds->dc.gc, ximage, 0, 0, 0, 0, w, h);
 		bi->present = True;
 	}
 	XDestroyImage(ximage);
@@ -906,7 +906,7 @@ xlib_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x)
 			}
 			XPRINTF(__CFMTS(c) "copying bitmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -956,7 +956,7 @@ xlib_drawbutton(AScreen *ds, Client *c, ElementType type, XftColor *col, int x)
 			}
 			XPRINTF(__CFMTS(c) "copying pixmap ximage %dx%dx%d+%d+%d to +%d+%d\n", __CARGS(c),
 					px->w, px->h, px->d, px->x, px->y, ec->eg.x, ec->eg.y);
-			XPutImage(dpy, d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
+			putimage(d, ds->dc.gc, ximage, px->x, px->y, ec->eg.x, ec->eg.y, px->w, px->h);
 			XDestroyImage(ximage);
 			return g.w;
 		}
@@ -1175,7 +1175,7 @@ xlib_drawdockapp(AScreen *ds, Client *c)
 			ds->dc.x, ds->dc.y, ds->dc.w, ds->dc.h);
 	if (!status)
 		XPRINTF("Could not fill rectangle, error %d\n", status);
-	XPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
+	XCPRINTF(c, "Filled dockapp frame %dx%d+%d+%d\n", ds->dc.w, ds->dc.h, ds->dc.x,
 		ds->dc.y);
 	/* note that ParentRelative dockapps need the background set to the foregroudn */
 	XSetWindowBackground(dpy, c->frame, pixel);